@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <bonez/sys/time.hpp>
+#include <bonez/parsing/parsing.hpp>
+
+namespace BnZ {
+
+// Run micro benchmarks and collect their timings.
+//
+// A benchmark is a functor processing a fixed number of operations and returning a checksum of its results,
+// which prevents the compiler from optimizing the work away and allows to check that two runs computed the same thing.
+// The functor is called once to warm up caches, then repeatedly until the minimal duration is reached.
+class BenchmarkRunner {
+public:
+    struct Result {
+        std::string m_sName;
+        uint64_t m_nOperationCount = 0u; // Total number of operations processed
+        uint64_t m_nRunCount = 0u;
+        Nanoseconds m_TotalTime { 0 };
+        Nanoseconds m_MinRunTime { 0 }; // Fastest run, less sensitive to system noise than the mean
+        double m_fChecksum = 0.;
+
+        double getNanosecondsPerOperation() const {
+            return m_nOperationCount ? double(m_TotalTime.count()) / m_nOperationCount : 0.;
+        }
+
+        double getOperationsPerSecond() const {
+            return m_TotalTime.count() ? m_nOperationCount / ns2sec(m_TotalTime.count()) : 0.;
+        }
+    };
+
+    BenchmarkRunner(std::string filter, Microseconds minDuration):
+        m_sFilter(std::move(filter)), m_MinDuration(minDuration) {
+    }
+
+    bool isEnabled(const std::string& name) const {
+        return m_sFilter.empty() || name.find(m_sFilter) != std::string::npos;
+    }
+
+    template<typename BenchmarkFunctor>
+    void run(const std::string& name, std::size_t operationCountPerRun, BenchmarkFunctor&& benchmark) {
+        if(!isEnabled(name)) {
+            return;
+        }
+
+        Result result;
+        result.m_sName = name;
+        result.m_fChecksum = double(benchmark()); // Warm up
+
+        Timer totalTimer;
+        while(result.m_nRunCount == 0u || totalTimer.getMicroEllapsedTime() < m_MinDuration) {
+            Timer runTimer;
+            auto checksum = benchmark();
+            auto runTime = runTimer.getNanoEllapsedTime();
+
+            m_fChecksumSink += double(checksum);
+
+            result.m_TotalTime += runTime;
+            if(result.m_nRunCount == 0u || runTime < result.m_MinRunTime) {
+                result.m_MinRunTime = runTime;
+            }
+            result.m_nOperationCount += operationCountPerRun;
+            ++result.m_nRunCount;
+        }
+
+        std::cout << result.m_sName << "\t"
+                  << result.getNanosecondsPerOperation() << "\t"
+                  << result.getOperationsPerSecond() << "\t"
+                  << result.m_nRunCount << "\t"
+                  << result.m_fChecksum << std::endl;
+
+        m_Results.emplace_back(result);
+    }
+
+    const std::vector<Result>& getResults() const {
+        return m_Results;
+    }
+
+    void storeResults(tinyxml2::XMLElement& xml) const {
+        auto pDocument = xml.GetDocument();
+        for(const auto& result: m_Results) {
+            auto pBenchmark = pDocument->NewElement("Benchmark");
+            xml.InsertEndChild(pBenchmark);
+
+            setAttribute(*pBenchmark, "name", result.m_sName);
+            setChildAttribute(*pBenchmark, "OperationCount", result.m_nOperationCount);
+            setChildAttribute(*pBenchmark, "RunCount", result.m_nRunCount);
+            setChildAttribute(*pBenchmark, "TotalTimeNs", uint64_t(result.m_TotalTime.count()));
+            setChildAttribute(*pBenchmark, "MinRunTimeNs", uint64_t(result.m_MinRunTime.count()));
+            setChildAttribute(*pBenchmark, "NanosecondsPerOperation", result.getNanosecondsPerOperation());
+            setChildAttribute(*pBenchmark, "OperationsPerSecond", result.getOperationsPerSecond());
+            setChildAttribute(*pBenchmark, "Checksum", result.m_fChecksum);
+        }
+    }
+
+private:
+    std::string m_sFilter;
+    Microseconds m_MinDuration;
+    std::vector<Result> m_Results;
+    volatile double m_fChecksumSink = 0.;
+};
+
+}
@@ -0,0 +1,171 @@
+#include "ProceduralScene.hpp"
+
+#include <bonez/voxskel/CubicalComplex3D.hpp>
+#include <bonez/voxskel/ThinningProcessDGCI2013.hpp>
+#include <bonez/voxskel/discrete_functions.hpp>
+
+namespace BnZ {
+
+static const float ROOM_SIZE = 10.f;
+
+static void computeBBox(TriangleMesh& mesh) {
+    mesh.m_BBox = BBox3f(mesh.m_Vertices[0].position);
+    for(const auto& vertex: mesh.m_Vertices) {
+        mesh.m_BBox.grow(vertex.position);
+    }
+}
+
+// The normal of the quad is normalize(cross(u, v))
+static TriangleMesh buildQuad(const Vec3f& origin, const Vec3f& u, const Vec3f& v,
+                              uint32_t subdivisionCount, uint32_t materialID) {
+    TriangleMesh mesh;
+    mesh.m_MaterialID = materialID;
+
+    auto normal = normalize(cross(u, v));
+    auto rcpSubdivisionCount = 1.f / subdivisionCount;
+    for(auto j: range(subdivisionCount + 1)) {
+        for(auto i: range(subdivisionCount + 1)) {
+            auto texCoords = Vec2f(i, j) * rcpSubdivisionCount;
+            mesh.m_Vertices.emplace_back(origin + texCoords.x * u + texCoords.y * v, normal, texCoords);
+        }
+    }
+
+    auto getIndex = [&](uint32_t i, uint32_t j) {
+        return i + j * (subdivisionCount + 1);
+    };
+    for(auto j: range(subdivisionCount)) {
+        for(auto i: range(subdivisionCount)) {
+            mesh.m_Triangles.emplace_back(getIndex(i, j), getIndex(i + 1, j), getIndex(i + 1, j + 1));
+            mesh.m_Triangles.emplace_back(getIndex(i, j), getIndex(i + 1, j + 1), getIndex(i, j + 1));
+        }
+    }
+
+    computeBBox(mesh);
+
+    return mesh;
+}
+
+static TriangleMesh buildSphere(const Vec3f& center, float radius, uint32_t discLat, uint32_t discLong,
+                                uint32_t materialID) {
+    TriangleMesh mesh;
+    mesh.m_MaterialID = materialID;
+
+    for(auto j: range(discLat + 1)) {
+        auto theta = j * pi<float>() / discLat;
+        for(auto i: range(discLong + 1)) {
+            auto phi = i * two_pi<float>() / discLong;
+            auto normal = Vec3f(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            mesh.m_Vertices.emplace_back(center + radius * normal, normal, Vec2f(float(i) / discLong, float(j) / discLat));
+        }
+    }
+
+    auto getIndex = [&](uint32_t i, uint32_t j) {
+        return i + j * (discLong + 1);
+    };
+    for(auto j: range(discLat)) {
+        for(auto i: range(discLong)) {
+            mesh.m_Triangles.emplace_back(getIndex(i, j), getIndex(i + 1, j), getIndex(i + 1, j + 1));
+            mesh.m_Triangles.emplace_back(getIndex(i, j), getIndex(i + 1, j + 1), getIndex(i, j + 1));
+        }
+    }
+
+    computeBBox(mesh);
+
+    return mesh;
+}
+
+static float getSphereCellSize(uint32_t sphereCountPerAxis) {
+    return ROOM_SIZE / sphereCountPerAxis;
+}
+
+static float getSphereRadius(uint32_t sphereCountPerAxis) {
+    return 0.3f * getSphereCellSize(sphereCountPerAxis);
+}
+
+SceneGeometry buildProceduralGeometry(uint32_t sphereCountPerAxis, uint32_t sphereDiscretization) {
+    SceneGeometry geometry;
+
+    Material wallMaterial("walls");
+    wallMaterial.m_DiffuseReflectance = Vec3f(0.8f);
+    auto wallMaterialID = geometry.addMaterial(wallMaterial);
+
+    Material sphereMaterial("spheres");
+    sphereMaterial.m_DiffuseReflectance = Vec3f(0.4f, 0.3f, 0.2f);
+    sphereMaterial.m_GlossyReflectance = Vec3f(0.4f);
+    sphereMaterial.m_Shininess = 32.f;
+    auto sphereMaterialID = geometry.addMaterial(sphereMaterial);
+
+    Material lightMaterial("light");
+    lightMaterial.m_DiffuseReflectance = Vec3f(0.f);
+    lightMaterial.m_EmittedRadiance = Vec3f(10.f);
+    auto lightMaterialID = geometry.addMaterial(lightMaterial);
+
+    // Walls, with normals oriented toward the inside of the room
+    auto L = ROOM_SIZE;
+    auto wallSubdivisionCount = 8u;
+    geometry.append(buildQuad(Vec3f(0, 0, 0), Vec3f(0, 0, L), Vec3f(L, 0, 0), wallSubdivisionCount, wallMaterialID));
+    geometry.append(buildQuad(Vec3f(0, L, 0), Vec3f(L, 0, 0), Vec3f(0, 0, L), wallSubdivisionCount, wallMaterialID));
+    geometry.append(buildQuad(Vec3f(0, 0, 0), Vec3f(0, L, 0), Vec3f(0, 0, L), wallSubdivisionCount, wallMaterialID));
+    geometry.append(buildQuad(Vec3f(L, 0, 0), Vec3f(0, 0, L), Vec3f(0, L, 0), wallSubdivisionCount, wallMaterialID));
+    geometry.append(buildQuad(Vec3f(0, 0, 0), Vec3f(L, 0, 0), Vec3f(0, L, 0), wallSubdivisionCount, wallMaterialID));
+    geometry.append(buildQuad(Vec3f(0, 0, L), Vec3f(0, L, 0), Vec3f(L, 0, 0), wallSubdivisionCount, wallMaterialID));
+
+    // Light facing the floor
+    auto lightSize = 0.2f * L;
+    auto lightOrigin = Vec3f(0.5f * (L - lightSize), 0.999f * L, 0.5f * (L - lightSize));
+    geometry.append(buildQuad(lightOrigin, Vec3f(lightSize, 0, 0), Vec3f(0, 0, lightSize), 1u, lightMaterialID));
+
+    auto cellSize = getSphereCellSize(sphereCountPerAxis);
+    auto radius = getSphereRadius(sphereCountPerAxis);
+    for(auto k: range(sphereCountPerAxis)) {
+        for(auto j: range(sphereCountPerAxis)) {
+            for(auto i: range(sphereCountPerAxis)) {
+                auto center = (Vec3f(i, j, k) + Vec3f(0.5f)) * cellSize;
+                geometry.append(buildSphere(center, radius, sphereDiscretization, 2u * sphereDiscretization, sphereMaterialID));
+            }
+        }
+    }
+
+    geometry.extractEmissiveMeshes();
+
+    return geometry;
+}
+
+CurvilinearSkeleton buildProceduralSkeleton(uint32_t sphereCountPerAxis, uint32_t resolution) {
+    auto voxelSize = ROOM_SIZE / resolution;
+    auto cellSize = getSphereCellSize(sphereCountPerAxis);
+    auto sqrRadius = sqr(getSphereRadius(sphereCountPerAxis));
+
+    // Each sphere is centered in a cell of the grid of spheres, so only one sphere has to be tested per voxel
+    VoxelGrid voxelGrid(resolution, resolution, resolution, 0);
+    for(auto z: range(resolution)) {
+        for(auto y: range(resolution)) {
+            for(auto x: range(resolution)) {
+                auto P = (Vec3f(x, y, z) + Vec3f(0.5f)) * voxelSize;
+                auto cell = min(Vec3u(P / cellSize), Vec3u(sphereCountPerAxis - 1));
+                auto center = (Vec3f(cell) + Vec3f(0.5f)) * cellSize;
+                auto offset = P - center;
+                if(dot(offset, offset) <= sqrRadius) {
+                    voxelGrid(x, y, z) = 1;
+                }
+            }
+        }
+    }
+
+    // Same pipeline than Scene::computeDiscreteData
+    auto emptySpaceCubicalComplex = getCubicalComplex(voxelGrid, true);
+    auto skeletonCubicalComplex = emptySpaceCubicalComplex;
+    auto distanceMap = computeDistanceMap26(emptySpaceCubicalComplex, CubicalComplex3D::isInObject, true);
+    auto openingMap = parallelComputeOpeningMap26(distanceMap);
+
+    ThinningProcessDGCI2013 thinningProcess;
+    thinningProcess.init(skeletonCubicalComplex, &distanceMap, &openingMap);
+    thinningProcess.directionalCollapse();
+
+    auto gridToWorldMatrix = scale(Mat4f(1.f), Vec3f(voxelSize));
+
+    return getCurvilinearSkeleton(skeletonCubicalComplex, emptySpaceCubicalComplex,
+                                  distanceMap, openingMap, gridToWorldMatrix);
+}
+
+}
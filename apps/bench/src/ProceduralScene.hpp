@@ -0,0 +1,15 @@
+#pragma once
+
+#include <bonez/scene/Scene.hpp>
+
+namespace BnZ {
+
+// A closed room lit by an emissive quad on its ceiling and filled with a grid of spheres.
+// The geometry is built in memory so that the benchmarks don't depend on scene files.
+SceneGeometry buildProceduralGeometry(uint32_t sphereCountPerAxis, uint32_t sphereDiscretization);
+
+// Compute the curvilinear skeleton of the empty space of a procedural scene.
+// The voxelization is analytic, so no OpenGL context is required (unlike Scene::computeDiscreteData).
+CurvilinearSkeleton buildProceduralSkeleton(uint32_t sphereCountPerAxis, uint32_t resolution);
+
+}
@@ -0,0 +1,450 @@
+#include <iostream>
+
+#include <bonez/scene/Scene.hpp>
+#include <bonez/scene/raytracing/RayQueue.hpp>
+#include <bonez/scene/shading/BSDF.hpp>
+#include <bonez/sampling/shapes.hpp>
+#include <bonez/sampling/distribution1d.h>
+#include <bonez/utils/KdTree.hpp>
+#include <bonez/utils/HashGrid.hpp>
+#include <bonez/opengl/GLShaderManager.hpp>
+#include <bonez/rendering/renderers/skeleton_connection/SkeletonVisibilityDistributions.hpp>
+
+#include "BenchmarkRunner.hpp"
+#include "ProceduralScene.hpp"
+
+INITIALIZE_EASYLOGGINGPP
+
+namespace BnZ {
+
+struct BenchSettings {
+    FilePath m_OutputPath; // XML file receiving the results, if not empty
+    FilePath m_ScenePath; // Scene description file, a procedural scene is used if empty
+    std::string m_sFilter; // Only run benchmarks whose name contains this string
+    Microseconds m_MinDuration { 200000 }; // Minimal duration of each benchmark
+    uint32_t m_nSeed = 0u;
+    uint32_t m_nSphereCountPerAxis = 4u;
+    uint32_t m_nSphereDiscretization = 32u;
+    uint32_t m_nSkeletonResolution = 64u;
+    uint32_t m_nThreadCount = getSystemThreadCount();
+};
+
+struct BenchParticle {
+    Vec3f m_Position;
+
+    friend const Vec3f& getPosition(const BenchParticle& particle) {
+        return particle.m_Position;
+    }
+
+    friend bool isValid(const BenchParticle& particle) {
+        return true;
+    }
+};
+
+static Unique<Scene> loadBenchScene(const BenchSettings& settings) {
+    if(settings.m_ScenePath.empty()) {
+        auto pScene = makeUnique<Scene>(buildProceduralGeometry(settings.m_nSphereCountPerAxis,
+                                                                settings.m_nSphereDiscretization));
+        if(settings.m_nSkeletonResolution > 0u) {
+            pScene->setCurvSkeleton(buildProceduralSkeleton(settings.m_nSphereCountPerAxis,
+                                                            settings.m_nSkeletonResolution));
+        }
+        return pScene;
+    }
+
+    tinyxml2::XMLDocument document;
+    if(tinyxml2::XML_NO_ERROR != document.LoadFile(settings.m_ScenePath.c_str())) {
+        throw std::runtime_error("Unable to load scene file " + settings.m_ScenePath.str());
+    }
+    auto pScene = document.RootElement();
+    if(!pScene) {
+        throw std::runtime_error("No root element in scene's XML file");
+    }
+
+    // Computing the skeleton requires an OpenGL context: only precomputed skeletons are loaded
+    auto pCurvSkel = pScene->FirstChildElement("CurvSkel");
+    if(pCurvSkel && !pCurvSkel->Attribute("path")) {
+        std::clog << "The skeleton of the scene is not precomputed, skeleton benchmarks are disabled" << std::endl;
+        pScene->DeleteChild(pCurvSkel);
+    }
+
+    GLShaderManager shaderManager;
+    return makeUnique<Scene>(pScene, settings.m_ScenePath.directory(), shaderManager);
+}
+
+static void runBenchmarks(const BenchSettings& settings, BenchmarkRunner& runner) {
+    auto pScene = loadBenchScene(settings);
+    const auto& scene = *pScene;
+    const auto& rtScene = scene.getRTScene();
+
+    RandomGenerator rng(settings.m_nSeed);
+
+    auto bbox = scene.getBBox();
+    auto sceneDiag = computeSceneDiag(scene);
+    auto randomPoint = [&]() {
+        return bbox.lower + rng.getFloat3() * (bbox.upper - bbox.lower);
+    };
+
+    const auto rayCount = 1u << 16;
+
+    std::vector<Ray> rays;
+    rays.reserve(rayCount);
+    for(auto i = 0u; i < rayCount; ++i) {
+        auto dir = uniformSampleSphere(rng.getFloat(), rng.getFloat()).value;
+        rays.emplace_back(randomPoint(), dir);
+    }
+
+    std::vector<Ray> shadowRays;
+    shadowRays.reserve(rayCount);
+    for(auto i = 0u; i < rayCount; ++i) {
+        auto dir = uniformSampleSphere(rng.getFloat(), rng.getFloat()).value;
+        shadowRays.emplace_back(randomPoint(), dir, 0.f, rng.getFloat() * 0.5f * sceneDiag);
+    }
+
+    runner.run("RTScene.intersect", rayCount, [&]() {
+        auto checksum = 0.f;
+        RTScene::Hit hit;
+        for(const auto& ray: rays) {
+            if(rtScene.intersect(ray, hit)) {
+                checksum += hit.m_fDistance;
+            }
+        }
+        return checksum;
+    });
+
+    runner.run("RTScene.occluded", rayCount, [&]() {
+        auto checksum = 0u;
+        for(const auto& ray: shadowRays) {
+            checksum += rtScene.occluded(ray);
+        }
+        return checksum;
+    });
+
+    {
+        // The same incoherent rays traced by packets in generation order, then sorted by a RayQueue: the difference is
+        // the gain of the binning, the cost of the sort included
+        const auto blockCount = uint32_t((rayCount + RayQueue::TRACE_BLOCK_SIZE - 1) / RayQueue::TRACE_BLOCK_SIZE);
+        std::vector<Intersection> queueIntersections(rayCount);
+        Unique<bool[]> queueOcclusions(new bool[rayCount]);
+
+        runner.run("Scene.intersect.unsorted", rayCount, [&]() {
+            processTasks(blockCount, [&](uint32_t blockID, uint32_t threadID) {
+                auto start = blockID * RayQueue::TRACE_BLOCK_SIZE;
+                auto end = std::min(std::size_t(rayCount), start + RayQueue::TRACE_BLOCK_SIZE);
+                scene.intersect(rays.data() + start, end - start, queueIntersections.data() + start, threadID);
+            }, settings.m_nThreadCount);
+            auto checksum = 0.f;
+            for(const auto& I: queueIntersections) {
+                checksum += I ? I.distance : 0.f;
+            }
+            return checksum;
+        });
+
+        RayQueue rayQueue;
+        runner.run("RayQueue.intersect", rayCount, [&]() {
+            rayQueue.clear();
+            for(const auto& ray: rays) {
+                rayQueue.push(ray);
+            }
+            rayQueue.intersect(scene, queueIntersections.data(), settings.m_nThreadCount);
+            auto checksum = 0.f;
+            for(const auto& I: queueIntersections) {
+                checksum += I ? I.distance : 0.f;
+            }
+            return checksum;
+        });
+
+        runner.run("Scene.occluded.unsorted", rayCount, [&]() {
+            processTasks(blockCount, [&](uint32_t blockID, uint32_t threadID) {
+                auto start = blockID * RayQueue::TRACE_BLOCK_SIZE;
+                auto end = std::min(std::size_t(rayCount), start + RayQueue::TRACE_BLOCK_SIZE);
+                scene.occluded(shadowRays.data() + start, end - start, queueOcclusions.get() + start, threadID);
+            }, settings.m_nThreadCount);
+            auto checksum = 0u;
+            for(auto i = 0u; i < rayCount; ++i) {
+                checksum += queueOcclusions[i];
+            }
+            return checksum;
+        });
+
+        runner.run("RayQueue.occluded", rayCount, [&]() {
+            rayQueue.clear();
+            for(const auto& ray: shadowRays) {
+                rayQueue.push(ray);
+            }
+            rayQueue.occluded(scene, queueOcclusions.get(), settings.m_nThreadCount);
+            auto checksum = 0u;
+            for(auto i = 0u; i < rayCount; ++i) {
+                checksum += queueOcclusions[i];
+            }
+            return checksum;
+        });
+    }
+
+    // Hits are computed once so that the next benchmarks measure only their kernel
+    std::vector<std::pair<Ray, RTScene::Hit>> hits;
+    hits.reserve(rayCount);
+    for(const auto& ray: rays) {
+        RTScene::Hit hit;
+        if(rtScene.intersect(ray, hit)) {
+            hits.emplace_back(ray, hit);
+        }
+    }
+
+    runner.run("Scene.postIntersect", hits.size(), [&]() {
+        auto checksum = 0.f;
+        for(const auto& hit: hits) {
+            auto I = scene.postIntersect(hit.first, hit.second);
+            checksum += I.Ns.x + I.texCoords.x;
+        }
+        return checksum;
+    });
+
+    std::vector<Intersection> intersections;
+    intersections.reserve(hits.size());
+    for(const auto& hit: hits) {
+        intersections.emplace_back(scene.postIntersect(hit.first, hit.second));
+    }
+
+    std::vector<BSDF> bsdfs(hits.size());
+    runner.run("BSDF.init", hits.size(), [&]() {
+        auto checksum = 0.f;
+        for(auto i: range(hits.size())) {
+            bsdfs[i].init(-hits[i].first.dir, intersections[i], scene);
+            checksum += bsdfs[i].getDiffuseCoefficient().x;
+        }
+        return checksum;
+    });
+
+    std::vector<Vec3f> outgoingDirections;
+    std::vector<Vec3f> bsdfSamples;
+    outgoingDirections.reserve(hits.size());
+    bsdfSamples.reserve(hits.size());
+    for(auto i = 0u; i < hits.size(); ++i) {
+        outgoingDirections.emplace_back(uniformSampleSphere(rng.getFloat(), rng.getFloat()).value);
+        bsdfSamples.emplace_back(rng.getFloat3());
+    }
+
+    runner.run("BSDF.eval", hits.size(), [&]() {
+        auto checksum = 0.f;
+        for(auto i: range(hits.size())) {
+            float cosThetaOutDir, directPdf, reversePdf;
+            auto fs = bsdfs[i].eval(outgoingDirections[i], cosThetaOutDir, &directPdf, &reversePdf);
+            checksum += fs.x + directPdf;
+        }
+        return checksum;
+    });
+
+    runner.run("BSDF.sample", hits.size(), [&]() {
+        auto checksum = 0.f;
+        for(auto i: range(hits.size())) {
+            Sample3f outgoingDirection;
+            float cosThetaOutDir;
+            auto fs = bsdfs[i].sample(bsdfSamples[i], outgoingDirection, cosThetaOutDir);
+            checksum += fs.x + outgoingDirection.pdf;
+        }
+        return checksum;
+    });
+
+    {
+        const auto distributionSize = 1u << 16;
+        const auto sampleCount = 1u << 16;
+
+        std::vector<float> weights;
+        weights.reserve(distributionSize);
+        for(auto i = 0u; i < distributionSize; ++i) {
+            weights.emplace_back(rng.getFloat());
+        }
+        std::vector<float> cdf(getDistribution1DBufferSize(distributionSize));
+
+        runner.run("buildDistribution1D", distributionSize, [&]() {
+            buildDistribution1D([&](uint32_t i) { return weights[i]; }, cdf.data(), distributionSize);
+            return cdf.back();
+        });
+
+        std::vector<float> samples;
+        samples.reserve(sampleCount);
+        for(auto i = 0u; i < sampleCount; ++i) {
+            samples.emplace_back(rng.getFloat());
+        }
+
+        runner.run("sampleDiscreteDistribution1D", sampleCount, [&]() {
+            auto checksum = 0u;
+            for(auto s: samples) {
+                checksum += sampleDiscreteDistribution1D(cdf.data(), distributionSize, s).value;
+            }
+            return checksum;
+        });
+    }
+
+    // Points on the surfaces of the scene, used as particles by the spatial structures
+    std::vector<SurfacePointSample> surfacePoints;
+    surfacePoints.reserve(rayCount);
+    scene.sampleSurfacePointsWrtArea(rayCount, std::back_inserter(surfacePoints), [&](std::size_t i) {
+        return Scene::SurfacePointSampleParams { rng.getFloat(), rng.getFloat(), rng.getFloat(), rng.getFloat2() };
+    });
+
+    const auto queryCount = 1u << 14;
+    std::vector<Vec3f> queryPoints;
+    queryPoints.reserve(queryCount);
+    for(auto i = 0u; i < queryCount; ++i) {
+        queryPoints.emplace_back(intersections.empty() ? randomPoint() : intersections[i % intersections.size()].P);
+    }
+
+    {
+        KdTree kdTree;
+        runner.run("KdTree.build", surfacePoints.size(), [&]() {
+            kdTree.build(surfacePoints.size(), [&](uint32_t i) { return surfacePoints[i].value.P; });
+            return kdTree.size();
+        });
+
+        if(kdTree.empty()) {
+            kdTree.build(surfacePoints.size(), [&](uint32_t i) { return surfacePoints[i].value.P; });
+        }
+
+        const auto K = 16u;
+        runner.run("KdTree.kNN", queryCount, [&]() {
+            auto checksum = 0.f;
+            for(const auto& P: queryPoints) {
+                kdTree.searchKNearestNeighbours(P, K, [&](uint32_t index, const Vec3f& position, float distSquared) {
+                    checksum += distSquared;
+                });
+            }
+            return checksum;
+        });
+    }
+
+    {
+        std::vector<BenchParticle> particles;
+        particles.reserve(surfacePoints.size());
+        for(const auto& point: surfacePoints) {
+            particles.emplace_back(BenchParticle { point.value.P });
+        }
+
+        auto radius = 0.01f * sceneDiag;
+
+        HashGrid hashGrid;
+        hashGrid.Reserve(int(particles.size()));
+        runner.run("HashGrid.build", particles.size(), [&]() {
+            hashGrid.build(particles.data(), uint32_t(particles.size()), radius);
+            // Read the built cells so that the build can't be optimized away, one query is negligible
+            auto checksum = 0u;
+            if(!particles.empty()) {
+                hashGrid.process(particles.data(), particles.front().m_Position, [&](const BenchParticle& particle) {
+                    ++checksum;
+                });
+            }
+            return checksum;
+        });
+
+        hashGrid.build(particles.data(), uint32_t(particles.size()), radius);
+        runner.run("HashGrid.query", queryCount, [&]() {
+            auto checksum = 0u;
+            for(const auto& P: queryPoints) {
+                hashGrid.process(particles.data(), P, [&](const BenchParticle& particle) {
+                    ++checksum;
+                });
+            }
+            return checksum;
+        });
+    }
+
+    if(auto pSkel = scene.getCurvSkeleton()) {
+        std::clog << "Skeleton node count = " << pSkel->size() << std::endl;
+
+        runner.run("CurvilinearSkeleton.getNearestNode", intersections.size(), [&]() {
+            auto checksum = 0u;
+            for(const auto& I: intersections) {
+                auto node = pSkel->getNearestNode(I);
+                checksum += (node != UNDEFINED_NODE);
+            }
+            return checksum;
+        });
+
+        std::vector<GraphNodeIndex> skeletonNodes;
+        for(auto nodeIndex: range(pSkel->size())) {
+            skeletonNodes.emplace_back(GraphNodeIndex(nodeIndex));
+        }
+
+        // One operation is the evaluation of one surface point for one node
+        const auto surfacePointSampleCount = min(std::size_t(1u << 12), surfacePoints.size());
+        SkeletonVisibilityDistributions distributions;
+        runner.run("SkeletonVisibilityDistributions.build", skeletonNodes.size() * surfacePointSampleCount, [&]() {
+            buildDistributions(distributions, scene, skeletonNodes,
+                               surfacePoints.data(), surfacePointSampleCount,
+                               true, settings.m_nThreadCount);
+            return distributions.distributionCount();
+        });
+    }
+}
+
+static void printUsage(const char* applicationName) {
+    std::cerr << "Usage: " << applicationName << " [--output <results.bnz.xml>] [--scene <scene.bnz.xml>] [--filter <name>]"
+              << " [--min-time <milliseconds>] [--seed <seed>] [--threads <count>]"
+              << " [--spheres <count per axis>] [--skel-resolution <resolution>]" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    initEasyLoggingpp(argc, argv);
+
+    BenchSettings settings;
+    for(auto i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if(i + 1 >= argc) {
+            printUsage(argv[0]);
+            return -1;
+        }
+        std::string value = argv[++i];
+        if(option == "--output") {
+            settings.m_OutputPath = value;
+        } else if(option == "--scene") {
+            settings.m_ScenePath = value;
+        } else if(option == "--filter") {
+            settings.m_sFilter = value;
+        } else if(option == "--min-time") {
+            settings.m_MinDuration = Microseconds(1000u * lexicalCast<uint64_t>(value));
+        } else if(option == "--seed") {
+            settings.m_nSeed = lexicalCast<uint32_t>(value);
+        } else if(option == "--threads") {
+            settings.m_nThreadCount = lexicalCast<uint32_t>(value);
+        } else if(option == "--spheres") {
+            settings.m_nSphereCountPerAxis = max(1u, lexicalCast<uint32_t>(value));
+        } else if(option == "--skel-resolution") {
+            settings.m_nSkeletonResolution = lexicalCast<uint32_t>(value);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    BenchmarkRunner runner(settings.m_sFilter, settings.m_MinDuration);
+
+    // Tab separated output: one line per benchmark
+    std::cout << "name\tns_per_op\tops_per_sec\truns\tchecksum" << std::endl;
+    runBenchmarks(settings, runner);
+
+    if(!settings.m_OutputPath.empty()) {
+        tinyxml2::XMLDocument document;
+        auto pRoot = document.NewElement("Benchmarks");
+        document.InsertFirstChild(pRoot);
+        setAttribute(*pRoot, "date", getDateString());
+        setAttribute(*pRoot, "scene", settings.m_ScenePath.empty() ? std::string("procedural") : settings.m_ScenePath.str());
+        setAttribute(*pRoot, "seed", settings.m_nSeed);
+        setAttribute(*pRoot, "threadCount", settings.m_nThreadCount);
+
+        runner.storeResults(*pRoot);
+
+        if(tinyxml2::XML_NO_ERROR != document.SaveFile(settings.m_OutputPath.c_str())) {
+            std::cerr << "Unable to write results to " << settings.m_OutputPath << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    return BnZ::main(argc, argv);
+}
@@ -0,0 +1,3 @@
+#pragma message("Compiling precompiled headers.\n")
+
+#include <bonez/stdafx.h>
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "PG15BatchRunner.hpp"
+
+#include <cstdlib>
+
+#include <bonez/parsing/parsing.hpp>
+#include <bonez/sys/threads.hpp>
+#include <bonez/sys/time.hpp>
+
+namespace BnZ {
+
+// Only overwrite the value if the attribute is present, such that defaults are kept
+template<typename T>
+static void readAttribute(const tinyxml2::XMLElement& elt, const char* name, T& value) {
+    if(elt.Attribute(name)) {
+        getAttribute(elt, name, value);
+    }
+}
+
+static void readICBPTSettings(const tinyxml2::XMLElement& elt, PG15ICBPTSettings& settings) {
+    readAttribute(elt, "useUniformImportanceRecordSampling", settings.useUniformImportanceRecordSampling);
+    readAttribute(elt, "uniformImportanceRecordCount", settings.uniformImportanceRecordCount);
+    readAttribute(elt, "importanceRecordsDensity", settings.importanceRecordsDensity);
+    readAttribute(elt, "irCountPerShadingPoint", settings.irCountPerShadingPoint);
+    readAttribute(elt, "unfilteredIRCountPerShadingPointFactor", settings.unfilteredIRCountPerShadingPointFactor);
+    readAttribute(elt, "distributionSelector", settings.distributionSelector);
+    readAttribute(elt, "useAlphaMaxHeuristic", settings.useAlphaMaxHeuristic);
+    readAttribute(elt, "useDistributionWeightingOptimization", settings.useDistributionWeightingOptimization);
+    readAttribute(elt, "useReservoirResampling", settings.useReservoirResampling);
+    readAttribute(elt, "resamplingCandidateCount", settings.resamplingCandidateCount);
+    readAttribute(elt, "profilingSamplingPeriod", settings.profilingSamplingPeriod);
+    getChildAttribute(elt, "AlphaConfidenceValue", settings.alphaConfidenceValue);
+}
+
+static PG15SkelBPTSettings readSkelBPTSettings(const tinyxml2::XMLElement& elt) {
+    PG15SkelBPTSettings settings;
+    readAttribute(elt, "useNodeRadianceWeight", settings.useNodeRadianceWeight);
+    readAttribute(elt, "useNodeDistanceWeight", settings.useNodeDistanceWeight);
+    readAttribute(elt, "nodeFilteringFactor", settings.nodeFilteringFactor);
+    readAttribute(elt, "useAmortizedVisibility", settings.useAmortizedVisibility);
+    readAttribute(elt, "visibilityRefreshRate", settings.visibilityRefreshRate);
+    readAttribute(elt, "useReservoirResampling", settings.useReservoirResampling);
+    readAttribute(elt, "resamplingCandidateCount", settings.resamplingCandidateCount);
+    readAttribute(elt, "profilingSamplingPeriod", settings.profilingSamplingPeriod);
+    return settings;
+}
+
+// Read the attributes and children of elt that are present over the values of job
+static void readJob(const tinyxml2::XMLElement& elt, PG15Job& job) {
+    std::string path;
+    if(getAttribute(elt, "viewer", path)) {
+        job.viewerPath = path;
+    }
+    if(getAttribute(elt, "reference", path)) {
+        job.referenceImagePath = path;
+    }
+    if(getAttribute(elt, "output", path)) {
+        job.resultPath = path;
+    }
+    readAttribute(elt, "config", job.configName);
+    readAttribute(elt, "name", job.name);
+
+    if(elt.Attribute("renderTime")) {
+        getAttribute(elt, "renderTime", job.renderTimeMsOrIterationCount);
+        job.equalTime = true;
+    }
+    if(elt.Attribute("iterationCount")) {
+        getAttribute(elt, "iterationCount", job.renderTimeMsOrIterationCount);
+        job.equalTime = false;
+    }
+
+    readAttribute(elt, "maxPathDepth", job.maxPathDepth);
+    readAttribute(elt, "resamplingPathCount", job.resamplingPathCount);
+    readAttribute(elt, "thinningResolution", job.thinningResolution);
+    readAttribute(elt, "useSegmentedSkel", job.useSegmentedSkel);
+    readAttribute(elt, "bpt", job.renderBPT);
+    readAttribute(elt, "icbpt", job.renderICBPT);
+    readAttribute(elt, "threadCount", job.threadCount);
+    readAttribute(elt, "outOfCoreThreshold", job.outOfCoreThreshold);
+    readAttribute(elt, "scratchDirectory", job.scratchDirectory);
+    readAttribute(elt, "checkpointInterval", job.checkpointInterval);
+    readAttribute(elt, "cropX", job.regionOfInterest.window.x);
+    readAttribute(elt, "cropY", job.regionOfInterest.window.y);
+    readAttribute(elt, "cropWidth", job.regionOfInterest.window.z);
+    readAttribute(elt, "cropHeight", job.regionOfInterest.window.w);
+    readAttribute(elt, "redistributeCropSamples", job.regionOfInterest.redistributeSamples);
+    readAttribute(elt, "denoise", job.denoising.enabled);
+
+    if(auto pDenoiser = elt.FirstChildElement("Denoiser")) {
+        job.denoising.denoiser.loadSettings(*pDenoiser);
+    }
+
+    if(auto pICBPT = elt.FirstChildElement("ICBPT")) {
+        readICBPTSettings(*pICBPT, job.icBPTSettings);
+    }
+
+    if(auto pSkelBPT = elt.FirstChildElement("SkelBPT")) {
+        job.skelBPTSettings.clear();
+        for(; pSkelBPT; pSkelBPT = pSkelBPT->NextSiblingElement("SkelBPT")) {
+            job.skelBPTSettings.emplace_back(readSkelBPTSettings(*pSkelBPT));
+        }
+    }
+}
+
+PG15JobList loadPG15JobList(const FilePath& jobFilePath) {
+    tinyxml2::XMLDocument document;
+    if(tinyxml2::XML_NO_ERROR != document.LoadFile(jobFilePath.c_str())) {
+        throw std::runtime_error("Unable to load job file " + jobFilePath.str());
+    }
+
+    auto pRoot = document.RootElement();
+    if(!pRoot) {
+        throw std::runtime_error("Invalid job file format (no root element)");
+    }
+
+    PG15JobList jobList;
+    readAttribute(*pRoot, "concurrency", jobList.concurrency);
+    jobList.concurrency = std::max(std::size_t(1), jobList.concurrency);
+
+    PG15Job defaultJob;
+    defaultJob.skelBPTSettings.clear();
+    readJob(*pRoot, defaultJob);
+
+    for(auto pJob = pRoot->FirstChildElement("Job"); pJob; pJob = pJob->NextSiblingElement("Job")) {
+        auto job = defaultJob;
+        readJob(*pJob, job);
+
+        if(job.viewerPath.empty() || job.configName.empty() || job.referenceImagePath.empty() || job.resultPath.empty()) {
+            throw std::runtime_error("Invalid job " + toString(jobList.jobs.size()) +
+                                     " (viewer, config, reference and output are required)");
+        }
+        if(!job.renderBPT && !job.renderICBPT && job.skelBPTSettings.empty()) {
+            throw std::runtime_error("Invalid job " + toString(jobList.jobs.size()) + " (no renderer)");
+        }
+        if(job.name.empty()) {
+            job.name = toString(job.renderTimeMsOrIterationCount) + (job.equalTime ? "ms" : "it");
+        }
+
+        jobList.jobs.emplace_back(job);
+    }
+
+    return jobList;
+}
+
+std::size_t runPG15JobList(const FilePath& applicationPath, const FilePath& jobFilePath) {
+    auto jobList = loadPG15JobList(jobFilePath);
+
+    std::vector<std::size_t> pendingJobs;
+    std::size_t totalTime = 0;
+    for(auto i: range(jobList.jobs.size())) {
+        const auto& job = jobList.jobs[i];
+        if(job.isDone()) {
+            LOG(INFO) << "Skip job " << i << " (" << job.getResultDirectory() << "), results already exist";
+            continue;
+        }
+        pendingJobs.emplace_back(i);
+
+        if(job.equalTime) {
+            auto rendererCount = std::size_t(job.renderBPT) + std::size_t(job.renderICBPT) + job.skelBPTSettings.size();
+            totalTime += rendererCount * job.renderTimeMsOrIterationCount;
+        }
+    }
+
+    LOG(INFO) << pendingJobs.size() << " jobs to run with concurrency " << jobList.concurrency;
+    LOG(INFO) << "Expected lower bound on render time = "
+              << (ms2sec(totalTime) / (3600 * jobList.concurrency)) << " hours" << std::endl;
+
+    if(pendingJobs.empty()) {
+        return 0;
+    }
+
+    // Each job runs in its own process: the thread pool and the OpenGL context are per process
+    std::atomic_uint nextJob { 0u };
+    std::atomic_uint failedJobCount { 0u };
+    auto threadCount = uint32_t(std::min(jobList.concurrency, pendingJobs.size()));
+
+    launchThreads([&](uint32_t threadID) {
+        for(auto i = nextJob++; i < pendingJobs.size(); i = nextJob++) {
+            auto jobIndex = pendingJobs[i];
+            auto command = "\"" + applicationPath.str() + "\" --job \"" + jobFilePath.str() + "\" " + toString(jobIndex);
+#ifdef _WIN32
+            command = "\"" + command + "\""; // cmd.exe strips the outer quotes
+#endif
+            LOG(INFO) << "Start job " << jobIndex << " on runner " << threadID;
+
+            auto returnCode = std::system(command.c_str());
+            if(returnCode != 0 || !jobList.jobs[jobIndex].isDone()) {
+                LOG(ERROR) << "Job " << jobIndex << " failed (return code = " << returnCode << ")";
+                ++failedJobCount;
+            } else {
+                LOG(INFO) << "Job " << jobIndex << " done";
+            }
+        }
+    }, threadCount);
+
+    return failedJobCount;
+}
+
+bool runPG15Job(const FilePath& applicationPath, const FilePath& jobFilePath, std::size_t jobIndex) {
+    auto jobList = loadPG15JobList(jobFilePath);
+    if(jobIndex >= jobList.jobs.size()) {
+        LOG(ERROR) << "Invalid job index " << jobIndex;
+        return false;
+    }
+
+    const auto& job = jobList.jobs[jobIndex];
+    if(job.isDone()) {
+        LOG(INFO) << "Job " << jobIndex << " already done";
+        return true;
+    }
+
+    if(job.threadCount > 0u) {
+        setSystemThreadCount(job.threadCount);
+    }
+
+    if(job.outOfCoreThreshold > 0u) {
+        setScratchDirectory(job.scratchDirectory);
+        setOutOfCoreThreshold(MemoryTag::LightVertices, job.outOfCoreThreshold * 1024u * 1024u);
+    }
+
+    PG2015Viewer viewer(
+                applicationPath,
+                job.viewerPath,
+                job.configName,
+                job.referenceImagePath,
+                job.resultPath,
+                job.renderTimeMsOrIterationCount,
+                job.maxPathDepth,
+                job.resamplingPathCount,
+                job.icBPTSettings,
+                job.skelBPTSettings,
+                job.thinningResolution,
+                job.useSegmentedSkel,
+                job.equalTime,
+                job.renderBPT,
+                job.renderICBPT,
+                job.name,
+                true, // headless
+                job.checkpointInterval,
+                job.regionOfInterest,
+                job.denoising);
+    viewer.run();
+
+    if(!viewer.isDone()) {
+        return false;
+    }
+
+    tinyxml2::XMLDocument markerDocument;
+    auto pRoot = markerDocument.NewElement("Job");
+    markerDocument.InsertEndChild(pRoot);
+
+    setChildAttribute(*pRoot, "JobFile", jobFilePath.str());
+    setChildAttribute(*pRoot, "Index", jobIndex);
+    setChildAttribute(*pRoot, "ThreadCount", getSystemThreadCount());
+    setChildAttribute(*pRoot, "Date", getDateString());
+
+    markerDocument.SaveFile(job.getDoneMarkerPath().c_str());
+
+    return true;
+}
+
+}
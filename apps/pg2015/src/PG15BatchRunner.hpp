@@ -0,0 +1,96 @@
+#pragma once
+
+#include <bonez/sys/files.hpp>
+
+#include "PG2015Viewer.hpp"
+
+namespace BnZ {
+
+// A rendering job: one scene configuration rendered by a set of renderers for a given budget
+struct PG15Job {
+    FilePath viewerPath; // Parameters of the viewer and scene
+    std::string configName; // Name of the configuration to load
+    FilePath referenceImagePath;
+    FilePath resultPath; // Path where to put the result folder
+    std::string name; // Name of the result folder, generated from the budget if not specified
+
+    std::size_t renderTimeMsOrIterationCount = 10000;
+    bool equalTime = true; // If false, "renderTimeMsOrIterationCount" is an iteration count
+
+    std::size_t maxPathDepth = 6;
+    std::size_t resamplingPathCount = 1024;
+    std::size_t thinningResolution = 128;
+    bool useSegmentedSkel = true;
+
+    // Renderer set
+    bool renderBPT = true;
+    bool renderICBPT = true;
+    PG15ICBPTSettings icBPTSettings;
+    std::vector<PG15SkelBPTSettings> skelBPTSettings;
+
+    uint32_t threadCount = 0; // 0 means all the threads of the machine
+
+    // Light vertex buffers of at least outOfCoreThreshold MB are mapped from a scratch file, 0 to keep them in memory
+    std::size_t outOfCoreThreshold = 0;
+    std::string scratchDirectory = "."; // Directory of the scratch files
+
+    float checkpointInterval = 0.f; // Seconds between two checkpoints of the render, 0 to disable
+
+    PG15RegionOfInterest regionOfInterest; // Full framebuffer by default
+
+    PG15DenoisingSettings denoising; // Disabled by default
+
+    FilePath getResultDirectory() const {
+        return resultPath + name;
+    }
+
+    // The marker file is written once all the results of the job have been stored
+    FilePath getDoneMarkerPath() const {
+        return getResultDirectory() + "job.done.bnz.xml";
+    }
+
+    bool isDone() const {
+        return exists(getDoneMarkerPath());
+    }
+};
+
+struct PG15JobList {
+    std::size_t concurrency = 1; // Number of jobs running at the same time
+    std::vector<PG15Job> jobs;
+};
+
+// Load a job file, which looks like:
+// <Jobs concurrency="2" threadCount="8">
+//     <Job viewer="scenes/door/viewer.bnz.xml" config="corner"
+//          reference="results/door/corner/reference/reference.exr"
+//          output="results/door/corner/" renderTime="10000" bpt="true" icbpt="true">
+//         <ICBPT distributionSelector="FC" />
+//         <SkelBPT nodeFilteringFactor="1" />
+//         <SkelBPT nodeFilteringFactor="0.5" />
+//         <SkelBPT nodeFilteringFactor="0.5" useAmortizedVisibility="true" visibilityRefreshRate="0.1" />
+//         <SkelBPT nodeFilteringFactor="0.5" useReservoirResampling="true" resamplingCandidateCount="8" />
+//     </Job>
+// </Jobs>
+// Attributes of <Jobs> other than concurrency are default values for all jobs.
+// The budget is either renderTime (in milliseconds) or iterationCount. Paths are relative to the working directory.
+// Light path counts exceeding the physical memory can be rendered with outOfCoreThreshold="1024" (in MB) and
+// scratchDirectory="/path/to/fast/disk".
+// The tile processing of ICBPT and SkelBPT is profiled at each call, profilingSamplingPeriod="16" only times one call
+// out of 16 of each task.
+// A region of the image can be rendered alone with cropX, cropY, cropWidth and cropHeight (in pixels), and
+// redistributeCropSamples="true" to spend the sample budget of the full image on it.
+// With checkpointInterval="600" (in seconds), a job periodically stores a checkpoint in its result folder and resumes from
+// it if it is run again after an interruption. A checkpoint stored with other settings stops the job.
+// With denoise="true", the denoised image of each renderer is stored and measured too. The denoiser is configured by a
+// <Denoiser radius="6" sigmaColor="0.5" /> child (see CrossBilateralDenoiser).
+PG15JobList loadPG15JobList(const FilePath& jobFilePath);
+
+// Run all the jobs of a job file that are not already done, each one in a child process of the application
+// Return the number of jobs that failed
+std::size_t runPG15JobList(const FilePath& applicationPath, const FilePath& jobFilePath);
+
+// Run a single job of a job file in the current process, without displaying anything
+// Return false if the job failed
+bool runPG15Job(const FilePath& applicationPath, const FilePath& jobFilePath, std::size_t jobIndex);
+
+}
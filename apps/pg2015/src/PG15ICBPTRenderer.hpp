@@ -6,6 +6,7 @@
 #include <bonez/rendering/renderers/importance_caching/GeorgievPerDepthImportanceCache.hpp>
 
 #include <bonez/sampling/patterns.hpp>
+#include <bonez/sampling/Reservoir.hpp>
 
 namespace BnZ {
 
@@ -19,6 +20,9 @@ struct PG15ICBPTSettings {
     Vec4f alphaConfidenceValue = Vec4f(1, 1, 1, 1);
     bool useAlphaMaxHeuristic = true;
     bool useDistributionWeightingOptimization = true;
+    bool useReservoirResampling = false; // Resample surface light vertices among uniform candidates instead of using the importance cache
+    std::size_t resamplingCandidateCount = 8; // Number of candidates streamed in the reservoir of each eye vertex and depth
+    uint32_t profilingSamplingPeriod = 1u; // Only one call out of profilingSamplingPeriod of each profiled task is timed
 };
 
 class PG15ICBPTRenderer: public PG15Renderer {
@@ -36,7 +40,17 @@ public:
         m_sDistributionSelector(settings.distributionSelector),
         m_AlphaConfidenceValues(settings.alphaConfidenceValue),
         m_bUseAlphaMaxHeuristic(settings.useAlphaMaxHeuristic),
-        m_bUseDistributionWeightingOptimization(settings.useDistributionWeightingOptimization) {
+        m_bUseDistributionWeightingOptimization(settings.useDistributionWeightingOptimization),
+        m_bUseReservoirResampling(settings.useReservoirResampling),
+        m_nResamplingCandidateCount(settings.resamplingCandidateCount),
+        m_TileProcessingTimer({
+            "TraceEyePaths",
+            "EvalContribution",
+            "KdTreeLookup",
+            "ResampleLightVertex",
+            "ConnectLightVerticesToSensor",
+            "EvalResamplingMISWeight"
+        }, getSystemThreadCount(), settings.profilingSamplingPeriod, TRACE_EVENT_BUFFER_SIZE) {
         initFramebuffer();
 
         m_fImportanceRecordOrientationTradeOff = 0.5f / length(getScene().getBBox().size());
@@ -44,12 +58,14 @@ public:
 
         m_ShadingPointIRBuffer.resize(m_nIRCountPerShadingPoint, getSystemThreadCount());
         m_ShadingPointUnfilteredIRBuffer.resize(getUnfilteredIRCountPerShadingPoint(), getSystemThreadCount());
+        m_ConnectionQueuesPerThread.resize(2, getSystemThreadCount());
     }
 
     void render() {
-        computeImportanceRecords();
+        // Resampled light vertices are drawn uniformly: the importance cache is neither built nor queried
+        if(!m_bUseReservoirResampling) {
+            computeImportanceRecords();
 
-        {
             auto timer = m_BeginFrameTimer.start(2);
             computeLightVertexDistributions();
         }
@@ -58,10 +74,20 @@ public:
             renderTile(threadID, tileID, viewport);
         });
 
+        // Connections of the last tile of each thread
+        if(getLightVertexPrefetcher().isEnabled()) {
+            launchThreads([&](uint32_t threadID) {
+                connectEyeVertices(threadID, m_ConnectionQueuesPerThread(0, threadID));
+            }, getSystemThreadCount());
+        }
+
         ++m_nIterationCount;
     }
 
     void renderTile(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) {
+        auto& previousTileConnections = m_ConnectionQueuesPerThread(0, threadID);
+        auto& tileConnections = m_ConnectionQueuesPerThread(1, threadID);
+
         PG15Renderer::processTilePixels(viewport, [&](uint32_t x, uint32_t y) {
             auto pixelID = getPixelIndex(x, y);
 
@@ -70,15 +96,46 @@ public:
                 accumulate(i, pixelID, Vec4f(0, 0, 0, 1));
             }
 
-            processSample(threadID, tileID, pixelID, x, y);
+            processSample(threadID, tileID, pixelID, x, y, tileConnections);
         });
 
+        // Out-of-core light vertices are read one tile after the chunks of the tile are prefetched, in-core ones
+        // right away
+        if(getLightVertexPrefetcher().isEnabled()) {
+            connectEyeVertices(threadID, previousTileConnections);
+            std::swap(previousTileConnections, tileConnections);
+        } else {
+            connectEyeVertices(threadID, tileConnections);
+        }
+
         // Compute contributions for 1-length eye paths (connection to sensor)
         connectLightVerticesToSensor(threadID, tileID, viewport);
     }
 
+    struct QueuedEyeVertex {
+        BDPTPathVertex m_EyeVertex;
+        uint32_t m_nPixelID;
+    };
+
+    // Connection of a queued eye vertex to the resampled light vertex of a depth
+    struct QueuedConnection {
+        uint32_t m_nEyeVertexIndex;
+        uint32_t m_nLightPathDepth;
+        std::size_t m_nStrategyIndex; // Distribution of the importance cache, max without importance cache
+        Sample1u m_LightVertexSample; // Unused for surface light vertices resampled with a reservoir
+        float m_fWeight; // Weight of the contribution: MIS weight / pdf of the light vertex
+        std::size_t m_nFirstCandidate; // Candidates of the reservoir in ConnectionQueue::m_Candidates
+    };
+
+    // Eye vertices of a tile and their resampled light vertices, connected after the light vertices are prefetched
+    struct ConnectionQueue {
+        std::vector<QueuedEyeVertex> m_EyeVertices;
+        std::vector<QueuedConnection> m_Connections;
+        std::vector<uint32_t> m_Candidates; // m_nResamplingCandidateCount light paths per reservoir connection
+    };
+
     void processSample(uint32_t threadID, uint32_t tileID, uint32_t pixelID,
-                           uint32_t x, uint32_t y) {
+                           uint32_t x, uint32_t y, ConnectionQueue& connections) {
         auto mis = [&](float v) {
             return Mis(v);
         };
@@ -123,8 +180,10 @@ public:
                 }
             }
 
-            // Connections
-            if(eyeVertex.m_Intersection) {
+            // Connections: the light vertices are resampled and prefetched, connectEyeVertices evaluates them
+            if(eyeVertex.m_Intersection && m_bUseReservoirResampling) {
+                queueResampledLightVertices(threadID, pixelID, eyeVertex, connections);
+            } else if(eyeVertex.m_Intersection) {
                 // Get nearest importance records and their number:
                 auto kdTreeLookupTimer = m_TileProcessingTimer.start(2, threadID);
 
@@ -146,75 +205,51 @@ public:
                         accumulate(NEAREST_IMPORTANCE_RECORD, pixelID, Vec4f(getColor(nearestIR), 0.f));
                     }
 
+                    auto eyeVertexIndex = uint32_t(connections.m_EyeVertices.size());
+                    connections.m_EyeVertices.emplace_back(QueuedEyeVertex { eyeVertex, pixelID });
+
                     for(auto j = 0u; j <= maxLightPathDepth; ++j) {
-                       auto lightPathDepth = j;
-                       auto totalLength = eyeVertex.m_nDepth + lightPathDepth + 1;
-
-                       if(totalLength <= getMaxDepth()) {
-                           //for(auto i = 0u; i < m_ImportanceCache.getEnabledDistributionCount(); ++i) {
-                               auto resamplingTimer = m_TileProcessingTimer.start(3, threadID);
-
-                               auto stategyIndex = clamp(size_t(getFloat(threadID) * m_ImportanceCache.getEnabledDistributionCount()), size_t(0),
-                                              size_t(m_ImportanceCache.getEnabledDistributionCount()) - 1);
-                               float strategyPdf = 1.f / m_ImportanceCache.getEnabledDistributionCount();
-
-                               auto lightVertexSample = [&]() {
-                                   auto result = m_ImportanceCache.sampleDistribution(lightPathDepth, stategyIndex, irCount, pImportanceRecords, getFloat(threadID));
-                                   return result;
-                               }();
-
-                               resamplingTimer.storeDuration();
-
-                               if(lightVertexSample.pdf) {
-                                    auto timer = m_TileProcessingTimer.start(5, threadID);
-                                    auto weight = [&]() {
-                                        if(m_bUseAlphaMaxHeuristic) {
-                                            return m_ImportanceCache.misAlphaMaxHeuristic(lightVertexSample, lightPathDepth, stategyIndex, irCount, pImportanceRecords);
-                                        }
-                                        return m_ImportanceCache.misBalanceHeuristic(lightVertexSample, lightPathDepth, stategyIndex, irCount, pImportanceRecords);
-                                    }();
-                                    timer.storeDuration();
-
-                                    if(weight > 0.f) {
-                                        if(lightPathDepth == 0u) {
-                                            auto evalContribTimer = m_TileProcessingTimer.start(1, threadID);
-
-                                           // EmissionVertex
-                                           const auto& emissionVertex = getEmissionVertex(lightVertexSample.value);
-                                           auto contrib = (1.f / getResamplingLightPathCount()) * fImportanceScale * connectVertices(eyeVertex, emissionVertex, getScene(), getResamplingLightPathCount(), mis);
-
-                                           contrib *= weight / (strategyPdf * lightVertexSample.pdf);
-
-                                           evalContribTimer.storeDuration();
-
-                                           accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
-                                           accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
-                                           accumulate(DIST0_CONTRIB + stategyIndex, pixelID, Vec4f(contrib, 0));
-                                           auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, lightPathDepth + 1);
-                                           accumulate(FINAL_RENDER_DEPTH1 + getMaxDepth() + strategyOffset, pixelID, Vec4f(contrib, 0));
-                                       } else {
-                                           auto evalContribTimer = m_TileProcessingTimer.start(1, threadID);
-
-                                           // SurfaceVertex
-                                           auto firstPathOffset = lightPathDepth - 1;
-                                           auto pLightPath = &getLightVertexBuffer()[firstPathOffset + lightVertexSample.value * getMaxLightPathDepth()];
-
-                                           auto contrib = (1.f / getResamplingLightPathCount()) * fImportanceScale * connectVertices(eyeVertex, *pLightPath, getScene(), getResamplingLightPathCount(), mis);
-
-                                           contrib *= weight / (strategyPdf * lightVertexSample.pdf);
-
-                                           evalContribTimer.storeDuration();
-
-                                           accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
-                                           accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
-                                           accumulate(DIST0_CONTRIB + stategyIndex, pixelID, Vec4f(contrib, 0));
-                                           auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, lightPathDepth + 1);
-                                           accumulate(FINAL_RENDER_DEPTH1 + getMaxDepth() + strategyOffset, pixelID, Vec4f(contrib, 0));
-                                       }
-                                   }
-                               }
-                           //}
-                       }
+                        auto lightPathDepth = j;
+                        auto totalLength = eyeVertex.m_nDepth + lightPathDepth + 1;
+
+                        if(totalLength > getMaxDepth()) {
+                            continue;
+                        }
+
+                        auto resamplingTimer = m_TileProcessingTimer.start(3, threadID);
+
+                        auto stategyIndex = clamp(size_t(getFloat(threadID) * m_ImportanceCache.getEnabledDistributionCount()), size_t(0),
+                                       size_t(m_ImportanceCache.getEnabledDistributionCount()) - 1);
+                        float strategyPdf = 1.f / m_ImportanceCache.getEnabledDistributionCount();
+
+                        auto lightVertexSample = m_ImportanceCache.sampleDistribution(lightPathDepth, stategyIndex, irCount, pImportanceRecords, getFloat(threadID));
+
+                        resamplingTimer.storeDuration();
+
+                        if(!lightVertexSample.pdf) {
+                            continue;
+                        }
+
+                        if(lightPathDepth) {
+                            getLightVertexPrefetcher().prefetch(&getLightVertexBuffer()(lightPathDepth - 1, lightVertexSample.value));
+                        }
+
+                        // The MIS weight only depends on the importance records, which are not kept in the queue
+                        auto timer = m_TileProcessingTimer.start(5, threadID);
+                        auto weight = [&]() {
+                            if(m_bUseAlphaMaxHeuristic) {
+                                return m_ImportanceCache.misAlphaMaxHeuristic(lightVertexSample, lightPathDepth, stategyIndex, irCount, pImportanceRecords);
+                            }
+                            return m_ImportanceCache.misBalanceHeuristic(lightVertexSample, lightPathDepth, stategyIndex, irCount, pImportanceRecords);
+                        }();
+                        timer.storeDuration();
+
+                        if(weight > 0.f) {
+                            connections.m_Connections.emplace_back(QueuedConnection {
+                                eyeVertexIndex, lightPathDepth, stategyIndex, lightVertexSample,
+                                weight / (strategyPdf * lightVertexSample.pdf), 0u
+                            });
+                        }
                     }
                 } else {
                     // TODO: must fallback to a conservative distribution
@@ -224,6 +259,129 @@ public:
         } while(extendEyePath());
     }
 
+    // Queue the connections of the eye vertex to a light vertex of each depth without the importance cache: the emission
+    // vertex is chosen uniformly among the light paths and the surface light vertices are resampled by
+    // evalReservoirLightVertexContrib among m_nResamplingCandidateCount uniform candidates
+    void queueResampledLightVertices(uint32_t threadID, uint32_t pixelID, const BDPTPathVertex& eyeVertex, ConnectionQueue& connections) {
+        auto resamplingTimer = m_TileProcessingTimer.start(3, threadID);
+
+        auto lightPathCount = getResamplingLightPathCount();
+        auto eyeVertexIndex = uint32_t(connections.m_EyeVertices.size());
+        connections.m_EyeVertices.emplace_back(QueuedEyeVertex { eyeVertex, pixelID });
+
+        for(auto lightPathDepth = 0u; lightPathDepth <= getMaxLightPathDepth(); ++lightPathDepth) {
+            auto totalLength = eyeVertex.m_nDepth + lightPathDepth + 1;
+            if(totalLength > getMaxDepth()) {
+                break;
+            }
+
+            QueuedConnection connection { eyeVertexIndex, lightPathDepth, std::numeric_limits<std::size_t>::max(),
+                                          Sample1u(0u, 0.f), 1.f, connections.m_Candidates.size() };
+            if(lightPathDepth) {
+                for(auto i = 0u; i < m_nResamplingCandidateCount; ++i) {
+                    auto index = clamp(uint32_t(getFloat(threadID) * lightPathCount), 0u, uint32_t(lightPathCount - 1));
+                    connections.m_Candidates.emplace_back(index);
+                    getLightVertexPrefetcher().prefetch(&getLightVertexBuffer()(lightPathDepth - 1, index));
+                }
+            } else {
+                // The inverse pdf of the uniform choice cancels the 1 / lightPathCount of the estimator
+                auto index = clamp(uint32_t(getFloat(threadID) * lightPathCount), 0u, uint32_t(lightPathCount - 1));
+                connection.m_LightVertexSample = Sample1u(index, 1.f / lightPathCount);
+                connection.m_fWeight = float(lightPathCount);
+            }
+            connections.m_Connections.emplace_back(connection);
+        }
+    }
+
+    // Connect the eye vertices of the queue to their resampled light vertices, then clear it
+    void connectEyeVertices(uint32_t threadID, ConnectionQueue& connections) {
+        auto mis = [&](float v) {
+            return Mis(v);
+        };
+
+        auto fImportanceScale = 1.f;
+        auto rcpLightPathCount = 1.f / getResamplingLightPathCount();
+
+        for(const auto& connection: connections.m_Connections) {
+            const auto& eyeVertex = connections.m_EyeVertices[connection.m_nEyeVertexIndex].m_EyeVertex;
+            auto pixelID = connections.m_EyeVertices[connection.m_nEyeVertexIndex].m_nPixelID;
+            auto lightPathDepth = connection.m_nLightPathDepth;
+            auto totalLength = eyeVertex.m_nDepth + lightPathDepth + 1;
+
+            auto evalContribTimer = m_TileProcessingTimer.start(1, threadID);
+
+            auto contrib = zero<Vec3f>();
+            if(m_bUseReservoirResampling && lightPathDepth) {
+                contrib = fImportanceScale * evalReservoirLightVertexContrib(threadID, eyeVertex, lightPathDepth,
+                                                                             connections.m_Candidates.data() + connection.m_nFirstCandidate);
+            } else if(lightPathDepth == 0u) {
+                // EmissionVertex
+                const auto& emissionVertex = getEmissionVertex(connection.m_LightVertexSample.value);
+                if(emissionVertex.m_pLight && emissionVertex.m_fLightPdf) {
+                    contrib = rcpLightPathCount * fImportanceScale * connection.m_fWeight *
+                            connectVertices(eyeVertex, emissionVertex, getScene(), getResamplingLightPathCount(), mis);
+                }
+            } else {
+                // SurfaceVertex
+                const auto& lightVertex = getLightVertexBuffer()(lightPathDepth - 1, connection.m_LightVertexSample.value);
+                contrib = rcpLightPathCount * fImportanceScale * connection.m_fWeight *
+                        connectVertices(eyeVertex, lightVertex, getScene(), getResamplingLightPathCount(), mis);
+            }
+
+            evalContribTimer.storeDuration();
+
+            accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
+            accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
+            if(connection.m_nStrategyIndex != std::numeric_limits<std::size_t>::max()) {
+                accumulate(DIST0_CONTRIB + connection.m_nStrategyIndex, pixelID, Vec4f(contrib, 0));
+            }
+            auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, lightPathDepth + 1);
+            accumulate(FINAL_RENDER_DEPTH1 + getMaxDepth() + strategyOffset, pixelID, Vec4f(contrib, 0));
+        }
+
+        connections.m_EyeVertices.clear();
+        connections.m_Connections.clear();
+        connections.m_Candidates.clear();
+    }
+
+    // Stream the m_nResamplingCandidateCount surface light vertices of pCandidates, drawn uniformly among the light paths,
+    // in a reservoir with the luminance of their unoccluded contribution as target: only the shadow ray of the kept
+    // candidate is traced. The reservoir holds a single candidate, so no distribution is built over the light vertices.
+    Vec3f evalReservoirLightVertexContrib(uint32_t threadID, const BDPTPathVertex& eyeVertex, std::size_t lightPathDepth,
+                                          const uint32_t* pCandidates) {
+        auto mis = [&](float v) {
+            return Mis(v);
+        };
+
+        struct Candidate {
+            Vec3f m_UnoccludedContrib = zero<Vec3f>();
+            Ray m_ShadowRay {};
+        };
+
+        auto lightPathCount = getResamplingLightPathCount();
+        auto sourcePdf = 1.f / lightPathCount;
+
+        Reservoir<Candidate> reservoir;
+        for(auto i = 0u; i < m_nResamplingCandidateCount; ++i) {
+            Candidate candidate;
+
+            const auto& lightVertex = getLightVertexBuffer()(lightPathDepth - 1, pCandidates[i]);
+            if(lightVertex.m_fPathPdf > 0.f) {
+                candidate.m_UnoccludedContrib = evalUnoccludedConnection(eyeVertex, lightVertex, lightPathCount,
+                                                                         mis, candidate.m_ShadowRay);
+            }
+
+            reservoir.add(candidate, luminance(candidate.m_UnoccludedContrib), sourcePdf, getFloat(threadID));
+        }
+
+        if(reservoir.empty() || getScene().occluded(reservoir.getSample().m_ShadowRay)) {
+            return zero<Vec3f>();
+        }
+
+        // The contribution weight of the reservoir replaces the inverse pdf of the light vertex
+        return reservoir.getContributionWeight() * (1.f / lightPathCount) * reservoir.getSample().m_UnoccludedContrib;
+    }
+
     void connectLightVerticesToSensor(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) {
         auto rcpPathCount = 1.f / getLightPathCount();
 
@@ -267,38 +425,22 @@ public:
 
         m_ImportanceCache.setEnabledDistributions(m_sDistributionSelector);
 
-        auto evalContrib = [&](uint32_t pathIdx, std::size_t depth, uint32_t importanceRecordID) {
-            const auto& importanceRecord = m_ImportanceRecordContainer[importanceRecordID];
-
-            if(depth == size_t(0)) {
-                // EmissionVertex
-                const auto& vertex = getEmissionVertex(pathIdx);
-                return vertex.m_fLightPdf == 0.f ? 0.f : luminance(evalContribution(vertex, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-            }
-
-            auto vertexIdx = depth - 1 + pathIdx * maxLightPathDepth;
-            if(getLightVertexBuffer()[vertexIdx].m_fPathPdf == 0.f) {
-                return 0.f;
-            }
-
-            return luminance(evalContribution(getLightVertexBuffer()[vertexIdx], importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-        };
-
-        auto evalUnoccluded = [&](uint32_t pathIdx, std::size_t depth, uint32_t importanceRecordID) {
+        // Unoccluded contributions of the vertices of depth of count consecutive paths, by blocks for BSDF::evalBatch
+        auto evalUnoccluded = [&](uint32_t firstPathIdx, std::size_t count, std::size_t depth, uint32_t importanceRecordID,
+                                  float* contributions, Ray* shadowRays) {
             const auto& importanceRecord = m_ImportanceRecordContainer[importanceRecordID];
 
             if(depth == size_t(0)) {
                 // EmissionVertex
-                const auto& vertex = getEmissionVertex(pathIdx);
-                return vertex.m_fLightPdf == 0.f ? 0.f : luminance(evalUnoccludedContribution(vertex, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-            }
-
-            auto vertexIdx = depth - 1 + pathIdx * maxLightPathDepth;
-            if(getLightVertexBuffer()[vertexIdx].m_fPathPdf == 0.f) {
-                return 0.f;
+                for(auto i = 0u; i < count; ++i) {
+                    const auto& vertex = getEmissionVertex(firstPathIdx + i);
+                    contributions[i] = vertex.m_fLightPdf == 0.f ? 0.f : luminance(evalUnoccludedContribution(vertex, importanceRecord.m_Intersection, importanceRecord.m_BSDF, shadowRays[i]));
+                }
+                return;
             }
 
-            return luminance(evalUnoccludedContribution(getLightVertexBuffer()[vertexIdx], importanceRecord.m_Intersection, importanceRecord.m_BSDF));
+            evalUnoccludedContributions(&getLightVertexBuffer()[depth - 1 + firstPathIdx * maxLightPathDepth], maxLightPathDepth, count,
+                                        importanceRecord.m_Intersection, importanceRecord.m_BSDF, contributions, shadowRays);
         };
 
         auto evalBounded = [&](uint32_t pathIdx, std::size_t depth, uint32_t importanceRecordID) {
@@ -335,16 +477,16 @@ public:
 
         auto bOptimize = m_bUseAlphaMaxHeuristic && m_bUseDistributionWeightingOptimization;
 
-        m_ImportanceCache.buildDistributions(m_ImportanceRecordContainer.size(),
-                                             getResamplingLightPathCount(),
-                                             getMaxLightPathDepth(),
-                                             evalContrib,
-                                             evalUnoccluded,
-                                             evalBounded,
-                                             evalConservative,
-                                             m_AlphaConfidenceValues,
-                                             getSystemThreadCount(),
-                                             bOptimize);
+        m_ImportanceCache.buildBatchedDistributions(m_ImportanceRecordContainer.size(),
+                                                    getResamplingLightPathCount(),
+                                                    getMaxLightPathDepth(),
+                                                    getScene(),
+                                                    evalUnoccluded,
+                                                    evalBounded,
+                                                    evalConservative,
+                                                    m_AlphaConfidenceValues,
+                                                    getSystemThreadCount(),
+                                                    bOptimize);
     }
 
     void computeImportanceRecords() {
@@ -502,12 +644,19 @@ public:
     }
 
     Vec3f evalUnoccludedContribution(const BDPTPathVertex& lightVertex, const SurfacePoint& I, const BSDF& bsdf) const {
+        Ray shadowRay;
+        return evalUnoccludedContribution(lightVertex, I, bsdf, shadowRay);
+    }
+
+    // Also fill the ray to trace to test the visibility of the light vertex
+    Vec3f evalUnoccludedContribution(const BDPTPathVertex& lightVertex, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const {
         Vec3f wi;
         float dist;
         auto G = geometricFactor(I, lightVertex.m_Intersection, wi, dist);
         if(G > 0.f) {
             float cosThetaOutVPL, costThetaOutBSDF;
             auto M = bsdf.eval(wi, costThetaOutBSDF) * lightVertex.m_BSDF.eval(-wi, cosThetaOutVPL);
+            shadowRay = Ray(I, lightVertex.m_Intersection, wi, dist);
             return M * G * lightVertex.m_Power;
         }
         return zero<Vec3f>();
@@ -559,14 +708,20 @@ public:
     }
 
     Vec3f evalUnoccludedContribution(const EmissionVertex& vertex, const SurfacePoint& I, const BSDF& bsdf) const {
-        RaySample shadowRay;
-        auto Le = vertex.m_pLight->sampleDirectIllumination(getScene(), vertex.m_PositionSample, I, shadowRay);
+        Ray shadowRay;
+        return evalUnoccludedContribution(vertex, I, bsdf, shadowRay);
+    }
 
-        if(Le != zero<Vec3f>() && shadowRay.pdf) {
-            shadowRay.pdf *= vertex.m_fLightPdf;
+    Vec3f evalUnoccludedContribution(const EmissionVertex& vertex, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const {
+        RaySample shadowRaySample;
+        auto Le = vertex.m_pLight->sampleDirectIllumination(getScene(), vertex.m_PositionSample, I, shadowRaySample);
+
+        if(Le != zero<Vec3f>() && shadowRaySample.pdf) {
+            shadowRaySample.pdf *= vertex.m_fLightPdf;
             float cosThetaOutDir;
-            auto fr = bsdf.eval(shadowRay.value.dir, cosThetaOutDir);
-            return Le * fr * abs(cosThetaOutDir) / shadowRay.pdf;
+            auto fr = bsdf.eval(shadowRaySample.value.dir, cosThetaOutDir);
+            shadowRay = shadowRaySample.value;
+            return Le * fr * abs(cosThetaOutDir) / shadowRaySample.pdf;
         }
 
         return zero<Vec3f>();
@@ -594,12 +749,19 @@ public:
         serialize(xml, "alphaConfidenceValue", m_AlphaConfidenceValues);
         serialize(xml, "useAlphaMaxHeuristic", m_bUseAlphaMaxHeuristic);
         serialize(xml, "useDistributionWeightingOptimization", m_bUseDistributionWeightingOptimization);
+        serialize(xml, "useReservoirResampling", m_bUseReservoirResampling);
+        serialize(xml, "resamplingCandidateCount", m_nResamplingCandidateCount);
+    }
+
+    bool storeProfilingTrace(const FilePath& filepath) const override {
+        return m_TileProcessingTimer.storeChromeTrace(filepath);
     }
 
     void storeStatistics(tinyxml2::XMLElement& xml) const {
         serialize(xml, "ImportanceRecordsCount", m_ImportanceRecordContainer.size());
         serialize(xml, "BeginFrameTime", m_BeginFrameTimer);
-        serialize(xml, "TileProcessingTime", (const TaskTimer&) m_TileProcessingTimer);
+        serialize(xml, "TileProcessingTime", (const TaskProfiler&) m_TileProcessingTimer);
+        serialize(xml, "ProfilingSamplingPeriod", m_TileProcessingTimer.getSamplingPeriod());
     }
 
     void initFramebuffer() {
@@ -652,6 +814,9 @@ public:
     bool m_bUseAlphaMaxHeuristic = true;
     bool m_bUseDistributionWeightingOptimization = true;
 
+    bool m_bUseReservoirResampling = false;
+    std::size_t m_nResamplingCandidateCount = 8;
+
     uint32_t m_nIRCountPerShadingPoint = 4u; // Number of importance records to use for each shading point
     mutable Array2d<uint32_t> m_ShadingPointIRBuffer; // A buffer to store the IRs associated to each shading point
 
@@ -659,6 +824,11 @@ public:
 
     mutable Array2d<GeorgievImportanceRecordContainer::NearestUnfilteredImportanceRecord> m_ShadingPointUnfilteredIRBuffer;
 
+    // Connections of the previous tile (0) and of the current one (1) of each thread. With an out-of-core light vertex
+    // buffer, the connections of a tile are evaluated after the eye paths of the next tile of the thread are traced, so
+    // the chunks of its light vertices are prefetched one tile before they are read.
+    PerThreadAccumulator<ConnectionQueue> m_ConnectionQueuesPerThread;
+
     enum FramebufferTarget {
         FINAL_RENDER,
         NEAREST_IMPORTANCE_RECORD,
@@ -679,16 +849,8 @@ public:
         }, 1u
     };
 
-    TaskTimer m_TileProcessingTimer = {
-        {
-            "TraceEyePaths",
-            "EvalContribution",
-            "KdTreeLookup",
-            "ResampleLightVertex",
-            "ConnectLightVerticesToSensor",
-            "EvalResamplingMISWeight"
-        }, getSystemThreadCount()
-    };
+    // Timed at each eye vertex: TaskProfiler keeps the cost of the timers negligible
+    TaskProfiler m_TileProcessingTimer;
 };
 
 }
@@ -2,6 +2,9 @@
 
 #include <bonez/scene/Scene.hpp>
 #include <bonez/scene/sensors/Sensor.hpp>
+#include <bonez/rendering/RenderCheckpoint.hpp>
+#include <bonez/rendering/Denoiser.hpp>
+#include <bonez/scene/sensors/PixelSensor.hpp>
 
 #include <bonez/rendering/renderers/recursive_mis_bdpt.hpp>
 #include <bonez/rendering/renderers/DirectImportanceSampleTilePartionning.hpp>
@@ -11,6 +14,21 @@ namespace BnZ {
 using EmissionVertexBuffer = std::vector<EmissionVertex>;
 using LightVertexBuffer = Array2d<BDPTPathVertex>;
 
+// Region of the framebuffer rendered by all renderers, and on which errors are measured
+struct PG15RegionOfInterest {
+    Vec4u window = Vec4u(0u); // (x, y, width, height), empty to render the full framebuffer
+    // Spread the samples of the full framebuffer over the window: each of its tiles is processed
+    // (tile count / window tile count) times per iteration, with the light paths of the iteration
+    bool redistributeSamples = false;
+};
+
+// Denoising of the results: the guides are collected by each renderer during the render and the denoised images are
+// stored and measured in addition to the raw ones
+struct PG15DenoisingSettings {
+    bool enabled = false;
+    CrossBilateralDenoiser denoiser;
+};
+
 struct PG15RendererParams {
     const Scene& m_Scene;
     const Sensor& m_Sensor;
@@ -23,18 +41,51 @@ struct PG15RendererParams {
     Vec2u m_TileCount;
     std::size_t m_nTileCount;
 
+    Vec4u m_CropWindow; // The full framebuffer without region of interest
+    std::vector<uint32_t> m_CropTiles; // Tiles overlapping the crop window
+    uint32_t m_nCropTilePassCount = 1u;
+
+    bool m_bCollectDenoisingFeatures = false;
+
     PG15RendererParams(const Scene& scene, const Sensor& sensor,
                        Vec2u framebufferSize,
-                       std::size_t maxDepth, std::size_t resamplingPathCount):
+                       std::size_t maxDepth, std::size_t resamplingPathCount,
+                       const PG15RegionOfInterest& roi = PG15RegionOfInterest(),
+                       bool collectDenoisingFeatures = false):
         m_Scene(scene),
         m_Sensor(sensor),
         m_FramebufferSize(framebufferSize),
         m_nMaxDepth(maxDepth),
-        m_nResamplingPathCount(resamplingPathCount) {
+        m_nResamplingPathCount(resamplingPathCount),
+        m_bCollectDenoisingFeatures(collectDenoisingFeatures) {
 
         m_TileCount = m_FramebufferSize / m_TileSize +
                 Vec2u(m_FramebufferSize % m_TileSize != zero<Vec2u>());
         m_nTileCount = m_TileCount.x * m_TileCount.y;
+
+        auto origin = min(Vec2u(roi.window.x, roi.window.y), m_FramebufferSize);
+        auto end = min(Vec2u(roi.window.x, roi.window.y) + Vec2u(roi.window.z, roi.window.w), m_FramebufferSize);
+        if(end.x <= origin.x || end.y <= origin.y) {
+            origin = Vec2u(0u);
+            end = m_FramebufferSize;
+        }
+        m_CropWindow = Vec4u(origin, end - origin);
+
+        auto firstTile = origin / m_TileSize;
+        auto endTile = (end + m_TileSize - Vec2u(1u)) / m_TileSize;
+        for(auto y = firstTile.y; y < endTile.y; ++y) {
+            for(auto x = firstTile.x; x < endTile.x; ++x) {
+                m_CropTiles.emplace_back(x + y * m_TileCount.x);
+            }
+        }
+
+        if(roi.redistributeSamples) {
+            m_nCropTilePassCount = std::max(1u, uint32_t(m_nTileCount / m_CropTiles.size()));
+        }
+    }
+
+    bool hasCropWindow() const {
+        return m_CropWindow != Vec4u(0u, 0u, m_FramebufferSize);
     }
 };
 
@@ -42,7 +93,8 @@ struct PG15SharedData {
     const std::size_t m_nLightPathCount;
     const std::size_t m_nLightPathMaxDepth;
     EmissionVertexBuffer m_EmissionVertexBuffer;
-    LightVertexBuffer m_LightVertexBuffer;
+    LightVertexBuffer m_LightVertexBuffer { MemoryTag::LightVertices }; // Out-of-core if its size exceeds the threshold of the tag
+    ChunkPrefetcher m_LightVertexPrefetcher;
     DirectImportanceSampleTilePartionning m_DirectImportanceSampleTilePartionning;
     PowerBasedLightSampler m_LightSampler;
 
@@ -50,7 +102,9 @@ struct PG15SharedData {
 
     PG15SharedData(std::size_t lightPathCount, std::size_t lightPathMaxDepth):
         m_nLightPathCount(lightPathCount), m_nLightPathMaxDepth(lightPathMaxDepth),
-        m_EmissionVertexBuffer(lightPathCount), m_LightVertexBuffer(lightPathMaxDepth, lightPathCount) {
+        m_EmissionVertexBuffer(lightPathCount) {
+        m_LightVertexBuffer.resize(lightPathMaxDepth, lightPathCount);
+        m_LightVertexPrefetcher = ChunkPrefetcher(m_LightVertexBuffer.data());
     }
 };
 
@@ -96,20 +150,67 @@ public:
     const Framebuffer& getFramebuffer() const {
         return m_Framebuffer;
     }
+
+    // Guides of the denoiser, nullptr if they are not collected
+    const Framebuffer* getFeatureBuffers() const {
+        return m_Params.m_bCollectDenoisingFeatures ? &m_FeatureBuffers : nullptr;
+    }
+
+    // Store the state required to continue the progressive rendering later, the files of the checkpoint are prefixed by name
+    void storeCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml, const std::string& name) const {
+        checkpoint.storeFramebuffer(name, m_Framebuffer);
+        if(m_Params.m_bCollectDenoisingFeatures) {
+            checkpoint.storeFramebuffer(name + "_features", m_FeatureBuffers);
+        }
+        setChildAttribute(xml, "IterationCount", m_nIterationCount);
+        storeRandomGeneratorState(xml, m_Rng);
+        doStoreCheckpoint(checkpoint, xml, name);
+    }
+
+    // Return false if the checkpoint can't be restored, in which case the state of the renderer is undefined
+    bool loadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml, const std::string& name) {
+        if(!getChildAttribute(xml, "IterationCount", m_nIterationCount) ||
+                !checkpoint.loadFramebuffer(name, m_Framebuffer)) {
+            return false;
+        }
+        if(m_Params.m_bCollectDenoisingFeatures && !checkpoint.loadFramebuffer(name + "_features", m_FeatureBuffers)) {
+            return false;
+        }
+        if(!loadRandomGeneratorState(xml, m_Rng)) {
+            // Stored with another thread count: continue with another seed to keep samples independent
+            m_Rng.setSeed(m_nSeed + uint32_t(m_nIterationCount));
+        }
+        return doLoadCheckpoint(checkpoint, xml, name);
+    }
+
+    // Store the timing events of the tile processing in the Chrome trace format.
+    // Return false without writing anything if the renderer doesn't profile its tile processing.
+    virtual bool storeProfilingTrace(const FilePath& filepath) const {
+        return false;
+    }
 protected:
+    // Number of timing events kept by each thread for the profiling trace
+    static const std::size_t TRACE_EVENT_BUFFER_SIZE = 1u << 16;
+
     PG15Renderer(const PG15RendererParams& params,
                  const PG15SharedData& sharedData):
         m_Params(params),
         m_SharedData(sharedData),
-        m_Framebuffer(params.m_FramebufferSize) {
+        m_Framebuffer(params.m_FramebufferSize),
+        m_FeatureBuffers(params.m_FramebufferSize) {
         m_Rng.init(getSystemThreadCount(), m_nSeed);
+        if(m_Params.m_bCollectDenoisingFeatures) {
+            m_nFirstFeatureChannel = CrossBilateralDenoiser::addFeatureChannels(m_FeatureBuffers);
+        }
     }
 
-    ~PG15Renderer() = default;
+    virtual ~PG15Renderer() = default;
 
     const PG15RendererParams& m_Params;
     const PG15SharedData& m_SharedData;
     Framebuffer m_Framebuffer;
+    Framebuffer m_FeatureBuffers;
+    std::size_t m_nFirstFeatureChannel = 0u;
 
     std::size_t m_nIterationCount = 0u;
 
@@ -117,18 +218,23 @@ protected:
         return m_nIterationCount;
     }
 
+    // Only process the tiles of the crop window, restricted to it, m_Params.m_nCropTilePassCount times each.
+    // The guides of the denoiser are collected after each pass on a tile.
     template<typename TileProcessingFunc>
     void processTiles(const TileProcessingFunc& fun) {
+        const auto& window = m_Params.m_CropWindow;
         auto task = [&](uint32_t threadID) {
             auto loopID = 0u;
             while(true) {
-                auto tileID = loopID * getSystemThreadCount() + threadID;
+                auto i = loopID * getSystemThreadCount() + threadID;
                 ++loopID;
 
-                if(tileID >= m_Params.m_nTileCount) {
+                if(i >= m_Params.m_CropTiles.size()) {
                     return;
                 }
 
+                auto tileID = m_Params.m_CropTiles[i];
+
                 uint32_t tileX = tileID % m_Params.m_TileCount.x;
                 uint32_t tileY = tileID / m_Params.m_TileCount.x;
 
@@ -143,7 +249,17 @@ protected:
                     viewport.w = m_Params.m_FramebufferSize.y - viewport.y;
                 }
 
-                fun(threadID, tileID, viewport);
+                if(m_Params.hasCropWindow()) {
+                    auto origin = max(Vec2u(viewport.x, viewport.y), Vec2u(window.x, window.y));
+                    auto end = min(Vec2u(viewport.x, viewport.y) + Vec2u(viewport.z, viewport.w),
+                                   Vec2u(window.x, window.y) + Vec2u(window.z, window.w));
+                    viewport = Vec4u(origin, end - origin);
+                }
+
+                for(auto passID = 0u; passID < m_Params.m_nCropTilePassCount; ++passID) {
+                    fun(threadID, tileID, viewport);
+                    collectDenoisingFeatures(threadID, viewport);
+                }
             }
         };
 
@@ -163,6 +279,31 @@ protected:
         }
     }
 
+    // Accumulate the guides of the primary hit of a random ray of each pixel of the viewport
+    void collectDenoisingFeatures(uint32_t threadID, const Vec4u& viewport) {
+        if(!m_Params.m_bCollectDenoisingFeatures) {
+            return;
+        }
+
+        processTilePixels(viewport, [&](uint32_t x, uint32_t y) {
+            PixelSensor sensor(getSensor(), Vec2u(x, y), getFramebufferSize());
+
+            auto lensSample = getFloat2(threadID);
+            auto pixelSample = getFloat2(threadID);
+
+            RaySample raySample;
+            Intersection I;
+            sampleExitantRay(sensor, getScene(), lensSample, pixelSample, raySample, I);
+
+            if(I) {
+                BSDF bsdf(-raySample.value.dir, I, getScene());
+                CrossBilateralDenoiser::accumulateFeatures(m_FeatureBuffers, m_nFirstFeatureChannel, getPixelIndex(x, y),
+                                                           bsdf.getDiffuseCoefficient() + bsdf.getGlossyCoefficient(),
+                                                           I.Ns, I.distance);
+            }
+        });
+    }
+
     ThreadRNG getThreadRNG(std::size_t threadID) const {
         return ThreadRNG(m_Rng, threadID);
     }
@@ -231,6 +372,11 @@ protected:
         return m_SharedData.m_LightVertexBuffer;
     }
 
+    // Resamplers should prefetch the light vertices they sample before accessing them
+    const ChunkPrefetcher& getLightVertexPrefetcher() const {
+        return m_SharedData.m_LightVertexPrefetcher;
+    }
+
     const PowerBasedLightSampler& getLightSampler() const {
         return m_SharedData.m_LightSampler;
     }
@@ -261,6 +407,14 @@ protected:
     }
 
 private:
+    // Derived renderers accumulating data across iterations store it in addition to the framebuffer
+    virtual void doStoreCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml, const std::string& name) const {
+    }
+
+    virtual bool doLoadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml, const std::string& name) {
+        return true;
+    }
+
     uint32_t m_nSeed = 42u;
     mutable ThreadsRandomGenerator m_Rng;
 };
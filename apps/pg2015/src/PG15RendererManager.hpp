@@ -15,7 +15,8 @@ void storeFramebuffer(int resultIndex,
                       const FilePath& exrDir,
                       const FilePath& baseName,
                       float gamma,
-                      const Framebuffer& framebuffer);
+                      const Framebuffer& framebuffer,
+                      const Vec4u& window);
 
 struct RenderStatistics {
     Microseconds renderTime { 0 }; // Current render time
@@ -35,8 +36,9 @@ struct RenderStatistics {
 
 // This class is in charge of rendering and comparing the three algorithms: BPT, ICBPT and SkelBPT
 // For SkelBPT, multiple instances can be run to try for various parameters
+// BPT and ICBPT can be disabled, their slot is kept in the result indices
 // All results are stored in a repertory:
-// - "Date_(renderTime | iterCount)"
+// - "Date_(renderTime | iterCount)", or resultName if not empty
 //      - exr: contains EXR images
 //      - png: contains PNG images (000 is BPT, 001 is ICBPT and 002-xxx are SkelBPT)
 //      - reports: contains XML reports containing informations about the rendering
@@ -44,7 +46,15 @@ struct RenderStatistics {
 //      - thinning.report.bnz.xml: contains informations about the thinning time
 //      - scene.bnz.xml: contains the scene description used for the rendering
 //      - config.bnz.xml: contains the scene configuration used for the rendering
+//      - checkpoint: state of the render stored periodically, removed once the results are stored
 //
+// With a region of interest, only its tiles are rendered, errors are measured on it and the images only contain it
+// (EXR files keep its position in their data window). The reference image can be either full size or cropped.
+//
+// With denoising enabled, each renderer collects the guides of the denoiser and its denoised image is stored as
+// "xxx.denoised" in exr and png, its errors being added to its report.
+//
+// If a checkpoint exists in the result repertory, the render is resumed from it.
 // See render() method for more informations
 class PG15RendererManager {
 public:
@@ -59,36 +69,58 @@ public:
                         std::size_t resamplingPathCount,
                         const PG15ICBPTSettings& icBPTSettings,
                         const std::vector<PG15SkelBPTSettings>& skelBPTSettings,
-                        bool equalTime):
+                        bool equalTime,
+                        bool renderBPT = true,
+                        bool renderICBPT = true,
+                        const std::string& resultName = "",
+                        float checkpointIntervalInSeconds = 0.f,
+                        const PG15RegionOfInterest& roi = PG15RegionOfInterest(),
+                        const PG15DenoisingSettings& denoising = PG15DenoisingSettings()):
         m_ResultPath(resultPath),
-        m_Params(scene, sensor, framebufferSize, maxPathDepth, resamplingPathCount),
+        m_Params(scene, sensor, framebufferSize, maxPathDepth, resamplingPathCount, roi, denoising.enabled),
         m_SharedData(framebufferSize.x * framebufferSize.y, m_Params.m_nMaxDepth - 1u),
         m_pReferenceImage(loadEXRImage(referenceImagePath.str())),
         m_ICBPTRenderer(m_Params, m_SharedData, icBPTSettings),
         m_RenderStatistics(2 + skelBPTSettings.size()),
         m_fGamma(gamma),
         m_nRenderTimeMsOrIterationCount(renderTimeMsOrIterationCount),
-        m_bEqualTime(equalTime) {
+        m_bEqualTime(equalTime),
+        m_bRenderBPT(renderBPT),
+        m_bRenderICBPT(renderICBPT),
+        m_Denoising(denoising) {
 
         for(const auto& settings: skelBPTSettings) {
             m_SkelBPTRenderers.emplace_back(m_Params, m_SharedData, settings);
         }
 
+        m_CropReferenceImage = m_pReferenceImage->getSize() == framebufferSize ?
+                    crop(*m_pReferenceImage, m_Params.m_CropWindow) : *m_pReferenceImage;
+
         m_Rng.init(getSystemThreadCount(), m_nSeed);
 
         m_SharedData.m_LightSampler.initFrame(scene);
 
-        initResultDir(configDoc, sceneDoc);
+        initResultDir(configDoc, sceneDoc, resultName);
+
+        m_pCheckpoint = makeUnique<RenderCheckpoint>(m_ResultPath + "checkpoint", checkpointIntervalInSeconds);
+        loadCheckpoint();
     }
 
     const FilePath& getResultPath() const {
         return m_ResultPath;
     }
 
+    bool isDone() const {
+        return m_bDone;
+    }
+
     void initResultDir(tinyxml2::XMLDocument& configDoc,
-                        tinyxml2::XMLDocument& sceneDoc) {
+                        tinyxml2::XMLDocument& sceneDoc,
+                        std::string resultName) {
         createDirectory(m_ResultPath);
-        auto resultName = getDateString() + "_" + toString(m_nRenderTimeMsOrIterationCount);
+        if(resultName.empty()) {
+            resultName = getDateString() + "_" + toString(m_nRenderTimeMsOrIterationCount);
+        }
 
         m_ResultPath = m_ResultPath + resultName;
         createDirectory(m_ResultPath);
@@ -125,13 +157,15 @@ public:
 
         auto& framebuffer = ((const RendererType&)renderer).getFramebuffer();
 
-        auto nrmse = computeNormalizedRootMeanSquaredError(*m_pReferenceImage, framebuffer.getChannel(0));
+        auto image = crop(framebuffer.getChannel(0), m_Params.m_CropWindow);
+
+        auto nrmse = computeNormalizedRootMeanSquaredError(m_CropReferenceImage, image);
         auto nrmseFloat = reduceMax(nrmse);
 
-        auto rmse = computeRootMeanSquaredError(*m_pReferenceImage, framebuffer.getChannel(0));
+        auto rmse = computeRootMeanSquaredError(m_CropReferenceImage, image);
         auto rmseFloat = reduceMax(rmse);
 
-        auto mae = computeMeanAbsoluteError(*m_pReferenceImage, framebuffer.getChannel(0));
+        auto mae = computeMeanAbsoluteError(m_CropReferenceImage, image);
         auto maeFloat = reduceMax(mae);
 
         stats.renderTimes.emplace_back(us2ms(stats.renderTime));
@@ -174,10 +208,14 @@ public:
         }
 
         // Run all algorithms
-        pLogger->info("Render BPT");
-        allDone = render(m_BPTRenderer, 0) && allDone;
-        pLogger->info("Render ICBPT");
-        allDone = render(m_ICBPTRenderer, 1) && allDone;
+        if(m_bRenderBPT) {
+            pLogger->info("Render BPT");
+            allDone = render(m_BPTRenderer, 0) && allDone;
+        }
+        if(m_bRenderICBPT) {
+            pLogger->info("Render ICBPT");
+            allDone = render(m_ICBPTRenderer, 1) && allDone;
+        }
 
         for(auto i: range(m_SkelBPTRenderers.size())) {
             pLogger->info("Render SkelBPT %v", i);
@@ -192,11 +230,143 @@ public:
 
         if(allDone) {
             storeResults();
+            m_pCheckpoint->remove();
+            m_bDone = true;
+        } else if(m_pCheckpoint->isStoreDue()) {
+            storeCheckpoint();
         }
 
         return allDone;
     }
 
+    void storeCheckpoint() {
+        pLogger->info("Store checkpoint of iteration %v", m_SharedData.m_nIterationCount);
+
+        auto& checkpoint = *m_pCheckpoint;
+        auto& state = checkpoint.beginStore();
+
+        setChildAttribute(state, "IterationCount", m_SharedData.m_nIterationCount);
+        storeRandomGeneratorState(state, m_Rng);
+
+        auto storeRenderer = [&](const auto& renderer, std::size_t index) {
+            auto pRenderer = state.GetDocument()->NewElement("Renderer");
+            state.InsertEndChild(pRenderer);
+            setAttribute(*pRenderer, "index", index);
+
+            const auto& stats = m_RenderStatistics[index];
+            setChildAttribute(*pRenderer, "RenderTime", stats.renderTime);
+            setChildAttribute(*pRenderer, "RenderTimes", stats.renderTimes);
+            setChildAttribute(*pRenderer, "NRMSE", stats.nrmse);
+            setChildAttribute(*pRenderer, "RMSE", stats.rmse);
+            setChildAttribute(*pRenderer, "MAE", stats.mae);
+
+            storeCheckpointSettings(renderer, *pRenderer);
+            renderer.storeCheckpoint(checkpoint, *pRenderer, toString3(index));
+        };
+
+        if(m_bRenderBPT) {
+            storeRenderer(m_BPTRenderer, 0);
+        }
+        if(m_bRenderICBPT) {
+            storeRenderer(m_ICBPTRenderer, 1);
+        }
+        for(auto i: range(m_SkelBPTRenderers.size())) {
+            storeRenderer(m_SkelBPTRenderers[i], 2 + i);
+        }
+
+        checkpoint.commit();
+    }
+
+    // Resume the render from the checkpoint of the result repertory if there is one
+    void loadCheckpoint() {
+        auto& checkpoint = *m_pCheckpoint;
+        auto pState = checkpoint.load();
+        if(!pState) {
+            return;
+        }
+
+        std::size_t iterationCount = 0;
+        if(!getChildAttribute(*pState, "IterationCount", iterationCount)) {
+            throw std::runtime_error("Invalid checkpoint in " + checkpoint.getDirectoryPath().str());
+        }
+
+        auto loadRenderer = [&](auto& renderer, std::size_t index) {
+            for(auto pRenderer = pState->FirstChildElement("Renderer"); pRenderer;
+                pRenderer = pRenderer->NextSiblingElement("Renderer")) {
+                std::size_t rendererIndex = 0;
+                if(!getAttribute(*pRenderer, "index", rendererIndex) || rendererIndex != index) {
+                    continue;
+                }
+
+                // A checkpoint left by a render with other settings must not be merged in the results
+                tinyxml2::XMLDocument settingsDocument;
+                auto pSettings = settingsDocument.NewElement("Renderer");
+                settingsDocument.InsertEndChild(pSettings);
+                storeCheckpointSettings(renderer, *pSettings);
+
+                auto pStoredSettings = pRenderer->FirstChildElement("Settings");
+                if(!pStoredSettings || printXML(*pStoredSettings) != printXML(*pSettings->FirstChildElement("Settings"))) {
+                    throw std::runtime_error("Checkpoint in " + checkpoint.getDirectoryPath().str() +
+                                             " has been stored with other settings for renderer " + toString(index) +
+                                             ", remove it to restart the render");
+                }
+
+                auto& stats = m_RenderStatistics[index];
+                getChildAttribute(*pRenderer, "RenderTime", stats.renderTime);
+                getChildAttribute(*pRenderer, "RenderTimes", stats.renderTimes);
+                getChildAttribute(*pRenderer, "NRMSE", stats.nrmse);
+                getChildAttribute(*pRenderer, "RMSE", stats.rmse);
+                getChildAttribute(*pRenderer, "MAE", stats.mae);
+
+                if(renderer.loadCheckpoint(checkpoint, *pRenderer, toString3(index))) {
+                    return;
+                }
+                break;
+            }
+            // Renderers share the light paths of each iteration: all of them must be resumed or none
+            throw std::runtime_error("Checkpoint in " + checkpoint.getDirectoryPath().str() +
+                                     " does not match renderer " + toString(index) + ", remove it to restart the render");
+        };
+
+        if(m_bRenderBPT) {
+            loadRenderer(m_BPTRenderer, 0);
+        }
+        if(m_bRenderICBPT) {
+            loadRenderer(m_ICBPTRenderer, 1);
+        }
+        for(auto i: range(m_SkelBPTRenderers.size())) {
+            loadRenderer(m_SkelBPTRenderers[i], 2 + i);
+        }
+
+        m_SharedData.m_nIterationCount = iterationCount;
+        if(!loadRandomGeneratorState(*pState, m_Rng)) {
+            // Stored with another thread count: continue with another seed to keep samples independent
+            m_Rng.setSeed(m_nSeed + uint32_t(iterationCount));
+        }
+
+        pLogger->warn("Resume from checkpoint %v at iteration %v", checkpoint.getDirectoryPath().str(), iterationCount);
+    }
+
+    // Settings a renderer is resumed with must match the ones of its checkpoint
+    template<typename RendererType>
+    void storeCheckpointSettings(const RendererType& renderer, tinyxml2::XMLElement& xml) const {
+        auto pSettings = xml.GetDocument()->NewElement("Settings");
+        xml.InsertEndChild(pSettings);
+
+        setChildAttribute(*pSettings, "FramebufferSize", m_Params.m_FramebufferSize);
+        setChildAttribute(*pSettings, "CropWindow", m_Params.m_CropWindow);
+        setChildAttribute(*pSettings, "CropTilePassCount", m_Params.m_nCropTilePassCount);
+        setChildAttribute(*pSettings, "LightPathCount", m_SharedData.m_nLightPathCount);
+        setChildAttribute(*pSettings, "CollectDenoisingFeatures", m_Params.m_bCollectDenoisingFeatures);
+        renderer.storeSettings(*pSettings);
+    }
+
+    static std::string printXML(const tinyxml2::XMLElement& xml) {
+        tinyxml2::XMLPrinter printer;
+        xml.Accept(&printer);
+        return printer.CStr();
+    }
+
     void drawGUI(GUI& gui) {
         if(auto window = gui.addWindow("RendererManager")) {
             std::vector<std::string> rendererNames = { "BPT", "ICBPT"};
@@ -241,8 +411,24 @@ public:
         FilePath pngDir = m_ResultPath + "png";
         FilePath exrDir = m_ResultPath + "exr";
         FilePath statsDir = m_ResultPath + "stats";
-
-        storeFramebuffer(index, pngDir, exrDir, baseName, m_fGamma, renderer.getFramebuffer());
+        FilePath tracesDir = m_ResultPath + "traces";
+
+        storeFramebuffer(index, pngDir, exrDir, baseName, m_fGamma, renderer.getFramebuffer(), m_Params.m_CropWindow);
+
+        // The denoised image is measured on the region of interest, as the raw one
+        const auto* pFeatures = renderer.getFeatureBuffers();
+        Image denoisedImage;
+        if(pFeatures) {
+            const auto& window = m_Params.m_CropWindow;
+            denoisedImage = crop(m_Denoising.denoiser.denoise(renderer.getFramebuffer(), 0u, *pFeatures), window);
+            storeEXRImage((exrDir + baseName.addExt(".denoised.exr")).str(), denoisedImage, Vec2u(window.x, window.y),
+                          m_Params.m_FramebufferSize);
+
+            auto copy = denoisedImage;
+            copy.flipY();
+            copy.applyGamma(m_fGamma);
+            storeImage((pngDir + baseName.addExt(".denoised.png")).str(), copy);
+        }
 
         createDirectory(statsDir);
 
@@ -253,6 +439,9 @@ public:
         storeArray(statsDir + baseName.addExt(".absErrorFloat"), stats.mae);
         storeArray(statsDir + baseName.addExt(".processingTimes"), stats.renderTimes);
 
+        createDirectory(tracesDir);
+        renderer.storeProfilingTrace(tracesDir + baseName.addExt(".trace.json"));
+
         auto reportsPath = m_ResultPath + "reports";
         createDirectory(reportsPath);
 
@@ -276,6 +465,19 @@ public:
         setChildAttribute(*pReport, "RMSE", stats.rmse.back());
         setChildAttribute(*pReport, "MAE", stats.mae.back());
         setChildAttribute(*pReport, "IterationCount", stats.getIterationCount());
+        if(m_Params.hasCropWindow()) {
+            setChildAttribute(*pReport, "CropWindow", m_Params.m_CropWindow);
+            setChildAttribute(*pReport, "CropTilePassCount", m_Params.m_nCropTilePassCount);
+        }
+        if(pFeatures) {
+            setChildAttribute(*pReport, "DenoisedNRMSE", reduceMax(computeNormalizedRootMeanSquaredError(m_CropReferenceImage, denoisedImage)));
+            setChildAttribute(*pReport, "DenoisedRMSE", reduceMax(computeRootMeanSquaredError(m_CropReferenceImage, denoisedImage)));
+            setChildAttribute(*pReport, "DenoisedMAE", reduceMax(computeMeanAbsoluteError(m_CropReferenceImage, denoisedImage)));
+
+            auto pDenoiserSettings = reportDocument.NewElement("Denoiser");
+            m_Denoising.denoiser.storeSettings(*pDenoiserSettings);
+            pReport->InsertEndChild(pDenoiserSettings);
+        }
 
         pReport->InsertEndChild(pRendererStats);
 
@@ -285,10 +487,14 @@ public:
     }
 
     void storeResults() {
-        pLogger->info("Store BPT results");
-        storeResults(m_BPTRenderer, 0);
-        pLogger->info("Store ICBPT results");
-        storeResults(m_ICBPTRenderer, 1);
+        if(m_bRenderBPT) {
+            pLogger->info("Store BPT results");
+            storeResults(m_BPTRenderer, 0);
+        }
+        if(m_bRenderICBPT) {
+            pLogger->info("Store ICBPT results");
+            storeResults(m_ICBPTRenderer, 1);
+        }
         for(auto i: range(m_SkelBPTRenderers.size())) {
             pLogger->info("Store SkelBPT %v results", i);
             storeResults(m_SkelBPTRenderers[i], 2 + i);
@@ -300,13 +506,13 @@ public:
             return Mis(v);
         };
 
-        processTasksDeterminist(m_SharedData.m_nLightPathCount, [&](uint32_t pathID, uint32_t threadID) {
-            ThreadRNG rng(m_Rng, threadID);
-            auto pLightPath = m_SharedData.m_LightVertexBuffer.getSlicePtr(pathID);
-            m_SharedData.m_EmissionVertexBuffer[pathID] =
-                    sampleLightPath(pLightPath, m_SharedData.m_nLightPathMaxDepth, m_Params.m_Scene,
-                            m_SharedData.m_LightSampler, m_Params.m_nResamplingPathCount, mis, rng);
-        }, getSystemThreadCount());
+        // The paths are extended together so that their rays are traced in coherent order
+        BnZ::sampleLightPaths(m_SharedData.m_LightVertexBuffer.data(), m_SharedData.m_EmissionVertexBuffer.data(),
+                              m_SharedData.m_nLightPathCount, m_SharedData.m_nLightPathMaxDepth, m_Params.m_Scene,
+                              m_SharedData.m_LightSampler, m_Params.m_nResamplingPathCount, mis,
+                              [&](uint32_t pathID, uint32_t threadID) {
+                                  return ThreadRNG(m_Rng, threadID);
+                              }, m_LightPathRayQueue, getSystemThreadCount());
     }
 
     void buildDirectImportanceSampleTilePartitionning() {
@@ -335,6 +541,7 @@ private:
     PG15RendererParams m_Params;
     PG15SharedData m_SharedData;
     Shared<Image> m_pReferenceImage;
+    Image m_CropReferenceImage; // Region of the reference on which errors are measured
 
     uint32_t m_nSeed = 1024u;
     mutable ThreadsRandomGenerator m_Rng;
@@ -350,6 +557,15 @@ private:
     float m_fGamma;
     std::size_t m_nRenderTimeMsOrIterationCount;
     bool m_bEqualTime = true;
+    bool m_bRenderBPT = true;
+    bool m_bRenderICBPT = true;
+    bool m_bDone = false; // All results have been stored
+
+    PG15DenoisingSettings m_Denoising;
+
+    Unique<RenderCheckpoint> m_pCheckpoint;
+
+    RayQueue m_LightPathRayQueue;
 
     TaskTimer m_InitIterationTimer = {
         {
@@ -364,7 +580,8 @@ inline void storeFramebuffer(int resultIndex,
                              const FilePath& exrDir,
                              const FilePath& baseName,
                              float gamma,
-                             const Framebuffer& framebuffer) {
+                             const Framebuffer& fullFramebuffer,
+                             const Vec4u& window) {
     // Create output directories in case they don't exist
     createDirectory(pngDir.str());
     createDirectory(exrDir.str());
@@ -373,10 +590,14 @@ inline void storeFramebuffer(int resultIndex,
     FilePath pngFile = pngDir + baseName.addExt(".png");
     FilePath exrFile = exrDir + baseName.addExt(".exr");
 
+    // Only the window is stored, the EXR files keep its position in the full framebuffer
+    auto framebuffer = crop(fullFramebuffer, window);
+    auto dataWindowOrigin = Vec2u(window.x, window.y);
+
     // Make a copy of the image
     Image copy = framebuffer.getChannel(0);
     // Store the EXR image "as is"
-    storeEXRImage(exrFile.str(), copy);
+    storeEXRImage(exrFile.str(), copy, dataWindowOrigin, fullFramebuffer.getSize());
 
     // Post-process copy of image and store PNG file
     copy.flipY();
@@ -386,7 +607,7 @@ inline void storeFramebuffer(int resultIndex,
 
     // Store complete framebuffer as a single EXR multi layer image
     auto exrFramebufferFilePath = exrDir + baseName.addExt(".bnzframebuffer.exr");
-    storeEXRFramebuffer(exrFramebufferFilePath.str(), framebuffer);
+    storeEXRFramebuffer(exrFramebufferFilePath.str(), framebuffer, dataWindowOrigin, fullFramebuffer.getSize());
 
     // Store complete framebuffer as PNG indivual files in a dediacted subdirectory
     auto pngFramebufferDirPath = pngDir + "framebuffers/";
@@ -3,6 +3,7 @@
 #include "PG15Renderer.hpp"
 
 #include <bonez/rendering/renderers/skeleton_connection/SkeletonVisibilityDistributions.hpp>
+#include <bonez/sampling/Reservoir.hpp>
 
 namespace BnZ {
 
@@ -10,6 +11,11 @@ struct PG15SkelBPTSettings {
     bool useNodeRadianceWeight = true;
     bool useNodeDistanceWeight = true;
     float nodeFilteringFactor = 0.5f;
+    bool useAmortizedVisibility = false; // Reuse the visibility tests of previous iterations to build the distributions
+    float visibilityRefreshRate = 0.1f; // Fraction of the light paths whose shadow rays are traced at each iteration
+    bool useReservoirResampling = false; // Resample surface light vertices among uniform candidates instead of using the skeleton distributions
+    std::size_t resamplingCandidateCount = 8; // Number of candidates streamed in the reservoir of each eye vertex and depth
+    uint32_t profilingSamplingPeriod = 1u; // Only one call out of profilingSamplingPeriod of each profiled task is timed
 };
 
 class PG15SkelBPTRenderer: public PG15Renderer {
@@ -23,14 +29,27 @@ public:
         m_fRadianceScale(1.f / getLightPathCount()),
         m_bUseNodeRadianceWeight(settings.useNodeRadianceWeight),
         m_bUseNodeDistanceWeight(settings.useNodeDistanceWeight),
-        m_fNodeFilteringFactor(settings.nodeFilteringFactor) {
+        m_fNodeFilteringFactor(settings.nodeFilteringFactor),
+        m_bUseAmortizedVisibility(settings.useAmortizedVisibility),
+        m_VisibilityCache(settings.visibilityRefreshRate),
+        m_bUseReservoirResampling(settings.useReservoirResampling),
+        m_nResamplingCandidateCount(settings.resamplingCandidateCount),
+        m_TileProcessingTimer({
+            "TraceEyePaths",
+            "EvalContribution",
+            "SkeletonMapping",
+            "ResampleLightVertex",
+            "ConnectLightVerticesToSensor"
+        }, getSystemThreadCount(), settings.profilingSamplingPeriod, TRACE_EVENT_BUFFER_SIZE) {
         initFramebuffer();
 
         m_EyeVertexCountPerNode.resize(m_pSkel->size());
         std::fill(begin(m_EyeVertexCountPerNode), end(m_EyeVertexCountPerNode), 0u);
 
         m_EyeVertexCountPerNodePerThread.resize(m_pSkel->size(), getSystemThreadCount());
+        m_ConnectionQueuesPerThread.resize(2, getSystemThreadCount());
         m_FilteredNodeIndex.resize(m_pSkel->size());
+        m_VisibilityCache.reset(m_pSkel->size());
     }
 
     void render() {
@@ -38,20 +57,73 @@ public:
             auto timer = m_BuildSkelDistributionsTimer.start(0u);
 
             computeFilteredNodes();
-            buildDistributions(m_SkeletonVisibilityDistributions, getScene(), m_FilteredNodes, getEmissionVertexBufferPtr(),
-                               getLightVertexBuffer(), getResamplingLightPathCount(),
-                               m_bUseNodeRadianceWeight, m_bUseNodeDistanceWeight, getSystemThreadCount());
+            // Resampled light vertices are drawn uniformly: the skeleton distributions are not needed
+            if(!m_bUseReservoirResampling) {
+                if(m_bUseAmortizedVisibility) {
+                    m_VisibilityCache.beginIteration();
+                }
+                buildDistributions(m_SkeletonVisibilityDistributions, getScene(), m_FilteredNodes, getEmissionVertexBufferPtr(),
+                                   getLightVertexBuffer(), getResamplingLightPathCount(),
+                                   m_bUseNodeRadianceWeight, m_bUseNodeDistanceWeight, getSystemThreadCount(),
+                                   m_bUseAmortizedVisibility ? &m_VisibilityCache : nullptr);
+            }
         }
 
-        std::fill(begin(m_EyeVertexCountPerNodePerThread), end(m_EyeVertexCountPerNodePerThread), 0u);
+        m_EyeVertexCountPerNodePerThread.fill(0u);
 
         processTiles([&](uint32_t threadID, uint32_t tileID, const Vec4u& viewport) {
             renderTile(threadID, tileID, viewport);
         });
 
+        // Connections of the last tile of each thread
+        if(getLightVertexPrefetcher().isEnabled()) {
+            launchThreads([&](uint32_t threadID) {
+                connectEyeVertices(threadID, m_ConnectionQueuesPerThread(0, threadID));
+            }, getSystemThreadCount());
+        }
+
         ++m_nIterationCount;
     }
 
+    void doStoreCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml, const std::string& name) const override {
+        // Eye vertices mapped during the last iteration are added to m_EyeVertexCountPerNode at the next one
+        std::vector<uint64_t> pendingEyeVertexCountPerNode(m_pSkel->size(), 0u);
+        m_EyeVertexCountPerNodePerThread.reduceAll([&](std::size_t nodeID, uint64_t count) {
+            pendingEyeVertexCountPerNode[nodeID] = count;
+        });
+
+        setChildAttribute(xml, "EyeVertexCountPerNode", m_EyeVertexCountPerNode);
+        setChildAttribute(xml, "PendingEyeVertexCountPerNode", pendingEyeVertexCountPerNode);
+        setChildAttribute(xml, "TotalFilteredNodeCount", m_nTotalFilteredNodeCount);
+        if(m_bUseAmortizedVisibility) {
+            m_VisibilityCache.storeCheckpoint(checkpoint, xml, name + "_visibility");
+        }
+    }
+
+    bool doLoadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml, const std::string& name) override {
+        std::vector<uint64_t> eyeVertexCountPerNode, pendingEyeVertexCountPerNode;
+        if(!getChildAttribute(xml, "EyeVertexCountPerNode", eyeVertexCountPerNode) ||
+                !getChildAttribute(xml, "PendingEyeVertexCountPerNode", pendingEyeVertexCountPerNode) ||
+                eyeVertexCountPerNode.size() != m_pSkel->size() ||
+                pendingEyeVertexCountPerNode.size() != m_pSkel->size()) {
+            return false;
+        }
+
+        m_EyeVertexCountPerNode = eyeVertexCountPerNode;
+        m_EyeVertexCountPerNodePerThread.fill(0u);
+        for(auto nodeID: range(m_pSkel->size())) {
+            m_EyeVertexCountPerNodePerThread(nodeID, 0u) = pendingEyeVertexCountPerNode[nodeID];
+        }
+        getChildAttribute(xml, "TotalFilteredNodeCount", m_nTotalFilteredNodeCount);
+
+        // The cache only reduces the number of shadow rays: if it can't be restored, its statistics are rebuilt
+        if(m_bUseAmortizedVisibility && !m_VisibilityCache.loadCheckpoint(checkpoint, xml, name + "_visibility")) {
+            m_VisibilityCache.reset(m_pSkel->size());
+        }
+
+        return true;
+    }
+
     void computeFilteredNodes() {
         updateEyeVertexCountPerNode();
 
@@ -66,13 +138,9 @@ public:
 
     void updateEyeVertexCountPerNode() {
         // Count the number of eye vertices mapped to each node
-        for(auto nodeID: range(m_pSkel->size())) {
-            auto count = size_t(0);
-            for(auto threadID: range(getSystemThreadCount())) {
-                count += m_EyeVertexCountPerNodePerThread(nodeID, threadID);
-            }
+        m_EyeVertexCountPerNodePerThread.reduceAll([&](std::size_t nodeID, uint64_t count) {
             m_EyeVertexCountPerNode[nodeID] += count;
-        }
+        });
     }
 
     void computeNodeMappingStatistics(
@@ -107,6 +175,9 @@ public:
     }
 
     void renderTile(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) {
+        auto& previousTileConnections = m_ConnectionQueuesPerThread(0, threadID);
+        auto& tileConnections = m_ConnectionQueuesPerThread(1, threadID);
+
         PG15Renderer::processTilePixels(viewport, [&](uint32_t x, uint32_t y) {
             auto pixelID = getPixelIndex(x, y);
 
@@ -115,19 +186,51 @@ public:
                 accumulate(i, pixelID, Vec4f(0, 0, 0, 1));
             }
 
-            processSample(threadID, tileID, pixelID, x, y);
+            processSample(threadID, tileID, pixelID, x, y, tileConnections);
         });
 
+        // Out-of-core light vertices are read one tile after the chunks of the tile are prefetched, in-core ones
+        // right away
+        if(getLightVertexPrefetcher().isEnabled()) {
+            connectEyeVertices(threadID, previousTileConnections);
+            std::swap(previousTileConnections, tileConnections);
+        } else {
+            connectEyeVertices(threadID, tileConnections);
+        }
+
         // Compute contributions for 1-length eye paths (connection to sensor)
         connectLightVerticesToSensor(threadID, tileID, viewport);
     }
 
+    struct ResampledLightVertex {
+        Sample1u m_Sample = Sample1u(0u, 0.f);
+        std::size_t m_nDistribIdx = std::numeric_limits<std::size_t>::max(); // Max for the default distribution
+    };
+
+    struct QueuedEyeVertex {
+        BDPTPathVertex m_EyeVertex;
+        uint32_t m_nPixelID;
+    };
+
+    // Eye vertices of a tile and their resampled light vertices, connected after the light vertices are prefetched
+    struct ConnectionQueue {
+        std::vector<QueuedEyeVertex> m_EyeVertices;
+        // getLightVertexSampleCount() samples per depth for each eye vertex
+        std::vector<ResampledLightVertex> m_LightVertices;
+    };
+
+    // Light vertices resampled for each depth at an eye vertex: the candidates of the reservoir, or a single one
+    std::size_t getLightVertexSampleCount() const {
+        return m_bUseReservoirResampling ? max(std::size_t(1), m_nResamplingCandidateCount) : std::size_t(1);
+    }
+
     void processSample(uint32_t threadID, uint32_t tileID, uint32_t pixelID,
-                           uint32_t x, uint32_t y) {
+                           uint32_t x, uint32_t y, ConnectionQueue& connections) {
         auto traceEyePathTimer = m_TileProcessingTimer.start(0, threadID);
 
         auto maxEyePathDepth = getMaxEyePathDepth();
         auto maxLightPathDepth = getMaxLightPathDepth();
+        auto sampleCountPerDepth = getLightVertexSampleCount();
 
         auto mis = [&](float v) {
             return Mis(v);
@@ -191,60 +294,147 @@ public:
 
                 mappingTimer.storeDuration();
 
-                // Connection with a light vertex of each depth
+                // Resample the light vertices of each depth and prefetch their chunks, the connections are evaluated
+                // by connectEyeVertices
+                auto resamplingTimer = m_TileProcessingTimer.start(3, threadID);
+
+                connections.m_EyeVertices.emplace_back(QueuedEyeVertex { eyeVertex, pixelID });
                 for(auto j = 0u; j <= maxLightPathDepth; ++j) {
                     auto lightPathDepth = j;
                     auto totalLength = eyeVertex.m_nDepth + lightPathDepth + 1;
+                    // Only surface light vertices are resampled with a reservoir
+                    auto sampleCount = lightPathDepth ? sampleCountPerDepth : std::size_t(1);
+                    for(auto i = 0u; i < sampleCountPerDepth; ++i) {
+                        connections.m_LightVertices.emplace_back();
+                        if(totalLength > getMaxDepth() || i >= sampleCount) {
+                            continue;
+                        }
+                        auto& resampledLightVertex = connections.m_LightVertices.back();
+                        resampledLightVertex = sampleLightVertex(threadID, filteredNodeIndex, lightPathDepth);
+                        if(lightPathDepth && resampledLightVertex.m_Sample.pdf > 0.f) {
+                            getLightVertexPrefetcher().prefetch(&getLightVertexBuffer()(lightPathDepth - 1, resampledLightVertex.m_Sample.value));
+                        }
+                    }
+                }
 
-                    if(totalLength <= getMaxDepth()) {
-                        if(filteredNodeIndex == std::numeric_limits<std::size_t>::max()) {
-                            auto lightVertexSample = m_SkeletonVisibilityDistributions.sampleDefaultDistribution(lightPathDepth, getFloat(threadID));
-                            if(lightVertexSample.pdf > 0.f) {
-                                auto evalContribTimer = m_TileProcessingTimer.start(1, threadID);
+                resamplingTimer.storeDuration();
+            }
+        } while(extendEyePath());
+    }
 
-                                auto contrib = evalLightVertexContrib(eyeVertex, lightPathDepth, lightVertexSample);
+    // Connect the eye vertices of the queue to their resampled light vertices, then clear it
+    void connectEyeVertices(uint32_t threadID, ConnectionQueue& connections) {
+        auto maxLightPathDepth = getMaxLightPathDepth();
+        auto sampleCountPerDepth = getLightVertexSampleCount();
+
+        for(auto k = 0u; k < connections.m_EyeVertices.size(); ++k) {
+            const auto& eyeVertex = connections.m_EyeVertices[k].m_EyeVertex;
+            auto pixelID = connections.m_EyeVertices[k].m_nPixelID;
+            auto pResampledLightVertices = connections.m_LightVertices.data() + k * (maxLightPathDepth + 1) * sampleCountPerDepth;
+
+            // Connection with a light vertex of each depth
+            for(auto j = 0u; j <= maxLightPathDepth; ++j) {
+                auto lightPathDepth = j;
+                auto totalLength = eyeVertex.m_nDepth + lightPathDepth + 1;
+                if(totalLength > getMaxDepth()) {
+                    continue;
+                }
+                const auto* pSamples = pResampledLightVertices + j * sampleCountPerDepth;
+
+                auto contrib = zero<Vec3f>();
+                auto distribIdx = pSamples[0].m_nDistribIdx;
+                if(m_bUseReservoirResampling && lightPathDepth) {
+                    auto evalContribTimer = m_TileProcessingTimer.start(1, threadID);
+                    contrib = evalReservoirLightVertexContrib(threadID, eyeVertex, lightPathDepth, pSamples, sampleCountPerDepth, distribIdx);
+                } else if(pSamples[0].m_Sample.pdf > 0.f) {
+                    auto evalContribTimer = m_TileProcessingTimer.start(1, threadID);
+                    contrib = evalLightVertexContrib(eyeVertex, lightPathDepth, pSamples[0].m_Sample);
+                } else {
+                    continue;
+                }
 
-                                evalContribTimer.storeDuration();
+                auto distribTarget = distribIdx == std::numeric_limits<std::size_t>::max() ?
+                            DEFAULT_DISTRIB_CONTRIBUTION :
+                            DISTRIB0_CONTRIBUTION + distribIdx;
 
-                                accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
-                                accumulate(DEFAULT_DISTRIB_CONTRIBUTION, pixelID, Vec4f(contrib, 0));
-                                accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
+                accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
+                accumulate(distribTarget, pixelID, Vec4f(contrib, 0));
+                accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
 
-                                auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, lightPathDepth + 1);
-                                accumulate(FINAL_RENDER_DEPTH1 + getMaxDepth() + strategyOffset, pixelID, Vec4f(contrib, 0));
-                            }
-                        } else {
-                            auto resamplingTimer = m_TileProcessingTimer.start(3, threadID);
+                auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, lightPathDepth + 1);
+                accumulate(FINAL_RENDER_DEPTH1 + getMaxDepth() + strategyOffset, pixelID, Vec4f(contrib, 0));
+            }
+        }
 
-                            auto distribIdx = clamp(size_t(getFloat(threadID) * m_SkeletonVisibilityDistributions.distributionCount()), size_t(0),
-                                                    m_SkeletonVisibilityDistributions.distributionCount() - 1);
-                            auto distribPdf = 1.f / m_SkeletonVisibilityDistributions.distributionCount();
+        connections.m_EyeVertices.clear();
+        connections.m_LightVertices.clear();
+    }
 
-                            auto lightPathDiscreteSample = m_SkeletonVisibilityDistributions.sample(distribIdx, filteredNodeIndex,
-                                                                                                    lightPathDepth, getFloat(threadID));
-                            lightPathDiscreteSample.pdf *= distribPdf;
+    // Sample a light vertex of the depth with a random skeleton distribution of the node, or the default distribution
+    // if the eye vertex is not mapped to a filtered node. The pdf includes the probability of choosing the distribution.
+    // With reservoir resampling, the distributions are not built and the light vertex is chosen uniformly.
+    ResampledLightVertex sampleLightVertex(uint32_t threadID, std::size_t filteredNodeIndex, std::size_t lightPathDepth) {
+        ResampledLightVertex resampledLightVertex;
+        if(m_bUseReservoirResampling) {
+            auto lightPathCount = getResamplingLightPathCount();
+            resampledLightVertex.m_Sample = Sample1u(clamp(uint32_t(getFloat(threadID) * lightPathCount), 0u, uint32_t(lightPathCount - 1)),
+                                                     1.f / lightPathCount);
+        } else if(filteredNodeIndex == std::numeric_limits<std::size_t>::max()) {
+            resampledLightVertex.m_Sample = m_SkeletonVisibilityDistributions.sampleDefaultDistribution(lightPathDepth, getFloat(threadID));
+        } else {
+            auto distribIdx = clamp(size_t(getFloat(threadID) * m_SkeletonVisibilityDistributions.distributionCount()), size_t(0),
+                                    m_SkeletonVisibilityDistributions.distributionCount() - 1);
+            auto distribPdf = 1.f / m_SkeletonVisibilityDistributions.distributionCount();
+
+            resampledLightVertex.m_nDistribIdx = distribIdx;
+            resampledLightVertex.m_Sample = m_SkeletonVisibilityDistributions.sample(distribIdx, filteredNodeIndex,
+                                                                                     lightPathDepth, getFloat(threadID));
+            resampledLightVertex.m_Sample.pdf *= distribPdf;
+        }
+        return resampledLightVertex;
+    }
 
-                            resamplingTimer.storeDuration();
+    // Stream the candidateCount surface light vertices drawn uniformly by sampleLightVertex in a reservoir, with the luminance
+    // of their unoccluded contribution as target: only the shadow ray of the kept candidate is traced.
+    // distribIdx is set to the default distribution since no skeleton distribution is used.
+    Vec3f evalReservoirLightVertexContrib(uint32_t threadID, const BDPTPathVertex& eyeVertex, std::size_t lightPathDepth,
+                                          const ResampledLightVertex* pCandidates, std::size_t candidateCount,
+                                          std::size_t& distribIdx) {
+        auto mis = [&](float v) {
+            return Mis(v);
+        };
 
-                            if(lightPathDiscreteSample.pdf > 0.f) {
-                                auto evalContribTimer = m_TileProcessingTimer.start(1, threadID);
+        struct Candidate {
+            ResampledLightVertex m_LightVertex;
+            Vec3f m_UnoccludedContrib = zero<Vec3f>();
+            Ray m_ShadowRay {};
+        };
 
-                                auto contrib = evalLightVertexContrib(eyeVertex, lightPathDepth, lightPathDiscreteSample);
+        Reservoir<Candidate> reservoir;
+        for(auto i = 0u; i < candidateCount; ++i) {
+            Candidate candidate;
+            candidate.m_LightVertex = pCandidates[i];
+
+            const auto& sample = candidate.m_LightVertex.m_Sample;
+            if(sample.pdf > 0.f) {
+                const auto& lightVertex = getLightVertexBuffer()(lightPathDepth - 1, sample.value);
+                if(lightVertex.m_fPathPdf > 0.f) {
+                    candidate.m_UnoccludedContrib = evalUnoccludedConnection(eyeVertex, lightVertex, getResamplingLightPathCount(),
+                                                                             mis, candidate.m_ShadowRay);
+                }
+            }
 
-                                evalContribTimer.storeDuration();
+            reservoir.add(candidate, luminance(candidate.m_UnoccludedContrib), sample.pdf, getFloat(threadID));
+        }
 
-                                accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
-                                accumulate(DISTRIB0_CONTRIBUTION + distribIdx, pixelID, Vec4f(contrib, 0));
-                                accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
+        distribIdx = reservoir.getSample().m_LightVertex.m_nDistribIdx;
+        if(reservoir.empty() || getScene().occluded(reservoir.getSample().m_ShadowRay)) {
+            return zero<Vec3f>();
+        }
 
-                                auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, lightPathDepth + 1);
-                                accumulate(FINAL_RENDER_DEPTH1 + getMaxDepth() + strategyOffset, pixelID, Vec4f(contrib, 0));
-                            }
-                        }
-                    }
-                }
-            }
-        } while(extendEyePath());
+        // The contribution weight of the reservoir replaces the inverse pdf of evalLightVertexContrib
+        return reservoir.getContributionWeight() * (1.f / getResamplingLightPathCount()) * m_fImportanceScale *
+                reservoir.getSample().m_UnoccludedContrib;
     }
 
     Vec3f evalLightVertexContrib(
@@ -341,11 +531,20 @@ public:
         serialize(xml, "useNodeRadianceWeight", m_bUseNodeRadianceWeight);
         serialize(xml, "useNodeDistanceWeight", m_bUseNodeDistanceWeight);
         serialize(xml, "nodeFilteringFactor", m_fNodeFilteringFactor);
+        serialize(xml, "useAmortizedVisibility", m_bUseAmortizedVisibility);
+        serialize(xml, "visibilityRefreshRate", m_VisibilityCache.getRefreshRate());
+        serialize(xml, "useReservoirResampling", m_bUseReservoirResampling);
+        serialize(xml, "resamplingCandidateCount", m_nResamplingCandidateCount);
+    }
+
+    bool storeProfilingTrace(const FilePath& filepath) const override {
+        return m_TileProcessingTimer.storeChromeTrace(filepath);
     }
 
     void storeStatistics(tinyxml2::XMLElement& xml) const {
         serialize(xml, "BeginFrameTime", m_BuildSkelDistributionsTimer);
-        serialize(xml, "TileProcessingTime", (const TaskTimer&) m_TileProcessingTimer);
+        serialize(xml, "TileProcessingTime", (const TaskProfiler&) m_TileProcessingTimer);
+        serialize(xml, "ProfilingSamplingPeriod", m_TileProcessingTimer.getSamplingPeriod());
 
         uint64_t sum;
         double mean, variance;
@@ -390,6 +589,11 @@ public:
         serialize(xml, "StdDevOfMappedEyeVertexForFilteredNodes", (const double&) sqrt(variance));
 
         serialize(xml, "MeanOfUseNodePerFrame", m_nTotalFilteredNodeCount / getIterationCount());
+
+        if(m_bUseAmortizedVisibility) {
+            serialize(xml, "TracedVisibilityCountLastFrame", m_VisibilityCache.getTracedCount());
+            serialize(xml, "EstimatedVisibilityCountLastFrame", m_VisibilityCache.getEstimatedCount());
+        }
     }
 
     Shared<const CurvilinearSkeleton> m_pSkel;
@@ -404,20 +608,25 @@ public:
     bool m_bUseNodeDistanceWeight = true;
     float m_fNodeFilteringFactor = 0.01f;
 
+    bool m_bUseAmortizedVisibility = false;
+    SkeletonVisibilityCache m_VisibilityCache;
+
+    bool m_bUseReservoirResampling = false;
+    std::size_t m_nResamplingCandidateCount = 8;
+
     float m_fImportanceScale = 1.f; // 1 / (number of eye path per pixel)
     float m_fRadianceScale = 0.f; // 1 / (number of light path per pixel)
 
     TaskTimer m_BuildSkelDistributionsTimer = {{ "BuildSkeletonDistributions" }, 1u };
-    TaskTimer m_TileProcessingTimer = {
-        {
-            "TraceEyePaths",
-            "EvalContribution",
-            "SkeletonMapping",
-            "ResampleLightVertex",
-            "ConnectLightVerticesToSensor"
-        }, getSystemThreadCount()};
+    // Timed at each eye vertex: TaskProfiler keeps the cost of the timers negligible
+    TaskProfiler m_TileProcessingTimer;
+
+    PerThreadAccumulator<uint64_t> m_EyeVertexCountPerNodePerThread;
 
-    Array2d<uint64_t> m_EyeVertexCountPerNodePerThread;
+    // Connections of the previous tile (0) and of the current one (1) of each thread. With an out-of-core light vertex
+    // buffer, the connections of a tile are evaluated after the eye paths of the next tile of the thread are traced, so
+    // the chunks of its light vertices are prefetched one tile before they are read.
+    PerThreadAccumulator<ConnectionQueue> m_ConnectionQueuesPerThread;
 
     // Framebuffer targets
     enum FramebufferTarget {
@@ -20,11 +20,19 @@ PG2015Viewer::PG2015Viewer(const FilePath& applicationPath,
                            const std::vector<PG15SkelBPTSettings>& skelBPTSettings,
                            std::size_t thinningResolution,
                            bool useSegmentedSkel,
-                           bool equalTime):
+                           bool equalTime,
+                           bool renderBPT,
+                           bool renderICBPT,
+                           const std::string& resultName,
+                           bool headless,
+                           float checkpointInterval,
+                           const PG15RegionOfInterest& roi,
+                           const PG15DenoisingSettings& denoising):
     m_ViewerDirPath(viewerFilePath.directory()),
+    m_bHeadless(headless),
     m_Settings(viewerFilePath),
     m_WindowManager(m_Settings.m_WindowSize.x, m_Settings.m_WindowSize.y,
-                    "PG2015Viewer"),
+                    "PG2015Viewer", !headless),
     m_GUI(applicationPath.file(), m_WindowManager),
     m_ShaderManager(applicationPath.directory() + "shaders"),
     m_GLImageRenderer(m_ShaderManager),
@@ -44,7 +52,13 @@ PG2015Viewer::PG2015Viewer(const FilePath& applicationPath,
                       resamplingPathCount,
                       icBPTSettings,
                       skelBPTSettings,
-                      equalTime) {
+                      equalTime,
+                      renderBPT,
+                      renderICBPT,
+                      resultName,
+                      checkpointInterval,
+                      roi,
+                      denoising) {
 
     m_ScreenFramebuffer.init(m_Settings.m_FramebufferSize);
 
@@ -208,6 +222,12 @@ void PG2015Viewer::sceneThinning() {
 }
 
 void PG2015Viewer::run() {
+    if(m_bHeadless) {
+        while(!m_RendererManager.render()) {
+        }
+        return;
+    }
+
     std::atomic<bool> done { false };
 
     std::thread renderThread([&]() {
@@ -29,10 +29,26 @@ public:
                  const std::vector<PG15SkelBPTSettings>& skelBPTSettings,
                  std::size_t thinningResolution,
                  bool useSegmentedSkel,
-                 bool equalTime = true); // If false, compute results for the same number of iterations, specified by "renderTimeMsOrIterationCount"
+                 bool equalTime = true, // If false, compute results for the same number of iterations, specified by "renderTimeMsOrIterationCount"
+                 bool renderBPT = true,
+                 bool renderICBPT = true,
+                 const std::string& resultName = "", // Name of the result directory, generated from the date if empty
+                 bool headless = false, // If true, the window is hidden and run() only renders
+                 float checkpointInterval = 0.f, // Seconds between two checkpoints of the render, 0 to disable
+                 const PG15RegionOfInterest& roi = PG15RegionOfInterest(), // Region rendered, the full framebuffer by default
+                 const PG15DenoisingSettings& denoising = PG15DenoisingSettings()); // Disabled by default
 
     void run();
 
+    // True if all renderers have finished and their results have been stored
+    bool isDone() const {
+        return m_RendererManager.isDone();
+    }
+
+    const FilePath& getResultPath() const {
+        return m_RendererManager.getResultPath();
+    }
+
 private:
     bool initScene(const std::string& configName);
 
@@ -50,6 +66,7 @@ private:
     };
 
     FilePath m_ViewerDirPath;
+    bool m_bHeadless = false;
 
     Settings m_Settings;
 
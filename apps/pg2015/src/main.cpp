@@ -1,6 +1,7 @@
 #include <iostream>
 
 #include "PG2015Viewer.hpp"
+#include "PG15BatchRunner.hpp"
 
 INITIALIZE_EASYLOGGINGPP
 
@@ -8,9 +9,25 @@ namespace BnZ {
 
 void generateResultsForPG15(const FilePath& applicationPath);
 
+// Usage:
+// - pg2015: render the default list of scenes
+// - pg2015 --batch <jobFile>: run all the jobs of a job file that have no results yet (see PG15BatchRunner.hpp)
+// - pg2015 --job <jobFile> <jobIndex>: run a single job without display (used by --batch)
 int main(int argc, char** argv) {
     initEasyLoggingpp(argc, argv);
 
+    try {
+        if(argc >= 3 && std::string(argv[1]) == "--batch") {
+            return runPG15JobList(argv[0], argv[2]) == 0u ? 0 : 1;
+        }
+        if(argc >= 4 && std::string(argv[1]) == "--job") {
+            return runPG15Job(argv[0], argv[2], std::stoul(argv[3])) ? 0 : 1;
+        }
+    } catch(const std::exception& e) {
+        LOG(ERROR) << e.what();
+        return 1;
+    }
+
     generateResultsForPG15(argv[0]);
 
 	return 0;
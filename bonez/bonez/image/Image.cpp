@@ -180,8 +180,22 @@ namespace BnZ {
         return pImage;
     }
 
+    // Header of an image stored in the data window [dataWindowOrigin, dataWindowOrigin + size) of the display window
+    static Imf::Header makeEXRHeader(const Vec2u& size, const Vec2u& dataWindowOrigin, const Vec2u& displayWindowSize) {
+        Imath::Box2i displayWindow(Imath::V2i(0, 0),
+                                   Imath::V2i(int(displayWindowSize.x) - 1, int(displayWindowSize.y) - 1));
+        Imath::Box2i dataWindow(Imath::V2i(int(dataWindowOrigin.x), int(dataWindowOrigin.y)),
+                                Imath::V2i(int(dataWindowOrigin.x + size.x) - 1, int(dataWindowOrigin.y + size.y) - 1));
+        return Imf::Header(displayWindow, dataWindow);
+    }
+
     void storeEXRImage(const std::string& filepath, const Image& image) {
-        Imf::Header header(image.getWidth(), image.getHeight());
+        storeEXRImage(filepath, image, Vec2u(0u), image.getSize());
+    }
+
+    void storeEXRImage(const std::string& filepath, const Image& image,
+                       const Vec2u& dataWindowOrigin, const Vec2u& displayWindowSize) {
+        auto header = makeEXRHeader(image.getSize(), dataWindowOrigin, displayWindowSize);
         header.insert("isBnZFramebuffer", Imf::IntAttribute(0));
         header.channels().insert("R", Imf::Channel(Imf::FLOAT));
         header.channels().insert("G", Imf::Channel(Imf::FLOAT));
@@ -192,7 +206,8 @@ namespace BnZ {
 
         Imf::FrameBuffer frameBuffer;
 
-        const auto basePtr = (char*) image.getPixels();
+        // The slices are addressed with the coordinates of the display window
+        const auto basePtr = (char*) (image.getPixels() - dataWindowOrigin.x - dataWindowOrigin.y * image.getWidth());
         const auto xStride = sizeof(Vec4f);
         const auto yStride = sizeof(Vec4f) * image.getWidth();
 
@@ -323,7 +338,12 @@ namespace BnZ {
     }
 
     void storeEXRFramebuffer(const std::string& filepath, const Framebuffer& framebuffer) {
-        Imf::Header header(framebuffer.getWidth(), framebuffer.getHeight());
+        storeEXRFramebuffer(filepath, framebuffer, Vec2u(0u), framebuffer.getSize());
+    }
+
+    void storeEXRFramebuffer(const std::string& filepath, const Framebuffer& framebuffer,
+                             const Vec2u& dataWindowOrigin, const Vec2u& displayWindowSize) {
+        auto header = makeEXRHeader(framebuffer.getSize(), dataWindowOrigin, displayWindowSize);
         header.insert("isBnZFramebuffer", Imf::IntAttribute(1));
 
         for(auto fbChannel: range(framebuffer.getChannelCount())) {
@@ -344,7 +364,7 @@ namespace BnZ {
             auto& channelName = framebuffer.getChannelName(fbChannel);
 
             const auto& image = framebuffer.getChannel(fbChannel);
-            const auto basePtr = (char*) image.getPixels();
+            const auto basePtr = (char*) (image.getPixels() - dataWindowOrigin.x - dataWindowOrigin.y * image.getWidth());
             const auto xStride = sizeof(Vec4f);
             const auto yStride = sizeof(Vec4f) * image.getWidth();
 
@@ -370,6 +390,16 @@ namespace BnZ {
         file.writePixels(framebuffer.getHeight());
     }
 
+    Image crop(const Image& image, const Vec4u& window) {
+        Image result(window.z, window.w, nullptr, MemoryTag::Images);
+        for(auto y = 0u; y < window.w; ++y) {
+            std::copy(image.getPixels() + (window.y + y) * image.getWidth() + window.x,
+                      image.getPixels() + (window.y + y) * image.getWidth() + window.x + window.z,
+                      result.getPixels() + y * window.z);
+        }
+        return result;
+    }
+
     Vec4f texture(const Image& image, const Vec2f& texCoords, ImageFilter filter) {
         if(filter == ImageFilter::Nearest) {
             Vec2f st = texCoords - floor(texCoords);
@@ -15,13 +15,15 @@ namespace BnZ {
 
     class Image {
     public:
-        typedef std::vector<Vec4f>::iterator iterator;
-        typedef std::vector<Vec4f>::const_iterator const_iterator;
+        using PixelContainer = std::vector<Vec4f, TrackedAllocator<Vec4f>>;
+        typedef PixelContainer::iterator iterator;
+        typedef PixelContainer::const_iterator const_iterator;
 
         Image() = default;
 
-        Image(uint32_t w, uint32_t h, const Vec4f* pixels = nullptr) :
-            m_nWidth(w), m_nHeight(h), m_Pixels(m_nWidth * m_nHeight) {
+        // memoryTag is the subsystem to which the pixels are accounted
+        Image(uint32_t w, uint32_t h, const Vec4f* pixels = nullptr, MemoryTag memoryTag = MemoryTag::Images) :
+            m_nWidth(w), m_nHeight(h), m_Pixels(m_nWidth * m_nHeight, TrackedAllocator<Vec4f>(memoryTag)) {
             if (pixels) {
                 std::copy(pixels, pixels + m_Pixels.size(), std::begin(m_Pixels));
             }
@@ -156,7 +158,7 @@ namespace BnZ {
 
     private:
         uint32_t m_nWidth = 0, m_nHeight = 0;
-        std::vector<Vec4f> m_Pixels;
+        PixelContainer m_Pixels { TrackedAllocator<Vec4f>(MemoryTag::Images) };
     };
 
     inline void fillTexture(GLTexture2D& texture, const Image& image) {
@@ -182,12 +184,23 @@ namespace BnZ {
 
     void storeEXRImage(const std::string& filepath, const Image& image);
 
+    // Store a crop of a larger image: the data window of the file is [dataWindowOrigin, dataWindowOrigin + image size)
+    // and its display window [0, displayWindowSize). loadEXRImage returns the data window only.
+    void storeEXRImage(const std::string& filepath, const Image& image,
+                       const Vec2u& dataWindowOrigin, const Vec2u& displayWindowSize);
+
     Framebuffer loadEXRFramebuffer(const std::string& filepath);
 
     bool loadEXRFramebuffer(const std::string& filepath, Framebuffer& framebuffer);
 
     void storeEXRFramebuffer(const std::string& filepath, const Framebuffer& framebuffer);
 
+    void storeEXRFramebuffer(const std::string& filepath, const Framebuffer& framebuffer,
+                             const Vec2u& dataWindowOrigin, const Vec2u& displayWindowSize);
+
+    // Copy of the pixels of a window (x, y, width, height) of the image. The window must be inside the image.
+    Image crop(const Image& image, const Vec4u& window);
+
     enum class ImageFilter {
         Nearest,
         Bilinear
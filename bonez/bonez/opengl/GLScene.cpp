@@ -152,10 +152,17 @@ void GLScene::render(GLMaterialUniforms& uniforms, uint32_t numInstances) const
 #else
 
 GLScene::GLScene(const SceneGeometry& geometry) {
-    m_TriangleMeshs.reserve(geometry.getMeshCount());
-    for (const auto& mesh : geometry.getMeshs()) {
-        m_TriangleMeshs.emplace_back(mesh);
-    }
+    m_TriangleMeshs.reserve(geometry.getMeshCount() + geometry.getInstancedMeshes().size());
+    geometry.forEachPlacedMesh([&](uint32_t meshID, const TriangleMesh& mesh) {
+        if (SceneGeometry::isInstancedMesh(meshID)) {
+            // Instances are uploaded in world space, the rendering code has no notion of model matrix
+            auto worldMesh = mesh;
+            worldMesh.transform(geometry.getInstance(meshID).m_LocalToWorldMatrix);
+            m_TriangleMeshs.emplace_back(worldMesh);
+        } else {
+            m_TriangleMeshs.emplace_back(mesh);
+        }
+    });
 
     m_Materials.reserve(geometry.getMaterialCount() + 1);
 
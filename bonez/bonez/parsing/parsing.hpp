@@ -11,6 +11,7 @@
 #include <bonez/scene/lights/EnvironmentLight.hpp>
 
 #include <bonez/sys/time.hpp>
+#include <bonez/sys/profiler.hpp>
 
 #include "tinyxml/tinyxml2.h"
 
@@ -215,7 +216,8 @@ inline void setValue(tinyxml2::XMLElement& elt, const Microseconds& microseconds
     setChildAttribute(elt, "Seconds", us2sec(microseconds));
 }
 
-inline void setValue(tinyxml2::XMLElement& elt, const TaskTimer& timer) {
+template<typename TimerType>
+inline void setTaskTimerValue(tinyxml2::XMLElement& elt, const TimerType& timer) {
     elt.DeleteChildren();
 
     auto taskDurations = computeTaskDurations<Microseconds>(timer);
@@ -228,6 +230,14 @@ inline void setValue(tinyxml2::XMLElement& elt, const TaskTimer& timer) {
     }
 }
 
+inline void setValue(tinyxml2::XMLElement& elt, const TaskTimer& timer) {
+    setTaskTimerValue(elt, timer);
+}
+
+inline void setValue(tinyxml2::XMLElement& elt, const TaskProfiler& profiler) {
+    setTaskTimerValue(elt, profiler);
+}
+
 template<typename T>
 inline tinyxml2::XMLElement* setChildAttribute(tinyxml2::XMLElement& elt, const char* name, const T& value) {
     auto pChildElement = elt.FirstChildElement(name);
@@ -0,0 +1,174 @@
+#include "Denoiser.hpp"
+
+#include <bonez/sys/easyloggingpp.hpp>
+
+namespace BnZ {
+
+const char* CrossBilateralDenoiser::ALBEDO_CHANNEL = "albedo";
+const char* CrossBilateralDenoiser::NORMAL_CHANNEL = "normal";
+const char* CrossBilateralDenoiser::DEPTH_CHANNEL = "depth";
+
+std::size_t CrossBilateralDenoiser::addFeatureChannels(Framebuffer& features) {
+    auto firstChannel = features.addChannel(ALBEDO_CHANNEL);
+    features.addChannel(NORMAL_CHANNEL);
+    features.addChannel(DEPTH_CHANNEL);
+    return firstChannel;
+}
+
+void CrossBilateralDenoiser::accumulateFeatures(Framebuffer& features, std::size_t firstChannel, uint32_t pixelID,
+                                                const Vec3f& albedo, const Vec3f& normal, float depth) {
+    features.accumulate(firstChannel, pixelID, Vec4f(albedo, 1.f));
+    features.accumulate(firstChannel + 1, pixelID, Vec4f(normal, 1.f));
+    features.accumulate(firstChannel + 2, pixelID, Vec4f(Vec3f(depth), 1.f));
+}
+
+namespace {
+
+// Normalized guides of a pixel
+struct GuidePixel {
+    Vec3f m_Demodulation; // Albedo used to demodulate the color
+    Vec3f m_Irradiance; // Demodulated color
+    Vec3f m_ToneMappedIrradiance; // Compared by the color weight, less sensitive to fireflies
+    Vec3f m_Albedo;
+    Vec3f m_Normal;
+    float m_fDepth;
+    bool m_bHasFeatures; // False if the pixel has no primary hit
+};
+
+inline Vec3f getNormalizedValue(const Vec4f& value) {
+    return value.w > 0.f ? Vec3f(value) / value.w : zero<Vec3f>();
+}
+
+}
+
+Image CrossBilateralDenoiser::denoise(const Image& color, const Image& albedo, const Image& normal, const Image& depth,
+                                      uint32_t threadCount) const {
+    auto width = color.getWidth();
+    auto height = color.getHeight();
+    auto tileSize = max(m_TileSize, Vec2u(1u));
+    auto tileCount = (Vec2u(width, height) + tileSize - Vec2u(1u)) / tileSize;
+    auto radius = int(m_nRadius);
+
+    std::vector<GuidePixel> guides(color.getPixelCount());
+    processTasks(height, [&](uint32_t y, uint32_t threadID) {
+        for(auto x = 0u; x < width; ++x) {
+            auto pixelID = x + y * width;
+            auto& guide = guides[pixelID];
+            guide.m_bHasFeatures = albedo[pixelID].w > 0.f;
+            guide.m_Albedo = getNormalizedValue(albedo[pixelID]);
+            // A null component of the albedo would make the irradiance undefined
+            guide.m_Demodulation = max(guide.m_Albedo, Vec3f(0.01f));
+            guide.m_Irradiance = getNormalizedValue(color[pixelID]) / guide.m_Demodulation;
+            guide.m_ToneMappedIrradiance = guide.m_Irradiance / (Vec3f(1.f) + guide.m_Irradiance);
+            guide.m_Normal = getNormalizedValue(normal[pixelID]);
+            guide.m_fDepth = getNormalizedValue(depth[pixelID]).x;
+        }
+    }, threadCount);
+
+    std::vector<float> spatialWeights((2 * radius + 1) * (2 * radius + 1));
+    for(auto dy = -radius; dy <= radius; ++dy) {
+        for(auto dx = -radius; dx <= radius; ++dx) {
+            spatialWeights[(dx + radius) + (dy + radius) * (2 * radius + 1)] =
+                    std::exp(-float(dx * dx + dy * dy) / (2.f * sqr(m_fSigmaSpatial)));
+        }
+    }
+
+    auto rcpColorVariance = 1.f / (2.f * sqr(m_fSigmaColor));
+    auto rcpNormalVariance = 1.f / (2.f * sqr(m_fSigmaNormal));
+    auto rcpDepthVariance = 1.f / (2.f * sqr(m_fSigmaDepth));
+    auto rcpAlbedoVariance = 1.f / (2.f * sqr(m_fSigmaAlbedo));
+
+    Image result(width, height);
+    processTasks(tileCount.x * tileCount.y, [&](uint32_t tileID, uint32_t threadID) {
+        auto tileOrigin = Vec2u(tileID % tileCount.x, tileID / tileCount.x) * tileSize;
+        auto tileEnd = min(tileOrigin + tileSize, Vec2u(width, height));
+
+        for(auto y = tileOrigin.y; y < tileEnd.y; ++y) {
+            for(auto x = tileOrigin.x; x < tileEnd.x; ++x) {
+                auto pixelID = x + y * width;
+                const auto& center = guides[pixelID];
+                if(!center.m_bHasFeatures) {
+                    result[pixelID] = Vec4f(getNormalizedValue(color[pixelID]), 1.f);
+                    continue;
+                }
+
+                auto rcpDepth = center.m_fDepth > 0.f ? 1.f / center.m_fDepth : 0.f;
+                auto sum = zero<Vec3f>();
+                auto weightSum = 0.f;
+
+                auto yBegin = std::max(int(y) - radius, 0), yEnd = std::min(int(y) + radius, int(height) - 1);
+                auto xBegin = std::max(int(x) - radius, 0), xEnd = std::min(int(x) + radius, int(width) - 1);
+                for(auto j = yBegin; j <= yEnd; ++j) {
+                    for(auto i = xBegin; i <= xEnd; ++i) {
+                        const auto& neighbour = guides[i + j * width];
+                        if(!neighbour.m_bHasFeatures) {
+                            continue;
+                        }
+
+                        auto exponent = distanceSquared(center.m_ToneMappedIrradiance, neighbour.m_ToneMappedIrradiance) * rcpColorVariance +
+                                distanceSquared(center.m_Normal, neighbour.m_Normal) * rcpNormalVariance +
+                                sqr((center.m_fDepth - neighbour.m_fDepth) * rcpDepth) * rcpDepthVariance +
+                                distanceSquared(center.m_Albedo, neighbour.m_Albedo) * rcpAlbedoVariance;
+
+                        auto weight = spatialWeights[(i - int(x) + radius) + (j - int(y) + radius) * (2 * radius + 1)] * std::exp(-exponent);
+                        sum += weight * neighbour.m_Irradiance;
+                        weightSum += weight;
+                    }
+                }
+
+                // The center pixel has a weight of 1, so weightSum > 0
+                result[pixelID] = Vec4f(center.m_Demodulation * sum / weightSum, 1.f);
+            }
+        }
+    }, threadCount);
+
+    return result;
+}
+
+Image CrossBilateralDenoiser::denoise(const Framebuffer& framebuffer, std::size_t channelIdx, const Framebuffer& features,
+                                      uint32_t threadCount) const {
+    auto findChannel = [&](const char* name) {
+        for(auto i = 0u; i < features.getChannelCount(); ++i) {
+            if(features.getChannelName(i) == name) {
+                return int(i);
+            }
+        }
+        return -1;
+    };
+
+    auto albedoIdx = findChannel(ALBEDO_CHANNEL);
+    auto normalIdx = findChannel(NORMAL_CHANNEL);
+    auto depthIdx = findChannel(DEPTH_CHANNEL);
+
+    if(albedoIdx < 0 || normalIdx < 0 || depthIdx < 0 || features.getSize() != framebuffer.getSize()) {
+        LOG(WARNING) << "CrossBilateralDenoiser: no feature buffers for the framebuffer, the image is not denoised";
+        auto copy = framebuffer.getChannel(channelIdx);
+        copy.divideByAlpha();
+        return copy;
+    }
+
+    return denoise(framebuffer.getChannel(channelIdx), features.getChannel(albedoIdx),
+                   features.getChannel(normalIdx), features.getChannel(depthIdx), threadCount);
+}
+
+void CrossBilateralDenoiser::loadSettings(const tinyxml2::XMLElement& xml) {
+    serialize(xml, "radius", m_nRadius);
+    serialize(xml, "sigmaSpatial", m_fSigmaSpatial);
+    serialize(xml, "sigmaColor", m_fSigmaColor);
+    serialize(xml, "sigmaNormal", m_fSigmaNormal);
+    serialize(xml, "sigmaDepth", m_fSigmaDepth);
+    serialize(xml, "sigmaAlbedo", m_fSigmaAlbedo);
+    serialize(xml, "tileSize", m_TileSize);
+}
+
+void CrossBilateralDenoiser::storeSettings(tinyxml2::XMLElement& xml) const {
+    serialize(xml, "radius", m_nRadius);
+    serialize(xml, "sigmaSpatial", m_fSigmaSpatial);
+    serialize(xml, "sigmaColor", m_fSigmaColor);
+    serialize(xml, "sigmaNormal", m_fSigmaNormal);
+    serialize(xml, "sigmaDepth", m_fSigmaDepth);
+    serialize(xml, "sigmaAlbedo", m_fSigmaAlbedo);
+    serialize(xml, "tileSize", m_TileSize);
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <bonez/parsing/parsing.hpp>
+#include <bonez/sys/threads.hpp>
+#include "Framebuffer.hpp"
+
+namespace BnZ {
+
+// Feature-guided cross-bilateral filter applied as a post-process on the estimate of a renderer.
+//
+// The guides are the albedo, shading normal and distance of the primary hit of each pixel, collected in a separate
+// framebuffer (see TileProcessingRenderer::getFeatureBuffers). The color is divided by the albedo before filtering and
+// multiplied back after, so that textures are not blurred. Pixels without primary hit (null albedo) are left untouched.
+//
+// Images are accumulated: each pixel stores the sum of its samples, and its number of samples in the alpha channel.
+// The denoised image is normalized (alpha = 1).
+struct CrossBilateralDenoiser {
+    static const char* ALBEDO_CHANNEL;
+    static const char* NORMAL_CHANNEL;
+    static const char* DEPTH_CHANNEL;
+
+    uint32_t m_nRadius = 6; // The filter footprint is (2 * radius + 1)^2 pixels
+    float m_fSigmaSpatial = 3.f; // In pixels
+    float m_fSigmaColor = 0.5f; // Difference of tonemapped irradiance
+    float m_fSigmaNormal = 0.3f;
+    float m_fSigmaDepth = 0.05f; // Relative to the distance of the center pixel
+    float m_fSigmaAlbedo = 0.1f;
+    Vec2u m_TileSize = Vec2u(32u, 32u); // Each tile is filtered by a single thread
+
+    // Add the channels of the guides to a framebuffer, return the index of the first one
+    static std::size_t addFeatureChannels(Framebuffer& features);
+
+    // Accumulate the guides of a primary hit to the feature channels starting at firstChannel
+    static void accumulateFeatures(Framebuffer& features, std::size_t firstChannel, uint32_t pixelID,
+                                   const Vec3f& albedo, const Vec3f& normal, float depth);
+
+    Image denoise(const Image& color, const Image& albedo, const Image& normal, const Image& depth,
+                  uint32_t threadCount = getSystemThreadCount()) const;
+
+    // Denoise a channel of a framebuffer with the guides of a feature framebuffer of the same size.
+    // Return the normalized channel if the guides are missing.
+    Image denoise(const Framebuffer& framebuffer, std::size_t channelIdx, const Framebuffer& features,
+                  uint32_t threadCount = getSystemThreadCount()) const;
+
+    void loadSettings(const tinyxml2::XMLElement& xml);
+
+    void storeSettings(tinyxml2::XMLElement& xml) const;
+};
+
+}
@@ -27,7 +27,7 @@ public:
     }
 
     std::size_t addChannel(const std::string& name) {
-        m_Images.emplace_back(Image(m_Size.x, m_Size.y));
+        m_Images.emplace_back(Image(m_Size.x, m_Size.y, nullptr, MemoryTag::Framebuffer));
         m_Names.emplace_back(name);
 
         return m_Images.size() - std::size_t(1);
@@ -93,4 +93,13 @@ public:
     }
 };
 
+// Copy of the pixels of a window (x, y, width, height) of each channel
+inline Framebuffer crop(const Framebuffer& framebuffer, const Vec4u& window) {
+    Framebuffer result(window.z, window.w);
+    for(auto i = 0u; i < framebuffer.getChannelCount(); ++i) {
+        result.setChannel(result.addChannel(framebuffer.getChannelName(i)), crop(framebuffer.getChannel(i), window));
+    }
+    return result;
+}
+
 }
@@ -0,0 +1,261 @@
+#include "RenderCheckpoint.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <bonez/image/Image.hpp>
+
+namespace BnZ {
+
+static const char* CHECKPOINT_STATE_FILE = "checkpoint.bnz.xml";
+static const char* CHECKPOINT_TMP_STATE_FILE = "checkpoint.bnz.xml.tmp";
+
+RenderCheckpoint::RenderCheckpoint(const FilePath& directoryPath, float intervalInSeconds):
+    m_DirectoryPath(directoryPath),
+    m_Interval(Microseconds(int64_t(intervalInSeconds * 1000000.f))) {
+}
+
+FilePath RenderCheckpoint::getStateFilePath() const {
+    return m_DirectoryPath + CHECKPOINT_STATE_FILE;
+}
+
+bool RenderCheckpoint::exists() const {
+    return BnZ::exists(getStateFilePath());
+}
+
+bool RenderCheckpoint::isStoreDue() const {
+    return m_Interval.count() > 0 && m_Timer.getMicroEllapsedTime() >= m_Interval;
+}
+
+const tinyxml2::XMLElement* RenderCheckpoint::load() {
+    if(!exists()) {
+        return nullptr;
+    }
+
+    if(tinyxml2::XML_NO_ERROR != m_Document.LoadFile(getStateFilePath().c_str())) {
+        std::cerr << "RenderCheckpoint: unable to read " << getStateFilePath() << std::endl;
+        m_Document.Clear();
+        return nullptr;
+    }
+
+    auto pRoot = m_Document.RootElement();
+    if(!pRoot || !getAttribute(*pRoot, "generation", m_nGeneration)) {
+        std::cerr << "RenderCheckpoint: invalid state file " << getStateFilePath() << std::endl;
+        m_Document.Clear();
+        return nullptr;
+    }
+
+    m_CommittedFiles = listFiles();
+
+    return pRoot;
+}
+
+const char* RenderCheckpoint::findFile(const std::string& name) const {
+    auto pRoot = m_Document.RootElement();
+    if(!pRoot) {
+        return nullptr;
+    }
+    auto pFiles = pRoot->FirstChildElement("Files");
+    if(!pFiles) {
+        return nullptr;
+    }
+    for(auto pFile = pFiles->FirstChildElement("File"); pFile; pFile = pFile->NextSiblingElement("File")) {
+        if(pFile->Attribute("name", name.c_str())) {
+            return pFile->Attribute("path");
+        }
+    }
+    return nullptr;
+}
+
+std::vector<FilePath> RenderCheckpoint::listFiles() const {
+    std::vector<FilePath> files;
+    auto pRoot = m_Document.RootElement();
+    if(pRoot) {
+        if(auto pFiles = pRoot->FirstChildElement("Files")) {
+            for(auto pFile = pFiles->FirstChildElement("File"); pFile; pFile = pFile->NextSiblingElement("File")) {
+                if(auto pPath = pFile->Attribute("path")) {
+                    files.emplace_back(m_DirectoryPath + pPath);
+                }
+            }
+        }
+    }
+    return files;
+}
+
+bool RenderCheckpoint::loadFramebuffer(const std::string& name, Framebuffer& framebuffer) const {
+    auto pPath = findFile(name);
+    if(!pPath) {
+        return false;
+    }
+    try {
+        return BnZ::loadEXRFramebuffer((m_DirectoryPath + pPath).str(), framebuffer);
+    } catch(const std::exception& e) {
+        std::cerr << "RenderCheckpoint: " << e.what() << std::endl;
+    }
+    return false;
+}
+
+bool RenderCheckpoint::loadImage(const std::string& name, Image& image) const {
+    auto pPath = findFile(name);
+    if(!pPath) {
+        return false;
+    }
+    try {
+        image = *loadEXRImage((m_DirectoryPath + pPath).str(), false);
+        return true;
+    } catch(const std::exception& e) {
+        std::cerr << "RenderCheckpoint: " << e.what() << std::endl;
+    }
+    return false;
+}
+
+bool RenderCheckpoint::loadBuffer(const std::string& name, std::vector<char>& data) const {
+    auto pPath = findFile(name);
+    if(!pPath) {
+        return false;
+    }
+    std::ifstream in((m_DirectoryPath + pPath).c_str(), std::ios::binary);
+    if(!in) {
+        std::cerr << "RenderCheckpoint: unable to read " << (m_DirectoryPath + pPath) << std::endl;
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+tinyxml2::XMLElement& RenderCheckpoint::beginStore() {
+    createDirectory(m_DirectoryPath);
+
+    ++m_nGeneration;
+    m_bStoreFailed = false;
+
+    m_Document.Clear();
+    auto pRoot = m_Document.NewElement("Checkpoint");
+    m_Document.InsertEndChild(pRoot);
+    setAttribute(*pRoot, "generation", m_nGeneration);
+    setAttribute(*pRoot, "date", getDateString());
+    pRoot->InsertEndChild(m_Document.NewElement("Files"));
+
+    return *pRoot;
+}
+
+FilePath RenderCheckpoint::addFile(const std::string& name, const char* extension) {
+    auto fileName = name + "." + toString(m_nGeneration) + "." + extension;
+
+    auto pFile = m_Document.NewElement("File");
+    setAttribute(*pFile, "name", name);
+    setAttribute(*pFile, "path", fileName);
+    m_Document.RootElement()->FirstChildElement("Files")->InsertEndChild(pFile);
+
+    return m_DirectoryPath + fileName;
+}
+
+void RenderCheckpoint::storeFramebuffer(const std::string& name, const Framebuffer& framebuffer) {
+    auto path = addFile(name);
+    try {
+        storeEXRFramebuffer(path.str(), framebuffer);
+    } catch(const std::exception& e) {
+        std::cerr << "RenderCheckpoint: " << e.what() << std::endl;
+        m_bStoreFailed = true;
+    }
+}
+
+void RenderCheckpoint::storeImage(const std::string& name, const Image& image) {
+    auto path = addFile(name);
+    try {
+        storeEXRImage(path.str(), image);
+    } catch(const std::exception& e) {
+        std::cerr << "RenderCheckpoint: " << e.what() << std::endl;
+        m_bStoreFailed = true;
+    }
+}
+
+void RenderCheckpoint::storeBuffer(const std::string& name, const void* pData, std::size_t byteCount) {
+    auto path = addFile(name, "bin");
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out.write(static_cast<const char*>(pData), byteCount);
+    if(!out) {
+        std::cerr << "RenderCheckpoint: unable to write " << path << std::endl;
+        m_bStoreFailed = true;
+    }
+}
+
+bool RenderCheckpoint::commit() {
+    m_Timer = Timer();
+
+    auto newFiles = listFiles();
+
+    auto tmpStatePath = m_DirectoryPath + CHECKPOINT_TMP_STATE_FILE;
+    if(m_bStoreFailed ||
+            tinyxml2::XML_NO_ERROR != m_Document.SaveFile(tmpStatePath.c_str()) ||
+            !replaceFile(tmpStatePath, getStateFilePath())) {
+        std::cerr << "RenderCheckpoint: unable to store generation " << m_nGeneration
+                  << " in " << m_DirectoryPath << ", the previous one is kept" << std::endl;
+        for(const auto& file: newFiles) {
+            removeFile(file);
+        }
+        return false;
+    }
+
+    // The previous generation is no longer referenced
+    for(const auto& file: m_CommittedFiles) {
+        removeFile(file);
+    }
+    m_CommittedFiles = newFiles;
+
+    return true;
+}
+
+void RenderCheckpoint::remove() {
+    removeFile(getStateFilePath());
+    for(const auto& file: m_CommittedFiles) {
+        removeFile(file);
+    }
+    m_CommittedFiles.clear();
+    m_Document.Clear();
+}
+
+void storeRandomGeneratorState(tinyxml2::XMLElement& xml, const ThreadsRandomGenerator& rng) {
+    auto pRng = xml.GetDocument()->NewElement("RandomGenerator");
+    xml.InsertEndChild(pRng);
+
+    setAttribute(*pRng, "threadCount", rng.getThreadCount());
+    for(auto threadID: range(rng.getThreadCount())) {
+        auto pThread = xml.GetDocument()->NewElement("Thread");
+        setAttribute(*pThread, "state", rng.getGenerator(threadID).getState());
+        pRng->InsertEndChild(pThread);
+    }
+}
+
+bool loadRandomGeneratorState(const tinyxml2::XMLElement& xml, ThreadsRandomGenerator& rng) {
+    auto pRng = xml.FirstChildElement("RandomGenerator");
+    if(!pRng) {
+        return false;
+    }
+
+    std::vector<std::string> states;
+    for(auto pThread = pRng->FirstChildElement("Thread"); pThread; pThread = pThread->NextSiblingElement("Thread")) {
+        states.emplace_back();
+        if(!getAttribute(*pThread, "state", states.back())) {
+            return false;
+        }
+    }
+
+    if(states.size() != rng.getThreadCount()) {
+        return false;
+    }
+
+    // Validate all states before modifying rng
+    std::vector<RandomGenerator> generators(states.size());
+    for(auto threadID: range(states.size())) {
+        if(!generators[threadID].setState(states[threadID])) {
+            return false;
+        }
+    }
+    for(auto threadID: range(states.size())) {
+        rng.getGenerator(threadID) = generators[threadID];
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <bonez/parsing/parsing.hpp>
+#include <bonez/sys/files.hpp>
+#include <bonez/sys/time.hpp>
+#include <bonez/sampling/Random.hpp>
+
+#include "Framebuffer.hpp"
+
+namespace BnZ {
+
+// Snapshot of the state of a progressive render, used to resume it if the process dies.
+//
+// A checkpoint is a directory containing a state file (checkpoint.bnz.xml) and the images it references.
+// Each store writes the images of a new generation, then replaces the state file by an atomic rename:
+// if the process dies during a store, the state file still describes the previous generation, whose files are
+// only removed after the rename.
+class RenderCheckpoint {
+public:
+    // A checkpoint is due every intervalInSeconds; a negative or null interval disables periodic stores
+    RenderCheckpoint(const FilePath& directoryPath, float intervalInSeconds);
+
+    const FilePath& getDirectoryPath() const {
+        return m_DirectoryPath;
+    }
+
+    bool exists() const;
+
+    // True if the interval has elapsed since the last store (or the construction)
+    bool isStoreDue() const;
+
+    // Load the state of the last checkpoint, return nullptr if there is none or if it can't be read
+    const tinyxml2::XMLElement* load();
+
+    bool loadFramebuffer(const std::string& name, Framebuffer& framebuffer) const;
+
+    bool loadImage(const std::string& name, Image& image) const;
+
+    bool loadBuffer(const std::string& name, std::vector<char>& data) const;
+
+    // Start a new generation: fill the returned element and store images, then call commit()
+    tinyxml2::XMLElement& beginStore();
+
+    void storeFramebuffer(const std::string& name, const Framebuffer& framebuffer);
+
+    void storeImage(const std::string& name, const Image& image);
+
+    // Raw binary data, for a state that is neither an image nor small enough for the state file
+    void storeBuffer(const std::string& name, const void* pData, std::size_t byteCount);
+
+    // Return false if the generation could not be written, in which case the previous one is kept
+    bool commit();
+
+    // Remove all files of the checkpoint, to call when the render is complete
+    void remove();
+
+private:
+    FilePath getStateFilePath() const;
+
+    // File name (relative to the directory) registered for name in the state, null if not found
+    const char* findFile(const std::string& name) const;
+
+    // Register a file of the generation being stored and return its path
+    FilePath addFile(const std::string& name, const char* extension = "exr");
+
+    std::vector<FilePath> listFiles() const;
+
+    FilePath m_DirectoryPath;
+    Microseconds m_Interval;
+    Timer m_Timer;
+
+    tinyxml2::XMLDocument m_Document;
+    uint32_t m_nGeneration = 0u;
+    bool m_bStoreFailed = false;
+    std::vector<FilePath> m_CommittedFiles; // Files of the generation described by the state file on disk
+};
+
+void storeRandomGeneratorState(tinyxml2::XMLElement& xml, const ThreadsRandomGenerator& rng);
+
+// Return false if no state is found or if it has been stored with a different number of threads,
+// in which case rng is not modified
+bool loadRandomGeneratorState(const tinyxml2::XMLElement& xml, ThreadsRandomGenerator& rng);
+
+}
@@ -1,4 +1,5 @@
 #include "RenderModule.hpp"
+#include "RenderCheckpoint.hpp"
 #include <bonez/utils/ColorMap.hpp>
 
 namespace BnZ {
@@ -6,6 +7,7 @@ namespace BnZ {
 static const std::string RES_IMAGE_EXT = "png";
 static const std::string RES_EXR_EXT = "exr";
 static const std::string RES_STATS_DIR = "stats";
+static const std::string CHECKPOINT_DIR = "checkpoint";
 
 struct RenderStatistics {
     // All timings are in milliseconds
@@ -29,12 +31,39 @@ struct RenderStatistics {
     std::vector<float> absErrorFloat;
 };
 
+static void storeRenderStatistics(tinyxml2::XMLElement& xml, const RenderStatistics& stats) {
+    setChildAttribute(xml, "InitTime", stats.initTime);
+    setChildAttribute(xml, "RenderTime", stats.renderTime);
+    setChildAttribute(xml, "IterCount", stats.iterCount);
+    setChildAttribute(xml, "ProcessingTimes", stats.processingTimes);
+    setChildAttribute(xml, "NRMSE", stats.nrmse);
+    setChildAttribute(xml, "NRMSEFloat", stats.nrmseFloat);
+    setChildAttribute(xml, "RMSE", stats.rmse);
+    setChildAttribute(xml, "RMSEFloat", stats.rmseFloat);
+    setChildAttribute(xml, "AbsError", stats.absError);
+    setChildAttribute(xml, "AbsErrorFloat", stats.absErrorFloat);
+}
+
+static void loadRenderStatistics(const tinyxml2::XMLElement& xml, RenderStatistics& stats) {
+    getChildAttribute(xml, "InitTime", stats.initTime);
+    getChildAttribute(xml, "RenderTime", stats.renderTime);
+    getChildAttribute(xml, "IterCount", stats.iterCount);
+    getChildAttribute(xml, "ProcessingTimes", stats.processingTimes);
+    getChildAttribute(xml, "NRMSE", stats.nrmse);
+    getChildAttribute(xml, "NRMSEFloat", stats.nrmseFloat);
+    getChildAttribute(xml, "RMSE", stats.rmse);
+    getChildAttribute(xml, "RMSEFloat", stats.rmseFloat);
+    getChildAttribute(xml, "AbsError", stats.absError);
+    getChildAttribute(xml, "AbsErrorFloat", stats.absErrorFloat);
+}
+
 static void storeFramebuffer(int resultIndex,
                              const FilePath& pngDir,
                              const FilePath& exrDir,
                              const FilePath& baseName,
                              float gamma,
-                             const Framebuffer& framebuffer) {
+                             const Framebuffer& fullFramebuffer,
+                             const Vec4u& window) {
     // Create output directories in case they don't exist
     createDirectory(pngDir.str());
     createDirectory(exrDir.str());
@@ -43,10 +72,14 @@ static void storeFramebuffer(int resultIndex,
     FilePath pngFile = pngDir + baseName.addExt("." + RES_IMAGE_EXT);
     FilePath exrFile = exrDir + baseName.addExt("." + RES_EXR_EXT);
 
+    // Only the crop window is stored, the EXR files keep its position in the full framebuffer
+    auto framebuffer = crop(fullFramebuffer, window);
+    auto dataWindowOrigin = Vec2u(window.x, window.y);
+
     // Make a copy of the image
     Image copy = framebuffer.getChannel(0);
     // Store the EXR image "as is"
-    storeEXRImage(exrFile.str(), copy);
+    storeEXRImage(exrFile.str(), copy, dataWindowOrigin, fullFramebuffer.getSize());
 
     // Post-process copy of image and store PNG file
     copy.flipY();
@@ -56,7 +89,7 @@ static void storeFramebuffer(int resultIndex,
 
     // Store complete framebuffer as a single EXR multi layer image
     auto exrFramebufferFilePath = exrDir + baseName.addExt(".bnzframebuffer." + RES_EXR_EXT);
-    storeEXRFramebuffer(exrFramebufferFilePath.str(), framebuffer);
+    storeEXRFramebuffer(exrFramebufferFilePath.str(), framebuffer, dataWindowOrigin, fullFramebuffer.getSize());
 
     // Store complete framebuffer as PNG indivual files in a dediacted subdirectory
     auto pngFramebufferDirPath = pngDir + "framebuffers/";
@@ -82,15 +115,32 @@ static void storeFramebuffer(int resultIndex,
     }
 }
 
+// Store the denoised image of a result next to its other images
+static void storeDenoisedImage(const FilePath& pngDir,
+                               const FilePath& exrDir,
+                               const FilePath& baseName,
+                               float gamma,
+                               const Image& denoisedImage,
+                               const Vec4u& window) {
+    auto copy = crop(denoisedImage, window);
+    storeEXRImage((exrDir + baseName.addExt(".denoised." + RES_EXR_EXT)).str(), copy,
+                  Vec2u(window.x, window.y), denoisedImage.getSize());
+
+    copy.flipY();
+    copy.applyGamma(gamma);
+    storeImage((pngDir + baseName.addExt(".denoised." + RES_IMAGE_EXT)).str(), copy);
+}
+
 void RenderModule::storeResult(const FilePath& resultDir, uint32_t index,
-                               const RenderStatistics& stats, float gamma, const Framebuffer& framebuffer) {
+                               const RenderStatistics& stats, float gamma, const Framebuffer& framebuffer,
+                               const Vec4u& window) {
     FilePath baseName(toString3(index));
 
     FilePath pngDir = resultDir + RES_IMAGE_EXT;
     FilePath exrDir = resultDir + RES_EXR_EXT;
     FilePath statsDir = resultDir + RES_STATS_DIR;
 
-    storeFramebuffer(index, pngDir, exrDir, baseName, gamma, framebuffer);
+    storeFramebuffer(index, pngDir, exrDir, baseName, gamma, framebuffer, window);
 
     createDirectory(statsDir.str());
 
@@ -221,6 +271,14 @@ bool RenderModule::renderCompare(
     auto reportsPath = resultPath + "reports";
     createDirectory(reportsPath);
     auto reportDocumentPath = reportsPath + (toString3(index) + ".report.bnz.xml");
+
+    // The report of an interrupted render is stored with its checkpoint, which is removed once the render is complete
+    RenderCheckpoint checkpoint(resultPath + (CHECKPOINT_DIR + "_" + toString3(index)), m_fCheckpointInterval);
+    if(exists(reportDocumentPath) && !checkpoint.exists()) {
+        std::clog << "Render " << index << " already done." << std::endl;
+        return true;
+    }
+
     tinyxml2::XMLDocument reportDocument;
 
     auto pReport = reportDocument.NewElement("Result");
@@ -257,7 +315,35 @@ bool RenderModule::renderCompare(
         stats.renderTime = Microseconds { 0 };
         stats.iterCount = 0u;
 
-        float nrmseFloat = std::numeric_limits<float>::max();
+        if(auto pState = checkpoint.load()) {
+            auto pRendererState = pState->FirstChildElement("Renderer");
+            if(pRendererState && pRenderer->loadCheckpoint(checkpoint, *pRendererState)) {
+                loadRenderStatistics(*pState, stats);
+                getChildAttribute(*pState, "RemainingIterCount", iterCount);
+                std::clog << "Resume from checkpoint at iteration " << stats.iterCount << std::endl;
+            } else {
+                std::cerr << "Invalid checkpoint in " << checkpoint.getDirectoryPath() << ", restart the render" << std::endl;
+                pRenderer->init(scene, camera, framebuffer, &rendererSettings);
+            }
+        }
+
+        auto storeCheckpoint = [&]() {
+            auto& state = checkpoint.beginStore();
+            storeRenderStatistics(state, stats);
+            setChildAttribute(state, "RemainingIterCount", iterCount);
+
+            auto pRendererState = state.GetDocument()->NewElement("Renderer");
+            state.InsertEndChild(pRendererState);
+            pRenderer->storeCheckpoint(checkpoint, *pRendererState);
+
+            checkpoint.commit();
+        };
+
+        // Errors are only measured over the crop window of the renderer
+        auto window = pRenderer->getCropWindow();
+        auto reference = referenceImage.getSize() == framebuffer.getSize() ? crop(referenceImage, window) : referenceImage;
+
+        float nrmseFloat = stats.nrmseFloat.empty() ? std::numeric_limits<float>::max() : stats.nrmseFloat.back();
         while((iterCount < 0 && us2ms(stats.renderTime) < processingTimeMs && nrmseFloat > minRMSE) || (iterCount >= 0 && iterCount--)) {
             {
                 Timer timer;
@@ -269,13 +355,15 @@ bool RenderModule::renderCompare(
 
             ++stats.iterCount;
 
-            auto nrmse = computeNormalizedRootMeanSquaredError(referenceImage, framebuffer.getChannel(0));
+            auto image = crop(framebuffer.getChannel(0), window);
+
+            auto nrmse = computeNormalizedRootMeanSquaredError(reference, image);
             nrmseFloat = (nrmse.r + nrmse.g + nrmse.b) / 3.f;
 
-            auto rmse = computeRootMeanSquaredError(referenceImage, framebuffer.getChannel(0));
+            auto rmse = computeRootMeanSquaredError(reference, image);
             auto rmseFloat = (rmse.r + rmse.g + rmse.b) / 3.f;
 
-            auto absError = computeMeanAbsoluteError(referenceImage, framebuffer.getChannel(0));
+            auto absError = computeMeanAbsoluteError(reference, image);
             auto absErrorFloat = (absError.r + absError.g + absError.b) / 3.f;
 
             std::clog << "NRMSE = " << nrmse << " ; Mean = " << nrmseFloat << std::endl;
@@ -293,14 +381,53 @@ bool RenderModule::renderCompare(
             stats.absErrorFloat.emplace_back(absErrorFloat);
 
             if(!callback()) {
+                storeCheckpoint();
                 done = true;
                 break;
             }
+
+            if(checkpoint.isStoreDue()) {
+                storeCheckpoint();
+            }
         }
 
         std::clog << "Store images" << std::endl;
 
-        storeResult(resultPath, index, stats, m_fGamma, framebuffer);
+        storeResult(resultPath, index, stats, m_fGamma, framebuffer, window);
+
+        if(window != Vec4u(0u, 0u, framebuffer.getSize())) {
+            setChildAttribute(*pReport, "CropWindow", window);
+        }
+
+        // Denoise the final estimate if the renderer has collected the guides, with the settings of its
+        // "Denoiser" element
+        if(auto pFeatures = pRenderer->getFeatureBuffers()) {
+            std::clog << "Denoise" << std::endl;
+
+            CrossBilateralDenoiser denoiser;
+            if(auto pDenoiserSettings = rendererSettings.FirstChildElement("Denoiser")) {
+                denoiser.loadSettings(*pDenoiserSettings);
+            }
+
+            Timer timer(true);
+            auto denoisedImage = denoiser.denoise(framebuffer, 0u, *pFeatures);
+            auto denoisingTime = timer.getMicroEllapsedTime();
+
+            auto image = crop(denoisedImage, window);
+            auto nrmse = computeNormalizedRootMeanSquaredError(reference, image);
+            auto rmse = computeRootMeanSquaredError(reference, image);
+            auto absError = computeMeanAbsoluteError(reference, image);
+
+            storeDenoisedImage(resultPath + RES_IMAGE_EXT, resultPath + RES_EXR_EXT, FilePath(toString3(index)),
+                               m_fGamma, denoisedImage, window);
+
+            setChildAttribute(*pReport, "DenoisingTime", denoisingTime);
+            setChildAttribute(*pReport, "DenoisedNRMSE", (nrmse.r + nrmse.g + nrmse.b) / 3.f);
+            setChildAttribute(*pReport, "DenoisedRMSE", (rmse.r + rmse.g + rmse.b) / 3.f);
+            setChildAttribute(*pReport, "DenoisedMAE", (absError.r + absError.g + absError.b) / 3.f);
+
+            std::clog << "Done." << std::endl;
+        }
 
         std::clog << "Done." << std::endl;
 
@@ -341,6 +468,11 @@ bool RenderModule::renderCompare(
 
     reportDocument.SaveFile(reportDocumentPath.c_str());
 
+    // Only remove the checkpoint once all results are stored
+    if(!done) {
+        checkpoint.remove();
+    }
+
     return !done;
 }
 
@@ -419,7 +551,29 @@ bool RenderModule::renderReference(
                     std::clog << "Done." << std::endl;
                 }
 
-                for(auto i = 0u; i < iterCount; ++i) {
+                // Resume an interrupted render of the reference
+                auto checkpointInterval = m_fCheckpointInterval;
+                getAttribute(*pReferenceSettings, "checkpointInterval", checkpointInterval);
+                RenderCheckpoint checkpoint(referenceDirPath + CHECKPOINT_DIR, checkpointInterval);
+
+                auto firstFrame = 0u;
+                if(auto pState = checkpoint.load()) {
+                    auto pRendererState = pState->FirstChildElement("Renderer");
+                    if(pRendererState && pRenderer->loadCheckpoint(checkpoint, *pRendererState)) {
+                        getChildAttribute(*pState, "Frame", firstFrame);
+                        getChildAttribute(*pState, "IterationCount", currentIterCount);
+                        getChildAttribute(*pState, "TotalTime", totalTime);
+                        std::clog << "Resume from checkpoint at frame " << currentIterCount << std::endl;
+                    } else {
+                        std::cerr << "Invalid checkpoint in " << checkpoint.getDirectoryPath() << ", ignore it" << std::endl;
+                        pRenderer->init(scene, camera, m_CPUFramebuffer, pRendererSettings);
+                        if(exists(referencePath)) {
+                            loadEXRFramebuffer(referenceDirPath + REFERENCE_EXRFRAMEBUFFER_FILE, m_CPUFramebuffer);
+                        }
+                    }
+                }
+
+                for(auto i = firstFrame; i < iterCount; ++i) {
                     Timer timer;
                     pRenderer->render();
                     totalTime += timer.getMicroEllapsedTime();
@@ -431,12 +585,26 @@ bool RenderModule::renderReference(
                         done = true;
                         break;
                     }
+
+                    if(checkpoint.isStoreDue() && i + 1u < iterCount) {
+                        auto& state = checkpoint.beginStore();
+                        setChildAttribute(state, "Frame", i + 1u);
+                        setChildAttribute(state, "IterationCount", currentIterCount);
+                        setChildAttribute(state, "TotalTime", totalTime);
+
+                        auto pRendererState = state.GetDocument()->NewElement("Renderer");
+                        state.InsertEndChild(pRendererState);
+                        pRenderer->storeCheckpoint(checkpoint, *pRendererState);
+
+                        checkpoint.commit();
+                    }
                 }
 
                 renderTime += totalTime;
 
                 std::clog << "Store framebuffer" << std::endl;
-                storeFramebuffer(-1, referenceDirPath, referenceDirPath, REFERENCE_IMAGE_FILE, m_fGamma, m_CPUFramebuffer);
+                storeFramebuffer(-1, referenceDirPath, referenceDirPath, REFERENCE_IMAGE_FILE, m_fGamma, m_CPUFramebuffer,
+                                 Vec4u(0u, 0u, m_CPUFramebuffer.getSize()));
                 std::clog << "Done." << std::endl;
 
                 std::clog << "Store XML information" << std::endl;
@@ -458,6 +626,9 @@ bool RenderModule::renderReference(
                 configDocument.SaveFile((referenceDirPath + REFERENCE_XML_CONFIG_FILE).c_str());
                 sceneDocument.SaveFile((referenceDirPath + REFERENCE_XML_SCENE_FILE).c_str());
 
+                // The stored reference can be continued with forceCompute, the checkpoint is no longer needed
+                checkpoint.remove();
+
                 std::clog << "Done." << std::endl;
             }
         }
@@ -512,7 +683,24 @@ bool RenderModule::renderConfig(
             return false;
         }
 
-        auto resultPrefix = getDateString();
+        // An unfinished session is continued: completed renders are skipped and interrupted ones resume from their checkpoint
+        auto unfinishedSessionPath = sessionPath + "unfinished.bnz.xml";
+        std::string resultPrefix;
+        tinyxml2::XMLDocument unfinishedSessionDoc;
+        if(exists(unfinishedSessionPath) &&
+                tinyxml2::XML_NO_ERROR == unfinishedSessionDoc.LoadFile(unfinishedSessionPath.c_str()) &&
+                unfinishedSessionDoc.RootElement() &&
+                getAttribute(*unfinishedSessionDoc.RootElement(), "result", resultPrefix)) {
+            std::clog << "Resume unfinished session " << resultPrefix << std::endl;
+        } else {
+            resultPrefix = getDateString();
+
+            unfinishedSessionDoc.Clear();
+            auto pSession = unfinishedSessionDoc.NewElement("Session");
+            unfinishedSessionDoc.InsertEndChild(pSession);
+            setAttribute(*pSession, "result", resultPrefix);
+            unfinishedSessionDoc.SaveFile(unfinishedSessionPath.c_str());
+        }
         resultPath = sessionPath + resultPrefix;
         createDirectory(resultPath);
 
@@ -532,8 +720,10 @@ bool RenderModule::renderConfig(
         float minRMSE = -1.f;
         getAttribute(*pRenders, "minRMSE", minRMSE);
 
+        getAttribute(*pRenders, "checkpointInterval", m_fCheckpointInterval);
+
         uint32_t renderCount = 0;
-        return runCompareRenderGroup(
+        auto completed = runCompareRenderGroup(
             resultPath,
             *pRenders,
             nullptr,
@@ -546,6 +736,11 @@ bool RenderModule::renderConfig(
             *referenceImage,
             callback,
             handleGlobalPreprocessParameters);
+
+        if(completed) {
+            removeFile(unfinishedSessionPath);
+        }
+        return completed;
     }
     return true;
 }
@@ -2,6 +2,7 @@
 
 //#include "viewer/Viewer.hpp"
 #include "RendererManager.hpp"
+#include "Denoiser.hpp"
 #include <bonez/opengl/GLImageRenderer.hpp>
 #include <bonez/scene/ConfigManager.hpp>
 
@@ -39,6 +40,15 @@ struct RenderModule {
 
     bool m_bApplyHeatMap = false;
 
+    float m_fCheckpointInterval = 600.f; // Seconds between two checkpoints of offline renders, 0 to disable
+
+    // Display a denoised preview of the first channel, updated every m_nDenoisingInterval iterations.
+    // The renderer must collect feature buffers (collectDenoisingFeatures setting of tile renderers).
+    bool m_bDenoise = false;
+    uint32_t m_nDenoisingInterval = 1;
+    CrossBilateralDenoiser m_Denoiser;
+    Image m_DenoisedImage;
+
     Image m_SmallViewImage { 5, 5 };
     const uint32_t m_sSmallViewPixelSize = 32u;
     GLFramebuffer2D<1, false> m_SmallViewFramebuffer;
@@ -54,6 +64,10 @@ struct RenderModule {
             auto pModuleSettings = pCacheRootElement->FirstChildElement("RenderModule");
             if(pModuleSettings) {
                 getAttribute(*pModuleSettings, "gamma", m_fGamma);
+                getAttribute(*pModuleSettings, "denoise", m_bDenoise);
+                if(auto pDenoiserSettings = pModuleSettings->FirstChildElement("Denoiser")) {
+                    m_Denoiser.loadSettings(*pDenoiserSettings);
+                }
             }
         }
 
@@ -72,6 +86,14 @@ struct RenderModule {
                 pCacheRootElement->InsertEndChild(pModuleSettings);
             }
             setAttribute(*pModuleSettings, "gamma", m_fGamma);
+            setAttribute(*pModuleSettings, "denoise", m_bDenoise);
+
+            auto pDenoiserSettings = pModuleSettings->FirstChildElement("Denoiser");
+            if(!pDenoiserSettings) {
+                pDenoiserSettings = pCacheRootElement->GetDocument()->NewElement("Denoiser");
+                pModuleSettings->InsertEndChild(pDenoiserSettings);
+            }
+            m_Denoiser.storeSettings(*pDenoiserSettings);
         }
     }
 
@@ -116,6 +138,18 @@ struct RenderModule {
             gui.addSeparator();
 
             gui.addVarRW(BNZ_GUI_VAR(m_bApplyHeatMap));
+
+            gui.addSeparator();
+
+            gui.addVarRW(BNZ_GUI_VAR(m_bDenoise));
+            gui.addVarRW(BNZ_GUI_VAR(m_nDenoisingInterval));
+            gui.addVarRW(BNZ_GUI_VAR(m_Denoiser.m_nRadius));
+            gui.addVarRW(BNZ_GUI_VAR(m_Denoiser.m_fSigmaSpatial));
+            gui.addVarRW(BNZ_GUI_VAR(m_Denoiser.m_fSigmaColor));
+            gui.addVarRW(BNZ_GUI_VAR(m_Denoiser.m_fSigmaNormal));
+            gui.addVarRW(BNZ_GUI_VAR(m_Denoiser.m_fSigmaDepth));
+            gui.addVarRW(BNZ_GUI_VAR(m_Denoiser.m_fSigmaAlbedo));
+            gui.addButton("Denoise", [this]() { m_DenoisedImage = Image(); });
         }
 
         if(auto window = gui.addWindow("RenderModule::ZoomedView")) {
@@ -172,12 +206,24 @@ struct RenderModule {
             if(m_nSelectedFramebuffer < 0 && (!m_bPause || m_bRenderFlag)) {
                 m_CurrentRenderer->render();
                 m_bRenderFlag = false;
+
+                if(m_CurrentRenderer->getIterationCount() % std::max(1u, m_nDenoisingInterval) == 0u) {
+                    m_DenoisedImage = Image();
+                }
+            }
+
+            auto pFeatures = m_CurrentRenderer->getFeatureBuffers();
+            auto displayDenoisedImage = m_bDenoise && pFeatures && m_nSelectedFramebuffer < 0 && m_nChannelIdx == 0u;
+            if(displayDenoisedImage && m_DenoisedImage.getSize() != m_CPUFramebuffer.getSize()) {
+                m_DenoisedImage = m_Denoiser.denoise(m_CPUFramebuffer, 0u, *pFeatures);
             }
          
             glViewport(0, 0, m_CPUFramebuffer.getWidth(), m_CPUFramebuffer.getHeight());
 
             if(!m_bApplyHeatMap) {
-                if(m_nSelectedFramebuffer < 0) {
+                if(displayDenoisedImage) {
+                    imageRenderer.drawImage(m_fGamma, m_DenoisedImage);
+                } else if(m_nSelectedFramebuffer < 0) {
                     imageRenderer.drawFramebuffer(m_fGamma, m_CPUFramebuffer, m_nChannelIdx);
                 } else if(m_nSelectedFramebuffer < int(m_nFramebufferCount)) {
                     imageRenderer.drawFramebuffer(m_fGamma, m_FramebufferList[m_nSelectedFramebuffer], m_nChannelIdx);
@@ -285,7 +331,8 @@ private:
                      uint32_t index,
                      const RenderStatistics& stats,
                      float gamma,
-                     const Framebuffer& framebuffer);
+                     const Framebuffer& framebuffer,
+                     const Vec4u& window); // Only this region of the framebuffer is stored
 };
 
 }
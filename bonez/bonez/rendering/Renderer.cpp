@@ -1,4 +1,5 @@
 #include "Renderer.hpp"
+#include "RenderCheckpoint.hpp"
 
 #include <bonez/sys/threads.hpp>
 #include <bonez/image/Image.hpp>
@@ -38,12 +39,48 @@ void Renderer::render() {
     ++m_nIterationCount;
 }
 
+void Renderer::storeCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml) const {
+    assert(m_pFramebuffer);
+    checkpoint.storeFramebuffer("framebuffer", *m_pFramebuffer);
+    setChildAttribute(xml, "Seed", m_nSeed);
+    setChildAttribute(xml, "IterationCount", m_nIterationCount);
+
+    doStoreCheckpoint(checkpoint, xml);
+}
+
+bool Renderer::loadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml) {
+    assert(m_pFramebuffer);
+    uint32_t seed = 0u, iterationCount = 0u;
+    if(!getChildAttribute(xml, "Seed", seed) || seed != m_nSeed ||
+            !getChildAttribute(xml, "IterationCount", iterationCount) ||
+            !checkpoint.loadFramebuffer("framebuffer", *m_pFramebuffer)) {
+        return false;
+    }
+
+    // The random generator is seeded with the iteration count, so the next iterations use new samples
+    m_nIterationCount = iterationCount;
+
+    return doLoadCheckpoint(checkpoint, xml);
+}
+
 void Renderer::setStatisticsOutput(tinyxml2::XMLElement* pStats) {
     m_pStats = pStats;
 }
 
 void Renderer::storeStatistics() {
-    // Store settings
+    if(auto pStats = getStatisticsOutput()) {
+        // Current and peak number of bytes allocated by each subsystem
+        auto pMemory = pStats->FirstChildElement("Memory");
+        if(!pMemory) {
+            pMemory = pStats->GetDocument()->NewElement("Memory");
+            pStats->InsertEndChild(pMemory);
+        }
+        for(auto i = 0u; i < MEMORY_TAG_COUNT; ++i) {
+            auto tag = MemoryTag(i);
+            auto pTag = setChildAttribute(*pMemory, getMemoryTagName(tag), getCurrentMemoryUsage(tag));
+            setAttribute(*pTag, "peak", getPeakMemoryUsage(tag));
+        }
+    }
 }
 
 void Renderer::loadSettings(const tinyxml2::XMLElement& xml) {
@@ -65,6 +102,15 @@ void Renderer::exposeIO(GUI& gui) {
     gui.addVarRW(BNZ_GUI_VAR(m_nPathDepthMask));
     gui.addVarRW(BNZ_GUI_VAR(m_nThreadCount));
     gui.addValue(BNZ_GUI_VAR(m_nIterationCount));
+
+    gui.addSeparator();
+    gui.addText("Memory (current / peak MB)");
+    for(auto i = 0u; i < MEMORY_TAG_COUNT; ++i) {
+        auto tag = MemoryTag(i);
+        gui.addText(std::string(getMemoryTagName(tag)) + ": " +
+                    toString(getCurrentMemoryUsage(tag) / (1024. * 1024.)) + " / " +
+                    toString(getPeakMemoryUsage(tag) / (1024. * 1024.)));
+    }
 }
 
 }
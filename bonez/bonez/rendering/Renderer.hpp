@@ -12,6 +12,7 @@
 namespace BnZ {
 
 class GLDebugRenderer;
+class RenderCheckpoint;
 
 class Renderer {
 public:
@@ -48,6 +49,18 @@ public:
 
     virtual void exposeIO(GUI& gui);
 
+    /**
+     * @brief storeCheckpoint Store the state required to continue the progressive rendering later:
+     * framebuffer, iteration count and renderer specific data.
+     */
+    void storeCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml) const;
+
+    /**
+     * @brief loadCheckpoint Restore a state stored by storeCheckpoint. Must be called after init with the settings used for the checkpoint.
+     * @return false if the checkpoint doesn't match the renderer, in which case init must be called again.
+     */
+    bool loadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml);
+
     struct ViewerData {
         GLDebugRenderer& debugRenderer;
 
@@ -68,6 +81,17 @@ public:
         return m_nIterationCount;
     }
 
+    // Region (x, y, width, height) of the framebuffer rendered, the full framebuffer by default.
+    // Error metrics and results only consider this region.
+    virtual Vec4u getCropWindow() const {
+        return Vec4u(0u, 0u, getFramebufferSize());
+    }
+
+    // Guides of the primary hits used to denoise the framebuffer (see CrossBilateralDenoiser), nullptr if not collected
+    virtual const Framebuffer* getFeatureBuffers() const {
+        return nullptr;
+    }
+
 protected:
     struct ThreadRNG {
         const Renderer& m_Renderer;
@@ -102,6 +126,39 @@ protected:
         return rng.getFloat();
     }
 
+    // Random sequence owned by a single path: paths sampled in parallel with it don't depend on the thread count
+    struct PathRNG {
+        mutable RandomGenerator m_Generator;
+
+        PathRNG(const Renderer& renderer, uint32_t pathID) {
+            setPathSeed(m_Generator, renderer.getSeed(), renderer.getIterationCount(), pathID);
+        }
+
+        Vec3f getFloat3() const {
+            return m_Generator.getFloat3();
+        }
+
+        Vec2f getFloat2() const {
+            return m_Generator.getFloat2();
+        }
+
+        float getFloat() const {
+            return m_Generator.getFloat();
+        }
+    };
+
+    friend Vec3f getFloat3(const PathRNG& rng) {
+        return rng.getFloat3();
+    }
+
+    friend Vec2f getFloat2(const PathRNG& rng) {
+        return rng.getFloat2();
+    }
+
+    friend float getFloat(const PathRNG& rng) {
+        return rng.getFloat();
+    }
+
     uint32_t getThreadCount() const {
         return m_nThreadCount;
     }
@@ -197,6 +254,14 @@ private:
 
     virtual void doRender() = 0;
 
+    // Store and load data accumulated across iterations, other than the framebuffer
+    virtual void doStoreCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml) const {
+    }
+
+    virtual bool doLoadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml) {
+        return true;
+    }
+
     // Render context:
     const Scene* m_pScene = nullptr;
     const Sensor* m_pSensor = nullptr;
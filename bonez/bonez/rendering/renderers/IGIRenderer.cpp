@@ -3,6 +3,8 @@
 
 #include <bonez/scene/sensors/PixelSensor.hpp>
 
+#include <numeric>
+
 namespace BnZ {
 
 void IGIRenderer::preprocess() {
@@ -18,26 +20,72 @@ void IGIRenderer::beginFrame() {
 
     if(m_nPathCount > 0u && m_nMaxPathDepth > 2u) {
         auto maxLightPathDepth = getMaxLightPathDepth();
-        m_SurfaceVPLBuffer.resize(getMaxLightPathDepth() * m_nPathCount);
+        m_LightPathBuffer.resize(maxLightPathDepth * m_nPathCount);
+        m_LightPathVPLOffsets.resize(m_nPathCount + 1);
 
         float scaleCoeff = 1.f / m_nPathCount;
 
-        for(auto i = 0u; i < m_nPathCount; ++i) {
-            auto pLightPath = m_SurfaceVPLBuffer.data() + i * maxLightPathDepth;
-            std::for_each(pLightPath, pLightPath + maxLightPathDepth, [&](SurfaceVPL& v) { v.pdf = 0.f; });
+        // Each path has its own slice and random sequence, so the VPLs don't depend on the thread count
+        processTasksDeterminist(m_nPathCount, [&](uint32_t pathID, uint32_t threadID) {
+            PathRNG rng(*this, pathID);
+            auto pLightPath = m_LightPathBuffer.data() + pathID * maxLightPathDepth;
+            auto vplCount = 0u;
 
-            ThreadRNG rng(*this, 0u);
             for(const auto& vertex: makeLightPath(getScene(), m_LightSampler, rng)) {
-                pLightPath->init(vertex);
-                pLightPath->power *= scaleCoeff;
+                if(vertex.pathPdf()) {
+                    pLightPath[vplCount].init(vertex);
+                    pLightPath[vplCount].power *= scaleCoeff;
+                    ++vplCount;
+                }
 
                 if(vertex.length() == maxLightPathDepth) {
                     break;
                 }
-                ++pLightPath;
             }
+
+            m_LightPathVPLOffsets[pathID + 1] = vplCount;
+        }, getThreadCount());
+
+        // Compact the VPLs in path order
+        m_LightPathVPLOffsets[0] = 0u;
+        std::partial_sum(begin(m_LightPathVPLOffsets), end(m_LightPathVPLOffsets), begin(m_LightPathVPLOffsets));
+        m_SurfaceVPLBuffer.resize(m_LightPathVPLOffsets.back());
+
+        processTasksDeterminist(m_nPathCount, [&](uint32_t pathID, uint32_t threadID) {
+            auto pLightPath = m_LightPathBuffer.data() + pathID * maxLightPathDepth;
+            std::copy(pLightPath, pLightPath + (m_LightPathVPLOffsets[pathID + 1] - m_LightPathVPLOffsets[pathID]),
+                      m_SurfaceVPLBuffer.data() + m_LightPathVPLOffsets[pathID]);
+        }, getThreadCount());
+    } else {
+        m_SurfaceVPLBuffer.clear();
+    }
+
+    if(m_bUseLightcuts) {
+        buildLightcutsTree();
+    }
+}
+
+void IGIRenderer::buildLightcutsTree() {
+    m_LightcutsTree.clear();
+
+    for(auto i: range(uint32_t(m_SurfaceVPLBuffer.size()))) {
+        const auto& vpl = m_SurfaceVPLBuffer[i];
+        if(vpl.pdf && vpl.depth + 2u <= m_nMaxPathDepth) {
+            // The VPL reflects light on the side of the incident direction
+            auto N = vpl.lastVertex.Ns;
+            if(dot(N, vpl.lastVertexBSDF.getIncidentDirection()) < 0.f) {
+                N = -N;
+            }
+            auto bsdfBound = vpl.lastVertexBSDF.getDiffuseCoefficient() + vpl.lastVertexBSDF.getGlossyCoefficient();
+            m_LightcutsTree.add(i, vpl.lastVertex.P, N, vpl.power * bsdfBound);
         }
     }
+
+    m_LightcutsTree.build(ThreadRNG(*this, 0u));
+
+    if(m_LightcutsBuffers.getThreadCount() != getThreadCount()) {
+        m_LightcutsBuffers.resize(1u, getThreadCount());
+    }
 }
 
 void IGIRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sampleID, uint32_t x, uint32_t y) const {
@@ -120,14 +168,36 @@ void IGIRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sa
         }
 
         // VPL illumination
-        for(const auto& vpl: m_SurfaceVPLBuffer) {
-            if(vpl.pdf) {
-                auto pathDepth = vpl.depth + 1 + currentDepth;
-
-                if(pathDepth <= m_nMaxPathDepth && acceptPathDepth(pathDepth)) {
-                    auto contrib = evalVPLContribution(vpl, I, bsdf);
+        if(m_bUseLightcuts) {
+            auto materialBound = bsdf.getDiffuseCoefficient() + bsdf.getGlossyCoefficient();
+            m_LightcutsTree.evalCut(I.P, I.Ns, materialBound, m_fLightcutsMaxRelativeError, m_nLightcutsMaxCutSize,
+                m_LightcutsBuffers(0u, threadID),
+                [&](uint32_t vplIndex) {
+                    const auto& vpl = m_SurfaceVPLBuffer[vplIndex];
+                    if(!acceptPathDepth(vpl.depth + 1 + currentDepth)) {
+                        return zero<Vec3f>();
+                    }
+                    return evalVPLContribution(vpl, I, bsdf);
+                },
+                [&](uint32_t vplIndex, const Vec3f& contrib) {
+                    auto pathDepth = m_SurfaceVPLBuffer[vplIndex].depth + 1 + currentDepth;
                     L += contrib;
                     accumulate(FINAL_RENDER_DEPTH1 + pathDepth - 1u, pixelID, Vec4f(contrib, 0.f));
+                });
+        } else {
+            Vec3f contributions[VPL_BATCH_SIZE];
+            auto vplCount = uint32_t(m_SurfaceVPLBuffer.size());
+            for(auto batchStart = 0u; batchStart < vplCount; batchStart += VPL_BATCH_SIZE) {
+                auto batchSize = min(VPL_BATCH_SIZE, vplCount - batchStart);
+                evalVPLContributions(m_SurfaceVPLBuffer.data() + batchStart, batchSize, I, bsdf, currentDepth, contributions);
+
+                for(auto i = 0u; i < batchSize; ++i) {
+                    const auto& vpl = m_SurfaceVPLBuffer[batchStart + i];
+                    if(acceptVPL(vpl, currentDepth)) {
+                        auto pathDepth = vpl.depth + 1 + currentDepth;
+                        L += contributions[i];
+                        accumulate(FINAL_RENDER_DEPTH1 + pathDepth - 1u, pixelID, Vec4f(contributions[i], 0.f));
+                    }
                 }
             }
         }
@@ -153,19 +223,59 @@ Vec3f IGIRenderer::evalVPLContribution(const SurfaceVPL& vpl, const Intersection
     return zero<Vec3f>();
 }
 
+void IGIRenderer::evalVPLContributions(const SurfaceVPL* pVPLs, uint32_t count, const Intersection& I, const BSDF& bsdf,
+                                       uint32_t currentDepth, Vec3f* pContributions) const {
+    Vec3f directions[VPL_BATCH_SIZE], reverseDirections[VPL_BATCH_SIZE];
+    float distances[VPL_BATCH_SIZE], geometricFactors[VPL_BATCH_SIZE];
+    const BSDF* vplBSDFs[VPL_BATCH_SIZE];
+
+    for(auto i = 0u; i < count; ++i) {
+        geometricFactors[i] = geometricFactor(I, pVPLs[i].lastVertex, directions[i], distances[i]);
+        reverseDirections[i] = -directions[i];
+        vplBSDFs[i] = &pVPLs[i].lastVertexBSDF;
+    }
+
+    Vec3f fs[VPL_BATCH_SIZE], vplFs[VPL_BATCH_SIZE];
+    float cosThetaOutDirs[VPL_BATCH_SIZE];
+    bsdf.evalBatch(directions, count, fs, cosThetaOutDirs);
+    BSDF::evalBatch(vplBSDFs, reverseDirections, count, vplFs, cosThetaOutDirs);
+
+    for(auto i = 0u; i < count; ++i) {
+        pContributions[i] = zero<Vec3f>();
+        if(geometricFactors[i] > 0.f && acceptVPL(pVPLs[i], currentDepth)) {
+            auto M = fs[i] * vplFs[i];
+            if(M != zero<Vec3f>()) {
+                Ray shadowRay(I, pVPLs[i].lastVertex, directions[i], distances[i]);
+                if(!getScene().occluded(shadowRay)) {
+                    pContributions[i] = M * geometricFactors[i] * pVPLs[i].power;
+                }
+            }
+        }
+    }
+}
+
 void IGIRenderer::doExposeIO(GUI& gui) {
     gui.addVarRW(BNZ_GUI_VAR(m_nMaxPathDepth));
     gui.addVarRW(BNZ_GUI_VAR(m_nPathCount));
+    gui.addVarRW(BNZ_GUI_VAR(m_bUseLightcuts));
+    gui.addVarRW(BNZ_GUI_VAR(m_fLightcutsMaxRelativeError));
+    gui.addVarRW(BNZ_GUI_VAR(m_nLightcutsMaxCutSize));
 }
 
 void IGIRenderer::doLoadSettings(const tinyxml2::XMLElement& xml) {
     serialize(xml, "maxDepth", m_nMaxPathDepth);
     serialize(xml, "pathCount", m_nPathCount);
+    serialize(xml, "useLightcuts", m_bUseLightcuts);
+    serialize(xml, "lightcutsMaxRelativeError", m_fLightcutsMaxRelativeError);
+    serialize(xml, "lightcutsMaxCutSize", m_nLightcutsMaxCutSize);
 }
 
 void IGIRenderer::doStoreSettings(tinyxml2::XMLElement& xml) const {
     serialize(xml, "maxDepth", m_nMaxPathDepth);
     serialize(xml, "pathCount", m_nPathCount);
+    serialize(xml, "useLightcuts", m_bUseLightcuts);
+    serialize(xml, "lightcutsMaxRelativeError", m_fLightcutsMaxRelativeError);
+    serialize(xml, "lightcutsMaxCutSize", m_nLightcutsMaxCutSize);
 }
 
 void IGIRenderer::processTile(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const {
@@ -4,6 +4,8 @@
 #include <bonez/sampling/Random.hpp>
 #include <bonez/scene/shading/BSDF.hpp>
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
+#include <bonez/scene/lights/LightcutsTree.hpp>
+#include <bonez/utils/PerThreadAccumulator.hpp>
 
 #include "paths.hpp"
 
@@ -33,7 +35,17 @@ class IGIRenderer: public TileProcessingRenderer {
     uint32_t m_nMaxPathDepth = 2u;
     uint32_t m_nPathCount = 1u;
 
-    std::vector<SurfaceVPL> m_SurfaceVPLBuffer;
+    std::vector<SurfaceVPL> m_SurfaceVPLBuffer; // Compacted VPLs of all paths
+
+    std::vector<SurfaceVPL> m_LightPathBuffer; // getMaxLightPathDepth() slots per path
+    std::vector<uint32_t> m_LightPathVPLOffsets; // Offset of the VPLs of each path in m_SurfaceVPLBuffer
+
+    // With lightcuts, each shading point gathers the VPLs through a cut of a light tree instead of all of them
+    bool m_bUseLightcuts = false;
+    float m_fLightcutsMaxRelativeError = 0.02f;
+    uint32_t m_nLightcutsMaxCutSize = 1000u;
+    LightcutsTree m_LightcutsTree;
+    mutable PerThreadAccumulator<LightcutsTree::CutBuffers> m_LightcutsBuffers; // One per thread, padded
 
     enum FramebufferTarget {
         FINAL_RENDER,
@@ -42,6 +54,19 @@ class IGIRenderer: public TileProcessingRenderer {
 
     Vec3f evalVPLContribution(const SurfaceVPL& vpl, const Intersection& I, const BSDF& bsdf) const;
 
+    // Same as evalVPLContribution for count consecutive VPLs, with batch evaluations of the BSDFs.
+    // The contribution of a VPL whose path is not accepted at currentDepth is zero.
+    static const uint32_t VPL_BATCH_SIZE = 64u;
+    void evalVPLContributions(const SurfaceVPL* pVPLs, uint32_t count, const Intersection& I, const BSDF& bsdf,
+                              uint32_t currentDepth, Vec3f* pContributions) const;
+
+    bool acceptVPL(const SurfaceVPL& vpl, uint32_t currentDepth) const {
+        auto pathDepth = vpl.depth + 1 + currentDepth;
+        return vpl.pdf && pathDepth <= m_nMaxPathDepth && acceptPathDepth(pathDepth);
+    }
+
+    void buildLightcutsTree();
+
 public:
     void preprocess() override;
 
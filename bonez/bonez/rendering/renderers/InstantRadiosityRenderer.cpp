@@ -1,59 +1,210 @@
 #include "InstantRadiosityRenderer.hpp"
 
 #include <bonez/scene/sensors/PixelSensor.hpp>
+#include <bonez/scene/lights/LightVisitor.hpp>
+#include <bonez/scene/lights/PointLight.hpp>
+#include <bonez/scene/lights/AreaLight.hpp>
+
+#include <numeric>
 
 namespace BnZ {
 
+namespace {
+
+// Compute the point light equivalent to an emission VPL. Lights that are not visited have no position.
+class EmissionVPLPointVisitor: public LightVisitor {
+public:
+    const Scene* m_pScene = nullptr;
+    Vec2f m_EmissionVertexSample;
+
+    bool m_bIsFinite = false;
+    Vec3f m_Position;
+    Vec3f m_Normal;
+    Vec3f m_Intensity;
+
+    void visit(const PointLight& light) override {
+        m_bIsFinite = true;
+        m_Position = light.m_Position;
+        m_Normal = zero<Vec3f>();
+        m_Intensity = light.m_Intensity;
+    }
+
+    void visit(const AreaLight& light) override {
+        SurfacePointSample point;
+        auto Le = light.sample(*m_pScene, m_EmissionVertexSample, point);
+
+        m_bIsFinite = true;
+        m_Position = point.value.P;
+        m_Normal = point.value.Ns;
+        m_Intensity = point.pdf > 0.f ? Le / point.pdf : zero<Vec3f>();
+    }
+};
+
+}
+
 void InstantRadiosityRenderer::preprocess() {
     m_Sampler.initFrame(getScene());
 }
 
 void InstantRadiosityRenderer::beginFrame() {
     auto lightPathDepth = m_nMaxDepth - 2;
+    auto lightPathCount = uint32_t(m_nLightPathCount);
+
+    m_LightPathEmissionVPLs.resize(lightPathCount);
+    m_LightPathSurfaceVPLs.resize(lightPathCount * lightPathDepth);
+    m_EmissionVPLOffsets.resize(lightPathCount + 1);
+    m_SurfaceVPLOffsets.resize(lightPathCount + 1);
 
-    m_EmissionVPLBuffer.clear();
-    m_EmissionVPLBuffer.reserve(m_nLightPathCount);
+    // Each path has its own slots and random sequence, so the VPLs don't depend on the thread count
+    processTasksDeterminist(lightPathCount, [&](uint32_t pathID, uint32_t threadID) {
+        PathRNG rng(*this, pathID);
+        auto pSurfaceVPLs = m_LightPathSurfaceVPLs.data() + pathID * lightPathDepth;
+        auto surfaceVPLCount = 0u;
 
-    m_SurfaceVPLBuffer.clear();
-    m_SurfaceVPLBuffer.reserve(m_nLightPathCount * lightPathDepth);
+        m_EmissionVPLOffsets[pathID + 1] = 0u;
 
-    for(auto i: range(m_nLightPathCount)) {
         auto power = Vec3f(1.f / m_nLightPathCount);
         EmissionVPL vpl;
-        vpl.pLight = m_Sampler.sample(getScene(), getFloat(0u), vpl.lightPdf);
+        vpl.pLight = m_Sampler.sample(getScene(), rng.getFloat(), vpl.lightPdf, &vpl.lightID);
         if(vpl.pLight && vpl.lightPdf) {
             float emissionVertexPdf;
             RaySample exitantRaySample;
-            vpl.emissionVertexSample = getFloat2(0u);
-            auto Le = vpl.pLight->sampleExitantRay(getScene(), vpl.emissionVertexSample, getFloat2(0u), exitantRaySample, emissionVertexPdf);
+            vpl.emissionVertexSample = rng.getFloat2();
+            auto Le = vpl.pLight->sampleExitantRay(getScene(), vpl.emissionVertexSample, rng.getFloat2(), exitantRaySample, emissionVertexPdf);
 
-            m_EmissionVPLBuffer.emplace_back(vpl);
+            m_LightPathEmissionVPLs[pathID] = vpl;
+            m_EmissionVPLOffsets[pathID + 1] = 1u;
 
-            if(Le != zero<Vec3f>() && exitantRaySample.pdf) {
+            if(Le != zero<Vec3f>() && exitantRaySample.pdf && lightPathDepth > 0u) {
                 auto intersection = getScene().intersect(exitantRaySample.value);
                 if(intersection) {
                     power *= Le / (vpl.lightPdf * exitantRaySample.pdf);
-                    m_SurfaceVPLBuffer.emplace_back(intersection, -exitantRaySample.value.dir, getScene(), power);
+                    pSurfaceVPLs[surfaceVPLCount++] = SurfaceVPL(intersection, -exitantRaySample.value.dir, getScene(), power);
 
                     for(auto depth = 1u; depth < lightPathDepth; ++depth) {
+                        const auto& lastVPL = pSurfaceVPLs[surfaceVPLCount - 1];
+
                         Sample3f outgoingDir;
                         float cosThetaOutDir;
-                        auto fs = m_SurfaceVPLBuffer.back().bsdf.sample(getFloat3(0u), outgoingDir, cosThetaOutDir,
-                                                                 nullptr, true);
+                        auto fs = lastVPL.bsdf.sample(rng.getFloat3(), outgoingDir, cosThetaOutDir, nullptr, true);
 
                         if(fs != zero<Vec3f>() && outgoingDir.pdf) {
-                            Ray ray(m_SurfaceVPLBuffer.back().intersection, outgoingDir.value);
+                            Ray ray(lastVPL.intersection, outgoingDir.value);
                             auto intersection = getScene().intersect(ray);
                             if(intersection) {
                                 power *= fs * abs(cosThetaOutDir) / outgoingDir.pdf;
-                                m_SurfaceVPLBuffer.emplace_back(intersection, -ray.dir, getScene(), power);
+                                pSurfaceVPLs[surfaceVPLCount++] = SurfaceVPL(intersection, -ray.dir, getScene(), power);
                             }
                         }
                     }
                 }
             }
         }
+
+        m_SurfaceVPLOffsets[pathID + 1] = surfaceVPLCount;
+    }, getThreadCount());
+
+    // Compact the VPLs in path order
+    m_EmissionVPLOffsets[0] = 0u;
+    std::partial_sum(begin(m_EmissionVPLOffsets), end(m_EmissionVPLOffsets), begin(m_EmissionVPLOffsets));
+    m_SurfaceVPLOffsets[0] = 0u;
+    std::partial_sum(begin(m_SurfaceVPLOffsets), end(m_SurfaceVPLOffsets), begin(m_SurfaceVPLOffsets));
+
+    m_EmissionVPLBuffer.resize(m_EmissionVPLOffsets.back());
+    m_SurfaceVPLBuffer.resize(m_SurfaceVPLOffsets.back());
+
+    processTasksDeterminist(lightPathCount, [&](uint32_t pathID, uint32_t threadID) {
+        if(m_EmissionVPLOffsets[pathID + 1] != m_EmissionVPLOffsets[pathID]) {
+            m_EmissionVPLBuffer[m_EmissionVPLOffsets[pathID]] = m_LightPathEmissionVPLs[pathID];
+        }
+        auto pSurfaceVPLs = m_LightPathSurfaceVPLs.data() + pathID * lightPathDepth;
+        std::copy(pSurfaceVPLs, pSurfaceVPLs + (m_SurfaceVPLOffsets[pathID + 1] - m_SurfaceVPLOffsets[pathID]),
+                  m_SurfaceVPLBuffer.data() + m_SurfaceVPLOffsets[pathID]);
+    }, getThreadCount());
+
+    if(m_bUseLightcuts) {
+        buildLightcutsTree();
+    }
+}
+
+void InstantRadiosityRenderer::buildLightcutsTree() {
+    m_LightcutsTree.clear();
+    m_InfiniteEmissionVPLs.clear();
+
+    // Emission VPLs have the identifiers [0, emissionVPLCount[ in the tree and surface VPLs the following ones
+    auto emissionVPLCount = uint32_t(m_EmissionVPLBuffer.size());
+
+    EmissionVPLPointVisitor visitor;
+    visitor.m_pScene = &getScene();
+
+    for(auto i: range(emissionVPLCount)) {
+        const auto& vpl = m_EmissionVPLBuffer[i];
+
+        visitor.m_bIsFinite = false;
+        visitor.m_EmissionVertexSample = vpl.emissionVertexSample;
+        getScene().getLightContainer().getLight(vpl.lightID)->accept(visitor);
+
+        if(visitor.m_bIsFinite) {
+            m_LightcutsTree.add(i, visitor.m_Position, visitor.m_Normal,
+                                visitor.m_Intensity / (vpl.lightPdf * m_nLightPathCount));
+        } else {
+            m_InfiniteEmissionVPLs.emplace_back(i);
+        }
+    }
+
+    for(auto i: range(uint32_t(m_SurfaceVPLBuffer.size()))) {
+        const auto& vpl = m_SurfaceVPLBuffer[i];
+        // The VPL reflects light on the side of the incident direction
+        auto N = vpl.intersection.Ns;
+        if(dot(N, vpl.bsdf.getIncidentDirection()) < 0.f) {
+            N = -N;
+        }
+        auto bsdfBound = vpl.bsdf.getDiffuseCoefficient() + vpl.bsdf.getGlossyCoefficient();
+        m_LightcutsTree.add(emissionVPLCount + i, vpl.intersection.P, N, vpl.power * bsdfBound);
+    }
+
+    m_LightcutsTree.build(ThreadRNG(*this, 0u));
+
+    if(m_LightcutsBuffers.getThreadCount() != getThreadCount()) {
+        m_LightcutsBuffers.resize(1u, getThreadCount());
+    }
+}
+
+Vec3f InstantRadiosityRenderer::evalEmissionVPLContribution(const EmissionVPL& vpl, const Intersection& I, const BSDF& bsdf) const {
+    RaySample shadowRay;
+    auto Le = vpl.pLight->sampleDirectIllumination(getScene(), vpl.emissionVertexSample, I, shadowRay);
+
+    if(shadowRay.pdf) {
+        auto contrib = Le * bsdf.eval(shadowRay.value.dir) * abs(dot(I.Ns, shadowRay.value.dir)) /
+                (vpl.lightPdf * shadowRay.pdf * m_nLightPathCount);
+
+        if(contrib != zero<Vec3f>() && !getScene().occluded(shadowRay.value)) {
+            return contrib;
+        }
+    }
+    return zero<Vec3f>();
+}
+
+Vec3f InstantRadiosityRenderer::evalSurfaceVPLContribution(const SurfaceVPL& vpl, const Intersection& I, const BSDF& bsdf) const {
+    auto dirToVPL = vpl.intersection.P - I.P;
+    auto dist = length(dirToVPL);
+
+    if(dist > 0.f) {
+        dirToVPL /= dist;
+
+        auto fs1 = bsdf.eval(dirToVPL);
+        auto fs2 = vpl.bsdf.eval(-dirToVPL);
+        auto geometricFactor = abs(dot(I.Ns, dirToVPL)) * abs(dot(vpl.intersection.Ns, -dirToVPL)) / sqr(dist);
+
+        auto contrib = vpl.power * fs1 * fs2 * geometricFactor;
+        if(contrib != zero<Vec3f>()) {
+            Ray shadowRay(I, vpl.intersection, dirToVPL, dist);
+            if(!getScene().occluded(shadowRay)) {
+                return contrib;
+            }
+        }
     }
+    return zero<Vec3f>();
 }
 
 void InstantRadiosityRenderer::processPixel(uint32_t threadID, uint32_t tileID, const Vec2u& pixel) const {
@@ -68,42 +219,35 @@ void InstantRadiosityRenderer::processPixel(uint32_t threadID, uint32_t tileID,
         auto I = getScene().intersect(raySample.value);
         BSDF bsdf(-raySample.value.dir, I, getScene());
         if(I) {
-            // Direct illumination
-            for(auto& vpl: m_EmissionVPLBuffer) {
-                RaySample shadowRay;
-                auto Le = vpl.pLight->sampleDirectIllumination(getScene(), vpl.emissionVertexSample, I, shadowRay);
-
-                if(shadowRay.pdf) {
-                    auto contrib = We * Le * bsdf.eval(shadowRay.value.dir) * abs(dot(I.Ns, shadowRay.value.dir)) /
-                            (vpl.lightPdf * shadowRay.pdf * m_nLightPathCount * raySample.pdf);
-
-                    if(contrib != zero<Vec3f>()) {
-                        if(!getScene().occluded(shadowRay.value)) {
-                            L += contrib;
-                        }
-                    }
-                }
-            }
-
-            // Indirect illumination
-            for(auto& vpl: m_SurfaceVPLBuffer) {
-                auto dirToVPL = vpl.intersection.P - I.P;
-                auto dist = length(dirToVPL);
+            auto sensorFactor = We / raySample.pdf;
 
-                if(dist > 0.f) {
-                    dirToVPL /= dist;
-
-                    auto fs1 = bsdf.eval(dirToVPL);
-                    auto fs2 = vpl.bsdf.eval(-dirToVPL);
-                    auto geometricFactor = abs(dot(I.Ns, dirToVPL)) * abs(dot(vpl.intersection.Ns, -dirToVPL)) / sqr(dist);
+            if(m_bUseLightcuts) {
+                for(auto i: m_InfiniteEmissionVPLs) {
+                    L += sensorFactor * evalEmissionVPLContribution(m_EmissionVPLBuffer[i], I, bsdf);
+                }
 
-                    auto contrib = We * vpl.power * fs1 * fs2 * geometricFactor / raySample.pdf;
-                    if(contrib != zero<Vec3f>()) {
-                        Ray shadowRay(I, vpl.intersection, dirToVPL, dist);
-                        if(!getScene().occluded(shadowRay)) {
-                            L += contrib;
+                auto emissionVPLCount = uint32_t(m_EmissionVPLBuffer.size());
+                auto materialBound = bsdf.getDiffuseCoefficient() + bsdf.getGlossyCoefficient();
+                m_LightcutsTree.evalCut(I.P, I.Ns, materialBound, m_fLightcutsMaxRelativeError, m_nLightcutsMaxCutSize,
+                    m_LightcutsBuffers(0u, threadID),
+                    [&](uint32_t vplID) {
+                        if(vplID < emissionVPLCount) {
+                            return evalEmissionVPLContribution(m_EmissionVPLBuffer[vplID], I, bsdf);
                         }
-                    }
+                        return evalSurfaceVPLContribution(m_SurfaceVPLBuffer[vplID - emissionVPLCount], I, bsdf);
+                    },
+                    [&](uint32_t vplID, const Vec3f& contrib) {
+                        L += sensorFactor * contrib;
+                    });
+            } else {
+                // Direct illumination
+                for(auto& vpl: m_EmissionVPLBuffer) {
+                    L += sensorFactor * evalEmissionVPLContribution(vpl, I, bsdf);
+                }
+
+                // Indirect illumination
+                for(auto& vpl: m_SurfaceVPLBuffer) {
+                    L += sensorFactor * evalSurfaceVPLContribution(vpl, I, bsdf);
                 }
             }
         }
@@ -121,16 +265,25 @@ void InstantRadiosityRenderer::processTile(uint32_t threadID, uint32_t tileID, c
 void InstantRadiosityRenderer::doExposeIO(GUI& gui) {
     gui.addVarRW(BNZ_GUI_VAR(m_nMaxDepth));
     gui.addVarRW(BNZ_GUI_VAR(m_nLightPathCount));
+    gui.addVarRW(BNZ_GUI_VAR(m_bUseLightcuts));
+    gui.addVarRW(BNZ_GUI_VAR(m_fLightcutsMaxRelativeError));
+    gui.addVarRW(BNZ_GUI_VAR(m_nLightcutsMaxCutSize));
 }
 
 void InstantRadiosityRenderer::doLoadSettings(const tinyxml2::XMLElement& xml) {
     serialize(xml, "maxDepth", m_nMaxDepth);
     serialize(xml, "lightPathCount", m_nLightPathCount);
+    serialize(xml, "useLightcuts", m_bUseLightcuts);
+    serialize(xml, "lightcutsMaxRelativeError", m_fLightcutsMaxRelativeError);
+    serialize(xml, "lightcutsMaxCutSize", m_nLightcutsMaxCutSize);
 }
 
 void InstantRadiosityRenderer::doStoreSettings(tinyxml2::XMLElement& xml) const {
     serialize(xml, "maxDepth", m_nMaxDepth);
     serialize(xml, "lightPathCount", m_nLightPathCount);
+    serialize(xml, "useLightcuts", m_bUseLightcuts);
+    serialize(xml, "lightcutsMaxRelativeError", m_fLightcutsMaxRelativeError);
+    serialize(xml, "lightcutsMaxCutSize", m_nLightcutsMaxCutSize);
 }
 
 void InstantRadiosityRenderer::initFramebuffer() {
@@ -3,6 +3,8 @@
 #include "TileProcessingRenderer.hpp"
 
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
+#include <bonez/scene/lights/LightcutsTree.hpp>
+#include <bonez/utils/PerThreadAccumulator.hpp>
 #include <bonez/scene/shading/BSDF.hpp>
 
 namespace BnZ {
@@ -11,6 +13,7 @@ class InstantRadiosityRenderer: public TileProcessingRenderer {
 private:
     struct EmissionVPL {
         const Light* pLight;
+        uint32_t lightID;
         float lightPdf;
         Vec2f emissionVertexSample;
     };
@@ -20,6 +23,8 @@ private:
         BSDF bsdf;
         Vec3f power;
 
+        SurfaceVPL() = default;
+
         SurfaceVPL(const Intersection& I, const Vec3f& wi, const Scene& scene, const Vec3f& power):
             intersection(I), bsdf(wi, intersection, scene), power(power) {
         }
@@ -29,6 +34,13 @@ private:
 
     void beginFrame() override;
 
+    void buildLightcutsTree();
+
+    // Contributions of VPLs to a point, without the importance of the sensor
+    Vec3f evalEmissionVPLContribution(const EmissionVPL& vpl, const Intersection& I, const BSDF& bsdf) const;
+
+    Vec3f evalSurfaceVPLContribution(const SurfaceVPL& vpl, const Intersection& I, const BSDF& bsdf) const;
+
     void processPixel(uint32_t threadID, uint32_t tileID, const Vec2u& pixel) const;
 
     void processTile(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const override;
@@ -46,7 +58,22 @@ private:
 
     std::vector<EmissionVPL> m_EmissionVPLBuffer;
     std::vector<SurfaceVPL> m_SurfaceVPLBuffer;
+
+    // VPLs of each light path before compaction: one emission VPL slot and (m_nMaxDepth - 2) surface VPL slots per path
+    std::vector<EmissionVPL> m_LightPathEmissionVPLs;
+    std::vector<SurfaceVPL> m_LightPathSurfaceVPLs;
+    std::vector<uint32_t> m_EmissionVPLOffsets; // Offset of the VPLs of each path in m_EmissionVPLBuffer
+    std::vector<uint32_t> m_SurfaceVPLOffsets; // Offset of the VPLs of each path in m_SurfaceVPLBuffer
     PowerBasedLightSampler m_Sampler;
+
+    // With lightcuts, each shading point gathers the VPLs through a cut of a light tree instead of all of them.
+    // Emission VPLs of lights without position (directional, environment) are not in the tree and always gathered.
+    bool m_bUseLightcuts = false;
+    float m_fLightcutsMaxRelativeError = 0.02f;
+    uint32_t m_nLightcutsMaxCutSize = 1000u;
+    LightcutsTree m_LightcutsTree;
+    mutable PerThreadAccumulator<LightcutsTree::CutBuffers> m_LightcutsBuffers; // One per thread, padded
+    std::vector<uint32_t> m_InfiniteEmissionVPLs;
 };
 
 }
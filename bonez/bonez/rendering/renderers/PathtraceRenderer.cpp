@@ -10,6 +10,7 @@ namespace BnZ {
 
 void PathtraceRenderer::preprocess() {
     m_Sampler.initFrame(getScene());
+    m_LightBVHSampler.initFrame(getScene());
 }
 
 void PathtraceRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sampleID, uint32_t x, uint32_t y) const {
@@ -47,8 +48,12 @@ void PathtraceRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint3
     for(auto vertex: makePath(getScene(), sourceVertex, rng)) {
         // Next event estimation
         if(vertex.intersection() && vertex.length() < m_nMaxPathDepth && acceptPathDepth(vertex.length() + 1)) {
+            if(m_bUseLightBVH) {
+                pLight = m_LightBVHSampler.sample(getScene(), vertex.intersection(), getFloat(threadID), lightPdf);
+            }
+
             RaySample shadowRay;
-            auto Le = pLight->sampleDirectIllumination(getScene(), getFloat2(threadID), vertex.intersection(), shadowRay);
+            auto Le = pLight ? pLight->sampleDirectIllumination(getScene(), getFloat2(threadID), vertex.intersection(), shadowRay) : zero<Vec3f>();
 
             if (Le != zero<Vec3f>() && shadowRay.pdf > 0.f && !getScene().occluded(shadowRay.value)) {
                 shadowRay.pdf *= lightPdf;
@@ -76,14 +81,17 @@ void PathtraceRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint3
 
 void PathtraceRenderer::doExposeIO(GUI& gui) {
     gui.addVarRW(BNZ_GUI_VAR(m_nMaxPathDepth));
+    gui.addVarRW(BNZ_GUI_VAR(m_bUseLightBVH));
 }
 
 void PathtraceRenderer::doLoadSettings(const tinyxml2::XMLElement& xml) {
     serialize(xml, "maxDepth", m_nMaxPathDepth);
+    serialize(xml, "useLightBVH", m_bUseLightBVH);
 }
 
 void PathtraceRenderer::doStoreSettings(tinyxml2::XMLElement& xml) const {
     serialize(xml, "maxDepth", m_nMaxPathDepth);
+    serialize(xml, "useLightBVH", m_bUseLightBVH);
 }
 
 void PathtraceRenderer::processTile(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const {
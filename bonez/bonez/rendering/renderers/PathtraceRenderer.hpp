@@ -2,14 +2,17 @@
 
 #include "TileProcessingRenderer.hpp"
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
+#include <bonez/scene/lights/LightBVHSampler.hpp>
 
 namespace BnZ {
 
 class PathtraceRenderer: public TileProcessingRenderer {
 public:
     PowerBasedLightSampler m_Sampler;
+    LightBVHSampler m_LightBVHSampler;
 
     uint32_t m_nMaxPathDepth = 2;
+    bool m_bUseLightBVH = false; // Choose the light of each next event estimation with m_LightBVHSampler
 
     void preprocess() override;
 
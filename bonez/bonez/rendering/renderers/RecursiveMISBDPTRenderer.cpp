@@ -12,6 +12,7 @@ namespace BnZ {
 void RecursiveMISBDPTRenderer::preprocess() {
     BPT_STRATEGY_s0_t2 = FINAL_RENDER_DEPTH1 + m_nMaxDepth;
     m_LightSampler.initFrame(getScene());
+    m_LightBVHSampler.initFrame(getScene());
 }
 
 void RecursiveMISBDPTRenderer::beginFrame() {
@@ -30,8 +31,9 @@ void RecursiveMISBDPTRenderer::sampleLightPaths() {
     processTasksDeterminist(m_nLightPathCount, [&](uint32_t pathID, uint32_t threadID) {
         ThreadRNG rng(*this, threadID);
         auto pLightPath = m_LightPathBuffer.getSlicePtr(pathID);
-        sampleLightPath(pLightPath, getMaxLightPathDepth(), getScene(),
-                        m_LightSampler, getSppCount(), mis, rng);
+        sampleLightPath(pLightPath, getMaxLightPathDepth(), getScene(), m_LightSampler, [&](const SurfacePoint& point, uint32_t lightID) {
+            return m_bUseLightBVH ? m_LightBVHSampler.pdf(point, lightID) : m_LightSampler.pdf(lightID);
+        }, getSppCount(), mis, rng);
     }, getThreadCount());
 }
 
@@ -100,17 +102,25 @@ void RecursiveMISBDPTRenderer::processSample(uint32_t threadID, uint32_t tileID,
     auto maxLightPathDepth = getMaxLightPathDepth();
 
 
+    // The eye vertex is extended in place, so we keep the previous point to evaluate the pdf of the direct illumination strategy
+    SurfacePoint previousEyePoint;
+
     auto extendEyePath = [&]() -> bool {
+        previousEyePoint = eyeVertex.m_Intersection;
         return eyeVertex.m_nDepth < maxEyePathDepth &&
             eyeVertex.extend(eyeVertex, getScene(), getSppCount(), false, rng, mis);
     };
 
+    auto directLightPdf = [&](uint32_t lightID) {
+        return m_bUseLightBVH ? m_LightBVHSampler.pdf(previousEyePoint, lightID) : m_LightSampler.pdf(lightID);
+    };
+
     // Iterate over an eye path
     do {
         // Intersection with light source
         auto totalLength = eyeVertex.m_nDepth;
         if(acceptPathDepth(totalLength) && totalLength <= m_nMaxDepth) {
-            auto contrib = fImportanceScale * computeEmittedRadiance(eyeVertex, getScene(), m_LightSampler, getSppCount(), mis);
+            auto contrib = fImportanceScale * computeEmittedRadiance(eyeVertex, getScene(), m_LightSampler, directLightPdf, getSppCount(), mis);
 
             if(isInvalidMeasurementEstimate(contrib)) {
                 reportInvalidContrib(threadID, tileID, pixelID, [&]() {
@@ -131,9 +141,14 @@ void RecursiveMISBDPTRenderer::processSample(uint32_t threadID, uint32_t tileID,
             auto totalLength = eyeVertex.m_nDepth + 1;
             if(acceptPathDepth(totalLength) && totalLength <= m_nMaxDepth) {
                 float lightPdf;
-                auto pLight = m_LightSampler.sample(getScene(), getFloat(threadID), lightPdf);
+                uint32_t lightID;
+                auto pLight = m_bUseLightBVH ?
+                            m_LightBVHSampler.sample(getScene(), eyeVertex.m_Intersection, getFloat(threadID), lightPdf, &lightID) :
+                            m_LightSampler.sample(getScene(), getFloat(threadID), lightPdf, &lightID);
+                auto emissionLightPdf = pLight ? m_LightSampler.pdf(lightID) : 0.f;
                 auto s2D = getFloat2(threadID);
-                auto contrib = fImportanceScale * connectVertices(eyeVertex, EmissionVertex(pLight, lightPdf, s2D), getScene(), getSppCount(), mis);
+                auto contrib = fImportanceScale * connectVertices(eyeVertex, EmissionVertex(pLight, lightPdf, s2D), emissionLightPdf,
+                                                                  getScene(), getSppCount(), mis);
 
                 if(isInvalidMeasurementEstimate(contrib)) {
                     reportInvalidContrib(threadID, tileID, pixelID, [&]() {
@@ -221,14 +236,17 @@ uint32_t RecursiveMISBDPTRenderer::getMaxEyePathDepth() const {
 
 void RecursiveMISBDPTRenderer::doExposeIO(GUI& gui) {
     gui.addVarRW(BNZ_GUI_VAR(m_nMaxDepth));
+    gui.addVarRW(BNZ_GUI_VAR(m_bUseLightBVH));
 }
 
 void RecursiveMISBDPTRenderer::doLoadSettings(const tinyxml2::XMLElement& xml) {
     serialize(xml, "maxDepth", m_nMaxDepth);
+    serialize(xml, "useLightBVH", m_bUseLightBVH);
 }
 
 void RecursiveMISBDPTRenderer::doStoreSettings(tinyxml2::XMLElement& xml) const {
     serialize(xml, "maxDepth", m_nMaxDepth);
+    serialize(xml, "useLightBVH", m_bUseLightBVH);
 }
 
 void RecursiveMISBDPTRenderer::initFramebuffer() {
@@ -5,6 +5,7 @@
 #include <bonez/sampling/shapes.hpp>
 #include <bonez/sampling/patterns.hpp>
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
+#include <bonez/scene/lights/LightBVHSampler.hpp>
 #include <bonez/scene/shading/BSDF.hpp>
 #include <bonez/utils/MultiDimensionalArray.hpp>
 
@@ -48,15 +49,17 @@ class RecursiveMISBDPTRenderer: public TileProcessingRenderer {
 
     // User parameters
     uint32_t m_nMaxDepth = 3;
+    bool m_bUseLightBVH = false; // Choose the light of the direct illumination strategy with m_LightBVHSampler
 
     // Per frame precomputed parameters
     uint32_t m_nLightPathCount;
 
     // Per scene data
     PowerBasedLightSampler m_LightSampler;
+    LightBVHSampler m_LightBVHSampler;
 
     // Per frame data
-    Array2d<PathVertex> m_LightPathBuffer;
+    Array2d<PathVertex> m_LightPathBuffer { MemoryTag::LightVertices };
     DirectImportanceSampleTilePartionning m_DirectImportanceSampleTilePartitionning;
 
     // Framebuffer targets
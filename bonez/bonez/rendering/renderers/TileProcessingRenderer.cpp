@@ -1,7 +1,13 @@
 #include "TileProcessingRenderer.hpp"
 
 #include <numeric>
+#include <atomic>
+#include <algorithm>
 #include <bonez/sys/DebugLog.hpp>
+#include <bonez/rendering/RenderCheckpoint.hpp>
+#include <bonez/rendering/Denoiser.hpp>
+#include <bonez/scene/sensors/PixelSensor.hpp>
+#include <bonez/scene/shading/BSDF.hpp>
 
 namespace BnZ {
 
@@ -16,10 +22,67 @@ void TileProcessingRenderer::doInit() {
 
     m_JitteredDistribution = JitteredDistribution2D(m_Spp.x, m_Spp.y);
 
+    initCropWindow();
+    resetAdaptiveSampling();
+
+    m_FeatureBuffers = Framebuffer(m_FramebufferSize);
+    if(m_bCollectDenoisingFeatures) {
+        m_nFirstFeatureChannel = CrossBilateralDenoiser::addFeatureChannels(m_FeatureBuffers);
+    }
+
     preprocess();
 }
 
+Vec4u TileProcessingRenderer::getCropWindow() const {
+    auto framebufferSize = getFramebufferSize();
+    auto origin = min(Vec2u(m_CropWindow.x, m_CropWindow.y), framebufferSize);
+    auto end = min(Vec2u(m_CropWindow.x, m_CropWindow.y) + Vec2u(m_CropWindow.z, m_CropWindow.w), framebufferSize);
+    if(end.x <= origin.x || end.y <= origin.y) {
+        return Vec4u(0u, 0u, framebufferSize);
+    }
+    return Vec4u(origin, end - origin);
+}
+
+Vec4u TileProcessingRenderer::getCropTileViewport(uint32_t tileID) const {
+    auto viewport = getTileViewport(tileID);
+    if(!hasCropWindow()) {
+        return viewport;
+    }
+    auto window = getCropWindow();
+    auto origin = max(Vec2u(viewport.x, viewport.y), Vec2u(window.x, window.y));
+    auto end = max(origin, min(Vec2u(viewport.x, viewport.y) + Vec2u(viewport.z, viewport.w), Vec2u(window.x, window.y) + Vec2u(window.z, window.w)));
+    return Vec4u(origin, end - origin);
+}
+
+void TileProcessingRenderer::initCropWindow() {
+    auto window = getCropWindow();
+    if((m_CropWindow.z || m_CropWindow.w) && window == Vec4u(0u, 0u, m_FramebufferSize)) {
+        if(Vec2u(m_CropWindow.z, m_CropWindow.w) != m_FramebufferSize) {
+            std::cerr << "TileProcessingRenderer: the crop window is empty or outside the framebuffer, render the full framebuffer" << std::endl;
+        }
+    }
+
+    auto firstTile = Vec2u(window.x, window.y) / m_TileSize;
+    auto endTile = (Vec2u(window.x, window.y) + Vec2u(window.z, window.w) + m_TileSize - Vec2u(1u)) / m_TileSize;
+
+    m_CropTiles.clear();
+    for(auto y = firstTile.y; y < endTile.y; ++y) {
+        for(auto x = firstTile.x; x < endTile.x; ++x) {
+            m_CropTiles.emplace_back(getTileID(Vec2u(x, y)));
+        }
+    }
+
+    m_nCropTilePassCount = 1u;
+    if(m_bRedistributeCropSamples && !m_CropTiles.empty()) {
+        m_nCropTilePassCount = max(1u, m_nTileCount / uint32_t(m_CropTiles.size()));
+    }
+}
+
 void TileProcessingRenderer::doRender() {
+    if(m_bAdaptiveSampling) {
+        beginAdaptiveFrame();
+    }
+
     {
         auto timer = m_RenderTimer.start(0);
         beginFrame();
@@ -30,15 +93,59 @@ void TileProcessingRenderer::doRender() {
 
         auto processedTileCount = 0u;
 
-        processTiles([&](uint32_t threadID, uint32_t tileID, const Vec4u& viewport) {
-            processTile(threadID, tileID, viewport);
-
+        auto displayProgress = [&](uint32_t totalTileCount) {
             if(m_bDisplayProgress) {
                 auto l = debugLock();
                 ++processedTileCount;
-                std::cerr << "Tile " << processedTileCount << " / " << getTileCount() << " (" << (processedTileCount * 100.f / getTileCount()) << " %)" << std::endl;
+                std::cerr << "Tile " << processedTileCount << " / " << totalTileCount << " (" << (processedTileCount * 100.f / totalTileCount) << " %)" << std::endl;
             }
-        });
+        };
+
+        if(!m_bAdaptiveSampling && !hasCropWindow()) {
+            processTiles([&](uint32_t threadID, uint32_t tileID, const Vec4u& viewport) {
+                processTile(threadID, tileID, viewport);
+                collectDenoisingFeatures(threadID, viewport);
+                displayProgress(getTileCount());
+            });
+            m_nTilePassCount += getTileCount();
+        } else if(!m_bAdaptiveSampling) {
+            auto cropTileCount = uint32_t(m_CropTiles.size());
+            auto task = [&](uint32_t threadID) {
+                for(auto i = threadID; i < cropTileCount; i += getThreadCount()) {
+                    auto tileID = m_CropTiles[i];
+                    auto viewport = getCropTileViewport(tileID);
+                    for(auto passID = 0u; passID < m_nCropTilePassCount; ++passID) {
+                        processTile(threadID, tileID, viewport);
+                    }
+                    collectDenoisingFeatures(threadID, viewport);
+                    displayProgress(cropTileCount);
+                }
+            };
+            launchThreads(task, getThreadCount());
+            m_nTilePassCount += cropTileCount * m_nCropTilePassCount;
+        } else {
+            // Each active tile is processed by a single thread to avoid concurrent accumulation on its pixels.
+            // Tiles have different pass counts, so they are fetched dynamically, the most expensive first
+            // (m_ActiveTiles is sorted by beginAdaptiveFrame()).
+            auto activeTileCount = uint32_t(m_ActiveTiles.size());
+            std::atomic_uint nextTile;
+            nextTile.store(0u);
+            auto task = [&](uint32_t threadID) {
+                for(auto i = nextTile++; i < activeTileCount; i = nextTile++) {
+                    auto tileID = m_ActiveTiles[i];
+                    auto viewport = getCropTileViewport(tileID);
+                    for(auto passID = 0u; passID < m_TilePassCounts[tileID]; ++passID) {
+                        processTile(threadID, tileID, viewport);
+                    }
+                    collectDenoisingFeatures(threadID, viewport);
+                    displayProgress(activeTileCount);
+                }
+            };
+            launchThreads(task, getThreadCount());
+            for(auto tileID: m_ActiveTiles) {
+                m_nTilePassCount += m_TilePassCounts[tileID];
+            }
+        }
     }
 
     {
@@ -46,9 +153,150 @@ void TileProcessingRenderer::doRender() {
         endFrame();
     }
 
+    if(m_bAdaptiveSampling) {
+        endAdaptiveFrame();
+    }
+
     logInvalidMeasurements();
 }
 
+void TileProcessingRenderer::resetAdaptiveSampling() {
+    m_HalfSampleImage = Image(m_FramebufferSize.x, m_FramebufferSize.y);
+    m_FrameStartImage = Image();
+    // Tiles outside the crop window are considered as converged
+    m_TileErrors.clear();
+    m_TileErrors.resize(m_nTileCount, 0.f);
+    for(auto tileID: m_CropTiles) {
+        m_TileErrors[tileID] = std::numeric_limits<float>::infinity();
+    }
+    m_TilePassCounts.clear();
+    m_TilePassCounts.resize(m_nTileCount, 1u);
+    m_ActiveTiles.clear();
+    m_nTilePassCount = 0u;
+}
+
+void TileProcessingRenderer::beginAdaptiveFrame() {
+    if(m_TileErrors.size() != m_nTileCount || m_HalfSampleImage.getSize() != m_FramebufferSize) {
+        // The tiling has been modified since the last frame
+        resetAdaptiveSampling();
+    }
+
+    // Odd frames are accumulated in the half sample image
+    if(getIterationCount() % 2u == 1u) {
+        m_FrameStartImage = getFramebuffer().getChannel(0);
+    }
+
+    // Tiles with an unknown error receive one pass, the remaining budget of the frame
+    // (one pass per tile, of the crop window unless its samples are redistributed) is distributed proportionally
+    // to the error of the others
+    m_ActiveTiles.clear();
+    auto errorSum = 0.f;
+    auto passBudget = m_bRedistributeCropSamples ? m_nTileCount : uint32_t(m_CropTiles.size());
+    for(auto tileID: m_CropTiles) {
+        auto error = m_TileErrors[tileID];
+        if(error >= m_fAdaptiveErrorThreshold) {
+            m_ActiveTiles.emplace_back(tileID);
+            m_TilePassCounts[tileID] = 1u;
+            --passBudget;
+            if(error != std::numeric_limits<float>::infinity()) {
+                errorSum += error;
+            }
+        } else {
+            m_TilePassCounts[tileID] = 0u;
+        }
+    }
+
+    if(errorSum > 0.f) {
+        for(auto tileID: m_ActiveTiles) {
+            auto error = m_TileErrors[tileID];
+            if(error != std::numeric_limits<float>::infinity()) {
+                auto extraPassCount = uint32_t(passBudget * error / errorSum);
+                m_TilePassCounts[tileID] = min(1u + extraPassCount, max(1u, m_nAdaptiveMaxTilePassCount));
+            }
+        }
+    }
+    std::stable_sort(begin(m_ActiveTiles), end(m_ActiveTiles), [&](uint32_t lhs, uint32_t rhs) {
+        return m_TilePassCounts[lhs] > m_TilePassCounts[rhs];
+    });
+}
+
+void TileProcessingRenderer::endAdaptiveFrame() {
+    if(getIterationCount() % 2u == 1u) {
+        const auto& image = getFramebuffer().getChannel(0);
+        for(auto pixelID: range(image.getPixelCount())) {
+            m_HalfSampleImage[pixelID] += image[pixelID] - m_FrameStartImage[pixelID];
+        }
+
+        // getIterationCount() is incremented after doRender()
+        if(getIterationCount() + 1u >= m_nAdaptiveMinIterationCount) {
+            computeTileErrors();
+        }
+    }
+}
+
+void TileProcessingRenderer::computeTileErrors() {
+    const auto& image = getFramebuffer().getChannel(0);
+
+    processTasksDeterminist(m_nTileCount, [&](uint32_t tileID, uint32_t threadID) {
+        if(m_TileErrors[tileID] < m_fAdaptiveErrorThreshold) {
+            return; // Converged tiles are not processed anymore, their error does not change
+        }
+
+        auto errorSum = 0.f;
+        auto pixelCount = 0u;
+        auto validPixelCount = 0u;
+        processTilePixels(getCropTileViewport(tileID), [&](uint32_t x, uint32_t y) {
+            ++pixelCount;
+
+            auto pixelID = getPixelIndex(x, y);
+            auto value = image[pixelID];
+            auto halfValue = m_HalfSampleImage[pixelID];
+            if(value.w <= 0.f || halfValue.w <= 0.f) {
+                return;
+            }
+            ++validPixelCount;
+
+            auto estimate = Vec3f(value) / value.w;
+            auto halfEstimate = Vec3f(halfValue) / halfValue.w;
+            auto difference = abs(estimate - halfEstimate);
+
+            // Relative error, the offset of the intensity prevents dark pixels from dominating the error of their tile
+            errorSum += (difference.x + difference.y + difference.z) / (0.001f + estimate.x + estimate.y + estimate.z);
+        });
+
+        if(validPixelCount < pixelCount) {
+            // Some pixels have no samples in one of the two images, we can't estimate the error yet
+            m_TileErrors[tileID] = std::numeric_limits<float>::infinity();
+        } else {
+            m_TileErrors[tileID] = pixelCount ? errorSum / pixelCount : 0.f;
+        }
+    }, getThreadCount());
+}
+
+void TileProcessingRenderer::collectDenoisingFeatures(uint32_t threadID, const Vec4u& viewport) {
+    if(!m_bCollectDenoisingFeatures) {
+        return;
+    }
+
+    processTilePixels(viewport, [&](uint32_t x, uint32_t y) {
+        PixelSensor sensor(getSensor(), Vec2u(x, y), getFramebufferSize());
+
+        auto lensSample = getFloat2(threadID);
+        auto pixelSample = getFloat2(threadID);
+
+        RaySample raySample;
+        Intersection I;
+        sampleExitantRay(sensor, getScene(), lensSample, pixelSample, raySample, I);
+
+        if(I) {
+            BSDF bsdf(-raySample.value.dir, I, getScene());
+            CrossBilateralDenoiser::accumulateFeatures(m_FeatureBuffers, m_nFirstFeatureChannel, getPixelIndex(x, y),
+                                                       bsdf.getDiffuseCoefficient() + bsdf.getGlossyCoefficient(),
+                                                       I.Ns, I.distance);
+        }
+    });
+}
+
 void TileProcessingRenderer::logInvalidMeasurements() {
     if(!m_bHasDetectedInvalidMeasurement) {
         for(auto i: range(getFramebuffer().getChannel(0).getPixelCount())) {
@@ -107,6 +355,10 @@ void TileProcessingRenderer::reportInvalidContrib(uint32_t threadID, uint32_t ti
 void TileProcessingRenderer::exposeIO(GUI& gui) {
     Renderer::exposeIO(gui);
 
+    auto cropWindow = m_CropWindow;
+    auto redistributeCropSamples = m_bRedistributeCropSamples;
+    auto tileSize = m_TileSize;
+
     if (ImGui::CollapsingHeader("TileProcessingRenderer"))
     {
         gui.addVarRW(BNZ_GUI_VAR(m_Spp.x));
@@ -115,6 +367,24 @@ void TileProcessingRenderer::exposeIO(GUI& gui) {
         gui.addVarRW(BNZ_GUI_VAR(m_TileSize.y));
 
         gui.addVarRW(BNZ_GUI_VAR(m_bDisplayProgress));
+
+        gui.addVarRW(BNZ_GUI_VAR(m_bAdaptiveSampling));
+        gui.addVarRW(BNZ_GUI_VAR(m_fAdaptiveErrorThreshold));
+        gui.addVarRW(BNZ_GUI_VAR(m_nAdaptiveMinIterationCount));
+        gui.addVarRW(BNZ_GUI_VAR(m_nAdaptiveMaxTilePassCount));
+        if(m_bAdaptiveSampling) {
+            gui.addValue("ActiveTileCount", uint32_t(m_ActiveTiles.size()));
+        }
+        gui.addValue("TilePassCount", uint32_t(m_nTilePassCount));
+
+        gui.addVarRW(BNZ_GUI_VAR(m_CropWindow.x));
+        gui.addVarRW(BNZ_GUI_VAR(m_CropWindow.y));
+        gui.addVarRW(BNZ_GUI_VAR(m_CropWindow.z));
+        gui.addVarRW(BNZ_GUI_VAR(m_CropWindow.w));
+        gui.addVarRW(BNZ_GUI_VAR(m_bRedistributeCropSamples));
+        gui.addValue("CropTileCount", uint32_t(m_CropTiles.size()));
+
+        gui.addValue(BNZ_GUI_VAR(m_bCollectDenoisingFeatures));
     }
 
     if (ImGui::CollapsingHeader("Render Timings"))
@@ -139,8 +409,16 @@ void TileProcessingRenderer::exposeIO(GUI& gui) {
     m_nSpp = m_Spp.x * m_Spp.y;
     m_TileSize.x = max(m_TileSize.x, 1u);
     m_TileSize.y = max(m_TileSize.y, 1u);
+    m_TileCount = m_FramebufferSize / m_TileSize +
+            Vec2u(m_FramebufferSize % m_TileSize != zero<Vec2u>());
     m_nTileCount = m_TileCount.x * m_TileCount.y;
     m_JitteredDistribution = JitteredDistribution2D(m_Spp.x, m_Spp.y);
+
+    // The crop tiles and the errors of adaptive sampling are indexed by tile
+    if(cropWindow != m_CropWindow || redistributeCropSamples != m_bRedistributeCropSamples || tileSize != m_TileSize) {
+        initCropWindow();
+        resetAdaptiveSampling();
+    }
 }
 
 void TileProcessingRenderer::loadSettings(const tinyxml2::XMLElement& xml) {
@@ -150,6 +428,13 @@ void TileProcessingRenderer::loadSettings(const tinyxml2::XMLElement& xml) {
     serialize(xml, "tileSize", m_TileSize);
     serialize(xml, "displayProgress", m_bDisplayProgress);
     serialize(xml, "hasDetectedInvalidMeasurement", m_bHasDetectedInvalidMeasurement);
+    serialize(xml, "adaptiveSampling", m_bAdaptiveSampling);
+    serialize(xml, "adaptiveErrorThreshold", m_fAdaptiveErrorThreshold);
+    serialize(xml, "adaptiveMinIterationCount", m_nAdaptiveMinIterationCount);
+    serialize(xml, "adaptiveMaxTilePassCount", m_nAdaptiveMaxTilePassCount);
+    serialize(xml, "cropWindow", m_CropWindow);
+    serialize(xml, "redistributeCropSamples", m_bRedistributeCropSamples);
+    serialize(xml, "collectDenoisingFeatures", m_bCollectDenoisingFeatures);
 
     doLoadSettings(xml);
 }
@@ -165,15 +450,84 @@ void TileProcessingRenderer::storeSettings(tinyxml2::XMLElement& xml) const {
 
     serialize(xml, "displayProgress", m_bDisplayProgress);
 
+    serialize(xml, "adaptiveSampling", m_bAdaptiveSampling);
+    serialize(xml, "adaptiveErrorThreshold", m_fAdaptiveErrorThreshold);
+    serialize(xml, "adaptiveMinIterationCount", m_nAdaptiveMinIterationCount);
+    serialize(xml, "adaptiveMaxTilePassCount", m_nAdaptiveMaxTilePassCount);
+    serialize(xml, "cropWindow", m_CropWindow);
+    serialize(xml, "redistributeCropSamples", m_bRedistributeCropSamples);
+    serialize(xml, "collectDenoisingFeatures", m_bCollectDenoisingFeatures);
+
     doStoreSettings(xml);
 }
 
+void TileProcessingRenderer::doStoreCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml) const {
+    setChildAttribute(xml, "TilePassCount", m_nTilePassCount);
+
+    if(m_bCollectDenoisingFeatures) {
+        checkpoint.storeFramebuffer("denoisingFeatures", m_FeatureBuffers);
+    }
+
+    if(m_bAdaptiveSampling) {
+        checkpoint.storeImage("halfSampleImage", m_HalfSampleImage);
+
+        // Errors not estimated yet are stored as -1 instead of infinity
+        auto tileErrors = m_TileErrors;
+        for(auto& error: tileErrors) {
+            if(error == std::numeric_limits<float>::infinity()) {
+                error = -1.f;
+            }
+        }
+        setChildAttribute(xml, "TileErrors", tileErrors);
+    }
+}
+
+bool TileProcessingRenderer::doLoadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml) {
+    getChildAttribute(xml, "TilePassCount", m_nTilePassCount);
+
+    // The guides are only averaged: if they are missing, they are accumulated again from the next frame
+    if(m_bCollectDenoisingFeatures && !checkpoint.loadFramebuffer("denoisingFeatures", m_FeatureBuffers)) {
+        m_FeatureBuffers.clear();
+    }
+
+    if(m_bAdaptiveSampling) {
+        // The half sample image must be consistent with the framebuffer for the error estimation
+        std::vector<float> tileErrors;
+        if(!getChildAttribute(xml, "TileErrors", tileErrors) || tileErrors.size() != m_nTileCount ||
+                !checkpoint.loadImage("halfSampleImage", m_HalfSampleImage) || m_HalfSampleImage.getSize() != m_FramebufferSize) {
+            return false;
+        }
+
+        for(auto& error: tileErrors) {
+            if(error < 0.f) {
+                error = std::numeric_limits<float>::infinity();
+            }
+        }
+        m_TileErrors = tileErrors;
+    }
+
+    return true;
+}
+
 void TileProcessingRenderer::storeStatistics() {
     Renderer::storeStatistics();
 
     if(auto pStats = getStatisticsOutput()) {
         setChildAttribute(*pStats, "IterationCount", getIterationCount());
         setChildAttribute(*pStats, "TotalSpp", getIterationCount() * getSppCount());
+        // With adaptive sampling, the mean number of samples per pixel differs from TotalSpp
+        setChildAttribute(*pStats, "TilePassCount", m_nTilePassCount);
+        if(m_bAdaptiveSampling) {
+            setChildAttribute(*pStats, "ActiveTileCount", uint32_t(m_ActiveTiles.size()));
+        }
+        if(m_bAdaptiveSampling || hasCropWindow()) {
+            // Mean over the tiles of the crop window
+            auto tileCount = uint32_t(m_CropTiles.size());
+            setChildAttribute(*pStats, "MeanSpp", tileCount ? float(m_nTilePassCount) * getSppCount() / tileCount : 0.f);
+        }
+        if(hasCropWindow()) {
+            setChildAttribute(*pStats, "CropWindow", getCropWindow());
+        }
         setChildAttribute(*pStats, "RenderTime", m_RenderTimer);
 
         auto beginFrameTime = m_RenderTimer.getEllapsedTime<Microseconds>(0);
@@ -29,6 +29,12 @@ public:
     void storeSettings(tinyxml2::XMLElement& xml) const override;
 
     void storeStatistics() override final;
+
+    Vec4u getCropWindow() const override;
+
+    const Framebuffer* getFeatureBuffers() const override {
+        return m_bCollectDenoisingFeatures ? &m_FeatureBuffers : nullptr;
+    }
 protected:
     const Vec2u getTileSize() const {
         return m_TileSize;
@@ -92,25 +98,36 @@ protected:
                     return;
                 }
 
-                uint32_t tileX = tileID % m_TileCount.x;
-                uint32_t tileY = tileID / m_TileCount.x;
+                fun(threadID, tileID, getTileViewport(tileID));
+            }
+        };
 
-                Vec2u tileOrg = Vec2u(tileX, tileY) * m_TileSize;
-                auto viewport = Vec4u(tileOrg, m_TileSize);
+        launchThreads(task, getThreadCount());
+    }
 
-                if(viewport.x + viewport.z > m_FramebufferSize.x) {
-                    viewport.z = m_FramebufferSize.x - viewport.x;
-                }
+    Vec4u getTileViewport(uint32_t tileID) const {
+        uint32_t tileX = tileID % m_TileCount.x;
+        uint32_t tileY = tileID / m_TileCount.x;
 
-                if(viewport.y + viewport.w > m_FramebufferSize.y) {
-                    viewport.w = m_FramebufferSize.y - viewport.y;
-                }
+        Vec2u tileOrg = Vec2u(tileX, tileY) * m_TileSize;
+        auto viewport = Vec4u(tileOrg, m_TileSize);
 
-                fun(threadID, tileID, viewport);
-            }
-        };
+        if(viewport.x + viewport.z > m_FramebufferSize.x) {
+            viewport.z = m_FramebufferSize.x - viewport.x;
+        }
 
-        launchThreads(task, getThreadCount());
+        if(viewport.y + viewport.w > m_FramebufferSize.y) {
+            viewport.w = m_FramebufferSize.y - viewport.y;
+        }
+
+        return viewport;
+    }
+
+    // Viewport of a tile restricted to the crop window
+    Vec4u getCropTileViewport(uint32_t tileID) const;
+
+    bool hasCropWindow() const {
+        return getCropWindow() != Vec4u(0u, 0u, getFramebufferSize());
     }
 
 private:
@@ -150,6 +167,27 @@ private:
         // Do nothing by default
     }
 
+    void doStoreCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml) const override;
+
+    bool doLoadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml) override;
+
+    // Adaptive sampling: the samples of a frame are redistributed among the tiles according to their relative error,
+    // estimated by comparing the final image with an image accumulating only one frame out of two (half the samples).
+    // Tiles below the error threshold stop receiving samples.
+    void beginAdaptiveFrame();
+
+    void endAdaptiveFrame();
+
+    void computeTileErrors();
+
+    void resetAdaptiveSampling();
+
+    // Compute the tiles overlapping the crop window and their number of passes per frame
+    void initCropWindow();
+
+    // Trace one primary ray per pixel of the viewport to accumulate the guides of the denoiser
+    void collectDenoisingFeatures(uint32_t threadID, const Vec4u& viewport);
+
     Vec2u m_TileSize = Vec2u(32u, 32u);
     Vec2u m_TileCount;
 
@@ -173,6 +211,34 @@ private:
     JitteredDistribution2D m_JitteredDistribution;
 
     mutable bool m_bHasDetectedInvalidMeasurement = false;
+
+    bool m_bAdaptiveSampling = false;
+    float m_fAdaptiveErrorThreshold = 0.01f;
+    uint32_t m_nAdaptiveMinIterationCount = 8u; // Number of frames rendered before stopping any tile
+    uint32_t m_nAdaptiveMaxTilePassCount = 4u; // Maximal number of times a tile is processed during one frame
+
+    Image m_HalfSampleImage; // Accumulate the final render of odd frames
+    Image m_FrameStartImage; // Copy of the final render before an odd frame
+    std::vector<float> m_TileErrors; // Relative error of each tile, infinite until estimated
+    std::vector<uint32_t> m_TilePassCounts; // Number of times each tile is processed during the current frame
+    std::vector<uint32_t> m_ActiveTiles;
+    uint64_t m_nTilePassCount = 0u; // Total number of processed tiles since init
+
+    // Region of interest: only the tiles overlapping the crop window (x, y, width, height) are processed by doRender(),
+    // restricted to the window. An empty window renders the full framebuffer. The light paths that renderers sample
+    // for the full framebuffer in beginFrame() are not affected.
+    Vec4u m_CropWindow = Vec4u(0u);
+    // Spread the samples of the full framebuffer over the crop window: each of its tiles is processed
+    // (tile count / crop tile count) times per frame. The passes of a frame share its light paths, as with adaptive sampling.
+    bool m_bRedistributeCropSamples = false;
+    std::vector<uint32_t> m_CropTiles; // All the tiles if there is no crop window
+    uint32_t m_nCropTilePassCount = 1u;
+
+    // Albedo, normal and depth of the primary hits, accumulated once per pixel and per frame in a framebuffer
+    // separate from the one of the renderer, whose channel indices are not affected
+    bool m_bCollectDenoisingFeatures = false;
+    Framebuffer m_FeatureBuffers;
+    std::size_t m_nFirstFeatureChannel = 0u;
 };
 
 }
@@ -150,31 +150,96 @@ void UniformResamplingRecursiveMISBPTRenderer::processSample(uint32_t threadID,
                 accumulate(BPT_STRATEGY_s0_t2 + strategyOffset, pixelID, Vec4f(contrib, 0));
             }
 
-            // Connection with each light vertex
-            for(auto j = 0u; j < maxLightPathDepth; ++j) {
-                auto pLightVertex = pLightPath + j;
-                auto totalLength = eyeVertex.m_nDepth + pLightVertex->m_nDepth + 1;
-
-                if(pLightVertex->m_fPathPdf > 0.f && acceptPathDepth(totalLength) && totalLength <= m_nMaxDepth) {
-                    auto contrib = fImportanceScale * connectVertices(eyeVertex, *pLightVertex, getScene(), getSppCount(), mis);
-
-                    if(isInvalidMeasurementEstimate(contrib)) {
-                        reportInvalidContrib(threadID, tileID, pixelID, [&]() {
-                            debugLog() << "s = " << (pLightVertex->m_nDepth + 1) << ", t = " << (eyeVertex.m_nDepth + 1) << std::endl;
-                        });
+            if(m_bUseReservoirResampling) {
+                connectResampledLightVertex(threadID, tileID, pixelID, eyeVertex, fImportanceScale);
+            } else {
+                // Connection with each light vertex
+                for(auto j = 0u; j < maxLightPathDepth; ++j) {
+                    auto pLightVertex = pLightPath + j;
+                    auto totalLength = eyeVertex.m_nDepth + pLightVertex->m_nDepth + 1;
+
+                    if(pLightVertex->m_fPathPdf > 0.f && acceptPathDepth(totalLength) && totalLength <= m_nMaxDepth) {
+                        auto contrib = fImportanceScale * connectVertices(eyeVertex, *pLightVertex, getScene(), getSppCount(), mis);
+
+                        if(isInvalidMeasurementEstimate(contrib)) {
+                            reportInvalidContrib(threadID, tileID, pixelID, [&]() {
+                                debugLog() << "s = " << (pLightVertex->m_nDepth + 1) << ", t = " << (eyeVertex.m_nDepth + 1) << std::endl;
+                            });
+                        }
+
+                        accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
+                        accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
+
+                        auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, pLightVertex->m_nDepth + 1);
+                        accumulate(BPT_STRATEGY_s0_t2 + strategyOffset, pixelID, Vec4f(contrib, 0));
                     }
-
-                    accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
-                    accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
-
-                    auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, pLightVertex->m_nDepth + 1);
-                    accumulate(BPT_STRATEGY_s0_t2 + strategyOffset, pixelID, Vec4f(contrib, 0));
                 }
             }
         }
     } while(extendEyePath());
 }
 
+void UniformResamplingRecursiveMISBPTRenderer::connectResampledLightVertex(uint32_t threadID, uint32_t tileID, uint32_t pixelID,
+                                                                           const PathVertex& eyeVertex, float fImportanceScale) const {
+    auto mis = [&](float v) {
+        return Mis(v);
+    };
+
+    struct Candidate {
+        std::size_t m_nLightVertexIndex = 0u;
+        Vec3f m_UnoccludedContrib = zero<Vec3f>();
+        Ray m_ShadowRay;
+    };
+
+    // Candidates are drawn uniformly among all light vertices and resampled according to the luminance of their
+    // unoccluded contribution: only the shadow ray of the selected candidate is traced
+    auto lightVertexCount = m_LightPathBuffer.size();
+    if(!lightVertexCount) {
+        return;
+    }
+    auto sourcePdf = 1.f / lightVertexCount;
+
+    Reservoir<Candidate> reservoir;
+    for(auto i = 0u; i < m_nResamplingCandidateCount; ++i) {
+        Candidate candidate;
+        candidate.m_nLightVertexIndex = clamp(std::size_t(getFloat(threadID) * lightVertexCount),
+                                              std::size_t(0),
+                                              lightVertexCount - 1);
+
+        const auto& lightVertex = m_LightPathBuffer[candidate.m_nLightVertexIndex];
+        auto totalLength = eyeVertex.m_nDepth + lightVertex.m_nDepth + 1;
+        if(lightVertex.m_fPathPdf > 0.f && acceptPathDepth(totalLength) && totalLength <= m_nMaxDepth) {
+            candidate.m_UnoccludedContrib = evalUnoccludedConnection(eyeVertex, lightVertex, getSppCount(), mis, candidate.m_ShadowRay);
+        }
+
+        reservoir.add(candidate, luminance(candidate.m_UnoccludedContrib), sourcePdf, getFloat(threadID));
+    }
+
+    if(reservoir.empty() || getScene().occluded(reservoir.getSample().m_ShadowRay)) {
+        return;
+    }
+
+    const auto& sample = reservoir.getSample();
+    const auto& lightVertex = m_LightPathBuffer[sample.m_nLightVertexIndex];
+    auto totalLength = eyeVertex.m_nDepth + lightVertex.m_nDepth + 1;
+
+    // The reservoir estimates the sum of the contributions of all light vertices while the connection with each vertex of
+    // one light path estimates its mean over the light paths: the MIS weights of connectVertices remain valid
+    auto contrib = fImportanceScale * reservoir.getContributionWeight() * sample.m_UnoccludedContrib / float(m_nLightPathCount);
+
+    if(isInvalidMeasurementEstimate(contrib)) {
+        reportInvalidContrib(threadID, tileID, pixelID, [&]() {
+            debugLog() << "s = " << (lightVertex.m_nDepth + 1) << ", t = " << (eyeVertex.m_nDepth + 1) << " (resampled)" << std::endl;
+        });
+    }
+
+    accumulate(FINAL_RENDER, pixelID, Vec4f(contrib, 0));
+    accumulate(FINAL_RENDER_DEPTH1 + totalLength - 1u, pixelID, Vec4f(contrib, 0));
+
+    auto strategyOffset = computeBPTStrategyOffset(totalLength + 1, lightVertex.m_nDepth + 1);
+    accumulate(BPT_STRATEGY_s0_t2 + strategyOffset, pixelID, Vec4f(contrib, 0));
+}
+
 void UniformResamplingRecursiveMISBPTRenderer::connectLightVerticesToSensor(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const {
     auto rcpPathCount = 1.f / m_nLightPathCount;
 
@@ -224,16 +289,22 @@ uint32_t UniformResamplingRecursiveMISBPTRenderer::getMaxEyePathDepth() const {
 void UniformResamplingRecursiveMISBPTRenderer::doExposeIO(GUI& gui) {
     gui.addVarRW(BNZ_GUI_VAR(m_nMaxDepth));
     gui.addVarRW(BNZ_GUI_VAR(m_nLightPathCount));
+    gui.addVarRW(BNZ_GUI_VAR(m_bUseReservoirResampling));
+    gui.addVarRW(BNZ_GUI_VAR(m_nResamplingCandidateCount));
 }
 
 void UniformResamplingRecursiveMISBPTRenderer::doLoadSettings(const tinyxml2::XMLElement& xml) {
     serialize(xml, "maxDepth", m_nMaxDepth);
     serialize(xml, "lightPathCount", m_nLightPathCount);
+    serialize(xml, "useReservoirResampling", m_bUseReservoirResampling);
+    serialize(xml, "resamplingCandidateCount", m_nResamplingCandidateCount);
 }
 
 void UniformResamplingRecursiveMISBPTRenderer::doStoreSettings(tinyxml2::XMLElement& xml) const {
     serialize(xml, "maxDepth", m_nMaxDepth);
     serialize(xml, "lightPathCount", m_nLightPathCount);
+    serialize(xml, "useReservoirResampling", m_bUseReservoirResampling);
+    serialize(xml, "resamplingCandidateCount", m_nResamplingCandidateCount);
 }
 
 void UniformResamplingRecursiveMISBPTRenderer::initFramebuffer() {
@@ -4,6 +4,7 @@
 #include <bonez/sampling/distribution1d.h>
 #include <bonez/sampling/shapes.hpp>
 #include <bonez/sampling/patterns.hpp>
+#include <bonez/sampling/Reservoir.hpp>
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
 #include <bonez/scene/shading/BSDF.hpp>
 #include <bonez/utils/MultiDimensionalArray.hpp>
@@ -28,6 +29,10 @@ class UniformResamplingRecursiveMISBPTRenderer: public TileProcessingRenderer {
 
     void processSample(uint32_t threadID, uint32_t tileID, uint32_t pixelID, uint32_t sampleID, uint32_t x, uint32_t y) const;
 
+    // Connect the eye vertex to one light vertex chosen by resampling candidates streamed from the light vertex buffer
+    void connectResampledLightVertex(uint32_t threadID, uint32_t tileID, uint32_t pixelID,
+                                     const PathVertex& eyeVertex, float fImportanceScale) const;
+
     void connectLightVerticesToSensor(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const;
 
     uint32_t getMaxLightPathDepth() const;
@@ -49,12 +54,14 @@ class UniformResamplingRecursiveMISBPTRenderer: public TileProcessingRenderer {
     // User parameters
     std::size_t m_nMaxDepth = 3;
     std::size_t m_nLightPathCount = 1024;
+    bool m_bUseReservoirResampling = false; // If false, each eye vertex is connected to all the vertices of a random light path
+    std::size_t m_nResamplingCandidateCount = 32; // Number of light vertices streamed in the reservoir of each eye vertex
 
     // Per scene data
     PowerBasedLightSampler m_LightSampler;
 
     // Per frame data
-    Array2d<PathVertex> m_LightPathBuffer;
+    Array2d<PathVertex> m_LightPathBuffer { MemoryTag::LightVertices };
     DirectImportanceSampleTilePartionning m_DirectImportanceSampleTilePartitionning;
 
     // Framebuffer targets
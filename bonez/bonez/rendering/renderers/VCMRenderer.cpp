@@ -2,11 +2,13 @@
 #include <bonez/scene/lights/AreaLight.hpp>
 
 #include <bonez/scene/sensors/PixelSensor.hpp>
+#include <bonez/utils/PerThreadAccumulator.hpp>
 
 namespace BnZ {
 
 void VCMRenderer::preprocess() {
     m_LightSampler.initFrame(getScene());
+    m_LightBVHSampler.initFrame(getScene());
 
     m_LightTraceOnly = false;
     m_UseVC = false;
@@ -49,66 +51,195 @@ void VCMRenderer::beginFrame() {
     m_nLightPathCount = getFramebuffer().getPixelCount() * getSppCount();
     m_nLightVertexCount = m_nLightPathCount * getMaxLightPathDepth();
 
-    m_LightPathBuffer.resize(getMaxLightPathDepth(), m_nLightPathCount);
-
     auto maxLightPathDepth = getMaxLightPathDepth();
 
+    if(m_nIterationCount == 0u || m_PixelRadii.size() != getFramebuffer().getPixelCount()) {
+        initMergingState();
+    } else if(m_bUseAdaptiveRadius) {
+        updatePixelRadii();
+    }
+    if(m_MergedCountsTileSize != getTileSize()) {
+        initPixelMergedCounts();
+    }
+
+    // The MIS factors are used by the light paths, they must be set before sampling them
+    setupMergingRadius();
+
+    // Without vertex connection, only the light vertices selected for merging are kept: the light paths are sampled
+    // in a buffer per thread and the selected vertices are streamed to m_StreamedLightVertices
+    auto storeLightPaths = m_UseVC || m_LightTraceOnly;
+
+    m_LightPathBuffer.resize(maxLightPathDepth, storeLightPaths ? m_nLightPathCount : getThreadCount());
+
+    m_SelectedLightVerticesPerThread.resize(getThreadCount());
+    m_StreamedLightVertices.resize(getThreadCount(), LightVertexVector(TrackedAllocator<PathVertex>(MemoryTag::LightVertices)));
+    for(auto threadID: range(getThreadCount())) {
+        m_SelectedLightVerticesPerThread[threadID].clear();
+        m_StreamedLightVertices[threadID].clear();
+    }
+
+    PerThreadAccumulator<uint64_t> validVertexCounts(1u, getThreadCount());
+
     // Sample light paths for each pixel
     TileProcessingRenderer::processTiles([&](uint32_t threadID, uint32_t tileID, const Vec4u& viewport) {
         TileProcessingRenderer::processTilePixels(viewport, [&](uint32_t x, uint32_t y) {
             auto pixelID = getPixelIndex(x, y);
 
             for(auto i = 0u, spp = getSppCount(); i < spp; ++i) {
-                auto pLightPath = m_LightPathBuffer.getSlicePtr(pixelID * spp + i);
+                auto pLightPath = m_LightPathBuffer.getSlicePtr(storeLightPaths ? pixelID * spp + i : threadID);
                 sampleLightPath(getScene(),
                                 threadID, pixelID, pLightPath,
                                 maxLightPathDepth);
+
+                if(m_UseVM) {
+                    selectMergedLightVertices(threadID, pLightPath, maxLightPathDepth, storeLightPaths,
+                                              validVertexCounts(0u, threadID));
+                }
             }
         });
     });
 
-    ThreadRNG rng(*this, 0u);
-    m_DirectImportanceSampleTilePartitionning.build(
-                m_LightPathBuffer.size(),
-                getScene(),
-                getSensor(),
-                getFramebufferSize(),
-                getTileSize(),
-                getTileCount2(),
-                [&](std::size_t i) {
-                    return m_LightPathBuffer[i].m_Intersection;
-                },
-                [&](std::size_t i) {
-                    return m_LightPathBuffer[i].m_fPathPdf > 0.f;
-                },
-                rng);
-
-    // For vertex merging:
-
-    // Setup our radius, 1st iteration has aIteration == 0, thus offset
-    float radius = m_BaseRadius;
-    radius /= pow(float(m_nIterationCount + 1), 0.5f * (1 - m_RadiusAlpha));
-    // Purely for numeric stability
-    radius = max(radius, 1e-7f);
-    const float radiusSqr = sqr(radius);
+    if(storeLightPaths) {
+        ThreadRNG rng(*this, 0u);
+        m_DirectImportanceSampleTilePartitionning.build(
+                    m_LightPathBuffer.size(),
+                    getScene(),
+                    getSensor(),
+                    getFramebufferSize(),
+                    getTileSize(),
+                    getTileCount2(),
+                    [&](std::size_t i) {
+                        return m_LightPathBuffer[i].m_Intersection;
+                    },
+                    [&](std::size_t i) {
+                        return m_LightPathBuffer[i].m_fPathPdf > 0.f;
+                    },
+                    rng);
+    }
+
+    if(m_UseVM)
+    {
+        m_MergedLightVertices.clear();
+        for(auto threadID: range(getThreadCount())) {
+            const auto& selectedVertices = m_SelectedLightVerticesPerThread[threadID];
+            m_MergedLightVertices.insert(end(m_MergedLightVertices), begin(selectedVertices), end(selectedVertices));
+            for(const auto& vertex: m_StreamedLightVertices[threadID]) {
+                m_MergedLightVertices.emplace_back(&vertex);
+            }
+        }
+        m_fExpectedValidLightVertexCount = float(validVertexCounts.reduce(0u));
+
+        // The cell count is bounded by the photon budget
+        auto cellCount = m_nMaxMergedLightVertexCount ? min(m_nLightPathCount, m_nMaxMergedLightVertexCount) : m_nLightPathCount;
+        m_LightVerticesHashGrid.Reserve(max(1u, cellCount));
+        m_LightVerticesHashGrid.build(m_MergedLightVertices.data(), uint32_t(m_MergedLightVertices.size()), m_MaxRadius);
+    }
+
+    ++m_nIterationCount;
+}
+
+void VCMRenderer::initMergingState() {
+    auto pixelCount = getFramebuffer().getPixelCount();
+    m_PixelRadii.assign(pixelCount, m_BaseRadius);
+    m_PixelAccumulatedCounts.assign(pixelCount, 0.f);
+    initPixelMergedCounts();
+
+    // Before the first iteration every light vertex is assumed to be valid
+    m_fExpectedValidLightVertexCount = float(m_nLightVertexCount);
+}
+
+void VCMRenderer::initPixelMergedCounts() {
+    static const std::size_t COUNTS_PER_CACHE_LINE = CACHE_LINE_SIZE / sizeof(uint32_t);
+
+    m_MergedCountsTileSize = getTileSize();
+    m_nMergedCountsTileCountX = getTileCount2().x;
+    auto tilePixelCount = std::size_t(m_MergedCountsTileSize.x) * m_MergedCountsTileSize.y;
+    m_nMergedCountsTileStride = (tilePixelCount + COUNTS_PER_CACHE_LINE - 1) / COUNTS_PER_CACHE_LINE * COUNTS_PER_CACHE_LINE;
+    m_PixelMergedCounts.assign(getTileCount() * m_nMergedCountsTileStride, 0u);
+}
+
+void VCMRenderer::updatePixelRadii() {
+    // Pixels without merges follow the global radius reduction, so that they don't keep the base radius
+    auto globalReduction = pow(float(m_nIterationCount) / (m_nIterationCount + 1), 0.5f * (1 - m_RadiusAlpha));
+
+    processTasks(getFramebuffer().getPixelCount(), [&](uint32_t pixelID, uint32_t threadID) {
+        auto& count = m_PixelMergedCounts[getPixelMergedCountIndex(pixelID)];
+        auto mergedCount = float(count);
+        count = 0u;
+        if(mergedCount == 0.f) {
+            m_PixelRadii[pixelID] = max(m_PixelRadii[pixelID] * globalReduction, 1e-7f);
+            return;
+        }
+        // [Hachisuka and Jensen 2009]: only a fraction alpha of the new light vertices is kept at each iteration
+        auto accumulatedCount = m_PixelAccumulatedCounts[pixelID];
+        auto newAccumulatedCount = accumulatedCount + m_RadiusAlpha * mergedCount;
+        auto radius = m_PixelRadii[pixelID] * sqrt(newAccumulatedCount / (accumulatedCount + mergedCount));
+        // Purely for numeric stability
+        m_PixelRadii[pixelID] = max(radius, 1e-7f);
+        m_PixelAccumulatedCounts[pixelID] = newAccumulatedCount;
+    }, getThreadCount());
+}
+
+void VCMRenderer::setupMergingRadius() {
+    // MIS weights of all strategies must use the same radius to sum to one, the mean merging area is used
+    // when each pixel has its own radius
+    auto radiusSqr = 0.f;
+    if(m_bUseAdaptiveRadius) {
+        // The maximum would be set by a few outliers, the grid is built with a percentile of the radii instead
+        m_SortedPixelRadii.assign(begin(m_PixelRadii), end(m_PixelRadii));
+        auto percentile = begin(m_SortedPixelRadii) + std::size_t(clamp(m_fGridRadiusPercentile, 0.f, 1.f) * (m_SortedPixelRadii.size() - 1));
+        std::nth_element(begin(m_SortedPixelRadii), percentile, end(m_SortedPixelRadii));
+        m_MaxRadius = max(*percentile, 1e-7f);
+
+        auto sumRadiusSqr = 0.;
+        for(auto& radius: m_PixelRadii) {
+            radius = min(radius, m_MaxRadius);
+            sumRadiusSqr += sqr(radius);
+        }
+        radiusSqr = float(sumRadiusSqr / m_PixelRadii.size());
+    } else {
+        // Setup our radius, 1st iteration has aIteration == 0, thus offset
+        float radius = m_BaseRadius;
+        radius /= pow(float(m_nIterationCount + 1), 0.5f * (1 - m_RadiusAlpha));
+        // Purely for numeric stability
+        m_MaxRadius = max(radius, 1e-7f);
+        radiusSqr = sqr(m_MaxRadius);
+    }
+
+    // Each light vertex is selected for merging with the same probability, chosen to fit the photon budget
+    m_fLightVertexSelectionProbability = 1.f;
+    if(m_UseVM && m_nMaxMergedLightVertexCount > 0u && m_fExpectedValidLightVertexCount > m_nMaxMergedLightVertexCount) {
+        m_fLightVertexSelectionProbability = m_nMaxMergedLightVertexCount / m_fExpectedValidLightVertexCount;
+    }
 
     // Factor used to normalise vertex merging contribution.
-    // We divide the summed up energy by disk radius and number of light paths
-    m_VmNormalization = 1.f / (radiusSqr * pi<float>() * m_nLightPathCount);
+    // We divide the summed up energy by the number of selected light paths, and by the disk area at each merge
+    m_VmNormalization = 1.f / (m_fLightVertexSelectionProbability * m_nLightPathCount);
 
-    // MIS weight constant [tech. rep. (20)], with n_VC = 1 and n_VM = mLightPathCount
-    const float etaVCM = (pi<float>() * radiusSqr) * m_nLightPathCount;
+    // MIS weight constant [tech. rep. (20)], with n_VC = 1 and n_VM = mLightPathCount * selection probability
+    const float etaVCM = (pi<float>() * radiusSqr) * m_nLightPathCount * m_fLightVertexSelectionProbability;
 
     m_MisVmWeightFactor = m_UseVM ? Mis(etaVCM)       : 0.f;
     m_MisVcWeightFactor = m_UseVC ? Mis(1.f / etaVCM) : 0.f;
+}
 
-    if(m_UseVM)
-    {
-        m_LightVerticesHashGrid.Reserve(m_nLightPathCount);
-        m_LightVerticesHashGrid.build(m_LightPathBuffer.data(), m_nLightVertexCount, radius);
+void VCMRenderer::selectMergedLightVertices(uint32_t threadID, const PathVertex* pLightPath, uint32_t maxLightPathDepth,
+                                            bool storeLightPaths, uint64_t& validVertexCount) {
+    for(auto i = 0u; i < maxLightPathDepth; ++i) {
+        const auto& vertex = pLightPath[i];
+        if(!isValid(vertex)) {
+            continue;
+        }
+        ++validVertexCount;
+        if(m_fLightVertexSelectionProbability < 1.f && getFloat(threadID) >= m_fLightVertexSelectionProbability) {
+            continue;
+        }
+        if(storeLightPaths) {
+            m_SelectedLightVerticesPerThread[threadID].emplace_back(&vertex);
+        } else {
+            m_StreamedLightVertices[threadID].emplace_back(vertex);
+        }
     }
-
-    ++m_nIterationCount;
 }
 
 void VCMRenderer::processTile(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const {
@@ -152,12 +283,17 @@ void VCMRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sa
         return;
     }
 
-    auto pLightPath = m_LightPathBuffer.data() + pixelID * getMaxLightPathDepth() * getSppCount() + sampleID * getMaxLightPathDepth();
+    // The light paths are only kept for vertex connection
+    auto pLightPath = m_UseVC ?
+                m_LightPathBuffer.data() + pixelID * getMaxLightPathDepth() * getSppCount() + sampleID * getMaxLightPathDepth() :
+                nullptr;
 
     PathVertex previousEyeVertex;
 
     float lightPdf;
-    auto pLight = m_LightSampler.sample(getScene(), getFloat(threadID), lightPdf);
+    uint32_t lightID;
+    auto pLight = m_LightSampler.sample(getScene(), getFloat(threadID), lightPdf, &lightID);
+    auto emissionLightPdf = lightPdf;
 
     auto maxEyePathDepth = getMaxEyePathDepth();
 
@@ -189,7 +325,6 @@ void VCMRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sa
                         (1.f + previousEyeVertex.m_fdVCM * m_MisVcWeightFactor + Mis(reversePdf) * previousEyeVertex.m_fdVM);
             }
         }
-        previousEyeVertex = eyePathVertex;
 
         // PPM merges only at the first non-specular surface from camera
         if(eyeVertexIndex > 0u && m_Ppm && !(eyePathVertex.m_nScatteringEvent & ScatteringEvent::Specular)) {
@@ -199,7 +334,7 @@ void VCMRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sa
         { // Intersection with light source
             auto totalLength = eyePathVertex.m_nDepth;
             if(acceptPathDepth(totalLength) && totalLength <= m_nMaxDepth) {
-                computeEmittedRadiance(threadID, pixelID, sampleID, x, y, eyePathVertex);
+                computeEmittedRadiance(threadID, pixelID, sampleID, x, y, eyePathVertex, previousEyeVertex);
                 if(m_LightTraceOnly) {
                     break;
                 }
@@ -207,7 +342,11 @@ void VCMRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sa
         }
 
         if(m_UseVC && !eyePathVertex.m_BSDF.isDelta()) {
-            vertexConnection(threadID, pixelID, sampleID, x, y, pLight, lightPdf, pLightPath, eyePathVertex);
+            if(m_bUseLightBVH) {
+                pLight = m_LightBVHSampler.sample(getScene(), eyePathVertex.m_Intersection, getFloat(threadID), lightPdf, &lightID);
+                emissionLightPdf = pLight ? m_LightSampler.pdf(lightID) : 0.f;
+            }
+            vertexConnection(threadID, pixelID, sampleID, x, y, pLight, lightPdf, emissionLightPdf, pLightPath, eyePathVertex);
         }
 
         // Vertex merging
@@ -218,6 +357,8 @@ void VCMRenderer::processSample(uint32_t threadID, uint32_t pixelID, uint32_t sa
         if(vertex.length() == maxEyePathDepth) {
             break;
         }
+
+        previousEyeVertex = eyePathVertex;
     }
 }
 
@@ -229,7 +370,18 @@ void VCMRenderer::sampleLightPath(
 
     if(maxLightPathDepth > 0u) {
         ThreadRNG rng(*this, threadID);
-        for(const auto& vertex: makeLightPath(getScene(), m_LightSampler, rng)) {
+
+        // Same as makeLightPath, but we need the light to compute the MIS weight of the direct illumination strategy
+        const Light* pLight = nullptr;
+        float lightPdf, positionPdfGivenLight;
+        uint32_t lightID;
+        auto lightSample = rng.getFloat();
+        auto positionSample = rng.getFloat2();
+        auto dirSample = rng.getFloat2();
+        auto primaryVertex = samplePrimaryLightVertex(getScene(), m_LightSampler, lightSample, positionSample, dirSample,
+                                                      pLight, lightPdf, positionPdfGivenLight, &lightID);
+
+        for(const auto& vertex: makePath(getScene(), primaryVertex, rng)) {
             auto idx = vertex.length() - 1u;
 
             pLightPath[idx].init(vertex);
@@ -253,7 +405,9 @@ void VCMRenderer::sampleLightPath(
                             (1.f + previousVertex.m_fdVCM * m_MisVcWeightFactor + Mis(reversePdf) * previousVertex.m_fdVM);
                 }
             } else {
-                pLightPath[idx].m_fdVCM = Mis(getSppCount() / pLightPath[idx].m_fPdfWrtArea);
+                // The direct illumination strategy can choose the light with another probability than the emission
+                auto directLightPdfRatio = m_bUseLightBVH ? m_LightBVHSampler.pdf(pLightPath[idx].m_Intersection, lightID) / lightPdf : 1.f;
+                pLightPath[idx].m_fdVCM = Mis(getSppCount() * directLightPdfRatio / pLightPath[idx].m_fPdfWrtArea);
                 pLightPath[idx].m_fdVC = Mis(g / pLightPath[idx].m_fPathPdf);
                 pLightPath[idx].m_fdVC = pLightPath[idx].m_fdVC * m_MisVcWeightFactor;
             }
@@ -266,7 +420,8 @@ void VCMRenderer::sampleLightPath(
 }
 
 void VCMRenderer::computeEmittedRadiance(uint32_t threadID, uint32_t pixelID, uint32_t sampleID,
-                                                              uint32_t x, uint32_t y, const PathVertex& eyeVertex) const {
+                                                              uint32_t x, uint32_t y, const PathVertex& eyeVertex,
+                                                              const PathVertex& previousEyeVertex) const {
     if(eyeVertex.m_Intersection.Le == zero<Vec3f>()) {
         return;
     }
@@ -289,9 +444,14 @@ void VCMRenderer::computeEmittedRadiance(uint32_t threadID, uint32_t pixelID, ui
             pAreaLight->pdf(eyeVertex.m_Intersection, eyeVertex.m_BSDF.getIncidentDirection(), getScene(),
                             pointPdfWrtArea, directionPdfWrtSolidAngle);
 
-            pointPdfWrtArea *= m_LightSampler.pdf(lightID);
+            // The light can be chosen with different probabilities for emission and direct illumination
+            auto emissionPdfWrtArea = pointPdfWrtArea * m_LightSampler.pdf(lightID);
+            auto directPdfWrtArea = m_bUseLightBVH ?
+                        pointPdfWrtArea * m_LightBVHSampler.pdf(previousEyeVertex.m_Intersection, lightID) :
+                        emissionPdfWrtArea;
 
-            rcpWeight += Mis(pointPdfWrtArea / getSppCount()) * (eyeVertex.m_fdVCM + Mis(directionPdfWrtSolidAngle) * eyeVertex.m_fdVC);
+            rcpWeight += Mis(directPdfWrtArea / getSppCount()) * eyeVertex.m_fdVCM +
+                    Mis(emissionPdfWrtArea / getSppCount()) * Mis(directionPdfWrtSolidAngle) * eyeVertex.m_fdVC;
         }
     }
 
@@ -304,7 +464,7 @@ void VCMRenderer::computeEmittedRadiance(uint32_t threadID, uint32_t pixelID, ui
 
 void VCMRenderer::computeDirectIllumination(uint32_t threadID, uint32_t pixelID, uint32_t sampleID,
                                uint32_t x, uint32_t y, const PathVertex& eyeVertex,
-                               const Light& light, float lightPdf) const {
+                               const Light& light, float lightPdf, float emissionLightPdf) const {
     float sampledPointPdfWrtArea, sampledPointToIncidentDirectionJacobian, revPdfWrtArea;
     RaySample shadowRay;
     auto positionSample = getFloat2(threadID);
@@ -337,6 +497,9 @@ void VCMRenderer::computeDirectIllumination(uint32_t threadID, uint32_t pixelID,
        rcpWeight += Mis(pdfWrtArea / (getSppCount() * sampledPointPdfWrtArea));
     }
 
+    // Light paths choose the light with emissionLightPdf instead of lightPdf
+    revPdfWrtArea *= emissionLightPdf / lightPdf;
+
     rcpWeight += Mis(revPdfWrtArea / getSppCount()) * (m_MisVmWeightFactor + eyeVertex.m_fdVCM + Mis(eyeRevPdf) * eyeVertex.m_fdVC);
 
     auto weight = 1.f / rcpWeight;
@@ -389,12 +552,12 @@ void VCMRenderer::connectVertices(uint32_t threadID, uint32_t pixelID, uint32_t
 }
 
 void VCMRenderer::vertexConnection(uint32_t threadID, uint32_t pixelID, uint32_t sampleID, uint32_t x, uint32_t y,
-                                const Light* pLight, float lightPdf, const PathVertex* pLightPath,
+                                const Light* pLight, float lightPdf, float emissionLightPdf, const PathVertex* pLightPath,
                                 const PathVertex& eyeVertex) const {
     { // Direct illumination
         auto totalLength = eyeVertex.m_nDepth + 1;
         if(pLight && lightPdf && acceptPathDepth(totalLength) && totalLength <= m_nMaxDepth) {
-            computeDirectIllumination(threadID, pixelID, sampleID, x, y, eyeVertex, *pLight, lightPdf);
+            computeDirectIllumination(threadID, pixelID, sampleID, x, y, eyeVertex, *pLight, lightPdf, emissionLightPdf);
         }
     }
 
@@ -412,7 +575,11 @@ void VCMRenderer::vertexConnection(uint32_t threadID, uint32_t pixelID, uint32_t
 
 void VCMRenderer::vertexMerging(uint32_t threadID, uint32_t pixelID, uint32_t sampleID, const PathVertex& eyeVertex) const {
     auto vmContrib = zero<Vec3f>();
-    auto query = [&](const PathVertex& lightPathVertex) {
+    auto radius = getMergingRadius(pixelID);
+    auto vmNormalization = m_VmNormalization / (pi<float>() * sqr(radius));
+    auto query = [&](const PathVertex* pLightPathVertex) {
+        const auto& lightPathVertex = *pLightPathVertex;
+
         // Reject if full path length below/above min/max path length
         auto totalDepth = lightPathVertex.m_nDepth + eyeVertex.m_nDepth;
         if(!acceptPathDepth(totalDepth) || totalDepth > m_nMaxDepth) {
@@ -454,11 +621,14 @@ void VCMRenderer::vertexMerging(uint32_t threadID, uint32_t pixelID, uint32_t sa
         auto contrib = misWeight * fr * lightPathVertex.m_Power;
         vmContrib += contrib;
 
-        accumulate(totalDepth, pixelID, Vec4f(eyeVertex.m_Power * m_VmNormalization * contrib, 0.f));
+        accumulate(totalDepth, pixelID, Vec4f(eyeVertex.m_Power * vmNormalization * contrib, 0.f));
     };
 
-    m_LightVerticesHashGrid.process(m_LightPathBuffer.data(), getPosition(eyeVertex), query);
-    accumulate(0u, pixelID, Vec4f(eyeVertex.m_Power * m_VmNormalization * vmContrib, 0.f));
+    auto foundCount = m_LightVerticesHashGrid.process(m_MergedLightVertices.data(), getPosition(eyeVertex), radius, query);
+    if(foundCount > 0) {
+        m_PixelMergedCounts[getPixelMergedCountIndex(pixelID)] += foundCount;
+    }
+    accumulate(0u, pixelID, Vec4f(eyeVertex.m_Power * vmNormalization * vmContrib, 0.f));
 }
 
 void VCMRenderer::connectLightVerticesToCamera(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const {
@@ -539,6 +709,11 @@ void VCMRenderer::doExposeIO(GUI& gui) {
     gui.addVarRW(BNZ_GUI_VAR(m_RadiusAlpha));
     const char* algorithms[] = { "kLightTrace", "kPpm", "kBpm", "kBpt", "kVcm" };
     gui.addRadioButtons("algorithm", m_AlgorithmType, 5, algorithms);
+    gui.addVarRW(BNZ_GUI_VAR(m_bUseLightBVH));
+    gui.addVarRW(BNZ_GUI_VAR(m_bUseAdaptiveRadius));
+    gui.addVarRW(BNZ_GUI_VAR(m_fGridRadiusPercentile));
+    gui.addVarRW(BNZ_GUI_VAR(m_nMaxMergedLightVertexCount));
+    gui.addValue(BNZ_GUI_VAR(m_fLightVertexSelectionProbability));
 }
 
 void VCMRenderer::doLoadSettings(const tinyxml2::XMLElement& xml) {
@@ -548,6 +723,10 @@ void VCMRenderer::doLoadSettings(const tinyxml2::XMLElement& xml) {
     setAlgorithmType(algorithmType);
     serialize(xml, "radiusFactor", m_RadiusFactor);
     serialize(xml, "radiusAlpha", m_RadiusAlpha);
+    serialize(xml, "useLightBVH", m_bUseLightBVH);
+    serialize(xml, "useAdaptiveRadius", m_bUseAdaptiveRadius);
+    serialize(xml, "gridRadiusPercentile", m_fGridRadiusPercentile);
+    serialize(xml, "maxMergedLightVertexCount", m_nMaxMergedLightVertexCount);
 }
 
 void VCMRenderer::doStoreSettings(tinyxml2::XMLElement& xml) const {
@@ -555,6 +734,10 @@ void VCMRenderer::doStoreSettings(tinyxml2::XMLElement& xml) const {
     serialize(xml, "algorithmType", getAlgorithmType());
     serialize(xml, "radiusFactor", m_RadiusFactor);
     serialize(xml, "radiusAlpha", m_RadiusAlpha);
+    serialize(xml, "useLightBVH", m_bUseLightBVH);
+    serialize(xml, "useAdaptiveRadius", m_bUseAdaptiveRadius);
+    serialize(xml, "gridRadiusPercentile", m_fGridRadiusPercentile);
+    serialize(xml, "maxMergedLightVertexCount", m_nMaxMergedLightVertexCount);
 }
 
 void VCMRenderer::initFramebuffer() {
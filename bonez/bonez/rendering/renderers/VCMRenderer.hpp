@@ -7,6 +7,7 @@
 #include <bonez/sampling/shapes.hpp>
 #include <bonez/sampling/patterns.hpp>
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
+#include <bonez/scene/lights/LightBVHSampler.hpp>
 #include <bonez/scene/shading/BSDF.hpp>
 
 #include <bonez/opengl/debug/GLDebugRenderer.hpp>
@@ -60,23 +61,55 @@ class VCMRenderer: public TileProcessingRenderer {
     void connectLightVerticesToCamera(uint32_t threadID, uint32_t tileID, const Vec4u& viewport) const;
 
     void computeEmittedRadiance(uint32_t threadID, uint32_t pixelID, uint32_t sampleID,
-                           uint32_t x, uint32_t y, const PathVertex& eyeVertex) const;
+                           uint32_t x, uint32_t y, const PathVertex& eyeVertex,
+                           const PathVertex& previousEyeVertex) const;
 
+    // lightPdf is the probability of having chosen the light for direct illumination,
+    // emissionLightPdf the probability of choosing it to emit a light path
     void computeDirectIllumination(uint32_t threadID, uint32_t pixelID, uint32_t sampleID,
                                    uint32_t x, uint32_t y, const PathVertex& eyeVertex,
-                                   const Light& light, float lightPdf) const;
+                                   const Light& light, float lightPdf, float emissionLightPdf) const;
 
     void connectVertices(uint32_t threadID, uint32_t pixelID, uint32_t sampleID,
                          uint32_t x, uint32_t y, const PathVertex& eyeVertex,
                          const PathVertex& lightVertex) const;
 
     void vertexConnection(uint32_t threadID, uint32_t pixelID, uint32_t sampleID, uint32_t x, uint32_t y,
-                                    const Light* pLight, float lightPdf, const PathVertex* pLightPath,
+                                    const Light* pLight, float lightPdf, float emissionLightPdf, const PathVertex* pLightPath,
                                     const PathVertex& eyeVertex) const;
 
     void vertexMerging(uint32_t threadID, uint32_t pixelID, uint32_t sampleID,
                                      const PathVertex& eyeVertex) const;
 
+    // Reset the per-pixel radii and the photon budget statistics, at the first iteration
+    void initMergingState();
+
+    // Reduce the radius of each pixel according to the light vertices found by its merges during the previous iteration
+    void updatePixelRadii();
+
+    // Compute the radii, the light vertex selection probability, the normalization and the MIS factors of the iteration
+    void setupMergingRadius();
+
+    // Add the light vertices of a light path selected for merging to the light vertices of the thread.
+    // If the light path buffer is not kept for the iteration, the selected vertices are copied.
+    void selectMergedLightVertices(uint32_t threadID, const PathVertex* pLightPath, uint32_t maxLightPathDepth,
+                                   bool storeLightPaths, uint64_t& validVertexCount);
+
+    float getMergingRadius(uint32_t pixelID) const {
+        return m_bUseAdaptiveRadius ? m_PixelRadii[pixelID] : m_MaxRadius;
+    }
+
+    // Lay out the merged light vertex counts per tile of m_MergedCountsTileSize, each tile on its own cache lines
+    void initPixelMergedCounts();
+
+    // Index of the merged light vertex count of a pixel, the pixels of a tile are processed by the same thread
+    std::size_t getPixelMergedCountIndex(uint32_t pixelID) const {
+        auto x = pixelID % getFramebufferSize().x;
+        auto y = pixelID / getFramebufferSize().x;
+        auto tileID = x / m_MergedCountsTileSize.x + (y / m_MergedCountsTileSize.y) * m_nMergedCountsTileCountX;
+        return tileID * m_nMergedCountsTileStride + (x % m_MergedCountsTileSize.x) + (y % m_MergedCountsTileSize.y) * m_MergedCountsTileSize.x;
+    }
+
     friend const Vec3f& getPosition(const PathVertex& pathVertex) {
         return pathVertex.m_Intersection.P;
     }
@@ -85,6 +118,15 @@ class VCMRenderer: public TileProcessingRenderer {
         return pathVertex.m_fPathPdf > 0.f;
     }
 
+    // The hash grid is built on the light vertices selected for merging
+    friend const Vec3f& getPosition(const PathVertex* pPathVertex) {
+        return pPathVertex->m_Intersection.P;
+    }
+
+    friend bool isValid(const PathVertex* pPathVertex) {
+        return pPathVertex->m_fPathPdf > 0.f;
+    }
+
     float Mis(float pdf) const {
         return pdf; // Balance heuristic
     }
@@ -107,9 +149,12 @@ class VCMRenderer: public TileProcessingRenderer {
 
     uint32_t m_nMaxDepth = 3;
 
+    bool m_bUseLightBVH = false; // Choose the light of the direct illumination strategy with m_LightBVHSampler
+
     PowerBasedLightSampler m_LightSampler;
+    LightBVHSampler m_LightBVHSampler;
 
-    Array2d<PathVertex> m_LightPathBuffer;
+    Array2d<PathVertex> m_LightPathBuffer { MemoryTag::LightVertices };
     DirectImportanceSampleTilePartionning m_DirectImportanceSampleTilePartitionning;
 
     uint32_t m_nLightPathCount;
@@ -117,6 +162,15 @@ class VCMRenderer: public TileProcessingRenderer {
 
     HashGrid m_LightVerticesHashGrid;
 
+    using LightVertexVector = std::vector<PathVertex, TrackedAllocator<PathVertex>>;
+
+    // Light vertices merged by the current iteration, a random subset of the light vertices when the photon budget
+    // is exceeded. They point to m_LightPathBuffer, or to m_StreamedLightVertices when the light paths are not kept
+    // (vertex merging without connections).
+    std::vector<const PathVertex*> m_MergedLightVertices;
+    std::vector<std::vector<const PathVertex*>> m_SelectedLightVerticesPerThread;
+    std::vector<LightVertexVector> m_StreamedLightVertices; // Per thread
+
     enum AlgorithmType
     {
         // light vertices contribute to camera,
@@ -153,7 +207,27 @@ class VCMRenderer: public TileProcessingRenderer {
     float m_BaseRadius;        // Initial merging radius
     float m_MisVmWeightFactor; // Weight of vertex merging (used in VC)
     float m_MisVcWeightFactor; // Weight of vertex connection (used in VM)
-    float m_VmNormalization;   // 1 / (Pi * radius^2 * light_path_count)
+    float m_VmNormalization;   // 1 / (light_path_count * selection probability), divided by Pi * radius^2 at each merge
+    float m_MaxRadius;         // Largest merging radius of the iteration, used to build the hash grid
+
+    // Photon budget: maximal number of light vertices merged by an iteration, 0 for no limit.
+    // Each light vertex is selected with the same probability and the merges are weighted by its inverse.
+    uint32_t m_nMaxMergedLightVertexCount = 0u;
+    float m_fLightVertexSelectionProbability = 1.f;
+    float m_fExpectedValidLightVertexCount; // Valid light vertices of the previous iteration
+
+    // Adaptive radius: each pixel reduces its radius as in stochastic progressive photon mapping,
+    // according to the number of light vertices found by its merges
+    bool m_bUseAdaptiveRadius = false;
+    float m_fGridRadiusPercentile = 0.9f; // Percentile of the radii used to build the hash grid, larger radii are clamped to it
+    std::vector<float> m_PixelRadii;
+    std::vector<float> m_PixelAccumulatedCounts;
+    std::vector<float> m_SortedPixelRadii; // Scratch buffer for the percentile
+    // Light vertices found during the current iteration, stored per tile: see getPixelMergedCountIndex
+    mutable std::vector<uint32_t> m_PixelMergedCounts;
+    Vec2u m_MergedCountsTileSize = Vec2u(0u);
+    uint32_t m_nMergedCountsTileCountX = 0u;
+    std::size_t m_nMergedCountsTileStride = 0u;
 
     uint32_t m_nIterationCount = 0u;
 };
@@ -288,38 +288,22 @@ void BDPTImportanceCachingRenderer::computeLightVertexDistributions() {
 
     m_ImportanceCache.setEnabledDistributions(m_sDistributionSelector);
 
-    auto evalContrib = [&](uint32_t pathIdx, std::size_t depth, uint32_t importanceRecordID) {
+    // Unoccluded contributions of the vertices of depth of count consecutive paths, by blocks for BSDF::evalBatch
+    auto evalUnoccluded = [&](uint32_t firstPathIdx, std::size_t count, std::size_t depth, uint32_t importanceRecordID,
+                              float* contributions, Ray* shadowRays) {
         const auto& importanceRecord = m_ImportanceRecordContainer[importanceRecordID];
 
         if(depth == size_t(0)) {
             // EmissionVertex
-            const auto& vertex = m_EmissionVertexBuffer[pathIdx];
-            return vertex.m_fLightPdf == 0.f ? 0.f : luminance(evalContribution(vertex, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-        }
-
-        auto vertexIdx = depth - 1 + pathIdx * maxLightPathDepth;
-        if(m_LightPathBuffer[vertexIdx].m_fPathPdf == 0.f) {
-            return 0.f;
-        }
-
-        return luminance(evalContribution(m_LightPathBuffer[vertexIdx], importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-    };
-
-    auto evalUnoccluded = [&](uint32_t pathIdx, std::size_t depth, uint32_t importanceRecordID) {
-        const auto& importanceRecord = m_ImportanceRecordContainer[importanceRecordID];
-
-        if(depth == size_t(0)) {
-            // EmissionVertex
-            const auto& vertex = m_EmissionVertexBuffer[pathIdx];
-            return vertex.m_fLightPdf == 0.f ? 0.f : luminance(evalUnoccludedContribution(vertex, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-        }
-
-        auto vertexIdx = depth - 1 + pathIdx * maxLightPathDepth;
-        if(m_LightPathBuffer[vertexIdx].m_fPathPdf == 0.f) {
-            return 0.f;
+            for(auto i = 0u; i < count; ++i) {
+                const auto& vertex = m_EmissionVertexBuffer[firstPathIdx + i];
+                contributions[i] = vertex.m_fLightPdf == 0.f ? 0.f : luminance(evalUnoccludedContribution(vertex, importanceRecord.m_Intersection, importanceRecord.m_BSDF, shadowRays[i]));
+            }
+            return;
         }
 
-        return luminance(evalUnoccludedContribution(m_LightPathBuffer[vertexIdx], importanceRecord.m_Intersection, importanceRecord.m_BSDF));
+        evalUnoccludedContributions(&m_LightPathBuffer[depth - 1 + firstPathIdx * maxLightPathDepth], maxLightPathDepth, count,
+                                    importanceRecord.m_Intersection, importanceRecord.m_BSDF, contributions, shadowRays);
     };
 
     auto evalBounded = [&](uint32_t pathIdx, std::size_t depth, uint32_t importanceRecordID) {
@@ -356,16 +340,16 @@ void BDPTImportanceCachingRenderer::computeLightVertexDistributions() {
 
     auto bOptimize = m_bUseAlphaMaxHeuristic && m_bUseDistributionWeightingOptimization;
 
-    m_ImportanceCache.buildDistributions(m_ImportanceRecordContainer.size(),
-                                         m_nPerImportanceCacheLightPathCount,
-                                         getMaxLightPathDepth(),
-                                         evalContrib,
-                                         evalUnoccluded,
-                                         evalBounded,
-                                         evalConservative,
-                                         m_AlphaConfidenceValues,
-                                         getThreadCount(),
-                                         bOptimize);
+    m_ImportanceCache.buildBatchedDistributions(m_ImportanceRecordContainer.size(),
+                                                m_nPerImportanceCacheLightPathCount,
+                                                getMaxLightPathDepth(),
+                                                getScene(),
+                                                evalUnoccluded,
+                                                evalBounded,
+                                                evalConservative,
+                                                m_AlphaConfidenceValues,
+                                                getThreadCount(),
+                                                bOptimize);
 }
 
 void BDPTImportanceCachingRenderer::computeImportanceRecords() {
@@ -523,12 +507,18 @@ Vec3f BDPTImportanceCachingRenderer::evalContribution(const PathVertex& lightVer
 }
 
 Vec3f BDPTImportanceCachingRenderer::evalUnoccludedContribution(const PathVertex& lightVertex, const SurfacePoint& I, const BSDF& bsdf) const {
+    Ray shadowRay;
+    return evalUnoccludedContribution(lightVertex, I, bsdf, shadowRay);
+}
+
+Vec3f BDPTImportanceCachingRenderer::evalUnoccludedContribution(const PathVertex& lightVertex, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const {
     Vec3f wi;
     float dist;
     auto G = geometricFactor(I, lightVertex.m_Intersection, wi, dist);
     if(G > 0.f) {
         float cosThetaOutVPL, costThetaOutBSDF;
         auto M = bsdf.eval(wi, costThetaOutBSDF) * lightVertex.m_BSDF.eval(-wi, cosThetaOutVPL);
+        shadowRay = Ray(I, lightVertex.m_Intersection, wi, dist);
         return M * G * lightVertex.m_Power;
     }
     return zero<Vec3f>();
@@ -580,14 +570,20 @@ Vec3f BDPTImportanceCachingRenderer::evalContribution(const EmissionVertex& vert
 }
 
 Vec3f BDPTImportanceCachingRenderer::evalUnoccludedContribution(const EmissionVertex& vertex, const SurfacePoint& I, const BSDF& bsdf) const {
-    RaySample shadowRay;
-    auto Le = vertex.m_pLight->sampleDirectIllumination(getScene(), vertex.m_PositionSample, I, shadowRay);
+    Ray shadowRay;
+    return evalUnoccludedContribution(vertex, I, bsdf, shadowRay);
+}
 
-    if(Le != zero<Vec3f>() && shadowRay.pdf) {
-        shadowRay.pdf *= vertex.m_fLightPdf;
+Vec3f BDPTImportanceCachingRenderer::evalUnoccludedContribution(const EmissionVertex& vertex, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const {
+    RaySample shadowRaySample;
+    auto Le = vertex.m_pLight->sampleDirectIllumination(getScene(), vertex.m_PositionSample, I, shadowRaySample);
+
+    if(Le != zero<Vec3f>() && shadowRaySample.pdf) {
+        shadowRaySample.pdf *= vertex.m_fLightPdf;
         float cosThetaOutDir;
-        auto fr = bsdf.eval(shadowRay.value.dir, cosThetaOutDir);
-        return Le * fr * abs(cosThetaOutDir) / shadowRay.pdf;
+        auto fr = bsdf.eval(shadowRaySample.value.dir, cosThetaOutDir);
+        shadowRay = shadowRaySample.value;
+        return Le * fr * abs(cosThetaOutDir) / shadowRaySample.pdf;
     }
 
     return zero<Vec3f>();
@@ -45,6 +45,9 @@ private:
 
     Vec3f evalUnoccludedContribution(const PathVertex& lightVertex, const SurfacePoint& I, const BSDF& bsdf) const;
 
+    // Also fill the ray to trace to test the visibility of the light vertex
+    Vec3f evalUnoccludedContribution(const PathVertex& lightVertex, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const;
+
     float evalBoundedGeometricFactor(const PathVertex& lightVertex, const SurfacePoint& I, float radiusOfInfluence, Vec3f& wi) const;
 
     Vec3f evalBoundedContribution(const PathVertex& lightVertex, const SurfacePoint& I, float radiusOfInfluence, const BSDF& bsdf) const;
@@ -53,6 +56,8 @@ private:
 
     Vec3f evalUnoccludedContribution(const EmissionVertex& vertex, const SurfacePoint& I, const BSDF& bsdf) const;
 
+    Vec3f evalUnoccludedContribution(const EmissionVertex& vertex, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const;
+
     Vec3f evalBoundedContribution(const EmissionVertex& vertex, const SurfacePoint& I, float radiusOfInfluence, const BSDF& bsdf) const;
 
     uint32_t getMaxLightPathDepth() const {
@@ -84,7 +89,7 @@ private:
     void initFramebuffer() override;
 
     std::vector<EmissionVertex> m_EmissionVertexBuffer;
-    Array2d<PathVertex> m_LightPathBuffer;
+    Array2d<PathVertex> m_LightPathBuffer { MemoryTag::LightVertices };
 
     DirectImportanceSampleTilePartionning m_DirectImportanceSampleTilePartitionning;
 
@@ -5,6 +5,8 @@
 #include <bonez/utils/MultiDimensionalArray.hpp>
 #include <bonez/sampling/distribution1d.h>
 
+#include "ShadowRayBatch.hpp"
+
 #include <array>
 
 namespace BnZ {
@@ -41,7 +43,7 @@ public:
                             bool bOptimize) {
         m_AlphaConfidenceFactors = alphaConfidenceFactors;
         m_nVertexCount = vertexCount;
-        m_nDistributionSize = getDistribution1DBufferSize(vertexCount);
+        m_nDistributionSize = getQuantizedDistribution1DBufferSize(vertexCount);
 
         for(auto pDistribution: m_EnabledDistributions) {
             if(pDistribution) {
@@ -80,6 +82,72 @@ public:
         }, threadCount);
     }
 
+    // Same as buildDistributions, but the full contribution is deduced from the unoccluded one:
+    // evalUnoccluded(i, importanceRecordID, shadowRay) returns the unoccluded contribution of vertex i and fills the
+    // ray testing its visibility. The contributions of each importance record are evaluated once for F and U and
+    // the shadow rays are traced by packets.
+    template<typename EvalUnoccludedContributionFunctor,
+             typename EvalBoundedContributionFunctor,
+             typename EvalConservativeConstributionFunctor>
+    void buildBatchedDistributions(std::size_t importanceRecordCount,
+                                   std::size_t vertexCount,
+                                   const Scene& scene,
+                                   EvalUnoccludedContributionFunctor&& evalUnoccluded,
+                                   EvalBoundedContributionFunctor&& evalBounded,
+                                   EvalConservativeConstributionFunctor&& evalConservative,
+                                   const Vec4f& alphaConfidenceFactors,
+                                   std::size_t threadCount,
+                                   bool bOptimize) {
+        m_AlphaConfidenceFactors = alphaConfidenceFactors;
+        m_nVertexCount = vertexCount;
+        m_nDistributionSize = getQuantizedDistribution1DBufferSize(vertexCount);
+
+        for(auto pDistribution: m_EnabledDistributions) {
+            if(pDistribution) {
+                pDistribution->resize(m_nDistributionSize, importanceRecordCount);
+            }
+        }
+
+        std::vector<ShadowRayBatch> batches(threadCount);
+
+        processTasksDeterminist(importanceRecordCount, [&](uint32_t importanceRecordID, uint32_t threadID) {
+            if(m_IsDistributionEnabled[DistributionIndex::F] || m_IsDistributionEnabled[DistributionIndex::U]) {
+                auto& batch = batches[threadID];
+                batch.eval(vertexCount, [&](uint32_t i, Ray& shadowRay) {
+                    return evalUnoccluded(i, importanceRecordID, shadowRay);
+                }, scene, m_IsDistributionEnabled[DistributionIndex::F], threadID);
+
+                if(m_IsDistributionEnabled[DistributionIndex::F]) {
+                    buildDistribution1D([&](uint32_t i) {
+                        return batch.getFullContribution(i);
+                    }, m_FullContributionDistribution.getSlicePtr(importanceRecordID), vertexCount);
+                }
+
+                if(m_IsDistributionEnabled[DistributionIndex::U]) {
+                    buildDistribution1D([&](uint32_t i) {
+                        return batch.getUnoccludedContribution(i);
+                    }, m_UnoccludedContributionDistribution.getSlicePtr(importanceRecordID), vertexCount);
+                }
+            }
+
+            if(m_IsDistributionEnabled[DistributionIndex::B]) {
+                buildDistribution1D([&](uint32_t i) {
+                    return evalBounded(i, importanceRecordID);
+                }, m_BoundedContributionDistribution.getSlicePtr(importanceRecordID), vertexCount);
+            }
+
+            if(m_IsDistributionEnabled[DistributionIndex::C]) {
+                buildDistribution1D([&](uint32_t i) {
+                    return evalConservative(i, importanceRecordID);
+                }, m_ConservativeDistribution.getSlicePtr(importanceRecordID), vertexCount);
+            }
+
+            if(bOptimize) {
+                optimizeAlphaDistributions(importanceRecordID);
+            }
+        }, threadCount);
+    }
+
     std::size_t getEnabledDistributionCount() const {
         return m_nEnabledDistributionCount;
     }
@@ -105,13 +173,13 @@ private:
     std::size_t m_nDistributionSize = 0u;
     std::size_t m_nVertexCount = 0u;
 
-    Array2d<float> m_FullContributionDistribution; // "F"
-    Array2d<float> m_UnoccludedContributionDistribution; // "U"
-    Array2d<float> m_BoundedContributionDistribution; // "B"
-    Array2d<float> m_ConservativeDistribution; // "C"
+    Array2d<QuantizedCDFValue> m_FullContributionDistribution { MemoryTag::ImportanceCache }; // "F"
+    Array2d<QuantizedCDFValue> m_UnoccludedContributionDistribution { MemoryTag::ImportanceCache }; // "U"
+    Array2d<QuantizedCDFValue> m_BoundedContributionDistribution { MemoryTag::ImportanceCache }; // "B"
+    Array2d<QuantizedCDFValue> m_ConservativeDistribution { MemoryTag::ImportanceCache }; // "C"
 
     std::array<int, 4u> m_IsDistributionEnabled = {{ true, true, true ,true }};
-    std::array<Array2d<float>*, 4u> m_EnabledDistributions;
+    std::array<Array2d<QuantizedCDFValue>*, 4u> m_EnabledDistributions;
     std::size_t m_nEnabledDistributionCount = 0u;
 
     Vec4f m_AlphaConfidenceFactors = Vec4f(1.f);
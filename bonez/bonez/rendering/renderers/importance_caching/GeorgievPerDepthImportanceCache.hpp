@@ -5,6 +5,8 @@
 #include <bonez/utils/MultiDimensionalArray.hpp>
 #include <bonez/sampling/distribution1d.h>
 
+#include "ShadowRayBatch.hpp"
+
 #include <array>
 
 namespace BnZ {
@@ -43,7 +45,7 @@ public:
         m_AlphaConfidenceFactors = alphaConfidenceFactors;
         m_nPathCount = pathCount;
         m_nMaxDepth = maxDepth;
-        m_nDistributionSize = getDistribution1DBufferSize(m_nPathCount); // Each individual distribution is composed of (at most) m_nPathCount vertices
+        m_nDistributionSize = getQuantizedDistribution1DBufferSize(m_nPathCount); // Each individual distribution is composed of (at most) m_nPathCount vertices
 
         for(auto pDistribution: m_EnabledDistributions) {
             if(pDistribution) {
@@ -87,6 +89,82 @@ public:
         }, threadCount);
     }
 
+    // Same as buildDistributions, but the full contribution is deduced from the unoccluded one:
+    // evalUnoccluded(firstPathIdx, pathCount, depth, importanceRecordID, contributions, shadowRays) fills the unoccluded
+    // contributions of the vertices of depth of the pathCount paths from firstPathIdx, and the rays testing their visibility
+    // (see ShadowRayBatch::evalBlocks). The contributions of each importance record are evaluated once for F and U and
+    // the shadow rays of all depths are traced together by packets.
+    template<typename EvalUnoccludedContributionFunctor,
+             typename EvalBoundedContributionFunctor,
+             typename EvalConservativeConstributionFunctor>
+    void buildBatchedDistributions(std::size_t importanceRecordCount,
+                                   std::size_t pathCount,
+                                   std::size_t maxDepth,
+                                   const Scene& scene,
+                                   EvalUnoccludedContributionFunctor&& evalUnoccluded,
+                                   EvalBoundedContributionFunctor&& evalBounded,
+                                   EvalConservativeConstributionFunctor&& evalConservative,
+                                   const Vec4f& alphaConfidenceFactors,
+                                   std::size_t threadCount,
+                                   bool bOptimize) {
+        m_AlphaConfidenceFactors = alphaConfidenceFactors;
+        m_nPathCount = pathCount;
+        m_nMaxDepth = maxDepth;
+        m_nDistributionSize = getQuantizedDistribution1DBufferSize(m_nPathCount);
+
+        for(auto pDistribution: m_EnabledDistributions) {
+            if(pDistribution) {
+                pDistribution->resize(m_nDistributionSize * (m_nMaxDepth + 1), importanceRecordCount);
+            }
+        }
+
+        std::vector<ShadowRayBatch> batches(threadCount);
+        auto vertexCount = pathCount * (maxDepth + 1); // Vertex i has depth i / pathCount
+
+        processTasksDeterminist(importanceRecordCount, [&](uint32_t importanceRecordID, uint32_t threadID) {
+            auto& batch = batches[threadID];
+            auto bBatchEnabled = m_IsDistributionEnabled[DistributionIndex::F] || m_IsDistributionEnabled[DistributionIndex::U];
+            if(bBatchEnabled) {
+                batch.evalBlocks(vertexCount, pathCount, [&](std::size_t first, std::size_t count, float* contributions, Ray* shadowRays) {
+                    evalUnoccluded(uint32_t(first % pathCount), count, first / pathCount, importanceRecordID, contributions, shadowRays);
+                }, scene, m_IsDistributionEnabled[DistributionIndex::F], threadID);
+            }
+
+            for(auto depth: range(maxDepth + 1)) {
+                auto distribOffset = distributionOffset(depth);
+                auto batchOffset = depth * pathCount;
+
+                if(m_IsDistributionEnabled[DistributionIndex::F]) {
+                    buildDistribution1D([&](uint32_t pathIdx) {
+                        return batch.getFullContribution(batchOffset + pathIdx);
+                    }, m_FullContributionDistribution.getSlicePtr(importanceRecordID) + distribOffset, pathCount);
+                }
+
+                if(m_IsDistributionEnabled[DistributionIndex::U]) {
+                    buildDistribution1D([&](uint32_t pathIdx) {
+                        return batch.getUnoccludedContribution(batchOffset + pathIdx);
+                    }, m_UnoccludedContributionDistribution.getSlicePtr(importanceRecordID) + distribOffset, pathCount);
+                }
+
+                if(m_IsDistributionEnabled[DistributionIndex::B]) {
+                    buildDistribution1D([&](uint32_t pathIdx) {
+                        return evalBounded(pathIdx, depth, importanceRecordID);
+                    }, m_BoundedContributionDistribution.getSlicePtr(importanceRecordID) + distribOffset, pathCount);
+                }
+
+                if(m_IsDistributionEnabled[DistributionIndex::C]) {
+                    buildDistribution1D([&](uint32_t pathIdx) {
+                        return evalConservative(pathIdx, depth, importanceRecordID);
+                    }, m_ConservativeDistribution.getSlicePtr(importanceRecordID) + distribOffset, pathCount);
+                }
+            }
+
+            if(bOptimize) {
+                optimizeAlphaDistributions(importanceRecordID);
+            }
+        }, threadCount);
+    }
+
     std::size_t getEnabledDistributionCount() const {
         return m_nEnabledDistributionCount;
     }
@@ -120,13 +198,13 @@ private:
     std::size_t m_nPathCount = 0u;
     std::size_t m_nMaxDepth = 0u;
 
-    Array2d<float> m_FullContributionDistribution; // "F"
-    Array2d<float> m_UnoccludedContributionDistribution; // "U"
-    Array2d<float> m_BoundedContributionDistribution; // "B"
-    Array2d<float> m_ConservativeDistribution; // "C"
+    Array2d<QuantizedCDFValue> m_FullContributionDistribution { MemoryTag::ImportanceCache }; // "F"
+    Array2d<QuantizedCDFValue> m_UnoccludedContributionDistribution { MemoryTag::ImportanceCache }; // "U"
+    Array2d<QuantizedCDFValue> m_BoundedContributionDistribution { MemoryTag::ImportanceCache }; // "B"
+    Array2d<QuantizedCDFValue> m_ConservativeDistribution { MemoryTag::ImportanceCache }; // "C"
 
     std::array<int, 4u> m_IsDistributionEnabled = {{ true, true, true ,true }};
-    std::array<Array2d<float>*, 4u> m_EnabledDistributions;
+    std::array<Array2d<QuantizedCDFValue>*, 4u> m_EnabledDistributions;
     std::size_t m_nEnabledDistributionCount = 0u;
 
     Vec4f m_AlphaConfidenceFactors = Vec4f(1.f);
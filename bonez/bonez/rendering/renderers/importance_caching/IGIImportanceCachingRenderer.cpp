@@ -98,29 +98,17 @@ void IGIImportanceCachingRenderer::beginFrame() {
         // The total number of VPL is the number of emissive VPL (m_nPathCount) + the number of surface VPL (maxLightPathDepth * m_nPathCount)
         m_nVPLCount = m_nPathCount + maxLightPathDepth * m_nPathCount;
 
-        auto evalContrib = [&](uint32_t vplIdx, uint32_t importanceRecordIdx) {
+        auto evalUnoccluded = [&](uint32_t vplIdx, uint32_t importanceRecordIdx, Ray& shadowRay) {
             const auto& importanceRecord = m_ImportanceRecordContainer[importanceRecordIdx];
             if(vplIdx < m_nPathCount) {
                 // EmissionVPL
                 const auto& vpl = m_EmissionVPLBuffer[vplIdx];
-                return vpl.lightPdf == 0.f ? 0.f : luminance(evalVPLContribution(vpl, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
+                return vpl.lightPdf == 0.f ? 0.f : luminance(evalUnoccludedVPLContribution(vpl, importanceRecord.m_Intersection, importanceRecord.m_BSDF, shadowRay));
             }
             // SurfaceVPL
             vplIdx -= m_nPathCount;
             const auto& vpl = m_SurfaceVPLBuffer[vplIdx];
-            return vpl.pdf == 0.f ? 0.f : luminance(evalVPLContribution(vpl, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-        };
-        auto evalUnoccluded = [&](uint32_t vplIdx, uint32_t importanceRecordIdx) {
-            const auto& importanceRecord = m_ImportanceRecordContainer[importanceRecordIdx];
-            if(vplIdx < m_nPathCount) {
-                // EmissionVPL
-                const auto& vpl = m_EmissionVPLBuffer[vplIdx];
-                return vpl.lightPdf == 0.f ? 0.f : luminance(evalUnoccludedVPLContribution(vpl, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
-            }
-            // SurfaceVPL
-            vplIdx -= m_nPathCount;
-            const auto& vpl = m_SurfaceVPLBuffer[vplIdx];
-            return vpl.pdf == 0.f ? 0.f : luminance(evalUnoccludedVPLContribution(vpl, importanceRecord.m_Intersection, importanceRecord.m_BSDF));
+            return vpl.pdf == 0.f ? 0.f : luminance(evalUnoccludedVPLContribution(vpl, importanceRecord.m_Intersection, importanceRecord.m_BSDF, shadowRay));
         };
         auto evalBounded = [&](uint32_t vplIdx, uint32_t importanceRecordIdx) {
             const auto& importanceRecord = m_ImportanceRecordContainer[importanceRecordIdx];
@@ -150,8 +138,8 @@ void IGIImportanceCachingRenderer::beginFrame() {
         };
 
         auto bOptimize = m_bUseAlphaMaxHeuristic && m_bUseDistributionWeightingOptimization;
-        m_ImportanceCache.buildDistributions(m_ImportanceRecordContainer.size(), m_nVPLCount, evalContrib, evalUnoccluded, evalBounded,
-                                             evalConservative, m_AlphaConfidenceValues, getThreadCount(), bOptimize);
+        m_ImportanceCache.buildBatchedDistributions(m_ImportanceRecordContainer.size(), m_nVPLCount, getScene(), evalUnoccluded, evalBounded,
+                                                    evalConservative, m_AlphaConfidenceValues, getThreadCount(), bOptimize);
     }
 
     m_ShadingPointIRBuffer.resize(m_nIRCountPerShadingPoint, getThreadCount());
@@ -269,12 +257,18 @@ Vec3f IGIImportanceCachingRenderer::evalVPLContribution(const SurfaceVPL& vpl, c
 }
 
 Vec3f IGIImportanceCachingRenderer::evalUnoccludedVPLContribution(const SurfaceVPL& vpl, const SurfacePoint& I, const BSDF& bsdf) const {
+    Ray shadowRay;
+    return evalUnoccludedVPLContribution(vpl, I, bsdf, shadowRay);
+}
+
+Vec3f IGIImportanceCachingRenderer::evalUnoccludedVPLContribution(const SurfaceVPL& vpl, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const {
     Vec3f wi;
     float dist;
     auto G = geometricFactor(I, vpl.lastVertex, wi, dist);
     if(G > 0.f) {
         float cosThetaOutVPL, costThetaOutBSDF;
         auto M = bsdf.eval(wi, costThetaOutBSDF) * vpl.lastVertexBSDF.eval(-wi, cosThetaOutVPL);
+        shadowRay = Ray(I, vpl.lastVertex, wi, dist);
         return M * G * vpl.power;
     }
     return zero<Vec3f>();
@@ -327,14 +321,20 @@ Vec3f IGIImportanceCachingRenderer::evalVPLContribution(const EmissionVPL& vpl,
 }
 
 Vec3f IGIImportanceCachingRenderer::evalUnoccludedVPLContribution(const EmissionVPL& vpl, const SurfacePoint& I, const BSDF& bsdf) const {
-    RaySample shadowRay;
-    auto Le = vpl.pLight->sampleDirectIllumination(getScene(), vpl.positionSample, I, shadowRay);
+    Ray shadowRay;
+    return evalUnoccludedVPLContribution(vpl, I, bsdf, shadowRay);
+}
 
-    if(Le != zero<Vec3f>() && shadowRay.pdf) {
-        shadowRay.pdf *= vpl.lightPdf;
+Vec3f IGIImportanceCachingRenderer::evalUnoccludedVPLContribution(const EmissionVPL& vpl, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const {
+    RaySample shadowRaySample;
+    auto Le = vpl.pLight->sampleDirectIllumination(getScene(), vpl.positionSample, I, shadowRaySample);
+
+    if(Le != zero<Vec3f>() && shadowRaySample.pdf) {
+        shadowRaySample.pdf *= vpl.lightPdf;
         float cosThetaOutDir;
-        auto fr = bsdf.eval(shadowRay.value.dir, cosThetaOutDir);
-        return Le * fr * abs(cosThetaOutDir) / shadowRay.pdf;
+        auto fr = bsdf.eval(shadowRaySample.value.dir, cosThetaOutDir);
+        shadowRay = shadowRaySample.value;
+        return Le * fr * abs(cosThetaOutDir) / shadowRaySample.pdf;
     }
 
     return zero<Vec3f>();
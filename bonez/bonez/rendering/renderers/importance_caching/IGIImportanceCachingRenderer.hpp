@@ -76,6 +76,9 @@ private:
 
     Vec3f evalUnoccludedVPLContribution(const SurfaceVPL& vpl, const SurfacePoint& I, const BSDF& bsdf) const;
 
+    // Also fill the ray to trace to test the visibility of the VPL
+    Vec3f evalUnoccludedVPLContribution(const SurfaceVPL& vpl, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const;
+
     float evalBoundedGeometricFactor(const SurfaceVPL& vpl, const SurfacePoint& I, float radiusOfInfluence, Vec3f& wi, float& dist) const;
 
     Vec3f evalBoundedVPLContribution(const SurfaceVPL& vpl, const SurfacePoint& I, float radiusOfInfluence, const BSDF& bsdf) const;
@@ -84,6 +87,8 @@ private:
 
     Vec3f evalUnoccludedVPLContribution(const EmissionVPL& vpl, const SurfacePoint& I, const BSDF& bsdf) const;
 
+    Vec3f evalUnoccludedVPLContribution(const EmissionVPL& vpl, const SurfacePoint& I, const BSDF& bsdf, Ray& shadowRay) const;
+
     Vec3f evalBoundedVPLContribution(const EmissionVPL& vpl, const SurfacePoint& I, float radiusOfInfluence, const BSDF& bsdf) const;
 
     void extractEnabledDistributionsFromSelector();
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <bonez/types.hpp>
+#include <bonez/scene/Scene.hpp>
+#include <bonez/scene/shading/BSDF.hpp>
+
+namespace BnZ {
+
+// Evaluation of the full and unoccluded contributions of a set of vertices to an importance record.
+//
+// The unoccluded contribution of each vertex is evaluated once and the full contribution is deduced from it by testing
+// the visibility of the vertex. The shadow rays of an importance record all start from its position, so they are coherent
+// and traced together by packets.
+class ShadowRayBatch {
+public:
+    // Maximal number of vertices evaluated by a call to the functor of evalBlocks
+    static const std::size_t BLOCK_SIZE = 16u;
+
+    // evalUnoccluded(i, shadowRay) returns the unoccluded contribution of vertex i and fills the ray that tests its visibility.
+    // If bFullContribution is false, no shadow ray is traced and only the unoccluded contributions are computed.
+    // threadID is the calling thread, whose ray tracing state is used.
+    template<typename EvalUnoccludedContributionFunctor>
+    void eval(std::size_t vertexCount, EvalUnoccludedContributionFunctor&& evalUnoccluded, const Scene& scene, bool bFullContribution,
+              uint32_t threadID) {
+        evalBlocks(vertexCount, 0u, [&](std::size_t first, std::size_t count, float* contributions, Ray* shadowRays) {
+            for(auto i = 0u; i < count; ++i) {
+                contributions[i] = evalUnoccluded(uint32_t(first + i), shadowRays[i]);
+            }
+        }, scene, bFullContribution, threadID);
+    }
+
+    // Same as eval, but evalUnoccludedBlock(first, count, contributions, shadowRays) evaluates the vertices [first, first + count)
+    // at once, so that their BSDFs can be evaluated with BSDF::evalBatch. count is at most BLOCK_SIZE and the blocks don't
+    // cross the multiples of blockAlignment (0 for no constraint).
+    template<typename EvalUnoccludedBlockFunctor>
+    void evalBlocks(std::size_t vertexCount, std::size_t blockAlignment, EvalUnoccludedBlockFunctor&& evalUnoccludedBlock,
+                    const Scene& scene, bool bFullContribution, uint32_t threadID) {
+        m_UnoccludedContributions.resize(vertexCount);
+        m_FullContributions.resize(vertexCount);
+        m_ShadowRays.clear();
+        m_ShadowRayVertices.clear();
+
+        Ray shadowRays[BLOCK_SIZE];
+        for(std::size_t first = 0u; first < vertexCount; ) {
+            auto end = std::min(first + BLOCK_SIZE, vertexCount);
+            if(blockAlignment) {
+                end = std::min(end, (first / blockAlignment + 1) * blockAlignment);
+            }
+
+            evalUnoccludedBlock(first, end - first, m_UnoccludedContributions.data() + first, shadowRays);
+            for(auto i = first; i < end; ++i) {
+                m_FullContributions[i] = 0.f;
+                if(bFullContribution && m_UnoccludedContributions[i] > 0.f) {
+                    m_ShadowRays.emplace_back(shadowRays[i - first]);
+                    m_ShadowRayVertices.emplace_back(uint32_t(i));
+                }
+            }
+            first = end;
+        }
+
+        if(m_ShadowRays.empty()) {
+            return;
+        }
+
+        if(m_nOcclusionCapacity < m_ShadowRays.size()) {
+            m_nOcclusionCapacity = m_ShadowRays.size();
+            m_Occlusions.reset(new bool[m_nOcclusionCapacity]);
+        }
+
+        scene.occluded(m_ShadowRays.data(), m_ShadowRays.size(), m_Occlusions.get(), threadID);
+
+        for(auto j = 0u; j < m_ShadowRays.size(); ++j) {
+            if(!m_Occlusions[j]) {
+                auto i = m_ShadowRayVertices[j];
+                m_FullContributions[i] = m_UnoccludedContributions[i];
+            }
+        }
+    }
+
+    float getUnoccludedContribution(std::size_t i) const {
+        return m_UnoccludedContributions[i];
+    }
+
+    float getFullContribution(std::size_t i) const {
+        return m_FullContributions[i];
+    }
+
+private:
+    std::vector<float> m_UnoccludedContributions;
+    std::vector<float> m_FullContributions;
+    std::vector<Ray> m_ShadowRays;
+    std::vector<uint32_t> m_ShadowRayVertices; // Index of the vertex of each shadow ray
+    Unique<bool[]> m_Occlusions;
+    std::size_t m_nOcclusionCapacity = 0u;
+};
+
+// Luminance of the unoccluded contributions of count surface light vertices, stored every stride vertices from pLightVertices,
+// to the point I of BSDF bsdf, for ShadowRayBatch::evalBlocks. count is at most ShadowRayBatch::BLOCK_SIZE and the BSDFs of
+// both sides are evaluated with BSDF::evalBatch. Vertices with a null path pdf don't contribute.
+template<typename LightVertex>
+inline void evalUnoccludedContributions(const LightVertex* pLightVertices, std::size_t stride, std::size_t count,
+                                        const SurfacePoint& I, const BSDF& bsdf, float* contributions, Ray* shadowRays) {
+    static const std::size_t BLOCK_SIZE = ShadowRayBatch::BLOCK_SIZE;
+    assert(count <= BLOCK_SIZE);
+
+    Vec3f directions[BLOCK_SIZE], reverseDirections[BLOCK_SIZE];
+    float geometricFactors[BLOCK_SIZE];
+    const BSDF* lightVertexBSDFs[BLOCK_SIZE];
+    uint32_t indices[BLOCK_SIZE]; // Index in the block of each evaluated vertex
+    std::size_t evalCount = 0u;
+
+    for(auto i = 0u; i < count; ++i) {
+        contributions[i] = 0.f;
+        const auto& lightVertex = pLightVertices[i * stride];
+        if(lightVertex.m_fPathPdf == 0.f) {
+            continue;
+        }
+        float dist;
+        auto G = geometricFactor(I, lightVertex.m_Intersection, directions[evalCount], dist);
+        if(G > 0.f) {
+            shadowRays[i] = Ray(I, lightVertex.m_Intersection, directions[evalCount], dist);
+            geometricFactors[evalCount] = G;
+            reverseDirections[evalCount] = -directions[evalCount];
+            lightVertexBSDFs[evalCount] = &lightVertex.m_BSDF;
+            indices[evalCount] = i;
+            ++evalCount;
+        }
+    }
+
+    Vec3f fs[BLOCK_SIZE], lightVertexFs[BLOCK_SIZE];
+    float cosThetaOutDirs[BLOCK_SIZE];
+    bsdf.evalBatch(directions, evalCount, fs, cosThetaOutDirs);
+    BSDF::evalBatch(lightVertexBSDFs, reverseDirections, evalCount, lightVertexFs, cosThetaOutDirs);
+
+    for(auto j = 0u; j < evalCount; ++j) {
+        auto i = indices[j];
+        contributions[i] = luminance(fs[j] * lightVertexFs[j] * geometricFactors[j] * pLightVertices[i * stride].m_Power);
+    }
+}
+
+}
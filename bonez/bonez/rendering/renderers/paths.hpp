@@ -326,8 +326,9 @@ inline VertexType samplePrimaryLightVertex(const Scene& scene,
                                          const Vec2f& directionSample,
                                          const Light*& pLight,
                                          float& lightPdf,
-                                         float& positionPdfGivenLight) {
-    pLight = sampler.sample(scene, lightSample, lightPdf);
+                                         float& positionPdfGivenLight,
+                                         uint32_t* pLightID = nullptr) {
+    pLight = sampler.sample(scene, lightSample, lightPdf, pLightID);
 
     if(!pLight) {
         lightPdf = 0.f;
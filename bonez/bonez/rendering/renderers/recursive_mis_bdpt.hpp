@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bonez/scene/Scene.hpp>
+#include <bonez/scene/raytracing/RayQueue.hpp>
 #include <bonez/scene/shading/BSDF.hpp>
 
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
@@ -100,8 +101,26 @@ public:
                    const Light*& pLight,
                    float& lightPdf,
                    uint32_t pathCount,
+                   MisFunctor&& mis):
+        BDPTPathVertex(scene, sampler, [&](const SurfacePoint& point, uint32_t lightID) { return sampler.pdf(lightID); },
+                       lightSample, positionSample, directionSample, pLight, lightPdf, pathCount, mis) {
+    }
+
+    // Create a primary light vertex whose light is chosen by the strategy s = 1 (direct illumination) with the probability
+    // directLightPdf(point, lightID) from the point of the vertex instead of the emission probability of sampler
+    template<typename DirectLightPdfFunctor, typename MisFunctor>
+    BDPTPathVertex(const Scene& scene,
+                   const PowerBasedLightSampler& sampler,
+                   DirectLightPdfFunctor&& directLightPdf,
+                   float lightSample,
+                   const Vec2f& positionSample,
+                   const Vec2f& directionSample,
+                   const Light*& pLight,
+                   float& lightPdf,
+                   uint32_t pathCount,
                    MisFunctor&& mis) {
-        pLight = sampler.sample(scene, lightSample, lightPdf);
+        uint32_t lightID;
+        pLight = sampler.sample(scene, lightSample, lightPdf, &lightID);
 
         if(!pLight) {
             lightPdf = 0.f;
@@ -141,11 +160,21 @@ public:
             m_BSDF.init(-raySample.value.dir, m_Intersection, scene);
             m_fPathPdf = rayOriginPdf * intersectionPdfWrtArea;
             m_fPdfWrtArea = intersectionPdfWrtArea;
-            m_fdVCM = mis(pathCount / m_fPdfWrtArea);
+            // The strategy s = 1 chooses the light with another probability than the emission, the ratio does not cancel
+            m_fdVCM = mis(pathCount * (directLightPdf(m_Intersection, lightID) / lightPdf) / m_fPdfWrtArea);
             m_fdVC = mis(pathCount * rayOriginToIncidentDirJacobian / m_fPathPdf);
         }
     }
 
+    // Direction of the next vertex of the path sampled by sampleExtension()
+    struct Extension {
+        Sample3f m_Direction;
+        Vec3f m_BSDFValue;
+        float m_fCosThetaOutDir;
+        float m_fReversePdf; // pdf of sampling the incident direction from the outgoing one
+        uint32_t m_nSampledEvent;
+    };
+
     // Extend to the next vertex of the path
     template<typename RandomGenerator, typename MisFunctor>
     bool extend(BDPTPathVertex& next,
@@ -154,22 +183,51 @@ public:
                 bool sampleAdjoint, // Number of paths sampled with the strategies s/t = m_nDepth + 1, t/s = *
                 RandomGenerator&& rng,
                 MisFunctor&& mis) {
+        Extension extension;
+        if(!sampleExtension(sampleAdjoint, rng, extension)) {
+            return false;
+        }
+        return applyExtension(next, extension, scene.intersect(getExtensionRay(extension)), scene, pathCount, mis);
+    }
+
+    // extend() is split in two steps so that the rays of many paths can be traced together (see sampleLightPaths):
+    // sampleExtension() samples the outgoing direction and returns false if the path stops,
+    // applyExtension() computes the next vertex from the intersection of the ray getExtensionRay().
+    template<typename RandomGenerator>
+    bool sampleExtension(bool sampleAdjoint, RandomGenerator&& rng, Extension& extension) const {
         if(!m_Intersection) {
             return false; // Can't sample from infinity
         }
 
-        Sample3f woSample;
-        float cosThetaOutDir;
-        uint32_t sampledEvent;
-        auto fs = m_BSDF.sample(Vec3f(getFloat(rng), getFloat2(rng)), woSample, cosThetaOutDir, &sampledEvent, sampleAdjoint);
+        extension.m_BSDFValue = m_BSDF.sample(Vec3f(getFloat(rng), getFloat2(rng)), extension.m_Direction,
+                                              extension.m_fCosThetaOutDir, &extension.m_nSampledEvent, sampleAdjoint);
 
-        if(woSample.pdf == 0.f || fs == zero<Vec3f>()) {
+        if(extension.m_Direction.pdf == 0.f || extension.m_BSDFValue == zero<Vec3f>()) {
             return false;
         }
 
-        float reversePdf = m_BSDF.pdf(woSample.value, true);
+        extension.m_fReversePdf = m_BSDF.pdf(extension.m_Direction.value, true);
 
-        auto nextI = scene.intersect(Ray(m_Intersection, woSample.value));
+        return true;
+    }
+
+    Ray getExtensionRay(const Extension& extension) const {
+        return Ray(m_Intersection, extension.m_Direction.value);
+    }
+
+    // next can be this vertex
+    template<typename MisFunctor>
+    bool applyExtension(BDPTPathVertex& next,
+                        const Extension& extension,
+                        const Intersection& nextI,
+                        const Scene& scene,
+                        uint32_t pathCount,
+                        MisFunctor&& mis) {
+        const auto& woSample = extension.m_Direction;
+        const auto& fs = extension.m_BSDFValue;
+        auto cosThetaOutDir = extension.m_fCosThetaOutDir;
+        auto sampledEvent = extension.m_nSampledEvent;
+        auto reversePdf = extension.m_fReversePdf;
 
         if(!nextI) {
             next.m_Intersection = nextI;
@@ -224,11 +282,15 @@ public:
     }
 };
 
-template<typename MisFunctor>
+// directLightPdf(lightID) must return the probability of choosing the area light lightID for the strategy s = 1 (direct illumination)
+// on the previous vertex of the eye path. It differs from lightSampler.pdf(lightID) when the direct illumination uses a spatially
+// varying light selection (see LightBVHSampler). Infinite lights are chosen with the same probability by both samplers.
+template<typename DirectLightPdfFunctor, typename MisFunctor>
 inline Vec3f computeEmittedRadiance(
         const BDPTPathVertex& eyeVertex,
         const Scene& scene,
         const PowerBasedLightSampler& lightSampler,
+        DirectLightPdfFunctor&& directLightPdf,
         size_t pathCount, // The number of paths sampled for the strategy s = 0, t = eyeVertex.m_nDepth + 1
         MisFunctor&& mis) {
     if(eyeVertex.m_Intersection.Le == zero<Vec3f>()) {
@@ -259,9 +321,12 @@ inline Vec3f computeEmittedRadiance(
             pAreaLight->pdf(eyeVertex.m_Intersection, eyeVertex.m_BSDF.getIncidentDirection(), scene,
                             pointPdfWrtArea, directionPdfWrtSolidAngle);
 
-            pointPdfWrtArea *= lightSampler.pdf(lightID); // Scale by the pdf of chosing the area light
+            // Scale by the pdf of chosing the area light, for emission and for direct illumination
+            auto emissionPdfWrtArea = pointPdfWrtArea * lightSampler.pdf(lightID);
+            auto directPdfWrtArea = pointPdfWrtArea * directLightPdf(lightID);
 
-            rcpWeight += mis(pointPdfWrtArea / pathCount) * (eyeVertex.m_fdVCM + mis(directionPdfWrtSolidAngle) * eyeVertex.m_fdVC);
+            rcpWeight += mis(directPdfWrtArea / pathCount) * eyeVertex.m_fdVCM +
+                    mis(emissionPdfWrtArea / pathCount) * mis(directionPdfWrtSolidAngle) * eyeVertex.m_fdVC;
         }
     }
 
@@ -270,10 +335,25 @@ inline Vec3f computeEmittedRadiance(
     return weight * contrib;
 }
 
+template<typename MisFunctor>
+inline Vec3f computeEmittedRadiance(
+        const BDPTPathVertex& eyeVertex,
+        const Scene& scene,
+        const PowerBasedLightSampler& lightSampler,
+        size_t pathCount, // The number of paths sampled for the strategy s = 0, t = eyeVertex.m_nDepth + 1
+        MisFunctor&& mis) {
+    return computeEmittedRadiance(eyeVertex, scene, lightSampler, [&](uint32_t lightID) {
+        return lightSampler.pdf(lightID);
+    }, pathCount, mis);
+}
+
+// Connect an eye vertex to a light that has been chosen with the probability lightVertex.m_fLightPdf
+// while light paths choose it with the probability emissionLightPdf (for example when the light is chosen with a LightBVHSampler)
 template<typename MisFunctor>
 inline Vec3f connectVertices(
         const BDPTPathVertex& eyeVertex,
         const EmissionVertex& lightVertex,
+        float emissionLightPdf,
         const Scene& scene,
         size_t pathCount, // The number of paths sampled for the strategy s = 1, t = eyeVertex.m_nDepth + 1
         MisFunctor&& mis) {
@@ -313,6 +393,9 @@ inline Vec3f connectVertices(
        rcpWeight += mis(pdfWrtArea / (pathCount * sampledPointPdfWrtArea));
     }
 
+    // Light paths choose the light with emissionLightPdf instead of lightVertex.m_fLightPdf
+    revPdfWrtArea *= emissionLightPdf / lightVertex.m_fLightPdf;
+
     rcpWeight += mis(revPdfWrtArea / pathCount) * (eyeVertex.m_fdVCM + mis(eyeRevPdf) * eyeVertex.m_fdVC);
 
     auto weight = 1.f / rcpWeight;
@@ -323,17 +406,29 @@ inline Vec3f connectVertices(
 template<typename MisFunctor>
 inline Vec3f connectVertices(
         const BDPTPathVertex& eyeVertex,
-        const BDPTPathVertex& lightVertex,
+        const EmissionVertex& lightVertex,
         const Scene& scene,
-        size_t pathCount, // The number of paths sampled for the strategy s = lightVertex.m_nDepth + 1, t = eyeVertex.m_nDepth + 1
+        size_t pathCount, // The number of paths sampled for the strategy s = 1, t = eyeVertex.m_nDepth + 1
         MisFunctor&& mis) {
+    return connectVertices(eyeVertex, lightVertex, lightVertex.m_fLightPdf, scene, pathCount, mis);
+}
+
+// Weighted contribution of the connection of two vertices without the visibility term.
+// incidentRay is filled with the shadow ray that tests the visibility of the connection.
+template<typename MisFunctor>
+inline Vec3f evalUnoccludedConnection(
+        const BDPTPathVertex& eyeVertex,
+        const BDPTPathVertex& lightVertex,
+        size_t pathCount, // The number of paths sampled for the strategy s = lightVertex.m_nDepth + 1, t = eyeVertex.m_nDepth + 1
+        MisFunctor&& mis,
+        Ray& incidentRay) {
     Vec3f incidentDirection;
     float dist;
     auto G = geometricFactor(eyeVertex.m_Intersection, lightVertex.m_Intersection, incidentDirection, dist);
     if(dist == 0.f) {
         return zero<Vec3f>();
     }
-    Ray incidentRay(eyeVertex.m_Intersection, lightVertex.m_Intersection, incidentDirection, dist);
+    incidentRay = Ray(eyeVertex.m_Intersection, lightVertex.m_Intersection, incidentDirection, dist);
 
     float cosAtLightVertex, cosAtEyeVertex;
     float lightDirPdf, lightRevPdf;
@@ -342,7 +437,7 @@ inline Vec3f connectVertices(
     auto M = lightVertex.m_BSDF.eval(-incidentDirection, cosAtLightVertex, &lightDirPdf, &lightRevPdf) *
             eyeVertex.m_BSDF.eval(incidentDirection, cosAtEyeVertex, &eyeDirPdf, &eyeRevPdf);
 
-    if(G > 0.f && M != zero<Vec3f>() && !scene.occluded(incidentRay)) {
+    if(G > 0.f && M != zero<Vec3f>()) {
         auto rcpWeight = 1.f;
 
         {
@@ -365,6 +460,21 @@ inline Vec3f connectVertices(
     return zero<Vec3f>();
 }
 
+template<typename MisFunctor>
+inline Vec3f connectVertices(
+        const BDPTPathVertex& eyeVertex,
+        const BDPTPathVertex& lightVertex,
+        const Scene& scene,
+        size_t pathCount, // The number of paths sampled for the strategy s = lightVertex.m_nDepth + 1, t = eyeVertex.m_nDepth + 1
+        MisFunctor&& mis) {
+    Ray incidentRay;
+    auto contrib = evalUnoccludedConnection(eyeVertex, lightVertex, pathCount, mis, incidentRay);
+    if(contrib != zero<Vec3f>() && !scene.occluded(incidentRay)) {
+        return contrib;
+    }
+    return zero<Vec3f>();
+}
+
 template<typename MisFunctor>
 inline Vec3f connectVertices(
         const BDPTPathVertex& lightVertex,
@@ -398,12 +508,15 @@ inline Vec3f connectVertices(
     return misWeight * lightVertex.m_Power * fr * abs(cosThetaOutDir) * We;
 }
 
-template<typename MisFunctor, typename RandomGenerator>
+// directLightPdf(point, lightID) is the probability of choosing the light of the path for the strategy s = 1 from the point
+// of its first vertex (see computeEmittedRadiance)
+template<typename DirectLightPdfFunctor, typename MisFunctor, typename RandomGenerator>
 EmissionVertex sampleLightPath(
         BDPTPathVertex* pLightPath,
         uint32_t maxLightPathDepth,
         const Scene& scene,
         const PowerBasedLightSampler& lightSampler,
+        DirectLightPdfFunctor&& directLightPdf,
         uint32_t misPathCount, // The number of paths used to estimate an integral
         MisFunctor&& mis,
         RandomGenerator&& rng) {
@@ -414,7 +527,7 @@ EmissionVertex sampleLightPath(
         const Light* pLight = nullptr;
         float lightPdf;
         auto positionSample = getFloat2(rng);
-        pLightPath[0] = BDPTPathVertex(scene, lightSampler, getFloat(rng), positionSample,
+        pLightPath[0] = BDPTPathVertex(scene, lightSampler, directLightPdf, getFloat(rng), positionSample,
                                        getFloat2(rng), pLight, lightPdf, misPathCount, mis);
         if(pLightPath->m_fPathPdf) {
             while(pLightPath->m_nDepth < maxLightPathDepth &&
@@ -430,6 +543,134 @@ EmissionVertex sampleLightPath(
     return { nullptr, 0.f, Vec2f(0.f) };
 }
 
+template<typename MisFunctor, typename RandomGenerator>
+EmissionVertex sampleLightPath(
+        BDPTPathVertex* pLightPath,
+        uint32_t maxLightPathDepth,
+        const Scene& scene,
+        const PowerBasedLightSampler& lightSampler,
+        uint32_t misPathCount, // The number of paths used to estimate an integral
+        MisFunctor&& mis,
+        RandomGenerator&& rng) {
+    return sampleLightPath(pLightPath, maxLightPathDepth, scene, lightSampler, [&](const SurfacePoint& point, uint32_t lightID) {
+        return lightSampler.pdf(lightID);
+    }, misPathCount, mis, rng);
+}
+
+// Same as calling sampleLightPath for each of pathCount light paths, stored contiguously with maxLightPathDepth vertices
+// per path, but the paths are extended together one depth at a time: the extension rays of a depth are traced through
+// rayQueue, sorted for coherence, instead of in path order. The rays of the primary vertices are traced by the lights.
+// getRNG(pathID, threadID) returns the random generator used for the path by a task of the thread.
+template<typename MisFunctor, typename RandomGeneratorFunctor>
+void sampleLightPaths(
+        BDPTPathVertex* pLightPaths,
+        EmissionVertex* pEmissionVertices,
+        std::size_t pathCount,
+        uint32_t maxLightPathDepth,
+        const Scene& scene,
+        const PowerBasedLightSampler& lightSampler,
+        uint32_t misPathCount, // The number of paths used to estimate an integral
+        MisFunctor&& mis,
+        RandomGeneratorFunctor&& getRNG,
+        RayQueue& rayQueue,
+        uint32_t threadCount = getSystemThreadCount()) {
+    const std::size_t wavefrontSize = 1u << 16; // Paths extended together, bounds the memory used by the rays
+
+    std::vector<uint32_t> activePaths, tracedPaths;
+    std::vector<BDPTPathVertex::Extension> extensions;
+    std::vector<uint8_t> isExtended;
+    std::vector<Intersection> intersections;
+
+    // Last step of sampleLightPath for a path whose last vertex is k
+    auto finishPath = [&](uint32_t pathID, uint32_t k) {
+        auto& vertex = pLightPaths[pathID * maxLightPathDepth + k];
+        if(!vertex.m_Intersection) {
+            vertex.m_fPathPdf = 0.f; // If the last vertex is outside the scene, invalidate it
+        }
+    };
+
+    for(auto wavefrontStart = std::size_t(0); wavefrontStart < pathCount; wavefrontStart += wavefrontSize) {
+        auto wavefrontPathCount = uint32_t(std::min(wavefrontSize, pathCount - wavefrontStart));
+
+        processTasksDeterminist(wavefrontPathCount, [&](uint32_t i, uint32_t threadID) {
+            auto pathID = uint32_t(wavefrontStart + i);
+            auto pLightPath = pLightPaths + pathID * maxLightPathDepth;
+            std::for_each(pLightPath, pLightPath + maxLightPathDepth,
+                          [&](BDPTPathVertex& vertex) { vertex.m_fPathPdf = 0.f; });
+
+            if(!maxLightPathDepth) {
+                pEmissionVertices[pathID] = { nullptr, 0.f, Vec2f(0.f) };
+                return;
+            }
+
+            auto&& rng = getRNG(pathID, threadID);
+            const Light* pLight = nullptr;
+            float lightPdf;
+            auto positionSample = getFloat2(rng);
+            pLightPath[0] = BDPTPathVertex(scene, lightSampler, getFloat(rng), positionSample,
+                                           getFloat2(rng), pLight, lightPdf, misPathCount, mis);
+            pEmissionVertices[pathID] = { pLight, lightPdf, positionSample };
+        }, threadCount);
+
+        activePaths.clear();
+        for(auto i = 0u; i < wavefrontPathCount; ++i) {
+            auto pathID = uint32_t(wavefrontStart + i);
+            if(maxLightPathDepth && pLightPaths[pathID * maxLightPathDepth].m_fPathPdf) {
+                activePaths.emplace_back(pathID);
+            }
+        }
+
+        // All active paths have k + 1 vertices
+        for(auto k = 0u; k + 1 < maxLightPathDepth && !activePaths.empty(); ++k) {
+            extensions.resize(activePaths.size());
+            isExtended.resize(activePaths.size());
+
+            processTasksDeterminist(uint32_t(activePaths.size()), [&](uint32_t i, uint32_t threadID) {
+                auto pathID = activePaths[i];
+                auto&& rng = getRNG(pathID, threadID);
+                isExtended[i] = pLightPaths[pathID * maxLightPathDepth + k].sampleExtension(true, rng, extensions[i]);
+            }, threadCount);
+
+            rayQueue.clear();
+            tracedPaths.clear();
+            for(auto i = 0u; i < activePaths.size(); ++i) {
+                auto pathID = activePaths[i];
+                if(isExtended[i]) {
+                    rayQueue.push(pLightPaths[pathID * maxLightPathDepth + k].getExtensionRay(extensions[i]));
+                    extensions[tracedPaths.size()] = extensions[i];
+                    tracedPaths.emplace_back(pathID);
+                } else {
+                    finishPath(pathID, k);
+                }
+            }
+
+            intersections.resize(tracedPaths.size());
+            rayQueue.intersect(scene, intersections.data(), threadCount);
+
+            isExtended.resize(tracedPaths.size());
+            processTasksDeterminist(uint32_t(tracedPaths.size()), [&](uint32_t i, uint32_t threadID) {
+                auto pLightPath = pLightPaths + tracedPaths[i] * maxLightPathDepth;
+                isExtended[i] = pLightPath[k].applyExtension(pLightPath[k + 1], extensions[i], intersections[i],
+                                                             scene, misPathCount, mis);
+            }, threadCount);
+
+            activePaths.clear();
+            for(auto i = 0u; i < tracedPaths.size(); ++i) {
+                if(isExtended[i]) {
+                    activePaths.emplace_back(tracedPaths[i]);
+                } else {
+                    finishPath(tracedPaths[i], k);
+                }
+            }
+        }
+
+        // The remaining paths reached the maximal depth
+        for(auto pathID: activePaths) {
+            finishPath(pathID, maxLightPathDepth - 1u);
+        }
+    }
+}
+
 template<typename MisFunctor, typename RandomGenerator>
 SensorVertex sampleEyePath(
         BDPTPathVertex* pEyePath,
@@ -454,7 +695,7 @@ SensorVertex sampleEyePath(
         }
         return { &sensor, positionSample };
     }
-    return { nullptr, 0.f, Vec2f(0.f) };
+    return { nullptr, Vec2f(0.f) };
 }
 
 inline std::size_t computeBPTStrategyOffset(std::size_t pathVertexCount, std::size_t lightVertexCount) {
@@ -12,51 +12,59 @@ void SkelBasedPathtraceRenderer::preprocess() {
     m_Sampler.initFrame(getScene());
 
     const auto& skeleton = *getScene().getCurvSkeleton();
+    std::vector<GraphNodeIndex> rootNodes;
     getScene().getLightContainer().forEach<PointLight>([&](std::size_t lightIdx, const PointLight& light) {
         auto rootNodeIndex = skeleton.getNearestNode(light.m_Position);
 
         if(rootNodeIndex != UNDEFINED_NODE) {
             m_PointLightPower.emplace_back(light.getPowerUpperBound(getScene()));
-            auto shortestPaths = DijkstraAlgorithm().computeShortestPaths(
-                        skeleton.getGraph(),
-                        rootNodeIndex,
-                        [&](GraphNodeIndex n1, GraphNodeIndex n2) {
-                            return 1;
-                        });
-
-            m_PointLightImportancePoints.emplace_back();
-            for(auto nodeIdx: range(skeleton.size())) {
-                auto currentNodeIdx = nodeIdx;
-                auto currentNodePosition = skeleton.getNode(currentNodeIdx).P;
-                auto sumPositions = currentNodePosition;
-                auto countPositions = 1u;
-
-                auto nextNodeIdx = shortestPaths[nodeIdx].predecessor;
-                if(nextNodeIdx != UNDEFINED_NODE) {
-                    auto nextNodePosition = skeleton.getNode(nextNodeIdx).P;
-
-                    auto makePredecessorShadowRay = [&]() {
-                        auto dir = nextNodePosition - currentNodePosition;
-                        auto l = length(dir);
-                        dir /= l;
-                        return Ray(currentNodePosition, dir, 0, l);
-                    };
-
-                    while(nextNodeIdx != currentNodeIdx && !getScene().occluded(makePredecessorShadowRay())) {
-                        sumPositions += nextNodePosition;
-                        ++countPositions;
-
-                        currentNodeIdx = nextNodeIdx;
-                        nextNodeIdx = shortestPaths[currentNodeIdx].predecessor;
-                        nextNodePosition = skeleton.getNode(nextNodeIdx).P;
-                    }
-                }
-
-                auto barycenter = sumPositions / float(countPositions);
-                m_PointLightImportancePoints.back().emplace_back(barycenter);
-            }
+            rootNodes.emplace_back(rootNodeIndex);
         }
     });
+
+    // The shortest path trees of all lights are computed in parallel
+    auto shortestPathsPerLight = computeShortestPathsPerRoot(
+                skeleton.getGraph(),
+                rootNodes,
+                [&](GraphNodeIndex n1, GraphNodeIndex n2) {
+                    return 1u;
+                },
+                getThreadCount());
+
+    for(const auto& shortestPaths: shortestPathsPerLight) {
+        m_PointLightImportancePoints.emplace_back(skeleton.size());
+        auto& importancePoints = m_PointLightImportancePoints.back();
+
+        processTasks(skeleton.size(), [&](uint32_t nodeIdx, uint32_t threadID) {
+            auto currentNodeIdx = nodeIdx;
+            auto currentNodePosition = skeleton.getNode(currentNodeIdx).P;
+            auto sumPositions = currentNodePosition;
+            auto countPositions = 1u;
+
+            auto nextNodeIdx = shortestPaths[nodeIdx].predecessor;
+            if(nextNodeIdx != UNDEFINED_NODE) {
+                auto nextNodePosition = skeleton.getNode(nextNodeIdx).P;
+
+                auto makePredecessorShadowRay = [&]() {
+                    auto dir = nextNodePosition - currentNodePosition;
+                    auto l = length(dir);
+                    dir /= l;
+                    return Ray(currentNodePosition, dir, 0, l);
+                };
+
+                while(nextNodeIdx != currentNodeIdx && !getScene().occluded(makePredecessorShadowRay())) {
+                    sumPositions += nextNodePosition;
+                    ++countPositions;
+
+                    currentNodeIdx = nextNodeIdx;
+                    nextNodeIdx = shortestPaths[currentNodeIdx].predecessor;
+                    nextNodePosition = skeleton.getNode(nextNodeIdx).P;
+                }
+            }
+
+            importancePoints[nodeIdx] = sumPositions / float(countPositions);
+        }, getThreadCount());
+    }
 }
 
 void SkelBasedPathtraceRenderer::drawGLData(const ViewerData& viewerData) {
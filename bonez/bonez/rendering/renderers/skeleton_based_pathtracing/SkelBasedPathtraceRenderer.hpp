@@ -4,7 +4,7 @@
 #include "../paths.hpp"
 
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
-#include <bonez/utils/DijkstraAlgorithm.hpp>
+#include <bonez/utils/ShortestPaths.hpp>
 
 #include <bonez/opengl/debug/GLDebugStream.hpp>
 
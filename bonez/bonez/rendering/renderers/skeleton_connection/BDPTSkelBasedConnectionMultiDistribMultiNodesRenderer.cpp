@@ -63,7 +63,7 @@ void BDPTSkelBasedConnectionMultiDistribMultiNodesRenderer::beginFrame() {
 
     m_PerThreadNodeBuffer.resize(m_nMaxNodeCount, getThreadCount());
     m_PerThreadFilteredNodeBuffer.resize(m_nMaxNodeCount, getThreadCount());
-    std::fill(begin(m_EyeVertexCountPerNodePerThread), end(m_EyeVertexCountPerNodePerThread), 0u);
+    m_EyeVertexCountPerNodePerThread.fill(0u);
 }
 
 void BDPTSkelBasedConnectionMultiDistribMultiNodesRenderer::sampleLightPaths() {
@@ -117,13 +117,9 @@ void BDPTSkelBasedConnectionMultiDistribMultiNodesRenderer::computeFilteredNodes
 
 void BDPTSkelBasedConnectionMultiDistribMultiNodesRenderer::updateEyeVertexCountPerNode() {
     // Count the number of eye vertices mapped to each node
-    for(auto nodeID: range(m_pSkel->size())) {
-        auto count = size_t(0);
-        for(auto threadID: range(getThreadCount())) {
-            count += m_EyeVertexCountPerNodePerThread(nodeID, threadID);
-        }
+    m_EyeVertexCountPerNodePerThread.reduceAll([&](std::size_t nodeID, uint64_t count) {
         m_EyeVertexCountPerNode[nodeID] += count;
-    }
+    }, getThreadCount());
 }
 
 void BDPTSkelBasedConnectionMultiDistribMultiNodesRenderer::computeNodeMappingStatistics(
@@ -7,6 +7,7 @@
 #include <bonez/scene/lights/PowerBasedLightSampler.hpp>
 #include <bonez/scene/shading/BSDF.hpp>
 #include <bonez/utils/MultiDimensionalArray.hpp>
+#include <bonez/utils/PerThreadAccumulator.hpp>
 
 #include <bonez/opengl/debug/GLDebugRenderer.hpp>
 
@@ -83,7 +84,7 @@ private:
     uint64_t m_nTotalFilteredNodeCount;
 
     std::vector<EmissionVertex> m_EmissionVertexBuffer;
-    Array2d<PathVertex> m_LightPathBuffer;
+    Array2d<PathVertex> m_LightPathBuffer { MemoryTag::LightVertices };
 
     DirectImportanceSampleTilePartionning m_DirectImportanceSampleTilePartitionning;
 
@@ -123,7 +124,7 @@ private:
     TaskTimer m_BeginFrameTimer;
     mutable TaskTimer m_TileProcessingTimer;
 
-    mutable Array2d<uint64_t> m_EyeVertexCountPerNodePerThread;
+    mutable PerThreadAccumulator<uint64_t> m_EyeVertexCountPerNodePerThread;
 };
 
 }
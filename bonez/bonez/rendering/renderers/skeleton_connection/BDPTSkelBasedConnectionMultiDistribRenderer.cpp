@@ -63,7 +63,7 @@ void BDPTSkelBasedConnectionMultiDistribRenderer::beginFrame() {
                            m_bUseNodeRadianceWeight, m_bUseNodeDistanceWeight, getThreadCount());
     }
 
-    std::fill(begin(m_EyeVertexCountPerNodePerThread), end(m_EyeVertexCountPerNodePerThread), 0u);
+    m_EyeVertexCountPerNodePerThread.fill(0u);
 }
 
 void BDPTSkelBasedConnectionMultiDistribRenderer::sampleLightPaths() {
@@ -117,13 +117,9 @@ void BDPTSkelBasedConnectionMultiDistribRenderer::computeFilteredNodes() {
 
 void BDPTSkelBasedConnectionMultiDistribRenderer::updateEyeVertexCountPerNode() {
     // Count the number of eye vertices mapped to each node
-    for(auto nodeID: range(m_pSkel->size())) {
-        auto count = size_t(0);
-        for(auto threadID: range(getThreadCount())) {
-            count += m_EyeVertexCountPerNodePerThread(nodeID, threadID);
-        }
+    m_EyeVertexCountPerNodePerThread.reduceAll([&](std::size_t nodeID, uint64_t count) {
         m_EyeVertexCountPerNode[nodeID] += count;
-    }
+    }, getThreadCount());
 }
 
 void BDPTSkelBasedConnectionMultiDistribRenderer::computeNodeMappingStatistics(
@@ -66,7 +66,7 @@ class IGISkelBasedConnectionRenderer: public TileProcessingRenderer {
 
     SkelMappingData m_SkelMappingData;
 
-    Array2d<float> m_SkelNodeVPLDistributionsArray; // For each node, contains a discrete distribution among vpls
+    Array2d<float> m_SkelNodeVPLDistributionsArray { MemoryTag::SkeletonDistributions }; // For each node, contains a discrete distribution among vpls
     std::vector<float> m_DefaultVPLDistributionsArray; // When a point is not associated with any node, use this distribution
     uint32_t m_nDistributionSize;
 
@@ -71,12 +71,12 @@ private:
 
     PrimarySkelMap m_SkelMappingData;
 
-    Array2d<float> m_SkelNodeLightVertexDistributionsArray; // For each node, contains a discrete distribution among light paths
+    Array2d<float> m_SkelNodeLightVertexDistributionsArray { MemoryTag::SkeletonDistributions }; // For each node, contains a discrete distribution among light paths
     std::vector<float> m_DefaultLightVertexDistributionsArray; // When a point is not associated with any node, use this distribution
     uint32_t m_nDistributionSize;
 
     std::vector<EmissionVertex> m_EmissionVertexBuffer;
-    Array2d<PathVertex> m_LightPathBuffer;
+    Array2d<PathVertex> m_LightPathBuffer { MemoryTag::LightVertices };
 
     DirectImportanceSampleTilePartionning m_DirectImportanceSampleTilePartitionning;
 
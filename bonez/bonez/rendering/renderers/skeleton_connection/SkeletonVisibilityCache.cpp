@@ -0,0 +1,140 @@
+#include "SkeletonVisibilityCache.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace BnZ {
+
+const uint32_t SkeletonVisibilityCache::INVALID_TARGET;
+
+SkeletonVisibilityCache::SkeletonVisibilityCache(float refreshRate, uint32_t slotCountPerNode, uint32_t seed):
+    m_nSlotCountPerNode(std::max(1u, slotCountPerNode)),
+    m_Rng(seed) {
+    setRefreshRate(refreshRate);
+}
+
+void SkeletonVisibilityCache::setRefreshRate(float refreshRate) {
+    m_fRefreshRate = std::min(1.f, std::max(refreshRate, 0.0001f));
+    m_nRefreshPeriod = std::size_t(std::round(1.f / m_fRefreshRate));
+}
+
+void SkeletonVisibilityCache::reset(std::size_t nodeCount) {
+    m_nNodeCount = nodeCount;
+    m_Slots.clear();
+    m_Slots.resize(nodeCount * m_nSlotCountPerNode);
+    m_NodeCounters.clear();
+    m_NodeCounters.resize(nodeCount);
+    m_nRefreshOffset = 0u;
+}
+
+void SkeletonVisibilityCache::beginIteration() {
+    m_nRefreshOffset = std::min(std::size_t(m_Rng.getFloat() * m_nRefreshPeriod), m_nRefreshPeriod - 1);
+    for(auto& counters: m_NodeCounters) {
+        counters.m_nTracedCount = 0u;
+        counters.m_nEstimatedCount = 0u;
+    }
+}
+
+bool SkeletonVisibilityCache::mustTrace(GraphNodeIndex node, uint32_t target, std::size_t pathIdx) const {
+    if(target == INVALID_TARGET) {
+        return true;
+    }
+    if((pathIdx + m_nRefreshOffset) % m_nRefreshPeriod == 0u) {
+        return true;
+    }
+    const auto& slot = getSlot(node, target);
+    return slot.m_nTarget != target || slot.m_nTestCount < MIN_TEST_COUNT;
+}
+
+void SkeletonVisibilityCache::addTest(GraphNodeIndex node, uint32_t target, bool visible) {
+    ++m_NodeCounters[node].m_nTracedCount;
+    if(target == INVALID_TARGET) {
+        return;
+    }
+
+    auto& slot = getSlot(node, target);
+    if(slot.m_nTarget != target) {
+        // Evict the statistics of the target sharing the slot
+        slot = Slot();
+        slot.m_nTarget = target;
+    }
+    // Halve the counts before they overflow, the estimate is kept
+    if(slot.m_nTestCount == std::numeric_limits<uint32_t>::max()) {
+        slot.m_nTestCount /= 2u;
+        slot.m_nVisibleCount /= 2u;
+    }
+    ++slot.m_nTestCount;
+    if(visible) {
+        ++slot.m_nVisibleCount;
+    }
+}
+
+float SkeletonVisibilityCache::estimateVisibility(GraphNodeIndex node, uint32_t target) {
+    ++m_NodeCounters[node].m_nEstimatedCount;
+
+    // Laplace estimator: a target is never considered fully occluded, so its light vertices can still be resampled
+    const auto& slot = getSlot(node, target);
+    if(slot.m_nTarget != target) {
+        return 0.5f;
+    }
+    return (slot.m_nVisibleCount + 1.f) / (slot.m_nTestCount + 2.f);
+}
+
+uint64_t SkeletonVisibilityCache::getTracedCount() const {
+    uint64_t count = 0u;
+    for(const auto& counters: m_NodeCounters) {
+        count += counters.m_nTracedCount;
+    }
+    return count;
+}
+
+uint64_t SkeletonVisibilityCache::getEstimatedCount() const {
+    uint64_t count = 0u;
+    for(const auto& counters: m_NodeCounters) {
+        count += counters.m_nEstimatedCount;
+    }
+    return count;
+}
+
+void SkeletonVisibilityCache::storeCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml, const std::string& name) const {
+    auto pCache = xml.GetDocument()->NewElement("VisibilityCache");
+    xml.InsertEndChild(pCache);
+
+    setAttribute(*pCache, "nodeCount", uint32_t(m_nNodeCount));
+    setAttribute(*pCache, "slotCountPerNode", m_nSlotCountPerNode);
+    setAttribute(*pCache, "rngState", m_Rng.getState());
+
+    checkpoint.storeBuffer(name, m_Slots.data(), m_Slots.size() * sizeof(Slot));
+}
+
+bool SkeletonVisibilityCache::loadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml, const std::string& name) {
+    auto pCache = xml.FirstChildElement("VisibilityCache");
+    if(!pCache) {
+        return false;
+    }
+
+    uint32_t nodeCount, slotCountPerNode;
+    std::string rngState;
+    if(!getAttribute(*pCache, "nodeCount", nodeCount) || nodeCount != m_nNodeCount ||
+            !getAttribute(*pCache, "slotCountPerNode", slotCountPerNode) || slotCountPerNode != m_nSlotCountPerNode ||
+            !getAttribute(*pCache, "rngState", rngState)) {
+        return false;
+    }
+
+    std::vector<char> data;
+    if(!checkpoint.loadBuffer(name, data) || data.size() != m_Slots.size() * sizeof(Slot)) {
+        return false;
+    }
+
+    auto rng = m_Rng;
+    if(!rng.setState(rngState)) {
+        return false;
+    }
+
+    m_Rng = rng;
+    std::memcpy(m_Slots.data(), data.data(), data.size());
+    return true;
+}
+
+}
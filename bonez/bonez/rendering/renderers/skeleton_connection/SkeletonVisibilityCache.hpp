@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <bonez/sys/memory.hpp>
+#include <bonez/utils/Graph.hpp>
+#include <bonez/sampling/Random.hpp>
+#include <bonez/rendering/RenderCheckpoint.hpp>
+
+namespace BnZ {
+
+// Visibility statistics between skeleton nodes and light vertices, reused across iterations to amortize the shadow
+// rays of the visibility distributions (see buildDistributions in SkeletonVisibilityDistributions.hpp).
+//
+// Light vertices change at each iteration but skeleton nodes never move, so the visibility from a node is accumulated
+// per target: the skeleton node nearest to a surface light vertex, or the light of an emission vertex. Each iteration
+// only traces the shadow rays of a subset of the light paths, chosen at random, and of the targets tested less than
+// MIN_TEST_COUNT times. The other weights use the estimated visibility.
+//
+// Each node has a fixed number of slots, a target is stored in the slot given by its hash and replaces the target
+// previously stored in it: the memory of the cache does not grow with the number of iterations.
+//
+// Resampling stays unbiased: the visibility distribution is only one of the distributions combined by the max heuristic
+// and the conservative distribution covers every light vertex.
+class SkeletonVisibilityCache {
+public:
+    static const uint32_t INVALID_TARGET = UNDEFINED_NODE;
+    static const uint32_t MIN_TEST_COUNT = 4u; // Shadow rays traced for a target before its estimate is used
+
+    // refreshRate is the fraction of the light paths whose shadow rays are traced at each iteration,
+    // slotCountPerNode the maximal number of targets whose statistics are kept for a node
+    SkeletonVisibilityCache(float refreshRate = 0.1f, uint32_t slotCountPerNode = 128u, uint32_t seed = 0u);
+
+    float getRefreshRate() const {
+        return m_fRefreshRate;
+    }
+
+    void setRefreshRate(float refreshRate);
+
+    uint32_t getSlotCountPerNode() const {
+        return m_nSlotCountPerNode;
+    }
+
+    // Clear all statistics, the nodes are those of a skeleton of nodeCount nodes
+    void reset(std::size_t nodeCount);
+
+    // Choose at random the light paths refreshed by the next iteration
+    void beginIteration();
+
+    // Target of a surface light vertex mapped to a skeleton node
+    static uint32_t getNodeTarget(GraphNodeIndex nearestNode) {
+        return nearestNode;
+    }
+
+    // Target of an emission vertex sampled on a light of the scene
+    uint32_t getLightTarget(int lightID) const {
+        return lightID < 0 ? INVALID_TARGET : uint32_t(m_nNodeCount + lightID);
+    }
+
+    // True if the visibility between the node and the light vertex must be tested with a shadow ray.
+    // Each node must be processed by only one thread at a time.
+    bool mustTrace(GraphNodeIndex node, uint32_t target, std::size_t pathIdx) const;
+
+    void addTest(GraphNodeIndex node, uint32_t target, bool visible);
+
+    // Estimated probability that a light vertex mapped to the target is visible from the node
+    float estimateVisibility(GraphNodeIndex node, uint32_t target);
+
+    // Shadow rays traced and visibilities estimated since the last call to beginIteration
+    uint64_t getTracedCount() const;
+
+    uint64_t getEstimatedCount() const;
+
+    // The statistics are stored in a buffer of the checkpoint, the state of the random generator in xml
+    void storeCheckpoint(RenderCheckpoint& checkpoint, tinyxml2::XMLElement& xml, const std::string& name) const;
+
+    // Return false if the checkpoint has been stored for another skeleton or slot count, in which case the cache is not modified
+    bool loadCheckpoint(const RenderCheckpoint& checkpoint, const tinyxml2::XMLElement& xml, const std::string& name);
+
+private:
+    struct Slot {
+        uint32_t m_nTarget = INVALID_TARGET;
+        uint32_t m_nVisibleCount = 0u;
+        uint32_t m_nTestCount = 0u;
+    };
+
+    // Padded so that threads processing different nodes don't share cache lines
+    struct NodeCounters {
+        uint64_t m_nTracedCount = 0u;
+        uint64_t m_nEstimatedCount = 0u;
+        uint8_t m_Padding[CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+    };
+
+    const Slot& getSlot(GraphNodeIndex node, uint32_t target) const {
+        auto hash = uint32_t((uint64_t(target) * 0x9E3779B97F4A7C15ull) >> 32);
+        return m_Slots[node * m_nSlotCountPerNode + hash % m_nSlotCountPerNode];
+    }
+
+    Slot& getSlot(GraphNodeIndex node, uint32_t target) {
+        return const_cast<Slot&>(static_cast<const SkeletonVisibilityCache&>(*this).getSlot(node, target));
+    }
+
+    float m_fRefreshRate;
+    std::size_t m_nRefreshPeriod; // A light path is refreshed every m_nRefreshPeriod iterations
+    std::size_t m_nRefreshOffset = 0u;
+    uint32_t m_nSlotCountPerNode;
+    std::size_t m_nNodeCount = 0u;
+    RandomGenerator m_Rng;
+
+    std::vector<Slot, TrackedAllocator<Slot>> m_Slots { TrackedAllocator<Slot>(MemoryTag::SkeletonDistributions) };
+    std::vector<NodeCounters, TrackedAllocator<NodeCounters>> m_NodeCounters { TrackedAllocator<NodeCounters>(MemoryTag::SkeletonDistributions) };
+};
+
+}
@@ -11,7 +11,8 @@ void buildDistributions(
         std::size_t lightPathCount,
         bool useNodeRadianceScale,
         bool useNodeDistanceScale,
-        std::size_t threadCount) {
+        std::size_t threadCount,
+        SkeletonVisibilityCache* pVisibilityCache) {
     auto maxDepth = surfaceLightVertexArray.size(0);
     auto pathCount = lightPathCount;
 
@@ -29,7 +30,43 @@ void buildDistributions(
         return 1.f;
     };
 
-    auto evalNodeVisibilityWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius) {
+    // Amortized mode: target of each light vertex in the visibility cache, indexed by depth * pathCount + pathIdx
+    std::vector<uint32_t> visibilityTargets;
+    if(pVisibilityCache) {
+        const auto& skel = *scene.getCurvSkeleton();
+        visibilityTargets.resize((maxDepth + 1) * pathCount, SkeletonVisibilityCache::INVALID_TARGET);
+        processTasks(pathCount, [&](uint32_t pathIdx, uint32_t threadID) {
+            const auto& emissionVertex = pEmissionVertexArray[pathIdx];
+            if(emissionVertex.m_pLight) {
+                visibilityTargets[pathIdx] = pVisibilityCache->getLightTarget(
+                            scene.getLightContainer().getLightID(emissionVertex.m_pLight));
+            }
+            for(auto depth = 1u; depth <= maxDepth; ++depth) {
+                const auto& lightVertex = surfaceLightVertexArray(depth - 1, pathIdx);
+                if(lightVertex.m_fPathPdf > 0.f) {
+                    visibilityTargets[depth * pathCount + pathIdx] =
+                            SkeletonVisibilityCache::getNodeTarget(skel.getNearestNode(lightVertex.m_Intersection));
+                }
+            }
+        }, threadCount);
+    }
+
+    // Visibility of a light vertex from a node: traced, or estimated from the cache in amortized mode
+    auto evalVisibility = [&](std::size_t depth, std::size_t pathIdx, GraphNodeIndex nodeIndex, const Ray& shadowRay) {
+        if(!pVisibilityCache) {
+            return scene.occluded(shadowRay) ? 0.f : 1.f;
+        }
+        auto target = visibilityTargets[depth * pathCount + pathIdx];
+        if(pVisibilityCache->mustTrace(nodeIndex, target, pathIdx)) {
+            auto visible = !scene.occluded(shadowRay);
+            pVisibilityCache->addTest(nodeIndex, target, visible);
+            return visible ? 1.f : 0.f;
+        }
+        return pVisibilityCache->estimateVisibility(nodeIndex, target);
+    };
+
+    auto evalNodeVisibilityWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius,
+                                     GraphNodeIndex nodeIndex) {
         if(!depth) {
             if(!pEmissionVertexArray[pathIdx].m_pLight ||
                     pEmissionVertexArray[pathIdx].m_fLightPdf == 0.f) {
@@ -46,11 +83,12 @@ void buildDistributions(
             if(L == zero<Vec3f>() || shadowRaySample.pdf == 0.f) {
                 return 0.f;
             }
-            if(scene.occluded(shadowRaySample.value)) {
+            auto visibility = evalVisibility(depth, pathIdx, nodeIndex, shadowRaySample.value);
+            if(visibility == 0.f) {
                 return 0.f;
             }
 
-            Vec3f weight(1.f);
+            Vec3f weight(visibility);
 
             if(useNodeRadianceScale) {
                 weight *= L;
@@ -72,11 +110,15 @@ void buildDistributions(
         auto l = BnZ::length(dir);
         dir /= l;
 
-        if(dot(I.Ns, dir) <= 0.f || scene.occluded(Ray(I, dir, l))) {
+        if(dot(I.Ns, dir) <= 0.f) {
+            return 0.f;
+        }
+        auto visibility = evalVisibility(depth, pathIdx, nodeIndex, Ray(I, dir, l));
+        if(visibility == 0.f) {
             return 0.f;
         }
 
-        Vec3f weight(1.f);
+        Vec3f weight(visibility);
 
         if(useNodeRadianceScale) {
             weight *= lightVertex.m_Power;
@@ -89,7 +131,8 @@ void buildDistributions(
         return luminance(weight);
     };
 
-    auto evalNodeGeometryWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius) {
+    auto evalNodeGeometryWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius,
+                                     GraphNodeIndex nodeIndex) {
         if(!depth) {
             if(!pEmissionVertexArray[pathIdx].m_pLight ||
                     pEmissionVertexArray[pathIdx].m_fLightPdf == 0.f) {
@@ -146,7 +189,8 @@ void buildDistributions(
         return luminance(weight);
     };
 
-    auto evalNodeConservativeWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius) {
+    auto evalNodeConservativeWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius,
+                                     GraphNodeIndex nodeIndex) {
         if(!depth) {
             if(!pEmissionVertexArray[pathIdx].m_pLight ||
                     pEmissionVertexArray[pathIdx].m_fLightPdf == 0.f) {
@@ -185,7 +229,8 @@ void buildDistributions(
         return 1.f;
     };
 
-    auto evalNodeVisibilityWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius) {
+    auto evalNodeVisibilityWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius,
+                                     GraphNodeIndex nodeIndex) {
         auto& lightVertex = surfacePointSamples[pathIdx];
         if(lightVertex.pdf == 0.f) {
             return 0.f;
@@ -209,7 +254,8 @@ void buildDistributions(
         return luminance(weight);
     };
 
-    auto evalNodeConservativeWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius) {
+    auto evalNodeConservativeWeight = [&](std::size_t depth, std::size_t pathIdx, const Vec3f& nodePosition, float nodeMaxballRadius,
+                                     GraphNodeIndex nodeIndex) {
         if(surfacePointSamples[pathIdx].pdf == 0.f) {
             return 0.f;
         }
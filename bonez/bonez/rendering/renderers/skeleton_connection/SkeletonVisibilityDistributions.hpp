@@ -6,6 +6,7 @@
 #include <bonez/sampling/distribution1d.h>
 
 #include "../recursive_mis_bdpt.hpp"
+#include "SkeletonVisibilityCache.hpp"
 
 namespace BnZ {
 
@@ -20,7 +21,8 @@ void buildDistributions(
         std::size_t lightPathCount,
         bool useNodeRadianceScale,
         bool useNodeDistanceScale,
-        std::size_t threadCount);
+        std::size_t threadCount,
+        SkeletonVisibilityCache* pVisibilityCache = nullptr); // Amortized mode if not null
 
 void buildDistributions(
         SkeletonVisibilityDistributions& distributions,
@@ -74,7 +76,7 @@ private:
               std::size_t distributionCount,
               EvalDefaultConservativeWeightFunctor&& evalDefaultConservativeWeight) {
         m_nLightPathCount = pathCount;
-        m_nDistributionSize = getDistribution1DBufferSize(pathCount);
+        m_nDistributionSize = getQuantizedDistribution1DBufferSize(pathCount);
 
         // BUILD DEFAULT DISTRIBUTIONS
         m_PerDepthDefaulConservativeDistributionsArray.resize(m_nDistributionSize, 1 + maxDepth);
@@ -85,7 +87,7 @@ private:
             }, m_PerDepthDefaulConservativeDistributionsArray.getSlicePtr(depth), pathCount);
         }
 
-        m_PerDepthPerNodeDistributions.resize(distributionCount);
+        m_PerDepthPerNodeDistributions.resize(distributionCount, Array3d<QuantizedCDFValue>(MemoryTag::SkeletonDistributions));
     }
 
     template<typename EvalWeightFunctor>
@@ -104,7 +106,7 @@ private:
 
             for(auto depth : range(maxDepth + 1)) {
                 buildDistribution1D([&](uint32_t pathIdx) {
-                    return evalWeight(depth, pathIdx, nodePos, nodeRadius);
+                    return evalWeight(depth, pathIdx, nodePos, nodeRadius, nodeIndex);
                 }, m_PerDepthPerNodeDistributions[distributionIndex].getSlicePtr(depth, indirectNodeIndex), m_nLightPathCount);
             }
         }, threadCount);
@@ -152,8 +154,8 @@ private:
 
     std::size_t m_nLightPathCount = 0u;
 
-    std::vector<Array3d<float>> m_PerDepthPerNodeDistributions;
-    Array2d<float> m_PerDepthDefaulConservativeDistributionsArray;
+    std::vector<Array3d<QuantizedCDFValue>> m_PerDepthPerNodeDistributions;
+    Array2d<QuantizedCDFValue> m_PerDepthDefaulConservativeDistributionsArray { MemoryTag::SkeletonDistributions };
     std::size_t m_nDistributionSize; // Size of a distribution for a given depth and a given node
 };
 
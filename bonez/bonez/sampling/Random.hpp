@@ -2,6 +2,7 @@
 
 #include <random>
 #include <algorithm>
+#include <sstream>
 #include <bonez/types.hpp>
 #include <bonez/utils/itertools/itertools.hpp>
 
@@ -51,6 +52,13 @@ public:
         m_nCallCount = 0u;
     }
 
+    // Initialize the whole state of the generator from a sequence of values, getSeed() then returns 0
+    void setSeed(std::seed_seq& seeds) {
+        m_Generator.seed(seeds);
+        m_nSeed = 0u;
+        m_nCallCount = 0u;
+    }
+
     uint32_t getSeed() const {
         return m_nSeed;
     }
@@ -95,6 +103,19 @@ public:
         m_nCallCount += callCount;
     }
 
+    // Complete state of the generator, used to resume a sequence after a checkpoint
+    std::string getState() const {
+        std::stringstream ss;
+        ss << m_nSeed << " " << m_nCallCount << " " << m_Generator;
+        return ss.str();
+    }
+
+    bool setState(const std::string& state) {
+        std::stringstream ss(state);
+        ss >> m_nSeed >> m_nCallCount >> m_Generator;
+        return !ss.fail();
+    }
+
 private:
     Generator m_Generator;
     std::uniform_real_distribution<float> m_Distribution;
@@ -113,6 +134,15 @@ inline uint32_t getTileSeed(uint32_t frameID, const Vec4u& tileViewport,
             frameID * imageSize.x * imageSize.y;
 }
 
+// Seed the random sequence of a path from the seed of the renderer, the frame and the path, independently of the thread
+// processing it. The state of the generator is hashed from all these values by a std::seed_seq, so path sequences
+// neither repeat across frames nor overlap those of a ThreadsRandomGenerator, seeded with consecutive integers.
+inline void setPathSeed(RandomGenerator& rng, uint32_t seed, uint32_t frameID, uint32_t pathID) {
+    static const uint32_t PATH_SEED_TAG = 0x9E3779B9u; // Distinguish path sequences from other seed sequences
+    std::seed_seq seeds { PATH_SEED_TAG, seed, frameID, pathID };
+    rng.setSeed(seeds);
+}
+
 class ThreadsRandomGenerator {
 public:
     ThreadsRandomGenerator() = default;
@@ -168,6 +198,14 @@ public:
         return m_RandomGenerators[threadID];
     }
 
+    const RandomGenerator& getGenerator(uint32_t threadID) const {
+        return m_RandomGenerators[threadID];
+    }
+
+    std::size_t getThreadCount() const {
+        return m_RandomGenerators.size();
+    }
+
 private:
     std::vector<RandomGenerator> m_RandomGenerators;
 };
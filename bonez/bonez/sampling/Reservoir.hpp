@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+
+namespace BnZ {
+
+// Weighted reservoir that keeps one element of a stream of candidates, for resampled importance sampling (RIS).
+//
+// Candidates x_1, ..., x_M are drawn from a source distribution p and added with their target density t(x_i). The kept
+// candidate y is chosen with probability proportional to t(x_i) / p(x_i) and f(y) * getContributionWeight() is an
+// unbiased estimate of the integral of f as long as t is positive wherever f is. The memory is constant in the number
+// of candidates, so no distribution has to be built over them.
+template<typename T>
+class Reservoir {
+public:
+    // s is a uniform random number in [0, 1). Return true if the candidate replaces the current sample.
+    bool add(const T& candidate, float targetPdf, float sourcePdf, float s) {
+        ++m_nCandidateCount;
+        if(targetPdf <= 0.f || sourcePdf <= 0.f) {
+            return false;
+        }
+        auto weight = targetPdf / sourcePdf;
+        m_fWeightSum += weight;
+        if(s * m_fWeightSum < weight) {
+            m_Sample = candidate;
+            m_fSampleTargetPdf = targetPdf;
+            return true;
+        }
+        return false;
+    }
+
+    // True if no candidate has a positive weight, then the estimate is zero
+    bool empty() const {
+        return m_fSampleTargetPdf == 0.f;
+    }
+
+    const T& getSample() const {
+        return m_Sample;
+    }
+
+    float getSampleTargetPdf() const {
+        return m_fSampleTargetPdf;
+    }
+
+    float getWeightSum() const {
+        return m_fWeightSum;
+    }
+
+    uint32_t getCandidateCount() const {
+        return m_nCandidateCount;
+    }
+
+    // Unbiased contribution weight of the sample: sum of the weights / (candidate count * target pdf of the sample)
+    float getContributionWeight() const {
+        if(empty()) {
+            return 0.f;
+        }
+        return m_fWeightSum / (m_nCandidateCount * m_fSampleTargetPdf);
+    }
+
+private:
+    T m_Sample = T();
+    float m_fSampleTargetPdf = 0.f;
+    float m_fWeightSum = 0.f;
+    uint32_t m_nCandidateCount = 0u;
+};
+
+}
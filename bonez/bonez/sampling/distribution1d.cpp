@@ -16,6 +16,7 @@
 
 #include "distribution1d.h"
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <bonez/maths/maths.hpp>
 #include <bonez/sys/threads.hpp>
@@ -51,9 +52,71 @@ float pdfDiscreteDistribution1D(const float* pCDF, uint32_t i) {
     return (pCDF[i + 1] - pCDF[i]);
 }
 
-float cdfDiscreteDistribution1D(const float* pCDF, uint32_t i) {
-    return pCDF[i];
+void quantizeDistribution1D(const float* pCDF, size_t size, QuantizedCDFValue* pQuantizedCDF) {
+    if(usesFloatCDF(size)) {
+        pQuantizedCDF[0] = FLOAT_CDF_MARKER;
+        std::memcpy(pQuantizedCDF + 1, pCDF, (size + 1) * sizeof(float));
+        return;
+    }
+
+    if(pCDF[size] == 0.f) {
+        std::fill(pQuantizedCDF, pQuantizedCDF + size + 1, QuantizedCDFValue(0));
+        return;
+    }
+
+    uint32_t nonZeroCount = 0u;
+    for(auto i = 0u; i < size; ++i) {
+        if(pCDF[i + 1] > pCDF[i]) {
+            ++nonZeroCount;
+        }
+    }
+
+    // One unit is reserved for each element with a non-zero weight, such that rounding can't make it impossible to sample.
+    // The format is chosen such that nonZeroCount <= size <= QUANTIZED_CDF_MAX / 2.
+    auto scale = float(QUANTIZED_CDF_MAX - nonZeroCount);
+
+    uint32_t reservedSum = 0u;
+    uint32_t previousValue = 0u;
+    pQuantizedCDF[0] = 0u;
+    for(auto i = 0u; i < size; ++i) {
+        if(pCDF[i + 1] > pCDF[i]) {
+            ++reservedSum;
+        }
+        auto value = std::min(uint32_t(pCDF[i + 1] * scale + 0.5f) + reservedSum, QUANTIZED_CDF_MAX);
+        previousValue = std::max(value, previousValue);
+        pQuantizedCDF[i + 1] = QuantizedCDFValue(previousValue);
+    }
+    pQuantizedCDF[size] = QUANTIZED_CDF_MAX;
 }
 
+Sample1u sampleDiscreteDistribution1D(const QuantizedCDFValue* pCDF, size_t size, float s1D) {
+    if(pCDF[0] == FLOAT_CDF_MARKER) {
+        if(getFloatCDFValue(pCDF, size) == 0.f) {
+            return Sample1u(0u, 0.f);
+        }
+
+        // Same as std::upper_bound on the float CDF, whose values are not aligned in the buffer
+        size_t first = 0u, count = size;
+        while(count > 0u) {
+            auto step = count / 2;
+            if(!(s1D < getFloatCDFValue(pCDF, first + step))) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        int i = clamp(int(first) - 1, 0, int(size) - 1);
+        return Sample1u(i, pdfDiscreteDistribution1D(pCDF, i));
+    }
+
+    if(pCDF[size] == 0) {
+        return Sample1u(0u, 0.f);
+    }
+
+    auto ptr = std::upper_bound(pCDF, pCDF + size, s1D * QUANTIZED_CDF_MAX);
+    int i = clamp(int(ptr - pCDF - 1), 0, int(size) - 1);
+    return Sample1u(i, pdfDiscreteDistribution1D(pCDF, i));
 }
 
+}
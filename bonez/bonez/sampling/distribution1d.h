@@ -3,6 +3,8 @@
 #include <bonez/sampling/Sample.hpp>
 #include <iostream>
 #include <algorithm>
+#include <vector>
+#include <cstring>
 #include <bonez/sys/threads.hpp>
 
 namespace BnZ {
@@ -54,14 +56,76 @@ float pdfContinuousDistribution1D(const float* pCDF, size_t size, float x);
 
 float pdfDiscreteDistribution1D(const float* pCDF, uint32_t idx);
 
-float cdfDiscreteDistribution1D(const float* pCDF, uint32_t idx);
+inline float cdfDiscreteDistribution1D(const float* pCDF, uint32_t idx) {
+    return pCDF[idx];
+}
+
+// Compressed storage of a discrete distribution: the normalized CDF is quantized on 16 bits, which halves the memory
+// and bandwidth of float CDFs. The pdf of an element is the difference of two consecutive quantized values, so sampling
+// and pdf evaluation are exactly consistent with each other and estimators remain unbiased.
+//
+// Each element with a non-zero weight is reserved one quantization step so that it keeps a non-zero probability. 16 bits
+// can only guarantee it for distributions of at most QUANTIZED_CDF_MAX / 2 elements: larger ones keep their float CDF,
+// each float being stored in two 16-bit values, and are sampled exactly as a float CDF. The first value of the buffer
+// tells the format, since the first value of a 16-bit CDF is always 0.
+using QuantizedCDFValue = uint16_t;
+
+static const uint32_t QUANTIZED_CDF_MAX = 0xFFFF;
+static const QuantizedCDFValue FLOAT_CDF_MARKER = 1;
+
+inline bool usesFloatCDF(size_t size) {
+    return size > QUANTIZED_CDF_MAX / 2;
+}
+
+// Number of values of the buffer of a quantized distribution of size elements
+inline size_t getQuantizedDistribution1DBufferSize(size_t size) {
+    return usesFloatCDF(size) ? 1 + 2 * (size + 1) : size + 1;
+}
+
+// Value idx of the CDF of a distribution stored as floats
+inline float getFloatCDFValue(const QuantizedCDFValue* pCDF, size_t idx) {
+    float value;
+    std::memcpy(&value, pCDF + 1 + 2 * idx, sizeof(float));
+    return value;
+}
+
+// Quantize a CDF built by buildDistribution1D. pQuantizedCDF must point to a buffer containing
+// getQuantizedDistribution1DBufferSize(size) values.
+void quantizeDistribution1D(const float* pCDF, size_t size, QuantizedCDFValue* pQuantizedCDF);
+
+// Same as buildDistribution1D, but the CDF is quantized in a buffer of getQuantizedDistribution1DBufferSize(size) values.
+// It is safe for function(i) to read pCDF.
+template<typename Functor>
+void buildDistribution1D(const Functor& function, QuantizedCDFValue* pCDF, size_t size,
+                         float* pSum = nullptr) {
+    thread_local std::vector<float> floatCDF;
+    floatCDF.resize(getDistribution1DBufferSize(size));
+    buildDistribution1D(function, floatCDF.data(), size, pSum);
+    quantizeDistribution1D(floatCDF.data(), size, pCDF);
+}
+
+Sample1u sampleDiscreteDistribution1D(const QuantizedCDFValue* pCDF, size_t size, float s1D);
+
+inline float pdfDiscreteDistribution1D(const QuantizedCDFValue* pCDF, uint32_t idx) {
+    if(pCDF[0] == FLOAT_CDF_MARKER) {
+        return getFloatCDFValue(pCDF, idx + 1) - getFloatCDFValue(pCDF, idx);
+    }
+    return float(pCDF[idx + 1] - pCDF[idx]) / QUANTIZED_CDF_MAX;
+}
+
+inline float cdfDiscreteDistribution1D(const QuantizedCDFValue* pCDF, uint32_t idx) {
+    if(pCDF[0] == FLOAT_CDF_MARKER) {
+        return getFloatCDFValue(pCDF, idx);
+    }
+    return float(pCDF[idx]) / QUANTIZED_CDF_MAX;
+}
 
 template<typename GetCDFPtrFunction>
 float pdfCombinedDiscreteDistribution1D(size_t distributionCount, const GetCDFPtrFunction& getCDFPtr, uint32_t idx) {
     auto computeUnormalizedCDF = [&](uint32_t idx) {
         float sum = 0.f;
         for(auto i = 0u; i < distributionCount; ++i) {
-            sum += getCDFPtr(i)[idx];
+            sum += cdfDiscreteDistribution1D(getCDFPtr(i), idx);
         }
         return sum;
     };
@@ -89,7 +153,7 @@ Sample1u sampleCombinedDiscreteDistribution(std::size_t distributionCount, const
         float computeCurrentValue() const {
             float sum = 0.f;
             for(auto i = 0u; i < m_pData->m_nDistributionCount; ++i) {
-                sum += (*m_pData->m_pGetCDFPtr)(i)[m_nCurrentElement];
+                sum += cdfDiscreteDistribution1D((*m_pData->m_pGetCDFPtr)(i), uint32_t(m_nCurrentElement));
             }
             return sum * m_pData->m_fRcpDistributionCount;
         }
@@ -34,46 +34,78 @@ void Scene::extractAreaLights() {
 }
 
 void Scene::buildSamplingDistribution() {
-    m_fTotalArea = 0.f;
+    auto threadCount = getSystemThreadCount();
+    const auto& meshs = m_Geometry.getMeshs();
 
-    m_MeshSamplingDistribution.resize(getDistribution1DBufferSize(m_Geometry.getMeshCount()));
-    m_MeshDistributionOffsets.reserve(m_Geometry.getMeshCount());
+    // Triangle distributions are built in the local space of the meshes, so they are shared by all the instances
+    // of a prototype mesh. The world space area of the sampled triangle is used to compute the pdf.
+    m_MeshDistributionOffsets.resize(meshs.size());
     auto offset = 0u;
-    for(const auto& mesh: m_Geometry.getMeshs()) {
-        m_MeshDistributionOffsets.emplace_back(offset);
-        auto distSize = getDistribution1DBufferSize(mesh.getTriangleCount());
-        offset += distSize;
+    for(auto meshID = 0u; meshID < meshs.size(); ++meshID) {
+        m_MeshDistributionOffsets[meshID] = offset;
+        offset += getDistribution1DBufferSize(meshs[meshID].getTriangleCount());
     }
     m_TriangleSamplingDistributions.resize(offset);
-    auto i = 0u;
-    for(const auto& mesh: m_Geometry.getMeshs()) {
-        auto totalArea = 0.f;
-        auto offset = m_MeshDistributionOffsets[i];
-        auto ptr = m_TriangleSamplingDistributions.data() + offset;
-        for(auto triangleIndex = 0u; triangleIndex < mesh.getTriangleCount(); ++triangleIndex) {
-            auto area = mesh.getTriangleArea(triangleIndex);
-            ptr[triangleIndex] = area;
-            totalArea += area;
+
+    // Triangle areas are computed by blocks, so that large meshes are spread over all threads
+    static const uint32_t TRIANGLE_BLOCK_SIZE = 4096u;
+    std::vector<Vec2u> triangleBlocks; // Mesh and first triangle of each block
+    for(auto meshID = 0u; meshID < meshs.size(); ++meshID) {
+        for(auto triangleIndex = 0u; triangleIndex < meshs[meshID].getTriangleCount(); triangleIndex += TRIANGLE_BLOCK_SIZE) {
+            triangleBlocks.emplace_back(meshID, triangleIndex);
         }
+    }
+    processTasks(triangleBlocks.size(), [&](uint32_t blockID, uint32_t threadID) {
+        auto meshID = triangleBlocks[blockID].x;
+        const auto& mesh = meshs[meshID];
+        auto ptr = m_TriangleSamplingDistributions.data() + m_MeshDistributionOffsets[meshID];
+        auto end = std::min(triangleBlocks[blockID].y + TRIANGLE_BLOCK_SIZE, uint32_t(mesh.getTriangleCount()));
+        for(auto triangleIndex = triangleBlocks[blockID].y; triangleIndex < end; ++triangleIndex) {
+            ptr[triangleIndex] = mesh.getTriangleArea(triangleIndex);
+        }
+    }, threadCount);
 
+    // The prefix sum of each mesh is sequential, so the CDFs are bit-identical to the ones of a serial build
+    std::vector<float> localMeshAreas(meshs.size());
+    processTasks(meshs.size(), [&](uint32_t meshID, uint32_t threadID) {
+        auto ptr = m_TriangleSamplingDistributions.data() + m_MeshDistributionOffsets[meshID];
         buildDistribution1D(
             [ptr](uint32_t triangleIndex) {
                 return ptr[triangleIndex];
             },
             ptr,
-            mesh.getTriangleCount());
-        m_MeshSamplingDistribution[i] = totalArea;
-        ++i;
+            meshs[meshID].getTriangleCount(),
+            &localMeshAreas[meshID]);
+    }, threadCount);
+
+    m_PlacedMeshIDs.clear();
+    m_Geometry.forEachPlacedMesh([&](uint32_t meshID, const TriangleMesh& mesh) {
+        m_PlacedMeshIDs.emplace_back(meshID);
+    });
+
+    std::vector<float> meshAreas(m_PlacedMeshIDs.size());
+    processTasks(m_PlacedMeshIDs.size(), [&](uint32_t i, uint32_t threadID) {
+        auto meshID = m_PlacedMeshIDs[i];
+        if(!SceneGeometry::isInstancedMesh(meshID)) {
+            meshAreas[i] = localMeshAreas[meshID];
+            return;
+        }
+        auto totalArea = 0.f;
+        for(auto triangleIndex = 0u; triangleIndex < m_Geometry.getMesh(meshID).getTriangleCount(); ++triangleIndex) {
+            totalArea += m_Geometry.getTriangleArea(meshID, triangleIndex);
+        }
+        meshAreas[i] = totalArea;
+    }, threadCount);
 
-        m_fTotalArea += totalArea;
-    }
+    m_MeshSamplingDistribution.resize(getDistribution1DBufferSize(m_PlacedMeshIDs.size()));
     auto ptr = m_MeshSamplingDistribution.data();
     buildDistribution1D(
         [&](uint32_t meshIndex) {
-            return ptr[meshIndex];
+            return meshAreas[meshIndex];
         },
         ptr,
-        m_Geometry.getMeshCount());
+        m_PlacedMeshIDs.size(),
+        &m_fTotalArea);
 
     m_fTotalArea *= 2.f; // Both side of each triangle to take into account
 }
@@ -102,10 +134,35 @@ Intersection Scene::intersect(const Ray& ray) const {
     return postIntersect(ray, hit);
 }
 
+void Scene::intersect(const Ray* pRays, std::size_t rayCount, Intersection* pIntersections, uint32_t threadID) const {
+    RTScene::Hit hits[RTScene::RAY_PACKET_SIZE];
+    bool results[RTScene::RAY_PACKET_SIZE];
+
+    for(auto offset = std::size_t(0); offset < rayCount; offset += RTScene::RAY_PACKET_SIZE) {
+        auto packetSize = std::min(RTScene::RAY_PACKET_SIZE, rayCount - offset);
+        m_RTScene.intersect(pRays + offset, packetSize, hits, results, threadID);
+
+        for(auto i = 0u; i < packetSize; ++i) {
+            const auto& ray = pRays[offset + i];
+            if(results[i]) {
+                pIntersections[offset + i] = postIntersect(ray, hits[i]);
+            } else {
+                Intersection I;
+                I.Le = Le(ray.dir);
+                pIntersections[offset + i] = I;
+            }
+        }
+    }
+}
+
 bool Scene::occluded(const Ray& ray) const {
     return m_RTScene.occluded(ray);
 }
 
+void Scene::occluded(const Ray* pRays, std::size_t rayCount, bool* pResults, uint32_t threadID) const {
+    m_RTScene.occluded(pRays, rayCount, pResults, threadID);
+}
+
 void Scene::uniformSampleSurfacePoints(uint32_t count,
                                        const float* s1DMeshBuffer, // Used to sample a mesh
                                        const float* s1DTriangleBuffer, // Used to sample a triangle
@@ -114,11 +171,13 @@ void Scene::uniformSampleSurfacePoints(uint32_t count,
                                        SurfacePointSample* sampledPointsBuffer) const {
     for(auto i = 0u; i < count; ++i) {
         auto sampledMesh = sampleDiscreteDistribution1D(m_MeshSamplingDistribution.data(),
-                                                        m_Geometry.getMeshCount(),
+                                                        m_PlacedMeshIDs.size(),
                                                         s1DMeshBuffer[i]);
         if(sampledMesh.pdf > 0.f) {
-            const auto& mesh = m_Geometry.getMesh(sampledMesh.value);
-            auto sampledTriangle = sampleDiscreteDistribution1D(m_TriangleSamplingDistributions.data() + m_MeshDistributionOffsets[sampledMesh.value],
+            auto meshID = m_PlacedMeshIDs[sampledMesh.value];
+            auto storedMeshID = m_Geometry.getStoredMeshID(meshID);
+            const auto& mesh = m_Geometry.getMeshs()[storedMeshID];
+            auto sampledTriangle = sampleDiscreteDistribution1D(m_TriangleSamplingDistributions.data() + m_MeshDistributionOffsets[storedMeshID],
                                                                 mesh.getTriangleCount(),
                                                                 s1DTriangleBuffer[i]);
             if(sampledTriangle.pdf > 0.f) {
@@ -127,9 +186,9 @@ void Scene::uniformSampleSurfacePoints(uint32_t count,
                                                           mesh.getVertex(triangle.v0).position,
                                                           mesh.getVertex(triangle.v1).position,
                                                           mesh.getVertex(triangle.v2).position);
-                auto area = mesh.getTriangleArea(sampledTriangle.value);
+                auto area = m_Geometry.getTriangleArea(meshID, sampledTriangle.value);
 
-                m_Geometry.getSurfacePoint(sampledMesh.value, sampledTriangle.value,
+                m_Geometry.getSurfacePoint(meshID, sampledTriangle.value,
                                            sampledUV.x, sampledUV.y, sampledPointsBuffer[i].value);
                 sampledPointsBuffer[i].pdf = 0.5f * sampledTriangle.pdf * sampledMesh.pdf / area; // 0.5f stands for the side selection
 
@@ -49,8 +49,15 @@ public:
 
     Intersection intersect(const Ray& ray) const;
 
+    // Intersection of a batch of coherent rays, traced by packets. threadID identifies the calling thread for the
+    // per-thread state of the ray tracing scene.
+    void intersect(const Ray* pRays, std::size_t rayCount, Intersection* pIntersections, uint32_t threadID = 0u) const;
+
     bool occluded(const Ray& ray) const;
 
+    // Occlusion test of a batch of coherent rays, traced by packets: pResults[i] is true if pRays[i] is occluded
+    void occluded(const Ray* pRays, std::size_t rayCount, bool* pResults, uint32_t threadID = 0u) const;
+
     const BBox3f& getBBox() const {
         return m_Geometry.getBBox();
     }
@@ -113,11 +120,13 @@ public:
             auto sample = getSample(i);
 
             auto sampledMesh = sampleDiscreteDistribution1D(m_MeshSamplingDistribution.data(),
-                                                            m_Geometry.getMeshCount(),
+                                                            m_PlacedMeshIDs.size(),
                                                             sample.meshSample);
             if(sampledMesh.pdf > 0.f) {
-                const auto& mesh = m_Geometry.getMesh(sampledMesh.value);
-                auto sampledTriangle = sampleDiscreteDistribution1D(m_TriangleSamplingDistributions.data() + m_MeshDistributionOffsets[sampledMesh.value],
+                auto meshID = m_PlacedMeshIDs[sampledMesh.value];
+                auto storedMeshID = m_Geometry.getStoredMeshID(meshID);
+                const auto& mesh = m_Geometry.getMeshs()[storedMeshID];
+                auto sampledTriangle = sampleDiscreteDistribution1D(m_TriangleSamplingDistributions.data() + m_MeshDistributionOffsets[storedMeshID],
                                                                     mesh.getTriangleCount(),
                                                                     sample.triangleSample);
                 if(sampledTriangle.pdf > 0.f) {
@@ -126,10 +135,10 @@ public:
                                                               mesh.getVertex(triangle.v0).position,
                                                               mesh.getVertex(triangle.v1).position,
                                                               mesh.getVertex(triangle.v2).position);
-                    auto area = mesh.getTriangleArea(sampledTriangle.value);
+                    auto area = m_Geometry.getTriangleArea(meshID, sampledTriangle.value);
 
                     SurfacePoint point;
-                    m_Geometry.getSurfacePoint(sampledMesh.value, sampledTriangle.value,
+                    m_Geometry.getSurfacePoint(meshID, sampledTriangle.value,
                                                sampledUV.x, sampledUV.y, point);
                     auto pdf = 0.5f * sampledTriangle.pdf * sampledMesh.pdf / area; // 0.5f stands for the side selection
 
@@ -184,8 +193,9 @@ private:
     Shared<const CurvilinearSkeleton> m_pCurvSkel;
     Shared<const GLScene> m_pGLScene;
 
+    std::vector<uint32_t> m_PlacedMeshIDs; // Meshes placed in the scene, regular and instanced, sampled by m_MeshSamplingDistribution
     std::vector<float> m_MeshSamplingDistribution;
-    std::vector<uint32_t> m_MeshDistributionOffsets;
+    std::vector<uint32_t> m_MeshDistributionOffsets; // Offset of the triangle distribution of each mesh of the geometry
     std::vector<float> m_TriangleSamplingDistributions;
 
     float m_fTotalArea = 0.f;
@@ -233,14 +233,18 @@ void SceneGeometry::postIntersect(const Ray& ray, Intersection& I) const {
     float v = I.uv.y;
     float w = 1.f - u - v;
 
-    const auto& mesh = m_TriangleMeshs[I.meshID];
+    const auto& mesh = getMesh(I.meshID);
     const auto& triangle = mesh.m_Triangles[I.triangleID];
 
     const auto& v0 = mesh.m_Vertices[triangle.v0];
     const auto& v1 = mesh.m_Vertices[triangle.v1];
     const auto& v2 = mesh.m_Vertices[triangle.v2];
 
-    I.Ns = normalize(w * v0.normal + u * v1.normal + v * v2.normal);
+    I.Ns = w * v0.normal + u * v1.normal + v * v2.normal;
+    if(isInstancedMesh(I.meshID)) {
+        I.Ns = getInstance(I.meshID).m_NormalMatrix * I.Ns;
+    }
+    I.Ns = normalize(I.Ns);
 
     if(glm::dot(-ray.dir, I.Ns) > 0.f) {
         I.Le = m_Materials[mesh.m_MaterialID].m_EmittedRadiance;
@@ -255,7 +259,7 @@ void SceneGeometry::postIntersect(const Ray& ray, Intersection& I) const {
 void SceneGeometry::getSurfacePoint(uint32_t meshID, uint32_t triangleID,
                                     float u, float v, SurfacePoint& point) const {
     float w = 1.f - u - v;
-    const auto& mesh = m_TriangleMeshs[meshID];
+    const auto& mesh = getMesh(meshID);
     const auto& triangle = mesh.m_Triangles[triangleID];
 
     const auto& v0 = mesh.m_Vertices[triangle.v0];
@@ -268,13 +272,194 @@ void SceneGeometry::getSurfacePoint(uint32_t meshID, uint32_t triangleID,
     point.meshID = meshID;
     point.triangleID = triangleID;
     point.P = w * v0.position + u * v1.position + v * v2.position;
-    point.Ng = normalize(cross(e0, e1));
+    point.Ng = cross(e0, e1);
     point.uv = Vec2f(u, v);
-    point.Ns = normalize(w * v0.normal + u * v1.normal + v * v2.normal);
+    point.Ns = w * v0.normal + u * v1.normal + v * v2.normal;
+    if(isInstancedMesh(meshID)) {
+        const auto& instance = getInstance(meshID);
+        point.P = Vec3f(instance.m_LocalToWorldMatrix * Vec4f(point.P, 1.f));
+        point.Ng = instance.m_NormalMatrix * point.Ng;
+        point.Ns = instance.m_NormalMatrix * point.Ns;
+    }
+    point.Ng = normalize(point.Ng);
+    point.Ns = normalize(point.Ns);
     faceForward(point.Ns, point.Ng);
     point.texCoords = w * v0.texCoords + u * v1.texCoords + v * v2.texCoords;
 }
 
+float SceneGeometry::getTriangleArea(uint32_t meshID, uint32_t triangleID) const {
+    if(!isInstancedMesh(meshID)) {
+        return m_TriangleMeshs[meshID].getTriangleArea(triangleID);
+    }
+    const auto& mesh = getMesh(meshID);
+    const auto& triangle = mesh.m_Triangles[triangleID];
+    const auto& localToWorldMatrix = getInstance(meshID).m_LocalToWorldMatrix;
+
+    auto p0 = Vec3f(localToWorldMatrix * Vec4f(mesh.m_Vertices[triangle.v0].position, 1.f));
+    auto p1 = Vec3f(localToWorldMatrix * Vec4f(mesh.m_Vertices[triangle.v1].position, 1.f));
+    auto p2 = Vec3f(localToWorldMatrix * Vec4f(mesh.m_Vertices[triangle.v2].position, 1.f));
+    return 0.5f * length(cross(p1 - p0, p2 - p0));
+}
+
+static BBox3f transformBBox(const BBox3f& bbox, const Mat4f& matrix) {
+    BBox3f result;
+    for(auto i = 0u; i < 8u; ++i) {
+        auto corner = Vec3f((i & 1u) ? bbox.upper.x : bbox.lower.x,
+                            (i & 2u) ? bbox.upper.y : bbox.lower.y,
+                            (i & 4u) ? bbox.upper.z : bbox.lower.z);
+        result.grow(Vec3f(matrix * Vec4f(corner, 1.f)));
+    }
+    return result;
+}
+
+void SceneGeometry::updateBBox() {
+    m_BBox = BBox3f();
+    for(const auto& mesh: m_TriangleMeshs) {
+        if(!mesh.m_bIsPrototype) {
+            m_BBox.grow(mesh.m_BBox);
+        }
+    }
+    for(const auto& instance: m_Instances) {
+        m_BBox.grow(instance.m_BBox);
+    }
+}
+
+void SceneGeometry::transform(const Mat4f& localToWorldMatrix) {
+    for(auto& mesh: m_TriangleMeshs) {
+        if(!mesh.m_bIsPrototype) {
+            mesh.transform(localToWorldMatrix);
+        }
+    }
+    for(auto& instance: m_Instances) {
+        instance.m_LocalToWorldMatrix = localToWorldMatrix * instance.m_LocalToWorldMatrix;
+        instance.m_NormalMatrix = transpose(inverse(Mat3f(instance.m_LocalToWorldMatrix)));
+        instance.m_BBox = transformBBox(m_Prototypes[instance.m_nPrototypeID].m_BBox, instance.m_LocalToWorldMatrix);
+    }
+    if(!m_TriangleMeshs.empty() || !m_Instances.empty()) {
+        updateBBox();
+    }
+}
+
+void SceneGeometry::append(SceneGeometry geometry) {
+    if(m_TriangleMeshs.empty() && m_Instances.empty()) {
+        m_BBox = geometry.m_BBox;
+    } else {
+        m_BBox.grow(geometry.m_BBox);
+    }
+    auto materialOffset = m_Materials.size();
+    auto meshOffset = uint32_t(m_TriangleMeshs.size());
+    auto prototypeOffset = uint32_t(m_Prototypes.size());
+    for(auto& material: geometry.m_Materials) {
+        m_Materials.emplace_back(std::move(material));
+    }
+    for(auto& mesh: geometry.m_TriangleMeshs) {
+        m_TriangleMeshs.emplace_back(std::move(mesh));
+        m_TriangleMeshs.back().m_MaterialID += uint32_t(materialOffset);
+//            if(isEmissive(m_Materials[m_TriangleMeshs.back().m_MaterialID])) {
+//                m_EmissiveMeshs.emplace_back(m_TriangleMeshs.size() - 1);
+//            }
+    }
+    for(auto& prototype: geometry.m_Prototypes) {
+        prototype.m_nFirstMeshID += meshOffset;
+        for(auto& nestedInstance: prototype.m_NestedInstances) {
+            nestedInstance.first += prototypeOffset;
+        }
+        m_Prototypes.emplace_back(std::move(prototype));
+    }
+    // Nested instances are already flattened in the instance list of geometry
+    for(const auto& instance: geometry.m_Instances) {
+        placeInstance(instance.m_nPrototypeID + prototypeOffset, instance.m_LocalToWorldMatrix);
+    }
+}
+
+uint32_t SceneGeometry::addPrototype(SceneGeometry geometry) {
+    auto materialOffset = uint32_t(m_Materials.size());
+    auto prototypeOffset = uint32_t(m_Prototypes.size());
+    for(auto& material: geometry.m_Materials) {
+        m_Materials.emplace_back(std::move(material));
+    }
+
+    // The meshes of the nested prototypes are moved first such that the meshes placed in geometry are consecutive
+    std::vector<uint32_t> meshIDs(geometry.m_TriangleMeshs.size());
+    for(auto i = 0u; i < geometry.m_TriangleMeshs.size(); ++i) {
+        if(geometry.m_TriangleMeshs[i].m_bIsPrototype) {
+            meshIDs[i] = uint32_t(m_TriangleMeshs.size());
+            m_TriangleMeshs.emplace_back(std::move(geometry.m_TriangleMeshs[i]));
+            m_TriangleMeshs.back().m_MaterialID += materialOffset;
+        }
+    }
+
+    MeshPrototype prototype;
+    prototype.m_nFirstMeshID = uint32_t(m_TriangleMeshs.size());
+    for(auto i = 0u; i < geometry.m_TriangleMeshs.size(); ++i) {
+        if(!geometry.m_TriangleMeshs[i].m_bIsPrototype) {
+            meshIDs[i] = uint32_t(m_TriangleMeshs.size());
+            m_TriangleMeshs.emplace_back(std::move(geometry.m_TriangleMeshs[i]));
+
+            auto& mesh = m_TriangleMeshs.back();
+            mesh.m_MaterialID += materialOffset;
+            mesh.m_bIsPrototype = true;
+            prototype.m_BBox.grow(mesh.m_BBox);
+            if(isEmissive(m_Materials[mesh.m_MaterialID])) {
+                prototype.m_bIsExpanded = true;
+            }
+        }
+    }
+    prototype.m_nMeshCount = uint32_t(m_TriangleMeshs.size()) - prototype.m_nFirstMeshID;
+
+    for(auto& nestedPrototype: geometry.m_Prototypes) {
+        nestedPrototype.m_nFirstMeshID = nestedPrototype.m_nMeshCount ? meshIDs[nestedPrototype.m_nFirstMeshID] : 0u;
+        for(auto& nestedInstance: nestedPrototype.m_NestedInstances) {
+            nestedInstance.first += prototypeOffset;
+        }
+        m_Prototypes.emplace_back(std::move(nestedPrototype));
+    }
+    for(const auto& instance: geometry.m_Instances) {
+        prototype.m_NestedInstances.emplace_back(instance.m_nPrototypeID + prototypeOffset, instance.m_LocalToWorldMatrix);
+    }
+
+    m_Prototypes.emplace_back(std::move(prototype));
+    return uint32_t(m_Prototypes.size() - 1);
+}
+
+void SceneGeometry::addInstance(uint32_t prototypeID, const Mat4f& localToWorldMatrix) {
+    placeInstance(prototypeID, localToWorldMatrix);
+    for(const auto& nestedInstance: m_Prototypes[prototypeID].m_NestedInstances) {
+        placeInstance(nestedInstance.first, localToWorldMatrix * nestedInstance.second);
+    }
+}
+
+void SceneGeometry::placeInstance(uint32_t prototypeID, const Mat4f& localToWorldMatrix) {
+    const auto& prototype = m_Prototypes[prototypeID];
+    if(!prototype.m_nMeshCount) {
+        return;
+    }
+
+    if(prototype.m_bIsExpanded) {
+        for(auto i = 0u; i < prototype.m_nMeshCount; ++i) {
+            auto mesh = m_TriangleMeshs[prototype.m_nFirstMeshID + i];
+            mesh.m_bIsPrototype = false;
+            mesh.transform(localToWorldMatrix);
+            append(std::move(mesh));
+        }
+        return;
+    }
+
+    MeshInstance instance;
+    instance.m_nPrototypeID = prototypeID;
+    instance.m_nFirstMeshID = uint32_t(m_InstancedMeshes.size()) | INSTANCED_MESH_BIT;
+    instance.m_LocalToWorldMatrix = localToWorldMatrix;
+    instance.m_NormalMatrix = transpose(inverse(Mat3f(localToWorldMatrix)));
+    instance.m_BBox = transformBBox(prototype.m_BBox, localToWorldMatrix);
+
+    for(auto i = 0u; i < prototype.m_nMeshCount; ++i) {
+        m_InstancedMeshes.emplace_back(InstancedMesh { prototype.m_nFirstMeshID + i, uint32_t(m_Instances.size()) });
+    }
+
+    m_BBox.grow(instance.m_BBox);
+    m_Instances.emplace_back(instance);
+}
+
 static Mat4f loadMatrix(const tinyxml2::XMLElement& description) {
     auto matrix = Mat4f(1.f);
     for(auto pElement = description.FirstChildElement(); pElement; pElement = pElement->NextSiblingElement()) {
@@ -296,6 +481,20 @@ static Mat4f loadMatrix(const tinyxml2::XMLElement& description) {
             }
 
             matrix = rotate(matrix, angle, axis);
+        } else if(std::string(pElement->Name()) == "Translate") {
+            auto translation = zero<Vec3f>();
+            getAttribute(*pElement, "x", translation.x);
+            getAttribute(*pElement, "y", translation.y);
+            getAttribute(*pElement, "z", translation.z);
+
+            matrix = translate(matrix, translation);
+        } else if(std::string(pElement->Name()) == "Scale") {
+            auto factors = Vec3f(1.f);
+            getAttribute(*pElement, "x", factors.x);
+            getAttribute(*pElement, "y", factors.y);
+            getAttribute(*pElement, "z", factors.z);
+
+            matrix = scale(matrix, factors);
         }
     }
     return matrix;
@@ -791,6 +990,41 @@ SceneGeometry loadGeometry(const FilePath& path, const tinyxml2::XMLElement& geo
         }
     }
 
+    // Prototypes are only rendered through their instances. A prototype is described like a geometry, so it can
+    // itself contain prototypes and instances
+    std::unordered_map<std::string, uint32_t> prototypeIDs;
+    for(auto pPrototype = geometryDescription.FirstChildElement("Prototype");
+        pPrototype; pPrototype = pPrototype->NextSiblingElement("Prototype")) {
+        std::string name;
+        if(!getAttribute(*pPrototype, "name", name)) {
+            pLogger->error("Error in geometry description: Prototype specified without name");
+            continue;
+        }
+        pLogger->verbose(1, "Load prototype %v", name);
+        prototypeIDs[name] = geometry.addPrototype(loadGeometry(path, *pPrototype));
+    }
+
+    for(auto pInstance = geometryDescription.FirstChildElement("Instance");
+        pInstance; pInstance = pInstance->NextSiblingElement("Instance")) {
+        std::string prototypeName;
+        if(!getAttribute(*pInstance, "prototype", prototypeName)) {
+            pLogger->error("Error in geometry description: Instance specified without prototype");
+            continue;
+        }
+        auto it = prototypeIDs.find(prototypeName);
+        if(it == end(prototypeIDs)) {
+            pLogger->error("Error in geometry description: prototype %v not found", prototypeName);
+            continue;
+        }
+
+        auto instanceMatrix = Mat4f(1.f);
+        auto pInstanceMatrix = pInstance->FirstChildElement("LocalToWorldMatrix");
+        if(pInstanceMatrix) {
+            instanceMatrix = loadMatrix(*pInstanceMatrix);
+        }
+        geometry.addInstance((*it).second, instanceMatrix);
+    }
+
     auto pMaterialUpdates = geometryDescription.FirstChildElement("MaterialUpdates");
     if(pMaterialUpdates) {
         for(auto pMaterial = pMaterialUpdates->FirstChildElement("Material"); pMaterial; pMaterial = pMaterial->NextSiblingElement("Material")) {
@@ -52,6 +52,8 @@ struct TriangleMesh {
 
     int32_t m_nLightID = -1;
 
+    bool m_bIsPrototype = false; // The mesh is only placed in the scene by instances, its vertices are in local space
+
     const Vertex& getVertex(uint32_t index) const {
         return m_Vertices[index];
     }
@@ -107,9 +109,43 @@ Sample<TriangleMesh::Vertex> sampleTriangle(const TriangleMesh& mesh, size_t tri
 TriangleMesh::Vertex computeTriangleCenter(const TriangleMesh& mesh, size_t triangleIdx);
 
 class SceneGeometry {
+public:
+    // A group of meshes stored once in local space and placed in the scene by instances
+    struct MeshPrototype {
+        uint32_t m_nFirstMeshID = 0u; // The meshes of the prototype are consecutive in getMeshs()
+        uint32_t m_nMeshCount = 0u;
+        BBox3f m_BBox;
+        // Emissive prototypes are expanded into regular meshes for each instance: area lights sample world space triangles
+        bool m_bIsExpanded = false;
+        // Instances of other prototypes contained in this one (multi-level instancing), with their local to prototype matrix
+        std::vector<std::pair<uint32_t, Mat4f>> m_NestedInstances;
+    };
+
+    struct MeshInstance {
+        uint32_t m_nPrototypeID;
+        uint32_t m_nFirstMeshID; // Virtual mesh ID of the first mesh of the prototype in this instance
+        Mat4f m_LocalToWorldMatrix;
+        Mat3f m_NormalMatrix;
+        BBox3f m_BBox;
+    };
+
+    // Meshes placed by instances have virtual IDs with this bit set. Hits, surface points and getMesh() use them,
+    // the other bits index getInstancedMeshes().
+    static const uint32_t INSTANCED_MESH_BIT = 1u << 31;
+
+    struct InstancedMesh {
+        uint32_t m_nMeshID; // Index of the prototype mesh in getMeshs()
+        uint32_t m_nInstanceID;
+    };
+
+private:
     std::vector<TriangleMesh> m_TriangleMeshs;
     std::vector<Material> m_Materials;
     std::vector<uint32_t> m_EmissiveMeshs; // Store the index of every mesh that have an emissive material
+
+    std::vector<MeshPrototype> m_Prototypes;
+    std::vector<MeshInstance> m_Instances;
+    std::vector<InstancedMesh> m_InstancedMeshes;
 	
     friend void loadAssimpScene(const aiScene* aiscene, const std::string& filepath, SceneGeometry& geometry);
 
@@ -124,31 +160,42 @@ class SceneGeometry {
     friend SceneGeometry loadQuad(const FilePath& path, const tinyxml2::XMLElement& quadDescription);
 
     BBox3f m_BBox;
+
+    void updateBBox();
+
+    // Place the meshes of a prototype, without its nested instances
+    void placeInstance(uint32_t prototypeID, const Mat4f& localToWorldMatrix);
 public:
     void clear() {
         m_TriangleMeshs.clear();
         m_Materials.clear();
+        m_Prototypes.clear();
+        m_Instances.clear();
+        m_InstancedMeshes.clear();
         m_BBox = BBox3f(Vec3f(0));
     }
 
-    void transform(const Mat4f& localToWorldMatrix) {
-        for(auto i = 0u; i < m_TriangleMeshs.size(); ++i) {
-            auto& mesh = m_TriangleMeshs[i];
-            mesh.transform(localToWorldMatrix);
-            if(i == 0u) {
-                m_BBox = mesh.m_BBox;
-            } else {
-                m_BBox.grow(mesh.m_BBox);
-            }
+    void transform(const Mat4f& localToWorldMatrix);
+
+    static bool isInstancedMesh(uint32_t meshID) {
+        return meshID & INSTANCED_MESH_BIT;
+    }
+
+    // Index in getMeshs() of a mesh: the prototype mesh for the virtual ID of an instanced mesh
+    uint32_t getStoredMeshID(uint32_t meshID) const {
+        if(isInstancedMesh(meshID)) {
+            return m_InstancedMeshes[meshID & ~INSTANCED_MESH_BIT].m_nMeshID;
         }
+        return meshID;
     }
 
+    // Return the prototype mesh for the virtual ID of an instanced mesh
     const TriangleMesh& getMesh(uint32_t geomID) const {
-        return m_TriangleMeshs[geomID];
+        return m_TriangleMeshs[getStoredMeshID(geomID)];
     }
 
     TriangleMesh& getMesh(uint32_t geomID) {
-        return m_TriangleMeshs[geomID];
+        return m_TriangleMeshs[getStoredMeshID(geomID)];
     }
 
     const std::vector<TriangleMesh>& getMeshs() const {
@@ -197,32 +244,54 @@ public:
         return m_BBox;
     }
 
-    void postIntersect(const Ray& ray, Intersection& I) const;
+    // Add the meshes of geometry as a new prototype and return its index. The prototypes and instances of geometry
+    // become prototypes nested in the new one.
+    uint32_t addPrototype(SceneGeometry geometry);
 
-    void getSurfacePoint(uint32_t meshID, uint32_t triangleID,
-                         float u, float v, SurfacePoint& point) const;
+    // Place a prototype and its nested prototypes in the scene
+    void addInstance(uint32_t prototypeID, const Mat4f& localToWorldMatrix);
 
-    void append(SceneGeometry geometry) {
-        if(m_TriangleMeshs.empty()) {
-            m_BBox = geometry.m_BBox;
-        } else {
-            m_BBox.grow(geometry.m_BBox);
-        }
-        auto materialOffset = m_Materials.size();
-        for(auto& material: geometry.m_Materials) {
-            m_Materials.emplace_back(std::move(material));
+    const std::vector<MeshPrototype>& getPrototypes() const {
+        return m_Prototypes;
+    }
+
+    const std::vector<MeshInstance>& getInstances() const {
+        return m_Instances;
+    }
+
+    const std::vector<InstancedMesh>& getInstancedMeshes() const {
+        return m_InstancedMeshes;
+    }
+
+    const MeshInstance& getInstance(uint32_t instancedMeshID) const {
+        return m_Instances[m_InstancedMeshes[instancedMeshID & ~INSTANCED_MESH_BIT].m_nInstanceID];
+    }
+
+    // Call f(meshID, mesh) for each mesh placed in the scene: regular meshes, then instanced meshes with their virtual ID
+    template<typename Functor>
+    void forEachPlacedMesh(Functor&& f) const {
+        for(auto meshID = 0u; meshID < m_TriangleMeshs.size(); ++meshID) {
+            if(!m_TriangleMeshs[meshID].m_bIsPrototype) {
+                f(meshID, m_TriangleMeshs[meshID]);
+            }
         }
-        for(auto& mesh: geometry.m_TriangleMeshs) {
-            m_TriangleMeshs.emplace_back(std::move(mesh));
-            m_TriangleMeshs.back().m_MaterialID += uint32_t(materialOffset);
-//            if(isEmissive(m_Materials[m_TriangleMeshs.back().m_MaterialID])) {
-//                m_EmissiveMeshs.emplace_back(m_TriangleMeshs.size() - 1);
-//            }
+        for(auto i = 0u; i < m_InstancedMeshes.size(); ++i) {
+            f(i | INSTANCED_MESH_BIT, m_TriangleMeshs[m_InstancedMeshes[i].m_nMeshID]);
         }
     }
 
+    // Area of a triangle in world space, meshID can be the virtual ID of an instanced mesh
+    float getTriangleArea(uint32_t meshID, uint32_t triangleID) const;
+
+    void postIntersect(const Ray& ray, Intersection& I) const;
+
+    void getSurfacePoint(uint32_t meshID, uint32_t triangleID,
+                         float u, float v, SurfacePoint& point) const;
+
+    void append(SceneGeometry geometry);
+
     void append(TriangleMesh mesh) {
-        if(m_TriangleMeshs.empty()) {
+        if(m_TriangleMeshs.empty() && m_Instances.empty()) {
             m_BBox = mesh.m_BBox;
         }  else {
             m_BBox.grow(mesh.m_BBox);
@@ -237,7 +306,7 @@ public:
     void extractEmissiveMeshes() {
         m_EmissiveMeshs.clear();
         for(auto index: range(m_TriangleMeshs.size())) {
-            if(isEmissive(m_Materials[m_TriangleMeshs[index].m_MaterialID])) {
+            if(!m_TriangleMeshs[index].m_bIsPrototype && isEmissive(m_Materials[m_TriangleMeshs[index].m_MaterialID])) {
                 m_EmissiveMeshs.emplace_back(index);
             }
         }
@@ -0,0 +1,314 @@
+#include "LightBVHSampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Light.hpp"
+#include "LightVisitor.hpp"
+#include "AreaLight.hpp"
+#include "PointLight.hpp"
+
+namespace BnZ {
+
+namespace {
+
+// Largest float below 1, used to keep the remapped samples in [0,1[
+const float ONE_MINUS_EPSILON = std::nextafter(1.f, 0.f);
+
+// Compute the bounds of the finite lights. Lights that are not visited are considered infinite.
+class FiniteLightBoundsVisitor: public LightVisitor {
+public:
+    const Scene* m_pScene = nullptr;
+    bool m_bIsFinite = false;
+    BBox3f m_BBox;
+    Vec3f m_Axis;
+    float m_fThetaO = 0.f;
+    float m_fThetaE = 0.f;
+
+    void visit(const PointLight& light) override {
+        m_bIsFinite = true;
+        m_BBox = BBox3f(light.m_Position);
+        m_Axis = Vec3f(0, 0, 1);
+        m_fThetaO = pi<float>();
+        m_fThetaE = 0.5f * pi<float>();
+    }
+
+    void visit(const AreaLight& light) override {
+        const auto& mesh = m_pScene->getGeometry().getMesh(light.getMeshIdx());
+
+        m_bIsFinite = true;
+        m_BBox = BBox3f();
+        m_Axis = zero<Vec3f>();
+        for(const auto& vertex: mesh.m_Vertices) {
+            m_BBox.grow(vertex.position);
+            m_Axis += vertex.normal;
+        }
+
+        // Emission is cosine weighted around the shading normal, which is an interpolation of the vertex normals
+        m_fThetaE = 0.5f * pi<float>();
+
+        auto l = length(m_Axis);
+        if(l == 0.f) {
+            m_Axis = Vec3f(0, 0, 1);
+            m_fThetaO = pi<float>();
+            return;
+        }
+        m_Axis /= l;
+
+        m_fThetaO = 0.f;
+        for(const auto& vertex: mesh.m_Vertices) {
+            m_fThetaO = max(m_fThetaO, std::acos(clamp(dot(m_Axis, vertex.normal), -1.f, 1.f)));
+        }
+    }
+};
+
+}
+
+void LightBVHSampler::initFrame(const Scene& scene) {
+    const auto& lights = scene.getLightContainer();
+    if(!lights.hasChanged(m_UpdateFlag)) {
+        return;
+    }
+
+    m_Nodes.clear();
+    m_LightLeafs.clear();
+    m_LightLeafs.resize(lights.size(), NO_NODE);
+    m_InfiniteLights.clear();
+    m_InfiniteLightIndices.clear();
+    m_InfiniteLightIndices.resize(lights.size(), uint32_t(-1));
+
+    std::vector<LightBounds> lightBounds;
+    std::vector<float> infiniteLightPowers;
+
+    auto finitePower = 0.f;
+    auto infinitePower = 0.f;
+
+    FiniteLightBoundsVisitor visitor;
+    visitor.m_pScene = &scene;
+
+    for(auto lightID: range(uint32_t(lights.size()))) {
+        const auto& pLight = lights.getLight(lightID);
+        auto power = luminance(pLight->getPowerUpperBound(scene));
+        if(power <= 0.f) {
+            continue;
+        }
+
+        visitor.m_bIsFinite = false;
+        pLight->accept(visitor);
+
+        if(visitor.m_bIsFinite) {
+            LightBounds bounds;
+            bounds.m_BBox = visitor.m_BBox;
+            bounds.m_Cone.m_Axis = visitor.m_Axis;
+            bounds.m_Cone.m_fThetaO = visitor.m_fThetaO;
+            bounds.m_Cone.m_fThetaE = visitor.m_fThetaE;
+            bounds.m_fPower = power;
+            bounds.m_nLightID = lightID;
+            lightBounds.emplace_back(bounds);
+            finitePower += power;
+        } else {
+            m_InfiniteLightIndices[lightID] = uint32_t(m_InfiniteLights.size());
+            m_InfiniteLights.emplace_back(lightID);
+            infiniteLightPowers.emplace_back(power);
+            infinitePower += power;
+        }
+    }
+
+    if(!lightBounds.empty()) {
+        m_Nodes.reserve(2 * lightBounds.size() - 1);
+        buildNode(lightBounds.data(), lightBounds.data() + lightBounds.size(), NO_NODE);
+    }
+
+    if(!m_InfiniteLights.empty()) {
+        m_InfiniteLightsDistribution = DiscreteDistribution(infiniteLightPowers.size(), infiniteLightPowers.data());
+    }
+
+    m_fInfiniteLightsProbability = (finitePower + infinitePower) > 0.f ? infinitePower / (finitePower + infinitePower) : 0.f;
+}
+
+uint32_t LightBVHSampler::buildNode(LightBounds* pBegin, LightBounds* pEnd, uint32_t parent) {
+    auto nodeIndex = uint32_t(m_Nodes.size());
+    m_Nodes.emplace_back();
+    m_Nodes[nodeIndex].m_nParent = parent;
+
+    if(pEnd - pBegin == 1) {
+        auto& leaf = m_Nodes[nodeIndex];
+        leaf.m_BBox = pBegin->m_BBox;
+        leaf.m_Cone = pBegin->m_Cone;
+        leaf.m_fPower = pBegin->m_fPower;
+        leaf.m_nLightID = pBegin->m_nLightID;
+        m_LightLeafs[pBegin->m_nLightID] = nodeIndex;
+        return nodeIndex;
+    }
+
+    // Median split along the largest axis of the centroid bounds: the tree is balanced
+    // so its depth is logarithmic in the number of lights
+    BBox3f centroidBounds;
+    for(auto it = pBegin; it != pEnd; ++it) {
+        centroidBounds.grow(center(it->m_BBox));
+    }
+    auto extent = centroidBounds.size();
+    auto axis = (extent.x > extent.y) ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    auto pMiddle = pBegin + (pEnd - pBegin) / 2;
+    std::nth_element(pBegin, pMiddle, pEnd, [axis](const LightBounds& lhs, const LightBounds& rhs) {
+        return center(lhs.m_BBox)[axis] < center(rhs.m_BBox)[axis];
+    });
+
+    auto firstChild = buildNode(pBegin, pMiddle, nodeIndex);
+    auto secondChild = buildNode(pMiddle, pEnd, nodeIndex);
+
+    auto& node = m_Nodes[nodeIndex];
+    node.m_nSecondChild = secondChild;
+    node.m_BBox = merge(m_Nodes[firstChild].m_BBox, m_Nodes[secondChild].m_BBox);
+    node.m_Cone = merge(m_Nodes[firstChild].m_Cone, m_Nodes[secondChild].m_Cone);
+    node.m_fPower = m_Nodes[firstChild].m_fPower + m_Nodes[secondChild].m_fPower;
+
+    return nodeIndex;
+}
+
+float LightBVHSampler::importance(const Node& node, const Vec3f& point, const Vec3f* pNormal) const {
+    auto c = center(node.m_BBox);
+    auto radius = 0.5f * length(node.m_BBox.size());
+
+    auto wo = point - c;
+    auto sqrDist = dot(wo, wo);
+    auto dist = std::sqrt(sqrDist);
+
+    if(dist > 0.f) {
+        wo /= dist;
+    }
+
+    // Bound on the angle subtended by the bounding sphere of the node
+    auto thetaU = dist > radius ? std::asin(radius / dist) : pi<float>();
+
+    // Bound the cosine at the emitters
+    auto theta = std::acos(clamp(dot(node.m_Cone.m_Axis, wo), -1.f, 1.f));
+    auto thetaPrime = max(0.f, theta - node.m_Cone.m_fThetaO - thetaU);
+    if(thetaPrime >= node.m_Cone.m_fThetaE) {
+        return 0.f;
+    }
+    auto cosThetaPrime = std::cos(thetaPrime);
+
+    // Bound the cosine at the receiver (both sides of the surface are considered)
+    auto cosThetaIPrime = 1.f;
+    if(pNormal) {
+        auto thetaI = std::acos(clamp(abs(dot(*pNormal, wo)), 0.f, 1.f));
+        cosThetaIPrime = std::cos(max(0.f, thetaI - thetaU));
+    }
+
+    // The distance is clamped to avoid the singularity when the point is inside the node
+    auto d2 = max(sqrDist, max(sqr(radius), 1e-8f));
+
+    return max(0.f, node.m_fPower * cosThetaPrime * cosThetaIPrime / d2);
+}
+
+const Light* LightBVHSampler::sample(const Scene& scene, const Vec3f& point, const Vec3f* pNormal, float lightSample, float& pdf, uint32_t* pLightID) const {
+    const auto& lights = scene.getLightContainer();
+
+    auto s = lightSample;
+    auto sampleInfiniteLights = m_Nodes.empty() || s < m_fInfiniteLightsProbability;
+
+    if(sampleInfiniteLights) {
+        if(m_InfiniteLights.empty()) {
+            pdf = 0.f;
+            return nullptr;
+        }
+        s = m_fInfiniteLightsProbability > 0.f ? min(s / m_fInfiniteLightsProbability, ONE_MINUS_EPSILON) : s;
+        auto sampledLight = m_InfiniteLightsDistribution.sample(s);
+        auto lightID = m_InfiniteLights[sampledLight.value];
+
+        pdf = m_fInfiniteLightsProbability * sampledLight.pdf;
+        if(pLightID) {
+            *pLightID = lightID;
+        }
+        return lights.getLight(lightID).get();
+    }
+
+    s = min((s - m_fInfiniteLightsProbability) / (1.f - m_fInfiniteLightsProbability), ONE_MINUS_EPSILON);
+    pdf = 1.f - m_fInfiniteLightsProbability;
+
+    auto nodeIndex = 0u;
+    while(!m_Nodes[nodeIndex].isLeaf()) {
+        auto firstChild = nodeIndex + 1;
+        auto secondChild = m_Nodes[nodeIndex].m_nSecondChild;
+
+        auto firstImportance = importance(m_Nodes[firstChild], point, pNormal);
+        auto secondImportance = importance(m_Nodes[secondChild], point, pNormal);
+        auto sum = firstImportance + secondImportance;
+
+        if(sum == 0.f) {
+            // No light of the subtree can illuminate the point
+            pdf = 0.f;
+            return nullptr;
+        }
+
+        auto firstProbability = firstImportance / sum;
+        if(s < firstProbability) {
+            s = min(s / firstProbability, ONE_MINUS_EPSILON);
+            pdf *= firstProbability;
+            nodeIndex = firstChild;
+        } else {
+            s = min((s - firstProbability) / (1.f - firstProbability), ONE_MINUS_EPSILON);
+            pdf *= 1.f - firstProbability;
+            nodeIndex = secondChild;
+        }
+    }
+
+    auto lightID = m_Nodes[nodeIndex].m_nLightID;
+    if(pLightID) {
+        *pLightID = lightID;
+    }
+    return lights.getLight(lightID).get();
+}
+
+float LightBVHSampler::pdf(const Vec3f& point, const Vec3f* pNormal, uint32_t lightID) const {
+    if(lightID >= m_LightLeafs.size()) {
+        return 0.f;
+    }
+
+    if(m_InfiniteLightIndices[lightID] != uint32_t(-1)) {
+        auto probability = m_Nodes.empty() ? 1.f : m_fInfiniteLightsProbability;
+        return probability * m_InfiniteLightsDistribution.pdf(m_InfiniteLightIndices[lightID]);
+    }
+
+    auto nodeIndex = m_LightLeafs[lightID];
+    if(nodeIndex == NO_NODE) {
+        return 0.f;
+    }
+
+    auto pdf = 1.f - m_fInfiniteLightsProbability;
+
+    // Climb from the leaf to the root
+    while(m_Nodes[nodeIndex].m_nParent != NO_NODE) {
+        auto parent = m_Nodes[nodeIndex].m_nParent;
+        auto firstImportance = importance(m_Nodes[parent + 1], point, pNormal);
+        auto secondImportance = importance(m_Nodes[m_Nodes[parent].m_nSecondChild], point, pNormal);
+        auto sum = firstImportance + secondImportance;
+        if(sum == 0.f) {
+            return 0.f;
+        }
+        pdf *= (nodeIndex == parent + 1 ? firstImportance : secondImportance) / sum;
+        nodeIndex = parent;
+    }
+
+    return pdf;
+}
+
+const Light* LightBVHSampler::sample(const Scene& scene, const SurfacePoint& point, float lightSample, float& pdf, uint32_t* pLightID) const {
+    return sample(scene, point.P, &point.Ns, lightSample, pdf, pLightID);
+}
+
+const Light* LightBVHSampler::sample(const Scene& scene, const Vec3f& point, float lightSample, float& pdf, uint32_t* pLightID) const {
+    return sample(scene, point, nullptr, lightSample, pdf, pLightID);
+}
+
+float LightBVHSampler::pdf(const SurfacePoint& point, uint32_t lightID) const {
+    return pdf(point.P, &point.Ns, lightID);
+}
+
+float LightBVHSampler::pdf(const Vec3f& point, uint32_t lightID) const {
+    return pdf(point, nullptr, lightID);
+}
+
+}
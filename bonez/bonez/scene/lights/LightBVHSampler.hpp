@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+
+#include <bonez/types.hpp>
+#include <bonez/maths/BBox.hpp>
+#include <bonez/scene/Scene.hpp>
+#include <bonez/scene/SurfacePoint.hpp>
+#include <bonez/sampling/DiscreteDistribution.hpp>
+
+#include "OrientationCone.hpp"
+
+namespace BnZ {
+
+// Spatially varying light selection for next event estimation.
+//
+// Finite lights (area lights and point lights) are stored in a binary BVH. Each node bounds the lights of its subtree with:
+// - a bounding box,
+// - an orientation cone (axis, angle thetaO bounding the normals, angle thetaE bounding the emission around the normals),
+// - the sum of their power.
+// For a given shading point, a child node is chosen proportionally to an upper bound of the contribution
+// of its lights to the point. Infinite lights (directional and environment lights) cannot be bounded spatially,
+// so they are chosen as a group with a probability proportional to their power, like PowerBasedLightSampler does.
+//
+// The emission of light paths is not spatially dependent: renderers should keep a PowerBasedLightSampler for that purpose.
+class LightBVHSampler {
+public:
+    void initFrame(const Scene& scene);
+
+    // Sample a light to compute the direct illumination on a surface point
+    const Light* sample(const Scene& scene, const SurfacePoint& point, float lightSample, float& pdf, uint32_t* pLightID = nullptr) const;
+
+    // Sample a light to compute the direct illumination on a point of the empty space
+    const Light* sample(const Scene& scene, const Vec3f& point, float lightSample, float& pdf, uint32_t* pLightID = nullptr) const;
+
+    // Return the probability of sampling the light lightID with sample(scene, point, ...)
+    float pdf(const SurfacePoint& point, uint32_t lightID) const;
+
+    float pdf(const Vec3f& point, uint32_t lightID) const;
+
+    std::size_t getNodeCount() const {
+        return m_Nodes.size();
+    }
+
+private:
+    static const uint32_t NO_NODE = uint32_t(-1);
+
+    struct LightBounds {
+        BBox3f m_BBox;
+        OrientationCone m_Cone;
+        float m_fPower = 0.f;
+        uint32_t m_nLightID = 0u;
+    };
+
+    struct Node {
+        BBox3f m_BBox;
+        OrientationCone m_Cone;
+        float m_fPower = 0.f;
+        uint32_t m_nParent = NO_NODE;
+        uint32_t m_nSecondChild = NO_NODE; // The first child is stored just after its parent, NO_NODE for a leaf
+        uint32_t m_nLightID = 0u; // Only valid for leafs
+
+        bool isLeaf() const {
+            return m_nSecondChild == NO_NODE;
+        }
+    };
+
+    uint32_t buildNode(LightBounds* pBegin, LightBounds* pEnd, uint32_t parent);
+
+    // Upper bound of the contribution of the lights of a node to point (pNormal can be null for points in empty space)
+    float importance(const Node& node, const Vec3f& point, const Vec3f* pNormal) const;
+
+    const Light* sample(const Scene& scene, const Vec3f& point, const Vec3f* pNormal, float lightSample, float& pdf, uint32_t* pLightID) const;
+
+    float pdf(const Vec3f& point, const Vec3f* pNormal, uint32_t lightID) const;
+
+    UpdateFlag m_UpdateFlag;
+
+    std::vector<Node> m_Nodes;
+    std::vector<uint32_t> m_LightLeafs; // For each light, the index of its leaf or NO_NODE
+
+    std::vector<uint32_t> m_InfiniteLights;
+    std::vector<uint32_t> m_InfiniteLightIndices; // For each light, its index in m_InfiniteLights or uint32_t(-1)
+    DiscreteDistribution m_InfiniteLightsDistribution;
+    float m_fInfiniteLightsProbability = 0.f;
+};
+
+}
@@ -0,0 +1,128 @@
+#include "LightcutsTree.hpp"
+
+#include <numeric>
+
+namespace BnZ {
+
+void LightcutsTree::add(uint32_t lightID, const Vec3f& position, const Vec3f& normal, const Vec3f& intensity) {
+    if(luminance(intensity) <= 0.f) {
+        return;
+    }
+    m_Lights.emplace_back(LightPoint{ lightID, position, normal, intensity });
+}
+
+void LightcutsTree::buildTopology() {
+    m_Nodes.clear();
+    if(m_Lights.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> lightIndices(m_Lights.size());
+    std::iota(begin(lightIndices), end(lightIndices), 0u);
+
+    m_Nodes.reserve(2 * m_Lights.size() - 1);
+    buildNode(lightIndices.data(), lightIndices.data() + lightIndices.size());
+}
+
+uint32_t LightcutsTree::buildNode(uint32_t* pBegin, uint32_t* pEnd) {
+    auto nodeIndex = uint32_t(m_Nodes.size());
+    m_Nodes.emplace_back();
+
+    if(pEnd - pBegin == 1) {
+        const auto& light = m_Lights[*pBegin];
+        auto& leaf = m_Nodes[nodeIndex];
+        leaf.m_BBox = BBox3f(light.m_Position);
+        if(light.m_Normal == zero<Vec3f>()) {
+            leaf.m_Cone.m_fThetaO = pi<float>();
+        } else {
+            leaf.m_Cone.m_Axis = light.m_Normal;
+            leaf.m_Cone.m_fThetaO = 0.f;
+        }
+        leaf.m_Cone.m_fThetaE = 0.5f * pi<float>();
+        leaf.m_Intensity = light.m_Intensity;
+        leaf.m_IntensityRatio = Vec3f(1.f);
+        leaf.m_nRepresentative = *pBegin;
+        return nodeIndex;
+    }
+
+    // Median split along the largest axis of the bounding box: the tree is balanced, so the depth of a cut
+    // is logarithmic in the number of lights
+    BBox3f bounds;
+    for(auto it = pBegin; it != pEnd; ++it) {
+        bounds.grow(m_Lights[*it].m_Position);
+    }
+    auto extent = bounds.size();
+    auto axis = (extent.x > extent.y) ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    auto pMiddle = pBegin + (pEnd - pBegin) / 2;
+    std::nth_element(pBegin, pMiddle, pEnd, [&](uint32_t lhs, uint32_t rhs) {
+        return m_Lights[lhs].m_Position[axis] < m_Lights[rhs].m_Position[axis];
+    });
+
+    auto firstChild = buildNode(pBegin, pMiddle);
+    auto secondChild = buildNode(pMiddle, pEnd);
+
+    auto& node = m_Nodes[nodeIndex];
+    node.m_nSecondChild = secondChild;
+    node.m_BBox = bounds;
+    node.m_Cone = merge(m_Nodes[firstChild].m_Cone, m_Nodes[secondChild].m_Cone);
+    node.m_Intensity = m_Nodes[firstChild].m_Intensity + m_Nodes[secondChild].m_Intensity;
+
+    return nodeIndex;
+}
+
+void LightcutsTree::chooseRepresentative(Node& node, float s) {
+    const auto& firstChild = *(&node + 1);
+    const auto& secondChild = m_Nodes[node.m_nSecondChild];
+
+    // Choosing the representative of a child proportionally to its intensity makes the estimate of the cluster unbiased
+    auto firstLuminance = luminance(firstChild.m_Intensity);
+    auto sumLuminance = firstLuminance + luminance(secondChild.m_Intensity);
+    node.m_nRepresentative = (s * sumLuminance < firstLuminance) ?
+                firstChild.m_nRepresentative : secondChild.m_nRepresentative;
+
+    const auto& representativeIntensity = m_Lights[node.m_nRepresentative].m_Intensity;
+    for(auto c = 0u; c < 3u; ++c) {
+        node.m_IntensityRatio[c] = representativeIntensity[c] > 0.f ? node.m_Intensity[c] / representativeIntensity[c] : 0.f;
+    }
+}
+
+float LightcutsTree::errorBound(const Node& node, const Vec3f& P, const Vec3f& N, const Vec3f& materialBound) const {
+    // Squared distance from P to the bounding box of the cluster
+    auto closestPoint = clamp(P, node.m_BBox.lower, node.m_BBox.upper);
+    auto sqrDist = distanceSquared(P, closestPoint);
+    if(sqrDist == 0.f) {
+        return std::numeric_limits<float>::max();
+    }
+
+    auto c = center(node.m_BBox);
+    auto radius = 0.5f * length(node.m_BBox.size());
+
+    auto wo = P - c;
+    auto dist = length(wo);
+    if(dist > 0.f) {
+        wo /= dist;
+    }
+
+    // Bound on the angle subtended by the bounding sphere of the node
+    auto thetaU = dist > radius ? std::asin(radius / dist) : pi<float>();
+
+    // Bound the cosine at the emitters
+    auto cosEmitterBound = 1.f;
+    if(node.m_Cone.m_fThetaO < pi<float>()) {
+        auto theta = std::acos(clamp(dot(node.m_Cone.m_Axis, wo), -1.f, 1.f));
+        auto thetaPrime = max(0.f, theta - node.m_Cone.m_fThetaO - thetaU);
+        if(thetaPrime >= node.m_Cone.m_fThetaE) {
+            return 0.f;
+        }
+        cosEmitterBound = std::cos(thetaPrime);
+    }
+
+    // Bound the cosine at the receiver (both sides of the surface are considered)
+    auto thetaI = std::acos(clamp(abs(dot(N, wo)), 0.f, 1.f));
+    auto cosReceiverBound = std::cos(max(0.f, thetaI - thetaU));
+
+    return max(0.f, luminance(materialBound * node.m_Intensity)) * cosEmitterBound * cosReceiverBound / sqrDist;
+}
+
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+#include <bonez/types.hpp>
+#include <bonez/maths/BBox.hpp>
+
+#include "OrientationCone.hpp"
+
+namespace BnZ {
+
+// Light tree for Lightcuts (Walter et al. 2005), used to gather the illumination of many virtual point lights.
+//
+// Each node is a cluster of lights represented by one of them, chosen randomly proportionally to the intensities
+// when the tree is built. For a receiver point, a cut of the tree is selected: the cut starts at the root and the
+// node with the largest error bound is replaced by its children until all error bounds are below a fraction of the
+// current estimate or the cut reaches a maximal size. The contribution of a cluster is estimated from the one
+// of its representative scaled by the ratio of intensities, so only one shadow ray is traced per node of the cut.
+//
+// Lights are either omnidirectional or emit in a cosine lobe around their normal (surface VPLs, area light samples).
+class LightcutsTree {
+    struct CutNode {
+        uint32_t m_nNodeIndex;
+        Vec3f m_RepresentativeContribution;
+        Vec3f m_Estimate;
+        float m_fErrorBound;
+    };
+
+public:
+    // Working memory of evalCut, kept by the caller (one per thread) so that cuts are selected without allocation
+    struct CutBuffers {
+    private:
+        friend class LightcutsTree;
+
+        std::vector<CutNode> m_Heap; // Max-heap on the error bound of the nodes that can be refined
+        std::vector<CutNode> m_Leafs; // Nodes that can't be refined (leafs or nodes that can't contribute)
+    };
+
+    void clear() {
+        m_Lights.clear();
+        m_Nodes.clear();
+    }
+
+    // normal is zero for an omnidirectional light. For an oriented light, intensity is the maximal radiant intensity,
+    // multiplied by the bound of the BSDF for a VPL. lightID is the value given to the evaluation callbacks of evalCut.
+    void add(uint32_t lightID, const Vec3f& position, const Vec3f& normal, const Vec3f& intensity);
+
+    std::size_t getLightCount() const {
+        return m_Lights.size();
+    }
+
+    std::size_t getNodeCount() const {
+        return m_Nodes.size();
+    }
+
+    bool empty() const {
+        return m_Nodes.empty();
+    }
+
+    // Build the tree over the lights added since the last clear(), rng is used to choose the representatives
+    template<typename RandomGenerator>
+    void build(RandomGenerator&& rng) {
+        buildTopology();
+        // Nodes are stored in depth first order: children are processed before their parent
+        for(auto i = m_Nodes.size(); i-- > 0u;) {
+            auto& node = m_Nodes[i];
+            if(!node.isLeaf()) {
+                chooseRepresentative(node, rng.getFloat());
+            }
+        }
+    }
+
+    // Estimate the sum of the contributions of all lights to a receiver point (P, N) whose BSDF is bounded by materialBound.
+    // - evalLight(lightID) must return the exact contribution of a light, including its visibility
+    // - accumulate(lightID, contribution) is called for each node of the selected cut, lightID being the representative
+    // The cut is refined while the largest error bound exceeds maxRelativeError times the luminance of the estimate,
+    // and contains at most maxCutSize nodes. Return the size of the cut.
+    template<typename EvalFunction, typename AccumulateFunction>
+    uint32_t evalCut(const Vec3f& P, const Vec3f& N, const Vec3f& materialBound,
+                     float maxRelativeError, uint32_t maxCutSize, CutBuffers& buffers,
+                     EvalFunction&& evalLight, AccumulateFunction&& accumulate) const {
+        if(m_Nodes.empty()) {
+            return 0u;
+        }
+
+        // Their capacity grows to the largest cut and is kept between calls
+        auto& heap = buffers.m_Heap;
+        auto& leafs = buffers.m_Leafs;
+        heap.clear();
+        leafs.clear();
+
+        auto compareErrors = [](const CutNode& lhs, const CutNode& rhs) {
+            return lhs.m_fErrorBound < rhs.m_fErrorBound;
+        };
+
+        auto addNode = [&](uint32_t nodeIndex, const Vec3f& representativeContribution) {
+            const auto& node = m_Nodes[nodeIndex];
+
+            CutNode cutNode;
+            cutNode.m_nNodeIndex = nodeIndex;
+            cutNode.m_RepresentativeContribution = representativeContribution;
+            cutNode.m_Estimate = representativeContribution * node.m_IntensityRatio;
+            cutNode.m_fErrorBound = node.isLeaf() ? 0.f : errorBound(node, P, N, materialBound);
+
+            if(cutNode.m_fErrorBound > 0.f) {
+                heap.emplace_back(cutNode);
+                std::push_heap(begin(heap), end(heap), compareErrors);
+            } else {
+                leafs.emplace_back(cutNode);
+            }
+            return cutNode.m_Estimate;
+        };
+
+        auto estimate = addNode(0u, evalLight(m_Lights[m_Nodes[0].m_nRepresentative].m_nLightID));
+        auto cutSize = 1u;
+
+        while(!heap.empty() && cutSize < maxCutSize &&
+              heap.front().m_fErrorBound > maxRelativeError * max(0.f, luminance(estimate))) {
+            std::pop_heap(begin(heap), end(heap), compareErrors);
+            auto cutNode = heap.back();
+            heap.pop_back();
+
+            const auto& node = m_Nodes[cutNode.m_nNodeIndex];
+            estimate -= cutNode.m_Estimate;
+
+            for(auto childIndex: { cutNode.m_nNodeIndex + 1u, node.m_nSecondChild }) {
+                auto representative = m_Nodes[childIndex].m_nRepresentative;
+                // One of the children shares the representative of the parent: its contribution is reused
+                auto contribution = (representative == node.m_nRepresentative) ?
+                            cutNode.m_RepresentativeContribution :
+                            evalLight(m_Lights[representative].m_nLightID);
+                estimate += addNode(childIndex, contribution);
+            }
+            ++cutSize;
+        }
+
+        for(const auto& cutNode: heap) {
+            accumulate(m_Lights[m_Nodes[cutNode.m_nNodeIndex].m_nRepresentative].m_nLightID, cutNode.m_Estimate);
+        }
+        for(const auto& cutNode: leafs) {
+            accumulate(m_Lights[m_Nodes[cutNode.m_nNodeIndex].m_nRepresentative].m_nLightID, cutNode.m_Estimate);
+        }
+
+        return cutSize;
+    }
+
+private:
+    static const uint32_t NO_NODE = uint32_t(-1);
+
+    struct LightPoint {
+        uint32_t m_nLightID;
+        Vec3f m_Position;
+        Vec3f m_Normal;
+        Vec3f m_Intensity;
+    };
+
+    struct Node {
+        BBox3f m_BBox;
+        OrientationCone m_Cone;
+        Vec3f m_Intensity = zero<Vec3f>(); // Sum of the intensities of the lights of the cluster
+        Vec3f m_IntensityRatio = zero<Vec3f>(); // Intensity of the cluster divided by the one of the representative
+        uint32_t m_nRepresentative = 0u; // Index in m_Lights
+        uint32_t m_nSecondChild = NO_NODE; // The first child is stored just after its parent, NO_NODE for a leaf
+
+        bool isLeaf() const {
+            return m_nSecondChild == NO_NODE;
+        }
+    };
+
+    void buildTopology();
+
+    uint32_t buildNode(uint32_t* pBegin, uint32_t* pEnd);
+
+    void chooseRepresentative(Node& node, float s);
+
+    // Upper bound of the luminance of the contribution of the lights of node to the receiver point
+    float errorBound(const Node& node, const Vec3f& P, const Vec3f& N, const Vec3f& materialBound) const;
+
+    std::vector<LightPoint> m_Lights;
+    std::vector<Node> m_Nodes;
+};
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cmath>
+
+#include <bonez/maths/maths.hpp>
+
+namespace BnZ {
+
+// Bound on the emission directions of a set of oriented emitters
+struct OrientationCone {
+    Vec3f m_Axis = Vec3f(0, 0, 1);
+    float m_fThetaO = 0.f; // Bound the angle between the axis and the normals of the emitters
+    float m_fThetaE = 0.f; // Bound the angle between the normals of the emitters and their emitted directions
+};
+
+// Smallest cone (approximately) containing a and b
+inline OrientationCone merge(const OrientationCone& a, const OrientationCone& b) {
+    if(b.m_fThetaO > a.m_fThetaO) {
+        return merge(b, a);
+    }
+
+    OrientationCone result;
+    result.m_fThetaE = max(a.m_fThetaE, b.m_fThetaE);
+
+    auto thetaD = std::acos(clamp(dot(a.m_Axis, b.m_Axis), -1.f, 1.f));
+    if(min(thetaD + b.m_fThetaO, pi<float>()) <= a.m_fThetaO) {
+        // a contains b
+        result.m_Axis = a.m_Axis;
+        result.m_fThetaO = a.m_fThetaO;
+        return result;
+    }
+
+    auto thetaO = 0.5f * (a.m_fThetaO + thetaD + b.m_fThetaO);
+    auto rotationAxis = cross(a.m_Axis, b.m_Axis);
+    auto l = length(rotationAxis);
+    if(thetaO >= pi<float>() || l == 0.f) {
+        result.m_Axis = a.m_Axis;
+        result.m_fThetaO = pi<float>();
+        return result;
+    }
+    rotationAxis /= l;
+
+    // Rotate the axis of a toward the axis of b
+    auto thetaR = thetaO - a.m_fThetaO;
+    result.m_Axis = normalize(std::cos(thetaR) * a.m_Axis + std::sin(thetaR) * cross(rotationAxis, a.m_Axis));
+    result.m_fThetaO = thetaO;
+
+    return result;
+}
+
+}
@@ -7,6 +7,10 @@ namespace BnZ {
 
 RTScene::EmbreeInitHandle RTScene::s_EmbreeHandle;
 
+const std::size_t RTScene::RAY_PACKET_SIZE;
+
+const uint32_t RTScene::INVALID_ID;
+
 RTScene::EmbreeInitHandle::EmbreeInitHandle() {
     rtcInit("threads=1"); // Init embree with only one thread because we don't want the acceleration data structures to depend on task ordering
 }
@@ -34,21 +38,37 @@ static void fillRTCRay(const Ray& ray, RTCRay& rtcRay) {
 struct RTCRayHandle {
     RTCRay rtcRay;
     const Ray& ray;
+    const RTScene& scene; // Top level scene, used to map embree geometries to meshes
     uint32_t threadID;
     const RTScene::FilterFunction* pFilterFunction;
 
-    RTCRayHandle(const Ray& ray, uint32_t threadID, const RTScene::FilterFunction* pFilterFunction = nullptr) :
-        ray(ray), threadID(threadID), pFilterFunction(pFilterFunction) {
+    RTCRayHandle(const Ray& ray, const RTScene& scene, uint32_t threadID, const RTScene::FilterFunction* pFilterFunction = nullptr) :
+        ray(ray), scene(scene), threadID(threadID), pFilterFunction(pFilterFunction) {
         fillRTCRay(ray, rtcRay);
     }
 };
 
+// The origin and direction of an embree ray are in the local space of the instance during the filter functions,
+// so the hit point is computed from the world space ray
+static RTScene::Hit getHit(const RTCRay& rtcRay, const Ray& ray, const RTScene& scene) {
+    RTScene::Hit hit;
+    hit.m_nInstID = rtcRay.instID;
+    hit.m_nMeshID = scene.getMeshID(rtcRay.geomID, rtcRay.instID);
+    hit.m_nTriangleID = rtcRay.primID;
+    hit.m_UV = Vec2f(rtcRay.u, rtcRay.v);
+    hit.m_Ng = normalize(scene.getWorldNormal(rtcRay.instID, Vec3f(rtcRay.Ng[0], rtcRay.Ng[1], rtcRay.Ng[2])));
+    hit.m_fDistance = rtcRay.tfar;
+    hit.m_P = ray.org + rtcRay.tfar * ray.dir;
+    return hit;
+}
+
 static bool autoIntersectFilterFunc(RTCRay& ray) {
     RTCRayHandle* handle = (RTCRayHandle*)&ray; // Find the handle containing the rtcRay
 
     // Test if the intersected primitive is the origin primitive: avoid self intersections of a given triangle
-    if ((ray.geomID == handle->ray.orgPrim.x && ray.primID == handle->ray.orgPrim.y)
-        || (ray.geomID == handle->ray.dstPrim.x && ray.primID == handle->ray.dstPrim.y)) {
+    auto meshID = handle->scene.getMeshID(ray.geomID, ray.instID);
+    if ((meshID == uint32_t(handle->ray.orgPrim.x) && ray.primID == handle->ray.orgPrim.y)
+        || (meshID == uint32_t(handle->ray.dstPrim.x) && ray.primID == handle->ray.dstPrim.y)) {
         ray.geomID = RTC_INVALID_GEOMETRY_ID; // According to embree's API, this cancel this intersection
         return true;
     }
@@ -64,14 +84,14 @@ static void intersectFilterFunc(void* userPtr, RTCRay& ray) {
     if (userPtr) {
         RTScene::FilterFunctions* pFunctions = (RTScene::FilterFunctions*)userPtr;
         if (pFunctions->m_pIntersectionFilter) {
-            if ((*pFunctions->m_pIntersectionFilter)(RTScene::Hit(ray), handle->threadID)) {
+            if ((*pFunctions->m_pIntersectionFilter)(getHit(ray, handle->ray, handle->scene), handle->threadID)) {
                 ray.geomID = RTC_INVALID_GEOMETRY_ID; // According to embree's API, this cancel this intersection
                 return;
             }
         }
     }
 
-    if(handle->pFilterFunction && (*handle->pFilterFunction)(RTScene::Hit(ray), handle->threadID)) {
+    if(handle->pFilterFunction && (*handle->pFilterFunction)(getHit(ray, handle->ray, handle->scene), handle->threadID)) {
         ray.geomID = RTC_INVALID_GEOMETRY_ID; // According to embree's API, this cancel this intersection
         return;
     }
@@ -86,31 +106,94 @@ static void occludedFilterFunc(void* userPtr, RTCRay& ray) {
     if (userPtr) {
         RTScene::FilterFunctions* pFunctions = (RTScene::FilterFunctions*)userPtr;
         if (pFunctions->m_pIntersectionFilter) {
-            if ((*pFunctions->m_pOcclusionFilter)(RTScene::Hit(ray), handle->threadID)) {
+            if ((*pFunctions->m_pOcclusionFilter)(getHit(ray, handle->ray, handle->scene), handle->threadID)) {
                 ray.geomID = RTC_INVALID_GEOMETRY_ID; // According to embree's API, this cancel this intersection
                 return;
             }
         }
     }
 
-    if(handle->pFilterFunction && (*handle->pFilterFunction)(RTScene::Hit(ray), handle->threadID)) {
+    if(handle->pFilterFunction && (*handle->pFilterFunction)(getHit(ray, handle->ray, handle->scene), handle->threadID)) {
         ray.geomID = RTC_INVALID_GEOMETRY_ID; // According to embree's API, this cancel this intersection
         return;
     }
 }
 
-RTScene::Hit::Hit(const RTCRay& ray):
-    m_nInstID(ray.instID),
-    m_nMeshID(ray.geomID),
-    m_nTriangleID(ray.primID),
-    m_UV(Vec2f(ray.u, ray.v)),
-    m_Ng(normalize(Vec3f(ray.Ng[0], ray.Ng[1], ray.Ng[2]))),
-    m_fDistance(ray.tfar),
-    m_P(Vec3f(ray.org[0], ray.org[1], ray.org[2]) + ray.tfar * Vec3f(ray.dir[0], ray.dir[1], ray.dir[2])) {
+struct RTCRayPacketHandle {
+    RTCRay4 rtcRays;
+    const Ray* pRays;
+    const RTScene* pScene;
+    uint32_t threadID;
+};
+
+static RTScene::Hit getPacketHit(const RTCRay4& rays, std::size_t i, const Ray& ray, const RTScene& scene) {
+    RTScene::Hit hit;
+    hit.m_nInstID = rays.instID[i];
+    hit.m_nMeshID = scene.getMeshID(rays.geomID[i], rays.instID[i]);
+    hit.m_nTriangleID = rays.primID[i];
+    hit.m_UV = Vec2f(rays.u[i], rays.v[i]);
+    hit.m_Ng = normalize(scene.getWorldNormal(rays.instID[i], Vec3f(rays.Ngx[i], rays.Ngy[i], rays.Ngz[i])));
+    hit.m_fDistance = rays.tfar[i];
+    hit.m_P = ray.org + rays.tfar[i] * ray.dir;
+    return hit;
+}
+
+static void intersectFilterFunc4(const void* valid, void* userPtr, RTCRay4& rays) {
+    RTCRayPacketHandle* handle = (RTCRayPacketHandle*)&rays; // Find the handle containing the rtcRays
+    auto pValid = (const int*)valid;
+
+    for(auto i = 0u; i < RTScene::RAY_PACKET_SIZE; ++i) {
+        if(!pValid[i]) {
+            continue;
+        }
+
+        // Avoid self intersections with the origin and destination primitives of the ray
+        const auto& ray = handle->pRays[i];
+        auto meshID = handle->pScene->getMeshID(rays.geomID[i], rays.instID[i]);
+        if((meshID == uint32_t(ray.orgPrim.x) && rays.primID[i] == ray.orgPrim.y)
+            || (meshID == uint32_t(ray.dstPrim.x) && rays.primID[i] == ray.dstPrim.y)) {
+            rays.geomID[i] = RTC_INVALID_GEOMETRY_ID; // According to embree's API, this cancel this intersection
+            continue;
+        }
+
+        if(userPtr) {
+            RTScene::FilterFunctions* pFunctions = (RTScene::FilterFunctions*)userPtr;
+            if(pFunctions->m_pIntersectionFilter && (*pFunctions->m_pIntersectionFilter)(getPacketHit(rays, i, ray, *handle->pScene), handle->threadID)) {
+                rays.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+            }
+        }
+    }
+}
+
+static void occludedFilterFunc4(const void* valid, void* userPtr, RTCRay4& rays) {
+    RTCRayPacketHandle* handle = (RTCRayPacketHandle*)&rays; // Find the handle containing the rtcRays
+    auto pValid = (const int*)valid;
+
+    for(auto i = 0u; i < RTScene::RAY_PACKET_SIZE; ++i) {
+        if(!pValid[i]) {
+            continue;
+        }
+
+        // Avoid self intersections with the origin and destination primitives of the ray
+        const auto& ray = handle->pRays[i];
+        auto meshID = handle->pScene->getMeshID(rays.geomID[i], rays.instID[i]);
+        if((meshID == uint32_t(ray.orgPrim.x) && rays.primID[i] == ray.orgPrim.y)
+            || (meshID == uint32_t(ray.dstPrim.x) && rays.primID[i] == ray.dstPrim.y)) {
+            rays.geomID[i] = RTC_INVALID_GEOMETRY_ID; // According to embree's API, this cancel this intersection
+            continue;
+        }
+
+        if(userPtr) {
+            RTScene::FilterFunctions* pFunctions = (RTScene::FilterFunctions*)userPtr;
+            if(pFunctions->m_pOcclusionFilter && (*pFunctions->m_pOcclusionFilter)(getPacketHit(rays, i, ray, *handle->pScene), handle->threadID)) {
+                rays.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+            }
+        }
+    }
 }
 
 RTScene::RTScene():
-    m_RTCScene(rtcNewScene(RTC_SCENE_STATIC, RTC_INTERSECT1)) {
+    m_RTCScene(rtcNewScene(RTC_SCENE_STATIC, RTCAlgorithmFlags(RTC_INTERSECT1 | RTC_INTERSECT4))) {
 }
 
 RTScene::~RTScene() {
@@ -125,30 +208,65 @@ RTScene::RTScene(RTScene&& scene) {
 
 RTScene& RTScene::operator =(RTScene&& scene) {
     std::swap(m_RTCScene, scene.m_RTCScene);
+    std::swap(m_MeshIDs, scene.m_MeshIDs);
+    std::swap(m_NormalMatrices, scene.m_NormalMatrices);
+    std::swap(m_PrototypeScenes, scene.m_PrototypeScenes);
     return *this;
 }
 
 void RTScene::addTriangleMesh(const TriangleMesh& mesh, FilterFunctions* pFilterFunctions) {
+    m_MeshIDs.emplace_back(uint32_t(m_MeshIDs.size()));
+    m_NormalMatrices.emplace_back(1.f);
+
     auto geoID = rtcNewTriangleMesh(m_RTCScene, RTC_GEOMETRY_STATIC, mesh.m_Triangles.size(),
         mesh.m_Vertices.size());
     rtcSetBuffer(m_RTCScene, geoID, RTC_VERTEX_BUFFER, (void*)(mesh.m_Vertices.data()), 0, sizeof(TriangleMesh::Vertex));
     rtcSetBuffer(m_RTCScene, geoID, RTC_INDEX_BUFFER, (void*)(mesh.m_Triangles.data()), 0, sizeof(TriangleMesh::Triangle)); // Care: this works because uint32 and int32 are compatible in terms of representation
     rtcSetUserData(m_RTCScene, geoID, pFilterFunctions);
     rtcSetOcclusionFilterFunction(m_RTCScene, geoID, occludedFilterFunc);
+    rtcSetOcclusionFilterFunction4(m_RTCScene, geoID, occludedFilterFunc4);
     rtcSetIntersectionFilterFunction(m_RTCScene, geoID, intersectFilterFunc);
+    rtcSetIntersectionFilterFunction4(m_RTCScene, geoID, intersectFilterFunc4);
 }
 
 void RTScene::addGeometry(const SceneGeometry& geometry) {
-    for (const auto& mesh : geometry.getMeshs()) {
-        addTriangleMesh(mesh);
+    const auto& meshs = geometry.getMeshs();
+    for (auto meshID = 0u; meshID < meshs.size(); ++meshID) {
+        if (!meshs[meshID].m_bIsPrototype) {
+            addTriangleMesh(meshs[meshID]);
+            m_MeshIDs.back() = meshID;
+        }
+    }
+
+    const auto& prototypes = geometry.getPrototypes();
+    std::vector<std::size_t> prototypeSceneIndices(prototypes.size(), std::size_t(-1));
+    for (const auto& instance : geometry.getInstances()) {
+        auto& sceneIndex = prototypeSceneIndices[instance.m_nPrototypeID];
+        if (sceneIndex == std::size_t(-1)) {
+            const auto& prototype = prototypes[instance.m_nPrototypeID];
+            RTScene prototypeScene;
+            for (auto i = 0u; i < prototype.m_nMeshCount; ++i) {
+                prototypeScene.addTriangleMesh(meshs[prototype.m_nFirstMeshID + i]);
+            }
+            prototypeScene.commit();
+            sceneIndex = m_PrototypeScenes.size();
+            m_PrototypeScenes.emplace_back(std::move(prototypeScene));
+        }
+    }
+
+    for (const auto& instance : geometry.getInstances()) {
+        addInstance(m_PrototypeScenes[prototypeSceneIndices[instance.m_nPrototypeID]],
+                    instance.m_LocalToWorldMatrix, instance.m_nFirstMeshID);
     }
 }
 
-void RTScene::addInstance(const RTScene& scene) {
+void RTScene::addInstance(const RTScene& scene, const Mat4f& localToWorldMatrix, uint32_t firstMeshID) {
+    m_MeshIDs.emplace_back(firstMeshID);
+    m_NormalMatrices.emplace_back(transpose(inverse(Mat3f(localToWorldMatrix))));
+
     auto pRTCScene = m_RTCScene;
     auto instID = rtcNewInstance(pRTCScene, scene.m_RTCScene);
-    Mat4f identity(1.f);
-    rtcSetTransform(pRTCScene, instID, RTC_MATRIX_COLUMN_MAJOR_ALIGNED16, value_ptr(identity));
+    rtcSetTransform(pRTCScene, instID, RTC_MATRIX_COLUMN_MAJOR_ALIGNED16, value_ptr(localToWorldMatrix));
 }
 
 void RTScene::commit() {
@@ -156,7 +274,7 @@ void RTScene::commit() {
 }
 
 bool RTScene::intersect(const Ray& ray, Hit& hit, uint32_t threadID) const {
-    RTCRayHandle rayHandle(ray, threadID);
+    RTCRayHandle rayHandle(ray, *this, threadID);
 
     rtcIntersect(m_RTCScene, rayHandle.rtcRay);
 
@@ -164,25 +282,19 @@ bool RTScene::intersect(const Ray& ray, Hit& hit, uint32_t threadID) const {
         return false;
     }
 
-    hit.m_nInstID = rayHandle.rtcRay.instID;
-    hit.m_nMeshID = rayHandle.rtcRay.geomID;
-    hit.m_nTriangleID = rayHandle.rtcRay.primID;
-    hit.m_UV = Vec2f(rayHandle.rtcRay.u, rayHandle.rtcRay.v);
-    hit.m_Ng = normalize(Vec3f(rayHandle.rtcRay.Ng[0], rayHandle.rtcRay.Ng[1], rayHandle.rtcRay.Ng[2]));
-    hit.m_fDistance = rayHandle.rtcRay.tfar;
-    hit.m_P = ray.org + rayHandle.rtcRay.tfar * ray.dir;
+    hit = getHit(rayHandle.rtcRay, ray, *this);
 
     return true;
 }
 
 bool RTScene::occluded(const Ray& ray, uint32_t threadID) const {
-    RTCRayHandle rayHandle(ray, threadID);
+    RTCRayHandle rayHandle(ray, *this, threadID);
     rtcOccluded(m_RTCScene, rayHandle.rtcRay);
     return rayHandle.rtcRay.geomID == 0;
 }
 
 bool RTScene::intersect(const Ray& ray, Hit& hit, const FilterFunction& filter, uint32_t threadID) const {
-    RTCRayHandle rayHandle(ray, threadID, &filter);
+    RTCRayHandle rayHandle(ray, *this, threadID, &filter);
 
     rtcIntersect(m_RTCScene, rayHandle.rtcRay);
 
@@ -190,21 +302,83 @@ bool RTScene::intersect(const Ray& ray, Hit& hit, const FilterFunction& filter,
         return false;
     }
 
-    hit.m_nInstID = rayHandle.rtcRay.instID;
-    hit.m_nMeshID = rayHandle.rtcRay.geomID;
-    hit.m_nTriangleID = rayHandle.rtcRay.primID;
-    hit.m_UV = Vec2f(rayHandle.rtcRay.u, rayHandle.rtcRay.v);
-    hit.m_Ng = normalize(Vec3f(rayHandle.rtcRay.Ng[0], rayHandle.rtcRay.Ng[1], rayHandle.rtcRay.Ng[2]));
-    hit.m_fDistance = rayHandle.rtcRay.tfar;
-    hit.m_P = ray.org + rayHandle.rtcRay.tfar * ray.dir;
+    hit = getHit(rayHandle.rtcRay, ray, *this);
 
     return true;
 }
 
 bool RTScene::occluded(const Ray& ray, const FilterFunction& filter, uint32_t threadID) const {
-    RTCRayHandle rayHandle(ray, threadID, &filter);
+    RTCRayHandle rayHandle(ray, *this, threadID, &filter);
     rtcOccluded(m_RTCScene, rayHandle.rtcRay);
     return rayHandle.rtcRay.geomID == 0;
 }
 
+// Fill the packet with the rays [offset, offset + packetSize) of pRays, the other slots are invalid
+static void fillRTCRayPacket(RTCRayPacketHandle& packet, const Ray* pRays, std::size_t offset, std::size_t packetSize, int* valid) {
+    packet.pRays = pRays + offset;
+
+    for(auto i = 0u; i < RTScene::RAY_PACKET_SIZE; ++i) {
+        if(i >= packetSize) {
+            valid[i] = 0;
+            continue;
+        }
+        const auto& ray = packet.pRays[i];
+        valid[i] = -1;
+        packet.rtcRays.orgx[i] = ray.org.x;
+        packet.rtcRays.orgy[i] = ray.org.y;
+        packet.rtcRays.orgz[i] = ray.org.z;
+        packet.rtcRays.dirx[i] = ray.dir.x;
+        packet.rtcRays.diry[i] = ray.dir.y;
+        packet.rtcRays.dirz[i] = ray.dir.z;
+        packet.rtcRays.tnear[i] = ray.tnear;
+        packet.rtcRays.tfar[i] = ray.tfar;
+        packet.rtcRays.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+        packet.rtcRays.primID[i] = RTC_INVALID_GEOMETRY_ID;
+        packet.rtcRays.instID[i] = RTC_INVALID_GEOMETRY_ID;
+        packet.rtcRays.mask[i] = 0xFFFFFFFF;
+        packet.rtcRays.time[i] = 0.f;
+    }
+}
+
+void RTScene::intersect(const Ray* pRays, std::size_t rayCount, Hit* pHits, bool* pResults, uint32_t threadID) const {
+    RTCRayPacketHandle packet;
+    packet.pScene = this;
+    packet.threadID = threadID;
+
+    RTCORE_ALIGN(16) int valid[RAY_PACKET_SIZE];
+
+    for(auto offset = std::size_t(0); offset < rayCount; offset += RAY_PACKET_SIZE) {
+        auto packetSize = std::min(RAY_PACKET_SIZE, rayCount - offset);
+        fillRTCRayPacket(packet, pRays, offset, packetSize, valid);
+
+        rtcIntersect4(valid, m_RTCScene, packet.rtcRays);
+
+        for(auto i = 0u; i < packetSize; ++i) {
+            pResults[offset + i] = uint32_t(packet.rtcRays.geomID[i]) != RTC_INVALID_GEOMETRY_ID && packet.rtcRays.tfar[i] > 0.f;
+            if(pResults[offset + i]) {
+                pHits[offset + i] = getPacketHit(packet.rtcRays, i, packet.pRays[i], *this);
+            }
+        }
+    }
+}
+
+void RTScene::occluded(const Ray* pRays, std::size_t rayCount, bool* pResults, uint32_t threadID) const {
+    RTCRayPacketHandle packet;
+    packet.pScene = this;
+    packet.threadID = threadID;
+
+    RTCORE_ALIGN(16) int valid[RAY_PACKET_SIZE];
+
+    for(auto offset = std::size_t(0); offset < rayCount; offset += RAY_PACKET_SIZE) {
+        auto packetSize = std::min(RAY_PACKET_SIZE, rayCount - offset);
+        fillRTCRayPacket(packet, pRays, offset, packetSize, valid);
+
+        rtcOccluded4(valid, m_RTCScene, packet.rtcRays);
+
+        for(auto i = 0u; i < packetSize; ++i) {
+            pResults[offset + i] = packet.rtcRays.geomID[i] == 0;
+        }
+    }
+}
+
 }
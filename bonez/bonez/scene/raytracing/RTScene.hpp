@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <vector>
 #include <bonez/scene/Ray.hpp>
 #include <bonez/scene/SceneGeometry.hpp>
 
@@ -9,6 +10,7 @@ struct __RTCScene;
 typedef __RTCScene* RTCScene;
 
 struct RTCRay;
+struct RTCRay4;
 
 namespace BnZ {
 
@@ -25,8 +27,6 @@ public:
 
         Hit() {
         }
-
-        Hit(const RTCRay& ray);
     };
     using FilterFunction = std::function < bool(const Hit& hit, uint32_t threadID) > ;
     struct FilterFunctions {
@@ -52,9 +52,13 @@ public:
 
     void addTriangleMesh(const TriangleMesh& mesh, FilterFunctions* pFilterFunctions = nullptr);
 
+    // Add the meshes and the instances of geometry. An embree scene is built for each instanced prototype and shared
+    // by all its instances.
     void addGeometry(const SceneGeometry& geometry);
 
-    void addInstance(const RTScene& scene);
+    // Add an instance of a committed scene made of triangle meshes only. The mesh ID of the hits on the i-th mesh
+    // of the instance is firstMeshID + i.
+    void addInstance(const RTScene& scene, const Mat4f& localToWorldMatrix, uint32_t firstMeshID);
 
     void commit();
 
@@ -66,9 +70,42 @@ public:
 
     bool occluded(const Ray& ray, const FilterFunction& filter, uint32_t threadID = 0u) const;
 
+    // Number of rays traced together by the packet versions of intersect() and occluded()
+    static const std::size_t RAY_PACKET_SIZE = 4u;
+
+    // Intersection of rayCount rays, traced by packets of RAY_PACKET_SIZE rays: pResults[i] is true if pRays[i] hits
+    // the scene, pHits[i] is then its hit. Packets are only efficient for coherent rays (see RayQueue).
+    void intersect(const Ray* pRays, std::size_t rayCount, Hit* pHits, bool* pResults, uint32_t threadID = 0u) const;
+
+    // Occlusion test of rayCount rays, traced by packets of RAY_PACKET_SIZE rays: pResults[i] is true if pRays[i] is occluded.
+    // Packets are only efficient for coherent rays, for example shadow rays sharing the same origin.
+    void occluded(const Ray* pRays, std::size_t rayCount, bool* pResults, uint32_t threadID = 0u) const;
+
+    static const uint32_t INVALID_ID = uint32_t(-1);
+
+    // Mesh ID of a hit on the geometry geomID of the instance instID (INVALID_ID if the geometry is not instanced)
+    uint32_t getMeshID(uint32_t geomID, uint32_t instID) const {
+        if(instID == INVALID_ID) {
+            return m_MeshIDs[geomID];
+        }
+        return m_MeshIDs[instID] + geomID;
+    }
+
+    // Transform a normal returned by embree for the instance instID to world space
+    Vec3f getWorldNormal(uint32_t instID, const Vec3f& N) const {
+        if(instID == INVALID_ID) {
+            return N;
+        }
+        return m_NormalMatrices[instID] * N;
+    }
+
 private:
     RTCScene m_RTCScene = nullptr; //! Embree scene
 
+    std::vector<uint32_t> m_MeshIDs; // Mesh ID of each embree geometry, first mesh ID for an instance
+    std::vector<Mat3f> m_NormalMatrices; // Normal matrix of each embree geometry
+    std::vector<RTScene> m_PrototypeScenes; // Scenes shared by the instances of the prototypes
+
     struct EmbreeInitHandle {
         EmbreeInitHandle(); // Init embree
 
@@ -0,0 +1,98 @@
+#include "RayQueue.hpp"
+
+#include <algorithm>
+
+namespace BnZ {
+
+const uint32_t RayQueue::ORIGIN_GRID_LEVEL;
+const uint32_t RayQueue::ORIGIN_GRID_RESOLUTION;
+const std::size_t RayQueue::TRACE_BLOCK_SIZE;
+
+// Insert two zeros between each of the 10 lowest bits of v
+static uint32_t expandBits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+void RayQueue::sortRays(const BBox3f& sceneBounds) {
+    auto size = sceneBounds.upper - sceneBounds.lower;
+    Vec3f cellScale;
+    for(auto i = 0u; i < 3u; ++i) {
+        cellScale[i] = size[i] > 0.f ? ORIGIN_GRID_RESOLUTION / size[i] : 0.f;
+    }
+
+    m_SortKeys.resize(m_Rays.size());
+    for(auto i = 0u; i < m_Rays.size(); ++i) {
+        const auto& ray = m_Rays[i];
+
+        uint32_t mortonCode = 0u;
+        for(auto axis = 0u; axis < 3u; ++axis) {
+            auto cell = clamp(int((ray.org[axis] - sceneBounds.lower[axis]) * cellScale[axis]), 0, int(ORIGIN_GRID_RESOLUTION) - 1);
+            mortonCode |= expandBits(uint32_t(cell)) << axis;
+        }
+
+        uint32_t octant = (ray.dir.x < 0.f ? 1u : 0u) | (ray.dir.y < 0.f ? 2u : 0u) | (ray.dir.z < 0.f ? 4u : 0u);
+        uint32_t bin = (octant << (3u * ORIGIN_GRID_LEVEL)) | mortonCode;
+
+        m_SortKeys[i] = (uint64_t(bin) << 32) | i;
+    }
+
+    std::sort(begin(m_SortKeys), end(m_SortKeys));
+
+    m_SortedRays.resize(m_Rays.size());
+    m_nBinCount = 0u;
+    for(auto i = 0u; i < m_SortKeys.size(); ++i) {
+        m_SortedRays[i] = m_Rays[uint32_t(m_SortKeys[i])];
+        if(!i || (m_SortKeys[i] >> 32) != (m_SortKeys[i - 1] >> 32)) {
+            ++m_nBinCount;
+        }
+    }
+}
+
+void RayQueue::intersect(const Scene& scene, Intersection* pIntersections, uint32_t threadCount) {
+    if(m_Rays.empty()) {
+        m_nBinCount = 0u;
+        return;
+    }
+
+    sortRays(scene.getBBox());
+    m_SortedIntersections.resize(m_SortedRays.size());
+
+    auto blockCount = uint32_t((m_SortedRays.size() + TRACE_BLOCK_SIZE - 1) / TRACE_BLOCK_SIZE);
+    processTasks(blockCount, [&](uint32_t blockID, uint32_t threadID) {
+        auto start = blockID * TRACE_BLOCK_SIZE;
+        auto end = std::min(m_SortedRays.size(), start + TRACE_BLOCK_SIZE);
+        scene.intersect(m_SortedRays.data() + start, end - start, m_SortedIntersections.data() + start, threadID);
+        for(auto i = start; i < end; ++i) {
+            pIntersections[uint32_t(m_SortKeys[i])] = m_SortedIntersections[i];
+        }
+    }, threadCount);
+}
+
+void RayQueue::occluded(const Scene& scene, bool* pResults, uint32_t threadCount) {
+    if(m_Rays.empty()) {
+        m_nBinCount = 0u;
+        return;
+    }
+
+    sortRays(scene.getBBox());
+    if(m_nOcclusionCapacity < m_SortedRays.size()) {
+        m_nOcclusionCapacity = m_SortedRays.size();
+        m_SortedOcclusions.reset(new bool[m_nOcclusionCapacity]);
+    }
+
+    auto blockCount = uint32_t((m_SortedRays.size() + TRACE_BLOCK_SIZE - 1) / TRACE_BLOCK_SIZE);
+    processTasks(blockCount, [&](uint32_t blockID, uint32_t threadID) {
+        auto start = blockID * TRACE_BLOCK_SIZE;
+        auto end = std::min(m_SortedRays.size(), start + TRACE_BLOCK_SIZE);
+        scene.occluded(m_SortedRays.data() + start, end - start, m_SortedOcclusions.get() + start, threadID);
+        for(auto i = start; i < end; ++i) {
+            pResults[uint32_t(m_SortKeys[i])] = m_SortedOcclusions[i];
+        }
+    }, threadCount);
+}
+
+}
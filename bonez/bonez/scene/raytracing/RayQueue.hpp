@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <bonez/sys/memory.hpp>
+#include <bonez/sys/threads.hpp>
+#include <bonez/scene/Scene.hpp>
+
+namespace BnZ {
+
+// Rays of many paths buffered and traced together in an order that makes them coherent.
+//
+// The rays are binned by direction octant, then by the cell of their origin in a uniform grid over the scene bounding
+// box, the cells being ordered along a Morton curve. Rays of the same bin start close to each other and go in similar
+// directions: tracing them in bin order, by packets, reduces the cache and branch misses of the BVH traversal compared
+// to the order in which they were generated. The results are scattered back in push order.
+class RayQueue {
+public:
+    // Cells per axis of the origin grid: 2^ORIGIN_GRID_LEVEL. The bin of a ray, its octant (3 bits) followed by the
+    // Morton code of its cell (3 * ORIGIN_GRID_LEVEL bits), must fit in 32 bits, so the level is at most 9.
+    static const uint32_t ORIGIN_GRID_LEVEL = 5u;
+    static const uint32_t ORIGIN_GRID_RESOLUTION = 1u << ORIGIN_GRID_LEVEL;
+    static_assert(3u + 3u * ORIGIN_GRID_LEVEL <= 32u, "The bins of the rays must fit in 32 bits");
+    static const std::size_t TRACE_BLOCK_SIZE = 1024u; // Consecutive sorted rays traced by each task
+
+    void clear() {
+        m_Rays.clear();
+    }
+
+    // Return the index of the ray in the queue, which is the index of its result
+    std::size_t push(const Ray& ray) {
+        m_Rays.emplace_back(ray);
+        return m_Rays.size() - 1;
+    }
+
+    std::size_t size() const {
+        return m_Rays.size();
+    }
+
+    bool empty() const {
+        return m_Rays.empty();
+    }
+
+    // pIntersections[i] is the intersection of the i-th ray of the queue
+    void intersect(const Scene& scene, Intersection* pIntersections, uint32_t threadCount = getSystemThreadCount());
+
+    // pResults[i] is true if the i-th ray of the queue is occluded
+    void occluded(const Scene& scene, bool* pResults, uint32_t threadCount = getSystemThreadCount());
+
+    // Number of non empty bins during the last trace
+    std::size_t getBinCount() const {
+        return m_nBinCount;
+    }
+
+private:
+    void sortRays(const BBox3f& sceneBounds);
+
+    std::vector<Ray> m_Rays;
+    std::vector<uint64_t> m_SortKeys; // Bin of each ray in the high 32 bits, index of the ray in the low 32 bits
+    std::vector<Ray> m_SortedRays;
+    std::vector<Intersection> m_SortedIntersections;
+    Unique<bool[]> m_SortedOcclusions;
+    std::size_t m_nOcclusionCapacity = 0u;
+    std::size_t m_nBinCount = 0u;
+};
+
+}
@@ -1,5 +1,8 @@
 #include "BSDF.hpp"
 
+#include <algorithm>
+#include <xmmintrin.h>
+
 namespace BnZ {
 
 BSDF::BSDF(
@@ -96,6 +99,182 @@ float BSDF::pdf(
     return evalReversePdf ? reversePdfW : directPdfW;
 }
 
+static const uint32_t BATCH_LANE_COUNT = 4u;
+
+// Structure of arrays layout: one float per lane for each parameter
+struct alignas(16) BSDF::BatchLanes {
+    float normal[3][BATCH_LANE_COUNT];
+    float samplingNormal[3][BATCH_LANE_COUNT];
+    float reflectedDirection[3][BATCH_LANE_COUNT]; // Axis of the glossy lobe
+    float cosThetaIncidentDir[BATCH_LANE_COUNT];
+    float diffProb[BATCH_LANE_COUNT];
+    float phongProb[BATCH_LANE_COUNT];
+    float shininess[BATCH_LANE_COUNT];
+    float diffuse[3][BATCH_LANE_COUNT]; // Zero if the component is not sampled, as in evalDiffuse
+    float glossy[3][BATCH_LANE_COUNT]; // Zero if the component is not sampled, as in evalGlossy
+    float reverseDiffusePdfW[BATCH_LANE_COUNT]; // Does not depend on the outgoing direction
+};
+
+void BSDF::setBatchLane(BatchLanes &lanes, uint32_t lane) const {
+    const auto R = reflect(mIncidentDirection, mSamplingNormal);
+    const auto diffuse = mProbabilities.diffProb == 0 ? zero<Vec3f>() : m_Kd;
+    const auto glossy = mProbabilities.phongProb == 0 ? zero<Vec3f>() : m_Ks;
+
+    for(auto i = 0u; i < 3u; ++i) {
+        lanes.normal[i][lane] = mNormal[i];
+        lanes.samplingNormal[i][lane] = mSamplingNormal[i];
+        lanes.reflectedDirection[i][lane] = R[i];
+        lanes.diffuse[i][lane] = diffuse[i];
+        lanes.glossy[i][lane] = glossy[i];
+    }
+    lanes.cosThetaIncidentDir[lane] = mCosThetaIncidentDir;
+    lanes.diffProb[lane] = mProbabilities.diffProb;
+    lanes.phongProb[lane] = mProbabilities.phongProb;
+    lanes.shininess[lane] = m_fShininess;
+
+    float reverseDiffusePdfW = 0.f;
+    pdfDiffuse(mIncidentDirection, nullptr, &reverseDiffusePdfW);
+    lanes.reverseDiffusePdfW[lane] = reverseDiffusePdfW;
+}
+
+void BSDF::evalBatchLanes(
+    const BatchLanes &lanes,
+    const Vec3f    *outgoingDirections,
+    std::size_t    directionStride,
+    uint32_t       laneCount,
+    Vec3f          *values,
+    float          *cosThetaOutDirs,
+    float          *oDirectPdfsW,
+    float          *oReversePdfsW) {
+    alignas(16) float directions[3][BATCH_LANE_COUNT] = {};
+    for(auto lane = 0u; lane < laneCount; ++lane) {
+        const auto &direction = outgoingDirections[lane * directionStride];
+        for(auto i = 0u; i < 3u; ++i) {
+            directions[i][lane] = direction[i];
+        }
+    }
+
+    const auto x = _mm_load_ps(directions[0]);
+    const auto y = _mm_load_ps(directions[1]);
+    const auto z = _mm_load_ps(directions[2]);
+    const auto zero = _mm_setzero_ps();
+
+    // Same operation order as dot(), so that the results match the scalar evaluation
+    auto dotDirection = [&](const float (&v)[3][BATCH_LANE_COUNT]) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_load_ps(v[0])), _mm_mul_ps(y, _mm_load_ps(v[1]))),
+                          _mm_mul_ps(z, _mm_load_ps(v[2])));
+    };
+
+    const auto cosThetaOutDir = dotDirection(lanes.normal);
+
+    // The two directions have to be in the same hemisphere (not(a < 0) keeps the lanes of NaN products, as eval does)
+    const auto sameHemisphere = _mm_cmpnlt_ps(_mm_mul_ps(cosThetaOutDir, _mm_load_ps(lanes.cosThetaIncidentDir)), zero);
+
+    // Diffuse component
+    const auto diffusePdfW = _mm_mul_ps(_mm_load_ps(lanes.diffProb),
+                                        _mm_max_ps(zero, _mm_mul_ps(dotDirection(lanes.samplingNormal), _mm_set1_ps(one_over_pi<float>()))));
+
+    // Glossy component: there is no SSE pow, it is computed per lane and only for the lanes that need it
+    alignas(16) float reflectCos[BATCH_LANE_COUNT];
+    _mm_store_ps(reflectCos, dotDirection(lanes.reflectedDirection));
+
+    alignas(16) float powReflectCos[BATCH_LANE_COUNT] = {};
+    for(auto lane = 0u; lane < laneCount; ++lane) {
+        if(lanes.phongProb[lane] != 0 && reflectCos[lane] >= 0.f) {
+            powReflectCos[lane] = pow(reflectCos[lane], lanes.shininess[lane]);
+        }
+    }
+
+    const auto cosR = _mm_load_ps(reflectCos);
+    const auto powCosR = _mm_load_ps(powReflectCos);
+    const auto glossyPdfW = _mm_and_ps(_mm_cmpge_ps(cosR, zero),
+        _mm_mul_ps(_mm_load_ps(lanes.phongProb),
+                   _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_load_ps(lanes.shininess), _mm_set1_ps(1.f)), powCosR),
+                              _mm_set1_ps(one_over_two_pi<float>()))));
+    const auto glossyMask = _mm_cmpgt_ps(cosR, zero);
+
+    alignas(16) float result[3][BATCH_LANE_COUNT];
+    for(auto i = 0u; i < 3u; ++i) {
+        const auto glossy = _mm_and_ps(glossyMask, _mm_mul_ps(_mm_load_ps(lanes.glossy[i]), powCosR));
+        _mm_store_ps(result[i], _mm_and_ps(sameHemisphere, _mm_add_ps(_mm_load_ps(lanes.diffuse[i]), glossy)));
+    }
+
+    alignas(16) float cosThetaOutDirResult[BATCH_LANE_COUNT];
+    alignas(16) float directPdfW[BATCH_LANE_COUNT];
+    alignas(16) float reversePdfW[BATCH_LANE_COUNT];
+    _mm_store_ps(cosThetaOutDirResult, cosThetaOutDir);
+    _mm_store_ps(directPdfW, _mm_and_ps(sameHemisphere, _mm_add_ps(diffusePdfW, glossyPdfW)));
+    _mm_store_ps(reversePdfW, _mm_and_ps(sameHemisphere, _mm_add_ps(_mm_load_ps(lanes.reverseDiffusePdfW), glossyPdfW)));
+
+    for(auto lane = 0u; lane < laneCount; ++lane) {
+        values[lane] = Vec3f(result[0][lane], result[1][lane], result[2][lane]);
+        cosThetaOutDirs[lane] = cosThetaOutDirResult[lane];
+        if(oDirectPdfsW) {
+            oDirectPdfsW[lane] = directPdfW[lane];
+        }
+        if(oReversePdfsW) {
+            oReversePdfsW[lane] = reversePdfW[lane];
+        }
+    }
+}
+
+void BSDF::evalBatch(
+    const Vec3f *outgoingDirections,
+    std::size_t count,
+    Vec3f       *values,
+    float       *cosThetaOutDirs,
+    float       *oDirectPdfsW,
+    float       *oReversePdfsW) const {
+    BatchLanes lanes;
+    for(auto lane = 0u; lane < BATCH_LANE_COUNT; ++lane) {
+        setBatchLane(lanes, lane);
+    }
+
+    for(auto i = std::size_t(0); i < count; i += BATCH_LANE_COUNT) {
+        auto laneCount = uint32_t(std::min<std::size_t>(BATCH_LANE_COUNT, count - i));
+        evalBatchLanes(lanes, outgoingDirections + i, 1u, laneCount, values + i, cosThetaOutDirs + i,
+                       oDirectPdfsW ? oDirectPdfsW + i : nullptr, oReversePdfsW ? oReversePdfsW + i : nullptr);
+    }
+}
+
+void BSDF::evalBatch(
+    const BSDF* const *bsdfs,
+    const Vec3f *outgoingDirections,
+    std::size_t count,
+    Vec3f       *values,
+    float       *cosThetaOutDirs,
+    float       *oDirectPdfsW,
+    float       *oReversePdfsW) {
+    BatchLanes lanes = {};
+    for(auto i = std::size_t(0); i < count; i += BATCH_LANE_COUNT) {
+        auto laneCount = uint32_t(std::min<std::size_t>(BATCH_LANE_COUNT, count - i));
+        for(auto lane = 0u; lane < laneCount; ++lane) {
+            bsdfs[i + lane]->setBatchLane(lanes, lane);
+        }
+        evalBatchLanes(lanes, outgoingDirections + i, 1u, laneCount, values + i, cosThetaOutDirs + i,
+                       oDirectPdfsW ? oDirectPdfsW + i : nullptr, oReversePdfsW ? oReversePdfsW + i : nullptr);
+    }
+}
+
+void BSDF::evalBatch(
+    const BSDF* const *bsdfs,
+    std::size_t count,
+    const Vec3f &outgoingDirection,
+    Vec3f       *values,
+    float       *cosThetaOutDirs,
+    float       *oDirectPdfsW,
+    float       *oReversePdfsW) {
+    BatchLanes lanes = {};
+    for(auto i = std::size_t(0); i < count; i += BATCH_LANE_COUNT) {
+        auto laneCount = uint32_t(std::min<std::size_t>(BATCH_LANE_COUNT, count - i));
+        for(auto lane = 0u; lane < laneCount; ++lane) {
+            bsdfs[i + lane]->setBatchLane(lanes, lane);
+        }
+        evalBatchLanes(lanes, &outgoingDirection, 0u, laneCount, values + i, cosThetaOutDirs + i,
+                       oDirectPdfsW ? oDirectPdfsW + i : nullptr, oReversePdfsW ? oReversePdfsW + i : nullptr);
+    }
+}
+
 Vec3f BSDF::sample(
     const Vec3f &aRndTriplet,
     Sample3f& outgoingDir,
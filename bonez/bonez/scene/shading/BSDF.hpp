@@ -126,6 +126,44 @@ public:
         const Vec3f &outgoingDirection,
         const bool  evalReversePdf = false) const;
 
+    /* \brief Given count directions, evaluates BSDF for each of them
+     *
+     * Same results as calling eval(outgoingDirections[i], cosThetaOutDirs[i],
+     * oDirectPdfsW + i, oReversePdfsW + i) for each i, but the directions are
+     * processed four at a time with SSE. The pdf arrays can be null.
+     */
+    void evalBatch(
+        const Vec3f *outgoingDirections,
+        std::size_t count,
+        Vec3f       *values,
+        float       *cosThetaOutDirs,
+        float       *oDirectPdfsW = nullptr,
+        float       *oReversePdfsW = nullptr) const;
+
+    /* \brief Evaluates count BSDFs, each one for its own direction
+     *
+     * values[i] is bsdfs[i]->eval(outgoingDirections[i], ...). Used to connect
+     * a point with several vertices at once, from the side of the vertices.
+     */
+    static void evalBatch(
+        const BSDF* const *bsdfs,
+        const Vec3f *outgoingDirections,
+        std::size_t count,
+        Vec3f       *values,
+        float       *cosThetaOutDirs,
+        float       *oDirectPdfsW = nullptr,
+        float       *oReversePdfsW = nullptr);
+
+    /* \brief Evaluates count BSDFs for the same direction */
+    static void evalBatch(
+        const BSDF* const *bsdfs,
+        std::size_t count,
+        const Vec3f &outgoingDirection,
+        Vec3f       *values,
+        float       *cosThetaOutDirs,
+        float       *oDirectPdfsW = nullptr,
+        float       *oReversePdfsW = nullptr);
+
     /* \brief Given 3 random numbers, samples new direction from BSDF.
      *
      * Uses z component of random triplet to pick BSDF component from
@@ -243,6 +281,26 @@ private:
         float          *oDirectPdfW = NULL,
         float          *oReversePdfW = NULL) const;
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Batch evaluation methods
+    // Each of the four SSE lanes evaluates its own BSDF for its own direction
+    ////////////////////////////////////////////////////////////////////////////
+
+    struct BatchLanes; // Parameters of the BSDF of each lane, defined in BSDF.cpp
+
+    void setBatchLane(BatchLanes &lanes, uint32_t lane) const;
+
+    // directionStride is the offset between the directions of two lanes (0 if they share it)
+    static void evalBatchLanes(
+        const BatchLanes &lanes,
+        const Vec3f    *outgoingDirections,
+        std::size_t    directionStride,
+        uint32_t       laneCount,
+        Vec3f          *values,
+        float          *cosThetaOutDirs,
+        float          *oDirectPdfsW,
+        float          *oReversePdfsW);
+
     ////////////////////////////////////////////////////////////////////////////
     // Albedo methods
     ////////////////////////////////////////////////////////////////////////////
@@ -44,6 +44,9 @@ public:
     
     void setGrid(GridType grid) {
         m_Grid = std::move(grid);
+        m_VoxelMapping.precomputeEmptyNeighbours(m_Grid.resolution(), [&](const Vec3i& voxel) {
+            return this->isInEmptySpace(voxel);
+        });
     }
 
     void setGridToWorld(const Mat4f& gridToWorld, float gridToWorldScale) {
@@ -7,7 +7,7 @@ EmptySpaceVoxelMapping::EmptySpaceVoxelMapping() {
         auto k = 0u;
         for(auto i = -1; i <= 1; ++i) {
             for(auto j = -1; j <= 1; ++j) {
-                m_FaceOffsets[int(CubeFace::POS_X)][k++] = Vec3i(1, i, j);
+                m_FaceNeighbours[int(CubeFace::POS_X)][k++].m_Offset = Vec3i(1, i, j);
             }
         }
     }
@@ -16,7 +16,7 @@ EmptySpaceVoxelMapping::EmptySpaceVoxelMapping() {
         auto k = 0u;
         for(auto i = -1; i <= 1; ++i) {
             for(auto j = -1; j <= 1; ++j) {
-                m_FaceOffsets[int(CubeFace::NEG_X)][k++] = Vec3i(-1, i, j);
+                m_FaceNeighbours[int(CubeFace::NEG_X)][k++].m_Offset = Vec3i(-1, i, j);
             }
         }
     }
@@ -25,7 +25,7 @@ EmptySpaceVoxelMapping::EmptySpaceVoxelMapping() {
         auto k = 0u;
         for(auto i = -1; i <= 1; ++i) {
             for(auto j = -1; j <= 1; ++j) {
-                m_FaceOffsets[int(CubeFace::POS_Y)][k++] = Vec3i(i, 1, j);
+                m_FaceNeighbours[int(CubeFace::POS_Y)][k++].m_Offset = Vec3i(i, 1, j);
             }
         }
     }
@@ -34,7 +34,7 @@ EmptySpaceVoxelMapping::EmptySpaceVoxelMapping() {
         auto k = 0u;
         for(auto i = -1; i <= 1; ++i) {
             for(auto j = -1; j <= 1; ++j) {
-                m_FaceOffsets[int(CubeFace::NEG_Y)][k++] = Vec3i(i, -1, j);
+                m_FaceNeighbours[int(CubeFace::NEG_Y)][k++].m_Offset = Vec3i(i, -1, j);
             }
         }
     }
@@ -43,7 +43,7 @@ EmptySpaceVoxelMapping::EmptySpaceVoxelMapping() {
         auto k = 0u;
         for(auto i = -1; i <= 1; ++i) {
             for(auto j = -1; j <= 1; ++j) {
-                m_FaceOffsets[int(CubeFace::POS_Z)][k++] = Vec3i(i, j, 1);
+                m_FaceNeighbours[int(CubeFace::POS_Z)][k++].m_Offset = Vec3i(i, j, 1);
             }
         }
     }
@@ -52,10 +52,17 @@ EmptySpaceVoxelMapping::EmptySpaceVoxelMapping() {
         auto k = 0u;
         for(auto i = -1; i <= 1; ++i) {
             for(auto j = -1; j <= 1; ++j) {
-                m_FaceOffsets[int(CubeFace::NEG_Z)][k++] = Vec3i(i, j, -1);
+                m_FaceNeighbours[int(CubeFace::NEG_Z)][k++].m_Offset = Vec3i(i, j, -1);
             }
         }
     }
+
+    for(auto& faceNeighbours: m_FaceNeighbours) {
+        for(auto& neighbour: faceNeighbours) {
+            neighbour.m_Direction = normalize(Vec3f(neighbour.m_Offset));
+            neighbour.m_nMaskBit = getNeighbourMaskBit(neighbour.m_Offset);
+        }
+    }
 }
 
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <bonez/maths/maths.hpp>
+#include <bonez/utils/Grid3D.hpp>
+#include <bonez/sys/threads.hpp>
 
 namespace BnZ {
 
@@ -8,6 +10,33 @@ class EmptySpaceVoxelMapping {
 public:
     EmptySpaceVoxelMapping();
 
+    // Precompute, for each voxel of a grid of the given resolution, the set of its neighbours that are in empty space.
+    // The getVoxel functions then read this set with a single lookup instead of calling isInEmptySpace for each neighbour:
+    // the functor given to them is only called for voxels outside of the grid, so it must be the same than here.
+    template<typename Functor>
+    void precomputeEmptyNeighbours(const Vec3u& resolution, Functor&& isInEmptySpace) {
+        m_EmptyNeighbourMasks = Grid3D<uint32_t>(resolution, 0u);
+        processTasksDeterminist(resolution.z, [&](uint32_t z, uint32_t threadID) {
+            for(auto y = 0u; y < resolution.y; ++y) {
+                for(auto x = 0u; x < resolution.x; ++x) {
+                    auto voxel = Vec3i(x, y, z);
+                    auto mask = 0u;
+                    for(auto dz = -1; dz <= 1; ++dz) {
+                        for(auto dy = -1; dy <= 1; ++dy) {
+                            for(auto dx = -1; dx <= 1; ++dx) {
+                                auto offset = Vec3i(dx, dy, dz);
+                                if(isInEmptySpace(voxel + offset)) {
+                                    mask |= getNeighbourMaskBit(offset);
+                                }
+                            }
+                        }
+                    }
+                    m_EmptyNeighbourMasks(voxel) = mask;
+                }
+            }
+        }, getSystemThreadCount());
+    }
+
     // Map a 3D surface point to an empty space voxel, according to an incident direction
     // If no empty space voxel is found in the neighbouring of the point, the voxel containing it is returned.
     // The function bool isInEmptySpace(Vec3i voxel) must be defined
@@ -29,32 +58,26 @@ public:
 
         auto voxel = Vec3i(pointInGrid);
         auto bestNeighbour = voxel;
-        Vec3i bestOffset;
         auto bestDotWithNormal = 0.f;
 
         auto bestDotWithIncidentDirection = 0.f;
 
-        for(const auto& offset: m_FaceOffsets[int(face)]) {
-            auto neighbour = voxel + offset;
-            if(isInEmptySpace(neighbour)) {
-                auto dir = normalize(Vec3f(neighbour - voxel));
-                auto d = dot(N, dir);
-                if(d > bestDotWithNormal) {
+        forEachEmptyNeighbour(voxel, face, isInEmptySpace, [&](const Vec3i& neighbour, const Vec3f& dir) {
+            auto d = dot(N, dir);
+            if(d > bestDotWithNormal) {
+                bestDotWithNormal = d;
+                bestNeighbour = neighbour;
+                bestDotWithIncidentDirection = dot(wi, dir);
+            } else if(d == bestDotWithNormal) {
+                // ambuiguity, use the incident direction to decide
+                auto d2 = dot(wi, dir);
+                if(d2 > bestDotWithIncidentDirection) {
                     bestDotWithNormal = d;
-                    bestOffset = offset;
                     bestNeighbour = neighbour;
-                    bestDotWithIncidentDirection = dot(wi, dir);
-                } else if(d == bestDotWithNormal) {
-                    // ambuiguity, use the incident direction to decide
-                    auto d2 = dot(wi, dir);
-                    if(d2 > bestDotWithIncidentDirection) {
-                        bestDotWithNormal = d;
-                        bestNeighbour = neighbour;
-                        bestDotWithIncidentDirection = d2;
-                    }
+                    bestDotWithIncidentDirection = d2;
                 }
             }
-        }
+        });
 
         return bestNeighbour;
     }
@@ -75,17 +98,13 @@ public:
         auto bestNeighbour = voxel;
         auto bestDot = 0.f;
 
-        for(const auto& offset: m_FaceOffsets[int(face)]) {
-            auto neighbour = voxel + offset;
-            if(isInEmptySpace(neighbour)) {
-                auto dir = normalize(Vec3f(neighbour - voxel));
-                auto d = dot(N, dir);
-                if(d > bestDot) {
-                    bestDot = d;
-                    bestNeighbour = neighbour;
-                }
+        forEachEmptyNeighbour(voxel, face, isInEmptySpace, [&](const Vec3i& neighbour, const Vec3f& dir) {
+            auto d = dot(N, dir);
+            if(d > bestDot) {
+                bestDot = d;
+                bestNeighbour = neighbour;
             }
-        }
+        });
 
         return bestNeighbour;
     }
@@ -96,7 +115,38 @@ public:
     }
 
 private:
-    Vec3i m_FaceOffsets[int(CubeFace::FACE_COUNT)][9]; // Offsets of voxel neighbours for each face
+    struct Neighbour {
+        Vec3i m_Offset;
+        Vec3f m_Direction; // Normalized offset
+        uint32_t m_nMaskBit; // Bit of the neighbour in m_EmptyNeighbourMasks
+    };
+
+    static uint32_t getNeighbourMaskBit(const Vec3i& offset) {
+        return 1u << ((offset.x + 1) + 3 * (offset.y + 1) + 9 * (offset.z + 1));
+    }
+
+    // Call callback(neighbour, direction) for each neighbour of voxel on the side of face that is in empty space
+    template<typename Functor, typename Callback>
+    void forEachEmptyNeighbour(const Vec3i& voxel, CubeFace face, Functor&& isInEmptySpace, Callback&& callback) const {
+        const auto& neighbours = m_FaceNeighbours[int(face)];
+        if(m_EmptyNeighbourMasks.contains(voxel)) {
+            auto mask = m_EmptyNeighbourMasks(voxel);
+            for(const auto& neighbour: neighbours) {
+                if(mask & neighbour.m_nMaskBit) {
+                    callback(voxel + neighbour.m_Offset, neighbour.m_Direction);
+                }
+            }
+        } else {
+            for(const auto& neighbour: neighbours) {
+                if(isInEmptySpace(voxel + neighbour.m_Offset)) {
+                    callback(voxel + neighbour.m_Offset, neighbour.m_Direction);
+                }
+            }
+        }
+    }
+
+    Neighbour m_FaceNeighbours[int(CubeFace::FACE_COUNT)][9]; // Voxel neighbours for each face
+    Grid3D<uint32_t> m_EmptyNeighbourMasks; // For each voxel, one bit per neighbour in empty space
 };
 
 }
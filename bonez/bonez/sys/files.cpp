@@ -1,6 +1,7 @@
 #include "files.hpp"
 
 #include <fstream>
+#include <cstdio>
 
 #ifdef _WIN32
 
@@ -19,6 +20,18 @@ void copyFile(const FilePath& srcFilePath, const FilePath& dstFilePath) {
     dst << src.rdbuf();
 }
 
+bool replaceFile(const FilePath& srcFilePath, const FilePath& dstFilePath) {
+#ifdef _WIN32
+    return MoveFileEx(srcFilePath.c_str(), dstFilePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return 0 == std::rename(srcFilePath.c_str(), dstFilePath.c_str());
+#endif
+}
+
+bool removeFile(const FilePath& filePath) {
+    return 0 == std::remove(filePath.c_str());
+}
+
 #ifndef __GNUC__
 
 Directory::Directory(const FilePath& path) :
@@ -132,6 +132,12 @@ private:
 
 void copyFile(const FilePath& srcFilePath, const FilePath& dstFilePath);
 
+// Rename srcFilePath to dstFilePath, replacing dstFilePath if it exists.
+// The replacement is atomic: a reader of dstFilePath sees either the old or the new file.
+bool replaceFile(const FilePath& srcFilePath, const FilePath& dstFilePath);
+
+bool removeFile(const FilePath& filePath);
+
 #ifdef __GNUC__
 
 class Directory {
@@ -0,0 +1,239 @@
+#include "memory.hpp"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <iostream>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace BnZ {
+
+static std::atomic<uint64_t> s_CurrentMemoryUsage[MEMORY_TAG_COUNT];
+static std::atomic<uint64_t> s_PeakMemoryUsage[MEMORY_TAG_COUNT];
+static std::atomic<uint64_t> s_OutOfCoreMemoryUsage[MEMORY_TAG_COUNT];
+static std::atomic<std::size_t> s_OutOfCoreThresholds[MEMORY_TAG_COUNT];
+static std::atomic<std::size_t> s_OutOfCoreAllocationCount;
+// Smallest out-of-core allocation of each tag, 0 if none: smaller blocks are never looked up in the registry. The
+// threshold itself can't be used since it may have changed since the allocation.
+static std::atomic<std::size_t> s_MinOutOfCoreByteCount[MEMORY_TAG_COUNT];
+
+// Out-of-core allocations, by start address. Never destroyed, since containers can be freed after the end of main.
+struct OutOfCoreRegistry {
+    std::mutex m_Mutex;
+    std::string m_ScratchDirectory = ".";
+    std::map<uintptr_t, std::size_t> m_Allocations; // Start address -> byte count
+};
+
+static OutOfCoreRegistry& getOutOfCoreRegistry() {
+    static auto pRegistry = new OutOfCoreRegistry();
+    return *pRegistry;
+}
+
+const char* getMemoryTagName(MemoryTag tag) {
+    static const char* names[] = {
+        "Other",
+        "LightVertices",
+        "SkeletonDistributions",
+        "ImportanceCache",
+        "HashGrid",
+        "Images",
+        "Framebuffer"
+    };
+    static_assert(sizeof(names) / sizeof(names[0]) == MEMORY_TAG_COUNT, "A name must be given to each memory tag");
+    return names[uint32_t(tag)];
+}
+
+void trackAllocation(MemoryTag tag, std::size_t byteCount) {
+    auto i = uint32_t(tag);
+    auto current = (s_CurrentMemoryUsage[i] += byteCount);
+    auto peak = s_PeakMemoryUsage[i].load();
+    while(peak < current && !s_PeakMemoryUsage[i].compare_exchange_weak(peak, current)) {
+    }
+}
+
+void trackDeallocation(MemoryTag tag, std::size_t byteCount) {
+    s_CurrentMemoryUsage[uint32_t(tag)] -= byteCount;
+}
+
+uint64_t getCurrentMemoryUsage(MemoryTag tag) {
+    return s_CurrentMemoryUsage[uint32_t(tag)];
+}
+
+uint64_t getPeakMemoryUsage(MemoryTag tag) {
+    return s_PeakMemoryUsage[uint32_t(tag)];
+}
+
+void setOutOfCoreThreshold(MemoryTag tag, std::size_t byteCount) {
+    s_OutOfCoreThresholds[uint32_t(tag)] = byteCount;
+}
+
+std::size_t getOutOfCoreThreshold(MemoryTag tag) {
+    return s_OutOfCoreThresholds[uint32_t(tag)];
+}
+
+void setScratchDirectory(const std::string& directory) {
+    auto& registry = getOutOfCoreRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_Mutex);
+    registry.m_ScratchDirectory = directory.empty() ? "." : directory;
+}
+
+bool isOutOfCoreMemory(const void* ptr) {
+    if(!s_OutOfCoreAllocationCount) {
+        return false;
+    }
+    auto& registry = getOutOfCoreRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_Mutex);
+    auto address = uintptr_t(ptr);
+    auto it = registry.m_Allocations.upper_bound(address);
+    if(it == begin(registry.m_Allocations)) {
+        return false;
+    }
+    --it;
+    return address < (*it).first + (*it).second;
+}
+
+uint64_t getOutOfCoreMemoryUsage(MemoryTag tag) {
+    return s_OutOfCoreMemoryUsage[uint32_t(tag)];
+}
+
+#ifndef _WIN32
+
+// Map a new scratch file of byteCount bytes, return nullptr on failure
+static void* mapScratchFile(std::size_t byteCount) {
+    auto& registry = getOutOfCoreRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_Mutex);
+
+    auto path = registry.m_ScratchDirectory + "/bonez_scratch_XXXXXX";
+    std::vector<char> pathBuffer(begin(path), end(path));
+    pathBuffer.emplace_back('\0');
+
+    auto fd = mkstemp(pathBuffer.data());
+    if(fd < 0) {
+        std::cerr << "Unable to create a scratch file in " << registry.m_ScratchDirectory << ": " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+    // The file is removed when it is unmapped
+    unlink(pathBuffer.data());
+
+    void* ptr = nullptr;
+    if(ftruncate(fd, off_t(byteCount)) == 0) {
+        ptr = mmap(nullptr, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(ptr == MAP_FAILED) {
+            ptr = nullptr;
+        }
+    }
+    if(!ptr) {
+        std::cerr << "Unable to map a scratch file of " << byteCount << " bytes: " << strerror(errno) << std::endl;
+    } else {
+        registry.m_Allocations[uintptr_t(ptr)] = byteCount;
+        ++s_OutOfCoreAllocationCount;
+    }
+    close(fd);
+
+    return ptr;
+}
+
+// Return false if ptr is not an out-of-core allocation
+static bool unmapScratchFile(void* ptr) {
+    if(!s_OutOfCoreAllocationCount) {
+        return false;
+    }
+    auto& registry = getOutOfCoreRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_Mutex);
+    auto it = registry.m_Allocations.find(uintptr_t(ptr));
+    if(it == end(registry.m_Allocations)) {
+        return false;
+    }
+    munmap(ptr, (*it).second);
+    registry.m_Allocations.erase(it);
+    --s_OutOfCoreAllocationCount;
+    return true;
+}
+
+#endif
+
+void* allocateMemory(MemoryTag tag, std::size_t byteCount) {
+    void* ptr = nullptr;
+#ifndef _WIN32
+    auto threshold = getOutOfCoreThreshold(tag);
+    if(threshold && byteCount >= threshold) {
+        // Fallback to the heap if the scratch file can't be mapped
+        ptr = mapScratchFile(byteCount);
+        if(ptr) {
+            s_OutOfCoreMemoryUsage[uint32_t(tag)] += byteCount;
+
+            auto& minByteCount = s_MinOutOfCoreByteCount[uint32_t(tag)];
+            auto current = minByteCount.load();
+            while((!current || byteCount < current) && !minByteCount.compare_exchange_weak(current, byteCount)) {
+            }
+        }
+    }
+#endif
+    if(!ptr) {
+        ptr = ::operator new(byteCount);
+    }
+    trackAllocation(tag, byteCount);
+    return ptr;
+}
+
+void deallocateMemory(MemoryTag tag, void* ptr, std::size_t byteCount) {
+    trackDeallocation(tag, byteCount);
+#ifndef _WIN32
+    // Only blocks at least as large as the smallest mapping of the tag can be mapped, the others skip the registry lock
+    auto minByteCount = s_MinOutOfCoreByteCount[uint32_t(tag)].load();
+    if(minByteCount && byteCount >= minByteCount && unmapScratchFile(ptr)) {
+        s_OutOfCoreMemoryUsage[uint32_t(tag)] -= byteCount;
+        return;
+    }
+#endif
+    ::operator delete(ptr);
+}
+
+ChunkPrefetcher::ChunkPrefetcher(const void* ptr, std::size_t chunkSize) {
+#ifndef _WIN32
+    std::size_t pageSize = sysconf(_SC_PAGESIZE);
+    m_nChunkSize = std::max(pageSize, (chunkSize + pageSize - 1) / pageSize * pageSize);
+
+    if(!ptr || !s_OutOfCoreAllocationCount) {
+        return;
+    }
+    auto& registry = getOutOfCoreRegistry();
+    std::lock_guard<std::mutex> lock(registry.m_Mutex);
+    auto it = registry.m_Allocations.upper_bound(uintptr_t(ptr));
+    if(it == begin(registry.m_Allocations)) {
+        return;
+    }
+    --it;
+    if(uintptr_t(ptr) < (*it).first + (*it).second) {
+        m_nBegin = (*it).first;
+        m_nEnd = (*it).first + (*it).second;
+        m_bEnabled = true;
+    }
+#else
+    m_nChunkSize = chunkSize;
+#endif
+}
+
+void ChunkPrefetcher::prefetchChunks(const void* ptr, std::size_t byteCount) const {
+#ifndef _WIN32
+    auto address = uintptr_t(ptr);
+    if(address < m_nBegin || address >= m_nEnd) {
+        return;
+    }
+    auto chunkBegin = m_nBegin + (address - m_nBegin) / m_nChunkSize * m_nChunkSize;
+    auto chunkEnd = std::min(m_nEnd, m_nBegin + (address + byteCount - m_nBegin + m_nChunkSize - 1) / m_nChunkSize * m_nChunkSize);
+    // Starts the reads and returns without waiting for them
+    madvise(reinterpret_cast<void*>(chunkBegin), chunkEnd - chunkBegin, MADV_WILLNEED);
+#endif
+}
+
+}
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
+#include <string>
+#include <limits>
+#include <type_traits>
 
 namespace BnZ {
 
@@ -25,4 +29,139 @@ Unique<T[]> makeUniqueArray(size_t size) {
     return Unique<T[]>(new T[size]);
 }
 
+// Size in bytes of a cache line on the targeted processors
+static const std::size_t CACHE_LINE_SIZE = 64u;
+
+// Subsystems whose memory is accounted by TrackedAllocator
+enum class MemoryTag: uint32_t {
+    Other,
+    LightVertices,
+    SkeletonDistributions,
+    ImportanceCache,
+    HashGrid,
+    Images,
+    Framebuffer,
+    Count
+};
+
+static const uint32_t MEMORY_TAG_COUNT = uint32_t(MemoryTag::Count);
+
+const char* getMemoryTagName(MemoryTag tag);
+
+void trackAllocation(MemoryTag tag, std::size_t byteCount);
+
+void trackDeallocation(MemoryTag tag, std::size_t byteCount);
+
+// Number of bytes currently allocated for a subsystem
+uint64_t getCurrentMemoryUsage(MemoryTag tag);
+
+// Maximal number of bytes allocated at the same time for a subsystem since the start of the application
+uint64_t getPeakMemoryUsage(MemoryTag tag);
+
+// Out-of-core memory: the allocations of a subsystem larger than a threshold are backed by a scratch file mapped in
+// memory instead of the heap. The system pages them in and out, so they can exceed the physical memory.
+// Disabled for all subsystems by default, and not supported on Windows (the heap is used).
+
+// Allocations of the subsystem of at least byteCount bytes are out-of-core, 0 to disable
+void setOutOfCoreThreshold(MemoryTag tag, std::size_t byteCount);
+
+std::size_t getOutOfCoreThreshold(MemoryTag tag);
+
+// Directory of the scratch files, the working directory by default. A scratch file is deleted as soon as it is mapped.
+void setScratchDirectory(const std::string& directory);
+
+// True if ptr is inside an out-of-core allocation
+bool isOutOfCoreMemory(const void* ptr);
+
+// Number of bytes currently allocated out-of-core for a subsystem, included in getCurrentMemoryUsage
+uint64_t getOutOfCoreMemoryUsage(MemoryTag tag);
+
+// Allocation functions of TrackedAllocator
+void* allocateMemory(MemoryTag tag, std::size_t byteCount);
+
+void deallocateMemory(MemoryTag tag, void* ptr, std::size_t byteCount);
+
+// Pages in the chunks of an out-of-core allocation before they are accessed, e.g. as soon as the index of an element
+// is sampled. The requests are asynchronous: the system reads the chunks in the background, in the order of the
+// requests, while the calling thread continues. Does nothing if the allocation is in the heap.
+class ChunkPrefetcher {
+public:
+    static const std::size_t DEFAULT_CHUNK_SIZE = 64u * 1024u;
+
+    // ptr is any address of the allocation, chunkSize is rounded to a multiple of the page size
+    explicit ChunkPrefetcher(const void* ptr = nullptr, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+    bool isEnabled() const {
+        return m_bEnabled;
+    }
+
+    void prefetch(const void* ptr, std::size_t byteCount) const {
+        if(m_bEnabled) {
+            prefetchChunks(ptr, byteCount);
+        }
+    }
+
+    template<typename T>
+    void prefetch(const T* ptr) const {
+        prefetch(ptr, sizeof(T));
+    }
+
+private:
+    void prefetchChunks(const void* ptr, std::size_t byteCount) const;
+
+    std::size_t m_nChunkSize;
+    bool m_bEnabled = false;
+    uintptr_t m_nBegin = 0u; // Bounds of the allocation, the chunks are aligned on m_nBegin
+    uintptr_t m_nEnd = 0u;
+};
+
+// Standard allocator that accounts its allocations to a subsystem. The tag follows the memory when containers are
+// copy-assigned, move-assigned or swapped, so each block is released with the tag it was allocated with: an assigned
+// container takes the tag of its source (e.g. Framebuffer::setChannel gives the channel the tag of the new image).
+template<typename T>
+class TrackedAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    TrackedAllocator(MemoryTag tag = MemoryTag::Other) noexcept:
+        m_Tag(tag) {
+    }
+
+    template<typename U>
+    TrackedAllocator(const TrackedAllocator<U>& allocator) noexcept:
+        m_Tag(allocator.getTag()) {
+    }
+
+    T* allocate(std::size_t n) {
+        if(n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(allocateMemory(m_Tag, n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, std::size_t n) {
+        deallocateMemory(m_Tag, ptr, n * sizeof(T));
+    }
+
+    MemoryTag getTag() const {
+        return m_Tag;
+    }
+
+private:
+    MemoryTag m_Tag;
+};
+
+template<typename T, typename U>
+inline bool operator ==(const TrackedAllocator<T>& lhs, const TrackedAllocator<U>& rhs) {
+    return lhs.getTag() == rhs.getTag();
+}
+
+template<typename T, typename U>
+inline bool operator !=(const TrackedAllocator<T>& lhs, const TrackedAllocator<U>& rhs) {
+    return !(lhs == rhs);
+}
+
 }
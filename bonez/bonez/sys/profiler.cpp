@@ -0,0 +1,75 @@
+#include "profiler.hpp"
+
+#include <fstream>
+
+namespace BnZ {
+
+TaskProfiler::TaskProfiler(std::vector<std::string> taskNames, std::size_t threadCount,
+                           uint32_t samplingPeriod, std::size_t eventBufferSize):
+    m_TaskNames(std::move(taskNames)),
+    m_Counters(m_TaskNames.size(), threadCount),
+    m_Events(eventBufferSize, threadCount),
+    m_EventCounts(1u, threadCount),
+    m_nSamplingPeriod(std::max(1u, samplingPeriod)) {
+    reset();
+}
+
+void TaskProfiler::reset() {
+    m_Counters.fill(TaskCounters());
+    m_EventCounts.fill(0u);
+    m_nOrigin = readTimestampCounter();
+}
+
+uint64_t TaskProfiler::getCallCount(std::size_t taskID) const {
+    uint64_t count = 0u;
+    for(auto threadID = 0u; threadID < m_Counters.getThreadCount(); ++threadID) {
+        count += m_Counters(taskID, threadID).m_nCallCount;
+    }
+    return count;
+}
+
+double TaskProfiler::getEstimatedTicks(std::size_t taskID) const {
+    auto ticks = 0.;
+    for(auto threadID = 0u; threadID < m_Counters.getThreadCount(); ++threadID) {
+        const auto& counters = m_Counters(taskID, threadID);
+        if(counters.m_nSampledCallCount) {
+            // The calls that are not sampled are assumed to last as long as the sampled ones on average
+            ticks += double(counters.m_nTicks) * counters.m_nCallCount / counters.m_nSampledCallCount;
+        }
+    }
+    return ticks;
+}
+
+void TaskProfiler::exportChromeTrace(std::ostream& out) const {
+    out << "{\"traceEvents\":[";
+    auto separator = "\n";
+    for(auto threadID = 0u; threadID < m_Counters.getThreadCount(); ++threadID) {
+        out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << threadID
+            << ",\"args\":{\"name\":\"Thread " << threadID << "\"}}";
+        separator = ",\n";
+
+        // When the ring buffer has wrapped around, the oldest event is the next one to be overwritten
+        auto bufferSize = m_Events.size();
+        auto totalEventCount = m_EventCounts(0u, threadID);
+        auto eventCount = std::min<uint64_t>(totalEventCount, bufferSize);
+        for(auto i = totalEventCount - eventCount; i < totalEventCount; ++i) {
+            const auto& event = m_Events(i % bufferSize, threadID);
+            out << separator << "{\"name\":\"" << m_TaskNames[event.m_nTaskID] << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << threadID
+                << ",\"ts\":" << ticks2us(double(event.m_nStart - m_nOrigin))
+                << ",\"dur\":" << ticks2us(double(event.m_nEnd - event.m_nStart)) << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool TaskProfiler::storeChromeTrace(const FilePath& filepath) const {
+    std::ofstream out(filepath.str());
+    if(!out) {
+        std::cerr << "Unable to open " << filepath << " to store the profiling trace" << std::endl;
+        return false;
+    }
+    exportChromeTrace(out);
+    return true;
+}
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <bonez/types.hpp>
+#include <bonez/utils/PerThreadAccumulator.hpp>
+
+#include "time.hpp"
+#include "files.hpp"
+
+namespace BnZ {
+
+// Drop-in replacement of TaskTimer for hot loops, based on the time stamp counter of the processor.
+//
+// Each thread owns its counters and a ring buffer storing its last timing events, padded from those of the other threads,
+// so starting and stopping a timer is a few cycles without synchronization. The events can be exported to the Chrome trace format (chrome://tracing).
+//
+// With a sampling period N > 1, only one call out of N of each task is timed and the total duration of a task is
+// estimated from the sampled calls.
+//
+// Compiling with BNZ_DISABLE_PROFILING removes all timings: start() returns an empty scoped timer.
+class TaskProfiler {
+public:
+    struct Event {
+        uint64_t m_nStart;
+        uint64_t m_nEnd;
+        uint32_t m_nTaskID;
+    };
+
+    class ScopedTimer {
+    public:
+        ScopedTimer() = default;
+
+        ScopedTimer(TaskProfiler* pProfiler, uint32_t taskID, uint32_t threadID, uint64_t start):
+            m_pProfiler(pProfiler), m_nTaskID(taskID), m_nThreadID(threadID), m_nStart(start) {
+        }
+
+        ScopedTimer(ScopedTimer&& timer):
+            m_pProfiler(timer.m_pProfiler), m_nTaskID(timer.m_nTaskID), m_nThreadID(timer.m_nThreadID), m_nStart(timer.m_nStart) {
+            timer.m_pProfiler = nullptr;
+        }
+
+        ScopedTimer& operator =(ScopedTimer&&) = delete;
+
+        void storeDuration() {
+#ifndef BNZ_DISABLE_PROFILING
+            if(m_pProfiler) {
+                m_pProfiler->storeEvent(m_nThreadID, { m_nStart, readTimestampCounter(), m_nTaskID });
+                m_pProfiler = nullptr;
+            }
+#endif
+        }
+
+        ~ScopedTimer() {
+            storeDuration();
+        }
+
+    private:
+        TaskProfiler* m_pProfiler = nullptr; // nullptr if the call is not sampled or if its duration has been stored
+        uint32_t m_nTaskID = 0u;
+        uint32_t m_nThreadID = 0u;
+        uint64_t m_nStart = 0u;
+    };
+
+    TaskProfiler() = default;
+
+    // eventBufferSize is the capacity of the ring buffer of each thread, 0 to disable the recording of events
+    TaskProfiler(std::vector<std::string> taskNames, std::size_t threadCount,
+                 uint32_t samplingPeriod = 1u, std::size_t eventBufferSize = 0u);
+
+    ScopedTimer start(std::size_t taskID, std::size_t threadID = 0) {
+#ifndef BNZ_DISABLE_PROFILING
+        auto& counters = m_Counters(taskID, threadID);
+        if(counters.m_nCallCount++ % m_nSamplingPeriod == 0u) {
+            return { this, uint32_t(taskID), uint32_t(threadID), readTimestampCounter() };
+        }
+#endif
+        return {};
+    }
+
+    // Clear the counters and the events of all threads
+    void reset();
+
+    uint32_t getSamplingPeriod() const {
+        return m_nSamplingPeriod;
+    }
+
+    std::size_t getTaskCount() const {
+        return m_TaskNames.size();
+    }
+
+    const std::string& getTaskName(std::size_t taskID) const {
+        return m_TaskNames[taskID];
+    }
+
+    uint64_t getCallCount(std::size_t taskID) const;
+
+    // Estimated total duration of a task, summed over all threads
+    template<typename DurationType>
+    DurationType getEllapsedTime(std::size_t taskID) const {
+        return std::chrono::duration_cast<DurationType>(std::chrono::duration<double>(ticks2sec(getEstimatedTicks(taskID))));
+    }
+
+    // Write the recorded events in the Chrome trace JSON format, timestamps are relative to the last reset
+    void exportChromeTrace(std::ostream& out) const;
+
+    bool storeChromeTrace(const FilePath& filepath) const;
+
+private:
+    struct TaskCounters {
+        uint64_t m_nTicks = 0u; // Sum of the durations of sampled calls
+        uint64_t m_nCallCount = 0u;
+        uint64_t m_nSampledCallCount = 0u;
+    };
+
+    void storeEvent(uint32_t threadID, const Event& event) {
+        auto& counters = m_Counters(event.m_nTaskID, threadID);
+        counters.m_nTicks += event.m_nEnd - event.m_nStart;
+        ++counters.m_nSampledCallCount;
+        if(m_Events.size()) {
+            auto& eventCount = m_EventCounts(0u, threadID);
+            m_Events(eventCount % m_Events.size(), threadID) = event;
+            ++eventCount;
+        }
+    }
+
+    double getEstimatedTicks(std::size_t taskID) const;
+
+    std::vector<std::string> m_TaskNames;
+    PerThreadAccumulator<TaskCounters> m_Counters; // Counters of each task for each thread
+    PerThreadAccumulator<Event> m_Events; // Ring buffer of each thread
+    PerThreadAccumulator<uint64_t> m_EventCounts; // Number of events stored by each thread since the last reset
+    uint32_t m_nSamplingPeriod = 1u;
+    uint64_t m_nOrigin = 0u; // Time stamp of the last reset
+};
+
+}
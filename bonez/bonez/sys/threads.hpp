@@ -25,6 +25,12 @@ public:
         return m_nThreadCount;
     }
 
+    // Override the number of threads used by default, must be called before the construction of objects that
+    // allocate per-thread data with getSystemThreadCount()
+    void setSystemThreadCount(uint32_t threadCount) {
+        m_nThreadCount = threadCount;
+    }
+
     template<typename TaskFunctor>
     void launchThreads(const TaskFunctor& task, uint32_t threadCount) {
         m_Threads.clear();
@@ -45,6 +51,10 @@ inline uint32_t getSystemThreadCount() {
     return ParallelProcessor::s_Instance.getSystemThreadCount();
 }
 
+inline void setSystemThreadCount(uint32_t threadCount) {
+    ParallelProcessor::s_Instance.setSystemThreadCount(threadCount);
+}
+
 template<typename TaskFunctor>
 inline void launchThreads(const TaskFunctor& task,
                           uint32_t threadCount) {
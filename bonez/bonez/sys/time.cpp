@@ -8,6 +8,21 @@ uint64_t getMicroseconds() {
                 std::chrono::high_resolution_clock::now().time_since_epoch()).count();
 }
 
+double getTimestampCounterFrequency() {
+    static const double frequency = [] {
+        using Clock = std::chrono::steady_clock;
+        auto startTime = Clock::now();
+        auto startTicks = readTimestampCounter();
+        auto endTime = startTime;
+        while(endTime - startTime < std::chrono::milliseconds(20)) {
+            endTime = Clock::now();
+        }
+        auto endTicks = readTimestampCounter();
+        return (endTicks - startTicks) / std::chrono::duration<double>(endTime - startTime).count();
+    }();
+    return frequency;
+}
+
 std::string getDateString() {
     time_t t = time(nullptr);
     char mbstr[1024];
@@ -26,7 +26,9 @@
 
 #include <vector>
 #include <cmath>
+#include <cassert>
 #include <bonez/maths/maths.hpp>
+#include <bonez/sys/memory.hpp>
 
 namespace BnZ {
 
@@ -130,6 +132,20 @@ public:
         const Vec3f& queryPos,
         const tFunc& aFunc) const
     {
+        return process(aParticles, queryPos, mRadius, aFunc);
+    }
+
+    // Same with a query radius that must not exceed the radius given to build()
+    template<typename tParticle, typename tFunc>
+    int process(
+        const tParticle* aParticles,
+        const Vec3f& queryPos,
+        float aQueryRadius,
+        const tFunc& aFunc) const
+    {
+        assert(aQueryRadius <= mRadius);
+        const float queryRadiusSqr = sqr(aQueryRadius);
+
         const Vec3f distMin = queryPos - mBBoxMin;
         const Vec3f distMax = mBBoxMax - queryPos;
         for(int i=0; i<3; i++)
@@ -180,7 +196,7 @@ public:
                 const float distSqr =
                     lengthSquared(queryPos - getPosition(particle));
 
-                if(distSqr <= mRadiusSqr) {
+                if(distSqr <= queryRadiusSqr) {
                     aFunc(particle);
                     ++found;
                 }
@@ -225,8 +241,8 @@ private:
 
     Vec3f mBBoxMin;
     Vec3f mBBoxMax;
-    std::vector<int> mIndices;
-    std::vector<int> mCellEnds;
+    std::vector<int, TrackedAllocator<int>> mIndices { TrackedAllocator<int>(MemoryTag::HashGrid) };
+    std::vector<int, TrackedAllocator<int>> mCellEnds { TrackedAllocator<int>(MemoryTag::HashGrid) };
 
     float mRadius;
     float mRadiusSqr;
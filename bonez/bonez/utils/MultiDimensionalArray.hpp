@@ -2,20 +2,23 @@
 
 #include <vector>
 #include <array>
+#include <bonez/sys/memory.hpp>
 
 namespace BnZ {
 
 template<typename T, std::size_t Dimension, typename Alloc>
 class MultiDimensionalArray;
 
-template<typename T, typename Alloc = std::allocator<T>>
+template<typename T, typename Alloc = TrackedAllocator<T>>
 using Array2d = MultiDimensionalArray<T, 2, Alloc>;
 
-template<typename T, typename Alloc = std::allocator<T>>
+template<typename T, typename Alloc = TrackedAllocator<T>>
 using Array3d = MultiDimensionalArray<T, 3, Alloc>;
 
-// A multidimensional array stored contiguously in memory
-template<typename T, std::size_t Dimension, typename Alloc = std::allocator<T>>
+// A multidimensional array stored contiguously in memory.
+// The memory is accounted to MemoryTag::Other, unless an allocator with another tag is given at construction:
+//     Array2d<PathVertex> m_LightPathBuffer { MemoryTag::LightVertices };
+template<typename T, std::size_t Dimension, typename Alloc = TrackedAllocator<T>>
 class MultiDimensionalArray: std::vector<T, Alloc> {
     using Container = std::vector<T, Alloc>;
 public:
@@ -33,6 +36,10 @@ public:
 
     MultiDimensionalArray() = default;
 
+    MultiDimensionalArray(const Alloc& allocator):
+        Container(allocator) {
+    }
+
     template<typename... Us>
     MultiDimensionalArray(std::size_t size0, Us&&... sizes):
         Container(totalSize(size0, std::forward<Us>(sizes)...)) {
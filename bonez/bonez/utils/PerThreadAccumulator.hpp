@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <bonez/sys/memory.hpp>
+#include <bonez/sys/threads.hpp>
+
+namespace BnZ {
+
+// Per-thread copies of an array of values (counters, statistics, durations) accumulated by a parallel loop and summed
+// after it.
+//
+// The values of a thread are contiguous and separated from those of the other threads by at least one cache line of
+// padding, so threads updating their own values never write to the same cache line.
+template<typename T>
+class PerThreadAccumulator {
+public:
+    // Number of indices summed by each task of a parallel reduction
+    static const std::size_t REDUCTION_BLOCK_SIZE = 1024u;
+
+    PerThreadAccumulator(MemoryTag tag = MemoryTag::Other):
+        m_Values(TrackedAllocator<T>(tag)) {
+    }
+
+    PerThreadAccumulator(std::size_t size, std::size_t threadCount, MemoryTag tag = MemoryTag::Other):
+        m_Values(TrackedAllocator<T>(tag)) {
+        resize(size, threadCount);
+    }
+
+    // All values are reset to T()
+    void resize(std::size_t size, std::size_t threadCount) {
+        m_nSize = size;
+        m_nThreadCount = threadCount;
+        m_nStride = size + PADDING;
+        m_Values.assign(PADDING + threadCount * m_nStride, T());
+    }
+
+    std::size_t size() const {
+        return m_nSize;
+    }
+
+    std::size_t getThreadCount() const {
+        return m_nThreadCount;
+    }
+
+    T& operator ()(std::size_t i, std::size_t threadID) {
+        return m_Values[PADDING + threadID * m_nStride + i];
+    }
+
+    const T& operator ()(std::size_t i, std::size_t threadID) const {
+        return m_Values[PADDING + threadID * m_nStride + i];
+    }
+
+    // The size() values of a thread
+    T* getThreadPtr(std::size_t threadID) {
+        return m_Values.data() + PADDING + threadID * m_nStride;
+    }
+
+    const T* getThreadPtr(std::size_t threadID) const {
+        return m_Values.data() + PADDING + threadID * m_nStride;
+    }
+
+    void fill(const T& value) {
+        std::fill(begin(m_Values), end(m_Values), value);
+    }
+
+    // Sum over all threads of the value i
+    T reduce(std::size_t i) const {
+        auto sum = T();
+        for(auto threadID = 0u; threadID < m_nThreadCount; ++threadID) {
+            sum += (*this)(i, threadID);
+        }
+        return sum;
+    }
+
+    // Call f(i, sum over all threads of the value i) for each i, in parallel over blocks of REDUCTION_BLOCK_SIZE indices
+    template<typename Functor>
+    void reduceAll(const Functor& f, uint32_t threadCount = getSystemThreadCount()) const {
+        auto blockCount = uint32_t((m_nSize + REDUCTION_BLOCK_SIZE - 1) / REDUCTION_BLOCK_SIZE);
+        auto reduceBlock = [&](uint32_t blockID, uint32_t threadID) {
+            auto end = std::min(m_nSize, (blockID + 1) * REDUCTION_BLOCK_SIZE);
+            for(auto i = blockID * REDUCTION_BLOCK_SIZE; i < end; ++i) {
+                f(i, reduce(i));
+            }
+        };
+        if(blockCount <= 1u) {
+            if(blockCount) {
+                reduceBlock(0u, 0u);
+            }
+            return;
+        }
+        processTasks(blockCount, reduceBlock, threadCount);
+    }
+
+private:
+    static const std::size_t PADDING = (CACHE_LINE_SIZE + sizeof(T) - 1) / sizeof(T); // Elements in a cache line
+
+    std::size_t m_nSize = 0u;
+    std::size_t m_nThreadCount = 0u;
+    std::size_t m_nStride = 0u;
+    std::vector<T, TrackedAllocator<T>> m_Values; // PADDING, then the values of each thread followed by PADDING
+};
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <queue>
+#include <limits>
+#include <vector>
+#include <functional>
+#include <bonez/sys/threads.hpp>
+#include <bonez/maths/maths.hpp>
+
+#include "Graph.hpp"
+
+namespace BnZ {
+
+// Shortest path trees on the adjacency lists of a Graph (Dijkstra algorithm).
+//
+// The frontier is a binary heap with lazy deletion: when the distance of a node decreases, the node is pushed again
+// and the outdated entry is skipped when it is popped, so a run is O(E log E) for E edges.
+
+template<typename DistanceType>
+struct ShortestPathNode {
+    GraphNodeIndex predecessor = UNDEFINED_NODE; // The root is its own predecessor, UNDEFINED_NODE if the node is unreachable
+    GraphNodeIndex root = UNDEFINED_NODE; // Nearest root, for multi-source runs
+    DistanceType distance = std::numeric_limits<DistanceType>::max();
+};
+
+template<typename DistanceType>
+using ShortestPathVector = std::vector<ShortestPathNode<DistanceType>>;
+
+template<typename DistanceFunction>
+using ShortestPathDistanceType = decltype(std::declval<DistanceFunction>()(GraphNodeIndex(), GraphNodeIndex()));
+
+// Multi-source run: all roots start at distance 0 and each node is connected to its nearest root.
+// distance(n1, n2) must return the non-negative length of the edge (n1, n2).
+template<typename DistanceFunction>
+ShortestPathVector<ShortestPathDistanceType<DistanceFunction>> computeShortestPaths(
+        const Graph& graph, const GraphNodeIndex* pRoots, std::size_t rootCount, const DistanceFunction& distance) {
+    using DistanceType = ShortestPathDistanceType<DistanceFunction>;
+    using HeapElement = std::pair<DistanceType, GraphNodeIndex>;
+
+    ShortestPathVector<DistanceType> result(graph.size());
+    std::priority_queue<HeapElement, std::vector<HeapElement>, std::greater<HeapElement>> heap;
+
+    for(auto i = 0u; i < rootCount; ++i) {
+        auto root = pRoots[i];
+        result[root].predecessor = root;
+        result[root].root = root;
+        result[root].distance = 0;
+        heap.emplace(DistanceType(0), root);
+    }
+
+    while(!heap.empty()) {
+        auto element = heap.top();
+        heap.pop();
+
+        auto nodeIndex = element.second;
+        const auto& node = result[nodeIndex];
+        if(element.first > node.distance) {
+            continue; // Outdated entry, the node has already been processed with a shorter distance
+        }
+
+        for(auto neighbourIndex: graph[nodeIndex]) {
+            auto neighbourDistance = node.distance + distance(nodeIndex, neighbourIndex);
+            auto& neighbour = result[neighbourIndex];
+            if(neighbourDistance < neighbour.distance) {
+                neighbour.predecessor = nodeIndex;
+                neighbour.root = node.root;
+                neighbour.distance = neighbourDistance;
+                heap.emplace(neighbourDistance, neighbourIndex);
+            }
+        }
+    }
+
+    return result;
+}
+
+template<typename DistanceFunction>
+ShortestPathVector<ShortestPathDistanceType<DistanceFunction>> computeShortestPaths(
+        const Graph& graph, GraphNodeIndex root, const DistanceFunction& distance) {
+    return computeShortestPaths(graph, &root, 1u, distance);
+}
+
+// One independent shortest path tree for each root, the runs are distributed over threadCount threads
+template<typename DistanceFunction>
+std::vector<ShortestPathVector<ShortestPathDistanceType<DistanceFunction>>> computeShortestPathsPerRoot(
+        const Graph& graph, const std::vector<GraphNodeIndex>& roots, const DistanceFunction& distance,
+        uint32_t threadCount = getSystemThreadCount()) {
+    std::vector<ShortestPathVector<ShortestPathDistanceType<DistanceFunction>>> result(roots.size());
+    processTasks(roots.size(), [&](uint32_t rootIndex, uint32_t threadID) {
+        result[rootIndex] = computeShortestPaths(graph, roots[rootIndex], distance);
+    }, threadCount);
+    return result;
+}
+
+template<typename DistanceType>
+DistanceType computeMaxDistance(const ShortestPathVector<DistanceType>& shortestPaths) {
+    auto maxDistance = DistanceType(0);
+    for(const auto& node: shortestPaths) {
+        if(node.predecessor != UNDEFINED_NODE) {
+            maxDistance = max(maxDistance, node.distance);
+        }
+    }
+    return maxDistance;
+}
+
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <bonez/types.hpp>
+#include <bonez/sys/memory.hpp>
+
+namespace BnZ {
+
+// Sparse 3D grid made of bricks of BRICK_SIZE^3 voxels, for data that differs from a background value in a small part
+// of the grid (skeleton voxels, birth dates of curvilinear edges, ...).
+//
+// A brick is only allocated when one of its voxels is set to a value different from the background and is released
+// when all of its voxels are back to the background. Each allocated brick stores a bitmask of its active voxels (those
+// that differ from the background), used to iterate over them without reading the values of inactive ones.
+// The memory used by an empty region is one pointer per brick, so 1/64 byte per voxel.
+//
+// Unlike Grid3D, voxels can't be modified through a reference: use set().
+template<typename T>
+class SparseGrid3D {
+public:
+    static const uint32_t BRICK_SIZE_LOG2 = 3u;
+    static const uint32_t BRICK_SIZE = 1u << BRICK_SIZE_LOG2;
+    static const uint32_t BRICK_VOXEL_COUNT = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+    SparseGrid3D() = default;
+
+    SparseGrid3D(size_t width, size_t height, size_t depth, T background = T()):
+        m_nWidth(width),
+        m_nHeight(height),
+        m_nDepth(depth),
+        m_BrickResolution(brickCount(width), brickCount(height), brickCount(depth)),
+        m_Bricks(m_BrickResolution.x * m_BrickResolution.y * m_BrickResolution.z),
+        m_Background(background) {
+    }
+
+    SparseGrid3D(const Vec3u& resolution, T background = T()):
+        SparseGrid3D(resolution.x, resolution.y, resolution.z, background) {
+    }
+
+    SparseGrid3D(const SparseGrid3D& grid):
+        m_nWidth(grid.m_nWidth),
+        m_nHeight(grid.m_nHeight),
+        m_nDepth(grid.m_nDepth),
+        m_BrickResolution(grid.m_BrickResolution),
+        m_Bricks(grid.m_Bricks.size()),
+        m_Background(grid.m_Background),
+        m_nAllocatedBrickCount(grid.m_nAllocatedBrickCount) {
+        for(auto i = 0u; i < m_Bricks.size(); ++i) {
+            if(grid.m_Bricks[i]) {
+                m_Bricks[i] = makeUnique<Brick>(*grid.m_Bricks[i]);
+            }
+        }
+    }
+
+    SparseGrid3D& operator =(const SparseGrid3D& grid) {
+        SparseGrid3D copy(grid);
+        *this = std::move(copy);
+        return *this;
+    }
+
+    SparseGrid3D(SparseGrid3D&&) = default;
+
+    SparseGrid3D& operator =(SparseGrid3D&&) = default;
+
+    const T& background() const {
+        return m_Background;
+    }
+
+    const T& operator ()(uint32_t x, uint32_t y, uint32_t z) const {
+        const auto& pBrick = m_Bricks[brickIndex(x, y, z)];
+        if(!pBrick) {
+            return m_Background;
+        }
+        return pBrick->m_Values[voxelIndex(x, y, z)];
+    }
+
+    const T& operator ()(const Vec3i& coords) const {
+        return (*this)(coords.x, coords.y, coords.z);
+    }
+
+    void set(uint32_t x, uint32_t y, uint32_t z, const T& value) {
+        auto& pBrick = m_Bricks[brickIndex(x, y, z)];
+        auto isActive = !(value == m_Background);
+        if(!pBrick) {
+            if(!isActive) {
+                return;
+            }
+            pBrick = makeUnique<Brick>(m_Background);
+            ++m_nAllocatedBrickCount;
+        }
+
+        auto i = voxelIndex(x, y, z);
+        pBrick->m_Values[i] = value;
+        if(isActive) {
+            pBrick->m_Occupancy[i >> 6] |= uint64_t(1) << (i & 63u);
+        } else {
+            pBrick->m_Occupancy[i >> 6] &= ~(uint64_t(1) << (i & 63u));
+            if(pBrick->empty()) {
+                pBrick = nullptr;
+                --m_nAllocatedBrickCount;
+            }
+        }
+    }
+
+    void set(const Vec3i& coords, const T& value) {
+        set(coords.x, coords.y, coords.z, value);
+    }
+
+    // True if the voxel differs from the background value
+    bool isActive(uint32_t x, uint32_t y, uint32_t z) const {
+        const auto& pBrick = m_Bricks[brickIndex(x, y, z)];
+        if(!pBrick) {
+            return false;
+        }
+        auto i = voxelIndex(x, y, z);
+        return pBrick->m_Occupancy[i >> 6] & (uint64_t(1) << (i & 63u));
+    }
+
+    bool isActive(const Vec3i& coords) const {
+        return isActive(coords.x, coords.y, coords.z);
+    }
+
+    // Call f(x, y, z, value) for each active voxel, brick by brick
+    template<typename Functor>
+    void forEachActive(const Functor& f) const {
+        for(auto brickIdx = 0u; brickIdx < m_Bricks.size(); ++brickIdx) {
+            const auto& pBrick = m_Bricks[brickIdx];
+            if(!pBrick) {
+                continue;
+            }
+            auto brickX = (brickIdx % m_BrickResolution.x) << BRICK_SIZE_LOG2;
+            auto brickY = ((brickIdx / m_BrickResolution.x) % m_BrickResolution.y) << BRICK_SIZE_LOG2;
+            auto brickZ = (brickIdx / (m_BrickResolution.x * m_BrickResolution.y)) << BRICK_SIZE_LOG2;
+
+            for(auto word = 0u; word < pBrick->m_Occupancy.size(); ++word) {
+                for(auto bits = pBrick->m_Occupancy[word]; bits; bits &= bits - 1) {
+                    auto i = (word << 6) + uint32_t(__builtin_ctzll(bits));
+                    f(brickX + (i & (BRICK_SIZE - 1)),
+                      brickY + ((i >> BRICK_SIZE_LOG2) & (BRICK_SIZE - 1)),
+                      brickZ + (i >> (2 * BRICK_SIZE_LOG2)),
+                      pBrick->m_Values[i]);
+                }
+            }
+        }
+    }
+
+    bool contains(int x, int y, int z) const {
+        return x >= 0 &&
+                y >= 0 &&
+                z >= 0 &&
+                x < (int)m_nWidth &&
+                y < (int)m_nHeight &&
+                z < (int)m_nDepth;
+    }
+
+    bool contains(const Vec3i& coords) const {
+        return contains(coords.x, coords.y, coords.z);
+    }
+
+    size_t width() const {
+        return m_nWidth;
+    }
+
+    size_t height() const {
+        return m_nHeight;
+    }
+
+    size_t depth() const {
+        return m_nDepth;
+    }
+
+    Vec3u resolution() const {
+        return Vec3u(m_nWidth, m_nHeight, m_nDepth);
+    }
+
+    size_t getAllocatedBrickCount() const {
+        return m_nAllocatedBrickCount;
+    }
+
+    // Number of bytes used by the grid
+    size_t getMemoryUsage() const {
+        return sizeof(*this) + m_Bricks.size() * sizeof(Unique<Brick>) + m_nAllocatedBrickCount * sizeof(Brick);
+    }
+
+private:
+    struct Brick {
+        std::array<uint64_t, BRICK_VOXEL_COUNT / 64> m_Occupancy; // One bit per active voxel
+        std::array<T, BRICK_VOXEL_COUNT> m_Values;
+
+        explicit Brick(const T& background) {
+            m_Occupancy.fill(0u);
+            m_Values.fill(background);
+        }
+
+        bool empty() const {
+            for(auto word: m_Occupancy) {
+                if(word) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    static uint32_t brickCount(size_t size) {
+        return uint32_t((size + BRICK_SIZE - 1) >> BRICK_SIZE_LOG2);
+    }
+
+    uint32_t brickIndex(uint32_t x, uint32_t y, uint32_t z) const {
+        return (x >> BRICK_SIZE_LOG2) + m_BrickResolution.x * ((y >> BRICK_SIZE_LOG2) + m_BrickResolution.y * (z >> BRICK_SIZE_LOG2));
+    }
+
+    static uint32_t voxelIndex(uint32_t x, uint32_t y, uint32_t z) {
+        return (x & (BRICK_SIZE - 1)) + ((y & (BRICK_SIZE - 1)) << BRICK_SIZE_LOG2) + ((z & (BRICK_SIZE - 1)) << (2 * BRICK_SIZE_LOG2));
+    }
+
+    size_t m_nWidth = 0, m_nHeight = 0, m_nDepth = 0;
+    Vec3u m_BrickResolution = Vec3u(0u);
+    std::vector<Unique<Brick>> m_Bricks;
+    T m_Background = T();
+    size_t m_nAllocatedBrickCount = 0u;
+};
+
+}
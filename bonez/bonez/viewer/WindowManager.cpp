@@ -99,7 +99,7 @@ namespace BnZ {
         }
     }
 
-    WindowManager::WindowManager(uint32_t width, uint32_t height, const char* title) {
+    WindowManager::WindowManager(uint32_t width, uint32_t height, const char* title, bool visible) {
         glfwSetErrorCallback(errorCallback);
         
         int major, minor, rev;
@@ -116,6 +116,7 @@ namespace BnZ {
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
         glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
         glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+        glfwWindowHint(GLFW_VISIBLE, visible ? GL_TRUE : GL_FALSE);
         if (!(m_pWindow = glfwCreateWindow(width, height, title, nullptr, nullptr))) {
             glfwTerminate();
             throw std::runtime_error("glfwCreateWindow() error");
@@ -16,7 +16,8 @@ namespace BnZ {
         using KeyCallback = std::function < void(int key, int scancode, int action, int mods) > ;
         using CharCallback = std::function < void(unsigned int c) > ;
 
-        WindowManager(uint32_t width, uint32_t height, const char* title);
+        // If visible is false, the window is hidden and only used to hold the OpenGL context
+        WindowManager(uint32_t width, uint32_t height, const char* title, bool visible = true);
 
         ~WindowManager();
 
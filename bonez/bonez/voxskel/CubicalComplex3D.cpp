@@ -349,8 +349,8 @@ bool CubicalComplex3D::isFreeZPOS1D(int x, int y, int z) const{
 using CCPoint = std::tuple<Vec3i, uint32_t, uint32_t>; // Voxel + distance26 + opening26
 
 void computeCurvilinearGraph(const CubicalComplex3D& skeletonCC,
-                             const Grid3D<uint32_t> distance26Map,
-                             const Grid3D<uint32_t> opening26Map,
+                             const Grid3D<uint32_t>& distance26Map,
+                             const Grid3D<uint32_t>& opening26Map,
                              Grid3D<int>& gridToNode,
                              std::vector<CCPoint>& nodes,
                              Graph& graph) {
@@ -393,7 +393,7 @@ void computeCurvilinearGraph(const CubicalComplex3D& skeletonCC,
 }
 
 Grid3D<uint32_t> computeCurvilinearSkeletonMappingGrid(const CubicalComplex3D& originalObjectCC,
-                                                       const Grid3D<uint32_t> opening26Map,
+                                                       const Grid3D<uint32_t>& opening26Map,
                                                        const std::vector<CCPoint>& nodes) {
     Grid3D<uint32_t> mappingGrid(originalObjectCC.resolution(), UNDEFINED_NODE);
 
@@ -473,7 +473,7 @@ Grid3D<uint32_t> computeCurvilinearSkeletonMappingGrid(const CubicalComplex3D& o
 
 static CurvilinearSkeleton transformToCurvilinearSkeleton(
         const std::vector<CCPoint>& nodes, const Graph& graph,
-        const CubicalComplex3D& originalObjectCC, const Grid3D<uint32_t> opening26Map,
+        const CubicalComplex3D& originalObjectCC, const Grid3D<uint32_t>& opening26Map,
         const Mat4f& gridToWorld) {
     CurvilinearSkeleton skeleton;
     auto radiusScale = pow(determinant(Mat3f(gridToWorld)), 1.f / 3);
@@ -499,8 +499,8 @@ static CurvilinearSkeleton transformToCurvilinearSkeleton(
 
 CurvilinearSkeleton getCurvilinearSkeleton(const CubicalComplex3D& skeletonCC,
                                            const CubicalComplex3D& originalObjectCC,
-                                           const Grid3D<uint32_t> distance26Map,
-                                           const Grid3D<uint32_t> opening26Map,
+                                           const Grid3D<uint32_t>& distance26Map,
+                                           const Grid3D<uint32_t>& opening26Map,
                                            const Mat4f& gridToWorld) {
     std::vector<CCPoint> nodes;
     Graph graph;
@@ -513,8 +513,8 @@ CurvilinearSkeleton getCurvilinearSkeleton(const CubicalComplex3D& skeletonCC,
 
 CurvilinearSkeleton getSegmentedCurvilinearSkeleton(const CubicalComplex3D& skeletonCC,
                                                     const CubicalComplex3D& originalObjectCC,
-                                                    const Grid3D<uint32_t> distance26Map,
-                                                    const Grid3D<uint32_t> opening26Map,
+                                                    const Grid3D<uint32_t>& distance26Map,
+                                                    const Grid3D<uint32_t>& opening26Map,
                                                     const Mat4f& gridToWorld) {
 
     std::vector<CCPoint> nodes;
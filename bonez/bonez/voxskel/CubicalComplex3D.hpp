@@ -218,14 +218,14 @@ public:
 
 CurvilinearSkeleton getCurvilinearSkeleton(const CubicalComplex3D& skeletonCC,
                                            const CubicalComplex3D& originalObjectCC,
-                                           const Grid3D<uint32_t> distance26Map,
-                                           const Grid3D<uint32_t> opening26Map,
+                                           const Grid3D<uint32_t>& distance26Map,
+                                           const Grid3D<uint32_t>& opening26Map,
                                            const Mat4f& gridToWorld);
 
 CurvilinearSkeleton getSegmentedCurvilinearSkeleton(const CubicalComplex3D& skeletonCC,
                                                     const CubicalComplex3D& originalObjectCC,
-                                                    const Grid3D<uint32_t> distance26Map,
-                                                    const Grid3D<uint32_t> opening26Map,
+                                                    const Grid3D<uint32_t>& distance26Map,
+                                                    const Grid3D<uint32_t>& opening26Map,
                                                     const Mat4f& gridToWorld);
 
 CubicalComplex3D getCubicalComplex(const VoxelGrid& voxelGrid, bool getComplementary = false);
@@ -116,7 +116,8 @@ CubicalComplex3D getCubicalComplexFromVoxelFramebuffer(const GLVoxelFramebuffer&
         if (x == w - 1 || y == h - 1 || z == d - 1 || value != voxelBuffer(x + 1, y + 1, z + 1)) cubicalComplex(x + 1, y + 1, z + 1).add(CC3DFaceBits::POINT);
     };
 
-    voxelBuffer.processVoxels(processVoxel, getComplementary);
+    // processVoxel writes in the rows y and y + 1 of the cubical complex
+    voxelBuffer.parallelProcessVoxels(processVoxel, getComplementary);
 
     return cubicalComplex;
 }
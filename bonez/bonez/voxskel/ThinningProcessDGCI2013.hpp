@@ -2,6 +2,7 @@
 
 #include <bonez/types.hpp>
 #include <bonez/utils/Grid3D.hpp>
+#include <bonez/utils/SparseGrid3D.hpp>
 #include <bonez/sys/threads.hpp>
 
 #include "CubicalComplex3D.hpp"
@@ -25,7 +26,7 @@ public:
     // Same but using multiple threads
     bool parallelDirectionalCollapse(int iterCount = -1);
 
-    const Grid3D<Vec3i>& getBirthMap() const {
+    const SparseGrid3D<Vec3i>& getBirthMap() const {
         return m_BirthMap;
     }
 
@@ -47,9 +48,7 @@ public:
         ZEDGE_IDX = 2,
     };
 
-    Grid3D<Vec3i> m_BirthMap; // Contains the birth date of the edge of each voxel
-    Grid3D<Vec3i> m_EdgeDistanceMap;
-    Grid3D<Vec3i> m_EdgeOpeningMap;
+    SparseGrid3D<Vec3i> m_BirthMap; // Contains the birth date of the edge of each voxel, only edges of the skeleton have one
     uint32_t m_nIterationCount = 0u; // Number of thinning iterations already done
 
     const Grid3D<uint32_t>* m_pDistanceMap; // Distance to border for each voxel
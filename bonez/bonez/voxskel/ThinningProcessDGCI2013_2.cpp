@@ -22,78 +22,9 @@ void ThinningProcessDGCI2013_2::init(CubicalComplex3D& cc,
     m_nIterationCount = 0u;
 
     if(m_pDistanceMap && m_pOpeningMap) {
-        m_BirthMap = Grid3D<Vec3i>(cc.width(), cc.height(), cc.depth(), Vec3i(-1));
-        m_EdgeDistanceMap = Grid3D<Vec3i>(cc.width(), cc.height(), cc.depth(), Vec3i(0));
-        m_EdgeOpeningMap = Grid3D<Vec3i>(cc.width(), cc.height(), cc.depth(), Vec3i(0));
-
-        foreachVoxel(cc.resolution(), [&](const Vec3i& voxel) {
-            if(cc(voxel).containsSome(CC3DFaceBits::XEDGE)) {
-                auto maxDist = (*m_pDistanceMap)(voxel);
-                auto maxOpening = (*m_pOpeningMap)(voxel);
-
-                if(voxel.y > 0) {
-                    maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x, voxel.y - 1, voxel.z)));
-                    maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x, voxel.y - 1, voxel.z)));
-
-                    if(voxel.z > 0) {
-                        maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x, voxel.y - 1, voxel.z - 1)));
-                        maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x, voxel.y - 1, voxel.z - 1)));
-                    }
-                }
-
-                if(voxel.z > 0) {
-                    maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x, voxel.y, voxel.z - 1)));
-                    maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x, voxel.y, voxel.z - 1)));
-                }
-
-                m_EdgeDistanceMap(voxel)[XEDGE_IDX] = maxDist;
-                m_EdgeOpeningMap(voxel)[XEDGE_IDX] = maxOpening;
-            }
-            if(cc(voxel).containsSome(CC3DFaceBits::YEDGE)) {
-                auto maxDist = (*m_pDistanceMap)(voxel);
-                auto maxOpening = (*m_pOpeningMap)(voxel);
-
-                if(voxel.x > 0) {
-                    maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x - 1, voxel.y, voxel.z)));
-                    maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x - 1, voxel.y, voxel.z)));
-
-                    if(voxel.z > 0) {
-                        maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x - 1, voxel.y, voxel.z - 1)));
-                        maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x - 1, voxel.y, voxel.z - 1)));
-                    }
-                }
-
-                if(voxel.z > 0) {
-                    maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x, voxel.y, voxel.z - 1)));
-                    maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x, voxel.y, voxel.z - 1)));
-                }
-
-                m_EdgeDistanceMap(voxel)[YEDGE_IDX] = maxDist;
-                m_EdgeOpeningMap(voxel)[YEDGE_IDX] = maxOpening;
-            }
-            if(cc(voxel).containsSome(CC3DFaceBits::ZEDGE)) {
-                auto maxDist = (*m_pDistanceMap)(voxel);
-                auto maxOpening = (*m_pOpeningMap)(voxel);
-
-                if(voxel.x > 0) {
-                    maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x - 1, voxel.y, voxel.z)));
-                    maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x - 1, voxel.y, voxel.z)));
-
-                    if(voxel.y > 0) {
-                        maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x - 1, voxel.y - 1, voxel.z)));
-                        maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x - 1, voxel.y - 1, voxel.z)));
-                    }
-                }
-
-                if(voxel.y > 0) {
-                    maxDist = max(maxDist, (*m_pDistanceMap)(Vec3i(voxel.x, voxel.y - 1, voxel.z)));
-                    maxOpening = max(maxOpening, (*m_pOpeningMap)(Vec3i(voxel.x, voxel.y - 1, voxel.z)));
-                }
-
-                m_EdgeDistanceMap(voxel)[ZEDGE_IDX] = maxDist;
-                m_EdgeOpeningMap(voxel)[ZEDGE_IDX] = maxOpening;
-            }
-        });
+        // The distance and opening of an edge are computed when it is tested (isConstrainedEdge) instead of being stored:
+        // edges are only removed by the thinning, so they are the same as at initialization
+        m_BirthMap = SparseGrid3D<Vec3i>(cc.resolution(), Vec3i(-1));
     }
 
     // Compute border
@@ -203,8 +134,10 @@ bool ThinningProcessDGCI2013_2::isConstrainedEdge(int x, int y, int z, int edgeI
         auto lifespan = (int) m_nIterationCount - birthDate;
         //return lifespan > (int)(*m_pOpeningMap)(x, y, z) - 2 * (int)(*m_pDistanceMap)(x, y, z) + birthDate;
         //return lifespan > (int)(*m_pOpeningMap)(x, y, z) - 2 * (int)(*m_pDistanceMap)(x, y, z) + birthDate;
-        return lifespan > m_EdgeOpeningMap(x, y, z)[edgeIdx] - m_EdgeDistanceMap(x, y, z)[edgeIdx] + birthDate;
-        //return lifespan > m_EdgeOpeningMap(x, y, z)[edgeIdx] - 2 * m_EdgeDistanceMap(x, y, z)[edgeIdx] + birthDate;
+        auto edgeDistance = (int) getEdgeMaximum(*m_pDistanceMap, Vec3i(x, y, z), edgeIdx);
+        auto edgeOpening = (int) getEdgeMaximum(*m_pOpeningMap, Vec3i(x, y, z), edgeIdx);
+        return lifespan > edgeOpening - edgeDistance + birthDate;
+        //return lifespan > edgeOpening - 2 * edgeDistance + birthDate;
         //return lifespan > (int) (*m_pOpeningMap)(x, y, z) - (int) (*m_pDistanceMap)(x, y, z);
         //return (int) m_D1Map(x, y, z) == 1u;
     }
@@ -257,7 +190,9 @@ void ThinningProcessDGCI2013_2::updateBirthMap() {
            !((*m_pCC)(voxel.x, voxel.y, voxel.z).containsSome(CC3DFaceBits::XZFACE)) &&
            (y == 0 || !((*m_pCC)(voxel.x, voxel.y - 1, voxel.z).containsSome(CC3DFaceBits::XYFACE))) &&
            (z == 0 || !((*m_pCC)(voxel.x, voxel.y, voxel.z - 1).containsSome(CC3DFaceBits::XZFACE)))) {
-            m_BirthMap(voxel)[XEDGE_IDX] = m_nIterationCount;
+            auto birthDates = m_BirthMap(voxel);
+            birthDates[XEDGE_IDX] = m_nIterationCount;
+            m_BirthMap.set(voxel, birthDates);
         }
 
         if(m_BirthMap(voxel)[YEDGE_IDX] < 0 &&
@@ -266,7 +201,9 @@ void ThinningProcessDGCI2013_2::updateBirthMap() {
            !((*m_pCC)(voxel.x, voxel.y, voxel.z).containsSome(CC3DFaceBits::YZFACE)) &&
            (x == 0 || !((*m_pCC)(voxel.x - 1, voxel.y, voxel.z).containsSome(CC3DFaceBits::XYFACE))) &&
            (z == 0 || !((*m_pCC)(voxel.x, voxel.y, voxel.z - 1).containsSome(CC3DFaceBits::YZFACE)))) {
-            m_BirthMap(voxel)[YEDGE_IDX] = m_nIterationCount;
+            auto birthDates = m_BirthMap(voxel);
+            birthDates[YEDGE_IDX] = m_nIterationCount;
+            m_BirthMap.set(voxel, birthDates);
         }
 
         if(m_BirthMap(voxel)[ZEDGE_IDX] < 0 &&
@@ -275,7 +212,9 @@ void ThinningProcessDGCI2013_2::updateBirthMap() {
            !((*m_pCC)(voxel.x, voxel.y, voxel.z).containsSome(CC3DFaceBits::YZFACE)) &&
            (x == 0 || !((*m_pCC)(voxel.x - 1, voxel.y, voxel.z).containsSome(CC3DFaceBits::XZFACE))) &&
            (y == 0 || !((*m_pCC)(voxel.x, voxel.y - 1, voxel.z).containsSome(CC3DFaceBits::YZFACE)))) {
-            m_BirthMap(voxel)[ZEDGE_IDX] = m_nIterationCount;
+            auto birthDates = m_BirthMap(voxel);
+            birthDates[ZEDGE_IDX] = m_nIterationCount;
+            m_BirthMap.set(voxel, birthDates);
         }
     }
 }
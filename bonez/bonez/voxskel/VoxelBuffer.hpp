@@ -3,6 +3,7 @@
 #include <vector>
 #include <cstdint>
 #include <bonez/types.hpp>
+#include <bonez/sys/threads.hpp>
 
 #include "GLVoxelFramebuffer.hpp"
 
@@ -22,22 +23,46 @@ public:
     template<typename Functor>
     void processVoxels(Functor f, bool processComplementary = false) {
         for(auto texture = 0u; texture < m_numRenderTarget; ++texture) {
-            auto* pData = m_data.data() + texture *  m_width * m_height;
             //Convert data in voxel position
             for (auto i = 0u; i <  m_width * m_height; i++) {
-                auto x = i % m_width;
-                auto y = (i - x) / m_width;
-                for(auto j = 0u; j < 4; j++){
-                    for(auto k = 0u; k < 32; k++) {
-                        auto z = texture * 128 + j * 32 + k;
-                        if (z < m_depth && (
-                                (!processComplementary && (pData[i][j] & s_bitmask[k]) != 0) ||
-                                    (processComplementary && (pData[i][j] & s_bitmask[k]) == 0)
-                                    )) {
-                            f(x, y, z);
-                        }
+                processColumn(texture, i, f, processComplementary);
+            }
+        }
+    }
+
+    // Same as processVoxels, but the rows of voxels (fixed y) are processed in parallel. All even rows are processed
+    // before odd rows, so f(x, y, z) can safely write data associated to the rows y and y + 1.
+    template<typename Functor>
+    void parallelProcessVoxels(Functor f, bool processComplementary = false) {
+        for(auto parity = 0u; parity < 2u; ++parity) {
+            auto rowCount = (m_height + 1 - parity) / 2;
+            processTasks(rowCount, [&](uint32_t rowID, uint32_t threadID) {
+                auto y = 2 * rowID + parity;
+                for(auto texture = 0u; texture < m_numRenderTarget; ++texture) {
+                    for(auto x = 0u; x < m_width; ++x) {
+                        processColumn(texture, x + y * m_width, f, processComplementary);
                     }
                 }
+            }, getSystemThreadCount());
+        }
+    }
+
+private:
+    // Process the voxels of the pixel i stored in a texture
+    template<typename Functor>
+    void processColumn(uint32_t texture, uint32_t i, Functor& f, bool processComplementary) {
+        auto* pData = m_data.data() + texture *  m_width * m_height;
+        auto x = i % m_width;
+        auto y = (i - x) / m_width;
+        for(auto j = 0u; j < 4; j++){
+            for(auto k = 0u; k < 32; k++) {
+                auto z = texture * 128 + j * 32 + k;
+                if (z < m_depth && (
+                        (!processComplementary && (pData[i][j] & s_bitmask[k]) != 0) ||
+                            (processComplementary && (pData[i][j] & s_bitmask[k]) == 0)
+                            )) {
+                    f(x, y, z);
+                }
             }
         }
     }
@@ -264,14 +264,38 @@ Grid3D<uint32_t> computeOpeningMap26(Grid3D<uint32_t> distanceMap26, Grid3D<Vec3
 
 inline Grid3D<uint32_t> computeOpeningMap26(Grid3D<uint32_t> distanceMap26) {
     Grid3D<Vec3u> centerMap;
-    return computeOpeningMap26(distanceMap26, centerMap);
+    return computeOpeningMap26(std::move(distanceMap26), centerMap);
 }
 
 Grid3D<uint32_t> parallelComputeOpeningMap26(Grid3D<uint32_t> distanceMap26, Grid3D<Vec3u>& centerMap);
 
 inline Grid3D<uint32_t> parallelComputeOpeningMap26(Grid3D<uint32_t> distanceMap26) {
     Grid3D<Vec3u> centerMap;
-    return parallelComputeOpeningMap26(distanceMap26, centerMap);
+    return parallelComputeOpeningMap26(std::move(distanceMap26), centerMap);
+}
+
+// Maximal value of map over the voxels that share the edge of axis edgeAxis (0 = x, 1 = y, 2 = z) of voxel, which are voxel
+// and its neighbours in the negative directions of the two other axes. MapType is a Grid3D or a SparseGrid3D.
+template<typename MapType>
+inline uint32_t getEdgeMaximum(const MapType& map, const Vec3i& voxel, int edgeAxis) {
+    auto u = (edgeAxis + 1) % 3;
+    auto v = (edgeAxis + 2) % 3;
+    auto value = map(voxel);
+    if(voxel[u] > 0) {
+        auto neighbour = voxel;
+        --neighbour[u];
+        value = max(value, map(neighbour));
+        if(voxel[v] > 0) {
+            --neighbour[v];
+            value = max(value, map(neighbour));
+        }
+    }
+    if(voxel[v] > 0) {
+        auto neighbour = voxel;
+        --neighbour[v];
+        value = max(value, map(neighbour));
+    }
+    return value;
 }
 
 struct Ball26 {